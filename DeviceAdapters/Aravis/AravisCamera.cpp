@@ -33,6 +33,7 @@
 #include <string>
 #include <algorithm>
 #include <cstdint>
+#include <cstdlib>
 
 std::vector<std::string> supportedPixelFormats = {
   "Mono8",
@@ -40,10 +41,17 @@ std::vector<std::string> supportedPixelFormats = {
   "Mono12",
   "Mono14",
   "Mono16",
+  "Mono10p",
+  "Mono12p",
+  "Mono10Packed",
+  "Mono12Packed",
   "BayerRG8",
   "BayerRG10",
   "BayerRG12",
   "BayerRG16",
+  "BayerRG10p",
+  "BayerRG12p",
+  "BayerRG12Packed",
   "RGB8",
   "BGR8"
 };
@@ -59,6 +67,12 @@ MODULE_API void InitializeModuleData()
   // Debugging.
   //arv_debug_enable("all:1,device");
 
+  // The Aravis fake GigE camera is only listed on request, for testing
+  // without hardware.
+  if (getenv("MM_ARAVIS_FAKE_CAMERA") != NULL){
+    arv_enable_interface("Fake");
+  }
+
   // Update and get number of aravis compatible cameras.
   arv_update_device_list();
   nDevices = arv_get_n_devices();
@@ -124,13 +138,20 @@ AravisCamera::AravisCamera(const char *name) :
   img_buffer_size(0),
   img_buffer_width(0),
   initialized(false),  
+  img_buffer_packed(false),
+  img_buffer_packed_format(PackedPixels::Mono12p),
+  stream_buffer_count(50),
+  stream_buffer_size(0),
   arv_buffer(nullptr),
   arv_cam(nullptr),
   arv_cam_name(nullptr),
+  arv_pixel_format(0),
+  arv_pixel_format_queried(0),
   arv_stream(nullptr),
   img_buffer(nullptr),
   pixel_type(nullptr)
 {
+  std::fill(stream_statistics, stream_statistics + STREAM_N_STATISTICS, 0);
   arv_cam_name = (char *)malloc(sizeof(char) * strlen(name));
   CDeviceUtils::CopyLimitedString(arv_cam_name, name);
 }
@@ -161,41 +182,56 @@ void AravisCamera::AcquisitionCallback(ArvStreamCallbackType type, ArvBuffer *cb
     arv_make_thread_high_priority(-10);
     break;
   case ARV_STREAM_CALLBACK_TYPE_BUFFER_DONE:
-
-    // Copy buffer data.
+  {
     g_assert(cb_arv_buffer == arv_stream_pop_buffer(arv_stream));
     g_assert(cb_arv_buffer != NULL);
-    ArvBufferUpdate(cb_arv_buffer);
-
-    // Image metadata.
-    md.put(MM::g_Keyword_Metadata_CameraLabel, "");
-    md.put(MM::g_Keyword_Metadata_ROI_X, CDeviceUtils::ConvertToString((long)img_buffer_width));
-    md.put(MM::g_Keyword_Metadata_ROI_Y, CDeviceUtils::ConvertToString((long)img_buffer_height));
-    md.put(MM::g_Keyword_Metadata_ImageNumber, CDeviceUtils::ConvertToString(counter));
-    md.put(MM::g_Keyword_Metadata_Exposure, exposure_time);
-    md.put(MM::g_Keyword_PixelType, pixel_type);
-    
-    // Pass data to MM.
-    int ret = GetCoreCallback()->InsertImage(this,
-					     img_buffer,
-					     img_buffer_width,
-					     img_buffer_height,
-					     img_buffer_bytes_per_pixel,
-					     1,
-					     md.Serialize().c_str(),
-					     FALSE);
-    if (ret == DEVICE_BUFFER_OVERFLOW) {
-      GetCoreCallback()->ClearImageBuffer(this);
+
+    // The image is inserted straight from the stream buffer, unless it
+    // has to be unpacked or converted to RGBA first. Incomplete frames
+    // are dropped (they are counted in the stream statistics).
+    const unsigned char *data = ArvBufferUpdate(cb_arv_buffer, false);
+    if (data != nullptr){
+      // Image metadata.
+      md.put(MM::g_Keyword_Metadata_CameraLabel, "");
+      md.put(MM::g_Keyword_Metadata_ROI_X, CDeviceUtils::ConvertToString((long)img_buffer_width));
+      md.put(MM::g_Keyword_Metadata_ROI_Y, CDeviceUtils::ConvertToString((long)img_buffer_height));
+      md.put(MM::g_Keyword_Metadata_ImageNumber, CDeviceUtils::ConvertToString(counter));
+      md.put(MM::g_Keyword_Metadata_Exposure, exposure_time);
+      md.put(MM::g_Keyword_PixelType, pixel_type);
+
+      guint64 timestamp = arv_buffer_get_timestamp(cb_arv_buffer);
+      if (timestamp != 0){
+        md.put(MM::g_Keyword_Metadata_HardwareTimestamp_ns, timestamp);
+      }
+
+      // Pass data to MM.
+      int ret = GetCoreCallback()->InsertImage(this,
+                                               data,
+                                               img_buffer_width,
+                                               img_buffer_height,
+                                               img_buffer_bytes_per_pixel,
+                                               1,
+                                               md.Serialize().c_str(),
+                                               FALSE);
+      if (ret == DEVICE_BUFFER_OVERFLOW) {
+        GetCoreCallback()->ClearImageBuffer(this);
+      }
+      counter += 1;
     }
-    
+
     arv_stream_push_buffer(arv_stream, cb_arv_buffer);
-    counter += 1;
+    break;
+  }
+  default:
     break;
   }
 }
 
 
-void AravisCamera::ArvBufferUpdate(ArvBuffer *aBuffer)
+// Returns the image in MM layout: the Aravis buffer data itself if it
+// needs no conversion and copy is false, otherwise img_buffer. Returns
+// nullptr if the buffer does not hold a complete image.
+const unsigned char *AravisCamera::ArvBufferUpdate(ArvBuffer *aBuffer, bool copy)
 {
   int status;
   size_t arvSize, size;
@@ -203,24 +239,33 @@ void AravisCamera::ArvBufferUpdate(ArvBuffer *aBuffer)
   unsigned char *arvBufferData;
   
   status = arv_buffer_get_status(aBuffer);
-  if (status != 0){
-    printf("Error, Aravis buffer status is %d\n", status);
-    return;
+  if (status != ARV_BUFFER_STATUS_SUCCESS){
+    LogMessage("Aravis buffer status is " + std::to_string(status), true);
+    return nullptr;
   }
 
   // Pixel format updates.
   arvPixelFormat = arv_buffer_get_image_pixel_format(aBuffer);
-  ArvPixelFormatUpdate(arvPixelFormat);
+  if (arvPixelFormat != arv_pixel_format){
+    ArvPixelFormatUpdate(arvPixelFormat);
+  }
 
   // Image size updates.
   img_buffer_width = (int)arv_buffer_get_image_width(aBuffer);
   img_buffer_height = (int)arv_buffer_get_image_height(aBuffer);
   img_buffer_number_pixels = img_buffer_width * img_buffer_height;
 
-  // Copy buffer to MM.
   arvBufferData = (unsigned char *)arv_buffer_get_data(aBuffer, &arvSize);
   size = img_buffer_width * img_buffer_height * img_buffer_bytes_per_pixel;
 
+  bool convert = img_buffer_packed || (img_buffer_number_components != 1);
+  if (!convert && !copy){
+    if (arvSize < size){
+      return nullptr;
+    }
+    return arvBufferData;
+  }
+
   if (img_buffer_size != size){
     if (img_buffer != nullptr){
       free(img_buffer);
@@ -228,12 +273,19 @@ void AravisCamera::ArvBufferUpdate(ArvBuffer *aBuffer)
     img_buffer = (unsigned char *)malloc(size);
     img_buffer_size = size;
   }
-  if (img_buffer_number_components == 1){
-    memcpy(img_buffer, arvBufferData, size);
+  if (img_buffer_packed){
+    if (arvSize < PackedPixels::PackedBytes(img_buffer_packed_format, img_buffer_number_pixels)){
+      return nullptr;
+    }
+    PackedPixels::Unpack(img_buffer_packed_format, (unsigned short *)img_buffer, arvBufferData, img_buffer_number_pixels);
+  }
+  else if (img_buffer_number_components == 1){
+    memcpy(img_buffer, arvBufferData, std::min(size, arvSize));
   }
   else{
     rgb_to_rgba(img_buffer, arvBufferData, img_buffer_number_pixels);
-  }  
+  }
+  return img_buffer;
 }
 
 
@@ -263,9 +315,33 @@ void AravisCamera::ArvGetExposure()
 }
 
 
+// Get the pixel format from the camera, and keep its name for identifying
+// formats that Aravis has no constant for. Buffers only carry the code,
+// and the camera is not asked again while acquiring.
+void AravisCamera::ArvPixelFormatQuery()
+{
+  GError *gerror = nullptr;
+  guint32 arvPixelFormat;
+
+  arvPixelFormat = arv_camera_get_pixel_format(arv_cam, &gerror);
+  if (ArvCheckError(gerror)){
+    return;
+  }
+  const char *name = arv_camera_get_pixel_format_as_string(arv_cam, &gerror);
+  if (!ArvCheckError(gerror) && name != nullptr){
+    arv_pixel_format_queried = arvPixelFormat;
+    arv_pixel_format_name = name;
+  }
+  ArvPixelFormatUpdate(arvPixelFormat);
+}
+
+
 // Update MM image values based on pixel format.
 void AravisCamera::ArvPixelFormatUpdate(guint32 arvPixelFormat)
 {
+  arv_pixel_format = arvPixelFormat;
+  img_buffer_packed = false;
+
   switch (arvPixelFormat){
   case ARV_PIXEL_FORMAT_MONO_8:
     img_buffer_bit_depth = 8;
@@ -280,7 +356,7 @@ void AravisCamera::ArvPixelFormatUpdate(guint32 arvPixelFormat)
     pixel_type = "10bit mono";
     break;
   case ARV_PIXEL_FORMAT_MONO_12:
-    img_buffer_bit_depth = 10;
+    img_buffer_bit_depth = 12;
     img_buffer_bytes_per_pixel = 2;
     img_buffer_number_components = 1;
     pixel_type = "12bit mono";
@@ -337,7 +413,23 @@ void AravisCamera::ArvPixelFormatUpdate(guint32 arvPixelFormat)
     break;
 
   default:
-    printf ("Aravis Error: Pixel Format %d is not implemented\n", (int)arvPixelFormat);
+    {
+      // Packed 10 and 12 bit formats are identified by their PFNC name,
+      // and unpacked to 16 bits per pixel.
+      PackedPixels::Format format;
+      if (arvPixelFormat == arv_pixel_format_queried &&
+          PackedPixels::FormatFromName(arv_pixel_format_name.c_str(), format)){
+        img_buffer_packed = true;
+        img_buffer_packed_format = format;
+        img_buffer_bit_depth = PackedPixels::BitDepth(format);
+        img_buffer_bytes_per_pixel = 2;
+        img_buffer_number_components = 1;
+        pixel_type = img_buffer_bit_depth == 10 ? "10bit mono" : "12bit mono";
+      }
+      else{
+        printf ("Aravis Error: Pixel Format %d is not implemented\n", (int)arvPixelFormat);
+      }
+    }
     break;
   }
 }
@@ -350,6 +442,7 @@ int AravisCamera::ArvStartSequenceAcquisition()
   GError *gerror = nullptr;
 
   counter = 0;
+  ArvPixelFormatQuery();
     
   arv_camera_set_acquisition_mode(arv_cam, ARV_ACQUISITION_MODE_CONTINUOUS, &gerror);
   if (!ArvCheckError(gerror)){
@@ -365,8 +458,9 @@ int AravisCamera::ArvStartSequenceAcquisition()
   if (ARV_IS_STREAM(arv_stream)){
     payload = arv_camera_get_payload(arv_cam, &gerror);
     if (!ArvCheckError(gerror)){
-      for (i = 0; i < 20; i++)
-	arv_stream_push_buffer(arv_stream, arv_buffer_new(payload, NULL));
+      size_t size = std::max(payload, (size_t)stream_buffer_size);
+      for (i = 0; i < stream_buffer_count; i++)
+	arv_stream_push_buffer(arv_stream, arv_buffer_new(size, NULL));
     }
     arv_camera_start_acquisition(arv_cam, &gerror);
     if (ArvCheckError(gerror)){
@@ -376,11 +470,43 @@ int AravisCamera::ArvStartSequenceAcquisition()
   else{
     return 1;
   }
+  std::fill(stream_statistics, stream_statistics + STREAM_N_STATISTICS, 0);
   capturing = true;
   return 0;
 }
 
 
+// Stream statistics are kept after the stream is destroyed.
+void AravisCamera::ArvUpdateStreamStatistics()
+{
+  guint64 completed, failures, underruns;
+
+  if (!ARV_IS_STREAM(arv_stream)){
+    return;
+  }
+
+  arv_stream_get_statistics(arv_stream, &completed, &failures, &underruns);
+  stream_statistics[STREAM_COMPLETED] = completed;
+  stream_statistics[STREAM_FAILURES] = failures;
+  stream_statistics[STREAM_UNDERRUNS] = underruns;
+
+  // Packet statistics are only available for GigE Vision streams.
+  guint nInfos = arv_stream_get_n_infos(arv_stream);
+  for (guint i = 0; i < nInfos; i++){
+    const char *name = arv_stream_get_info_name(arv_stream, i);
+    if (name == NULL || arv_stream_get_info_type(arv_stream, i) != G_TYPE_UINT64){
+      continue;
+    }
+    if (strcmp(name, "n_resent_packets") == 0){
+      stream_statistics[STREAM_RESENT_PACKETS] = arv_stream_get_info_uint64(arv_stream, i);
+    }
+    else if (strcmp(name, "n_missing_packets") == 0){
+      stream_statistics[STREAM_MISSING_PACKETS] = arv_stream_get_info_uint64(arv_stream, i);
+    }
+  }
+}
+
+
 int AravisCamera::ClearROI()
 {
   gint h,tmp,w;
@@ -436,10 +562,10 @@ const unsigned char* AravisCamera::GetImageBuffer()
   unsigned char *arv_buffer_data;
 
   if (ARV_IS_BUFFER (arv_buffer)) {
-    ArvBufferUpdate(arv_buffer);
+    const unsigned char *data = ArvBufferUpdate(arv_buffer, true);
     g_clear_object(&arv_buffer);
     SetProperty(MM::g_Keyword_PixelType, pixel_type);
-    return img_buffer;
+    return data;
   }
   return NULL;
 }
@@ -528,10 +654,7 @@ int AravisCamera::Initialize()
   img_buffer_width = (int)w;
 
   // Set image properties based on current pixel type.
-  guint32 arvPixelFormat;
-  arvPixelFormat = arv_camera_get_pixel_format(arv_cam, &gerror);
-  ArvCheckError(gerror);
-  ArvPixelFormatUpdate(arvPixelFormat);
+  ArvPixelFormatQuery();
 
   // Turn off auto exposure.
   arv_camera_set_exposure_time_auto(arv_cam, ARV_AUTO_OFF, &gerror);
@@ -738,6 +861,30 @@ int AravisCamera::Initialize()
   }
   g_free(triggerSources);
 
+  // Stream buffers.
+  pAct = new CPropertyAction(this, &AravisCamera::OnStreamBufferCount);
+  ret = CreateIntegerProperty("StreamBufferCount", stream_buffer_count, false, pAct);
+  assert(ret == DEVICE_OK);
+  SetPropertyLimits("StreamBufferCount", 2, 1000);
+
+  pAct = new CPropertyAction(this, &AravisCamera::OnStreamBufferSize);
+  ret = CreateIntegerProperty("StreamBufferSize", stream_buffer_size, false, pAct);
+  assert(ret == DEVICE_OK);
+
+  // Stream statistics of the current (or last) sequence acquisition.
+  const char *statisticNames[STREAM_N_STATISTICS] = {
+    "StreamCompletedBuffers",
+    "StreamFailures",
+    "StreamUnderruns",
+    "StreamResentPackets",
+    "StreamMissingPackets"
+  };
+  for (i = 0; i < STREAM_N_STATISTICS; i++){
+    CPropertyActionEx *pActEx = new CPropertyActionEx(this, &AravisCamera::OnStreamStatistic, i);
+    ret = CreateIntegerProperty(statisticNames[i], 0, true, pActEx);
+    assert(ret == DEVICE_OK);
+  }
+
   initialized = true;
     
   return DEVICE_OK;
@@ -976,16 +1123,13 @@ int AravisCamera::OnPixelType(MM::PropertyBase* pProp, MM::ActionType eAct)
 
   if (eAct == MM::AfterSet){
     if (!capturing){
-      guint32 arvPixelFormat;
       std::string pixelType;
       pProp->Get(pixelType);
       
       arv_camera_set_pixel_format_from_string(arv_cam, pixelType.c_str(), &gerror);
       ArvCheckError(gerror);
       
-      arvPixelFormat = arv_camera_get_pixel_format(arv_cam, &gerror);
-      ArvCheckError(gerror);
-      ArvPixelFormatUpdate(arvPixelFormat);
+      ArvPixelFormatQuery();
     }
   }
   else if (eAct == MM::BeforeGet) {
@@ -1000,6 +1144,54 @@ int AravisCamera::OnPixelType(MM::PropertyBase* pProp, MM::ActionType eAct)
 }
 
 
+int AravisCamera::OnStreamBufferCount(MM::PropertyBase* pProp, MM::ActionType eAct)
+{
+  if (eAct == MM::AfterSet){
+    if (capturing){
+      return DEVICE_CAMERA_BUSY_ACQUIRING;
+    }
+    pProp->Get(stream_buffer_count);
+  }
+  else if (eAct == MM::BeforeGet){
+    pProp->Set(stream_buffer_count);
+  }
+  return DEVICE_OK;
+}
+
+
+// Minimum size of the stream buffers in bytes; 0 uses the camera payload.
+int AravisCamera::OnStreamBufferSize(MM::PropertyBase* pProp, MM::ActionType eAct)
+{
+  if (eAct == MM::AfterSet){
+    if (capturing){
+      return DEVICE_CAMERA_BUSY_ACQUIRING;
+    }
+    long size;
+    pProp->Get(size);
+    if (size < 0){
+      return DEVICE_INVALID_PROPERTY_VALUE;
+    }
+    stream_buffer_size = size;
+  }
+  else if (eAct == MM::BeforeGet){
+    pProp->Set(stream_buffer_size);
+  }
+  return DEVICE_OK;
+}
+
+
+int AravisCamera::OnStreamStatistic(MM::PropertyBase* pProp, MM::ActionType eAct, long index)
+{
+  if (eAct == MM::BeforeGet){
+    if (capturing){
+      ArvUpdateStreamStatistics();
+    }
+    pProp->Set((long)stream_statistics[index]);
+  }
+  return DEVICE_OK;
+}
+
+
 int AravisCamera::OnTriggerMode(MM::PropertyBase* pProp, MM::ActionType eAct)
 {
   GError *gerror = nullptr;
@@ -1201,6 +1393,7 @@ int AravisCamera::StopSequenceAcquisition()
     capturing = false;
     arv_camera_stop_acquisition(arv_cam, &gerror);
     ArvCheckError(gerror);
+    ArvUpdateStreamStatistics();
     g_clear_object(&arv_stream);
     
     GetCoreCallback()->AcqFinished(this, 0);
@@ -36,6 +36,7 @@
 #include <stdio.h>
 */
 #include "DeviceBase.h"
+#include "PackedPixels.h"
 #include "arv.h"
 #include "glib.h"
 
@@ -91,20 +92,35 @@ public:
   int OnGamma(MM::PropertyBase* pProp, MM::ActionType eAct);
   int OnGammaEnable(MM::PropertyBase* pProp, MM::ActionType eAct);
   int OnPixelType(MM::PropertyBase* pProp, MM::ActionType eAct);
+  int OnStreamBufferCount(MM::PropertyBase* pProp, MM::ActionType eAct);
+  int OnStreamBufferSize(MM::PropertyBase* pProp, MM::ActionType eAct);
+  int OnStreamStatistic(MM::PropertyBase* pProp, MM::ActionType eAct, long index);
   int OnTriggerMode(MM::PropertyBase* pProp, MM::ActionType eAct);
   int OnTriggerSelector(MM::PropertyBase* pProp, MM::ActionType eAct);
   int OnTriggerSource(MM::PropertyBase* pProp, MM::ActionType eAct);
 
   // Internal.
   void AcquisitionCallback(ArvStreamCallbackType, ArvBuffer *);
-  void ArvBufferUpdate(ArvBuffer *aBuffer);
+  const unsigned char *ArvBufferUpdate(ArvBuffer *aBuffer, bool copy);
   int ArvCheckError(GError *gerror) const;
   void ArvGetExposure();
+  void ArvPixelFormatQuery();
   void ArvPixelFormatUpdate(guint32 arvPixelFormat);
   int ArvStartSequenceAcquisition();
+  void ArvUpdateStreamStatistics();
 
   
 private:
+  // Stream statistics, in the order of the property indices.
+  enum StreamStatistic {
+    STREAM_COMPLETED,
+    STREAM_FAILURES,
+    STREAM_UNDERRUNS,
+    STREAM_RESENT_PACKETS,
+    STREAM_MISSING_PACKETS,
+    STREAM_N_STATISTICS
+  };
+
   bool capturing;
   long counter;
   double exposure_time;
@@ -116,11 +132,19 @@ private:
   size_t img_buffer_size;
   int img_buffer_width;
   bool initialized;
+  bool img_buffer_packed;
+  PackedPixels::Format img_buffer_packed_format;
+  long stream_buffer_count;
+  long stream_buffer_size;
+  guint64 stream_statistics[STREAM_N_STATISTICS];
 
   ArvBuffer *arv_buffer;
   ArvCamera *arv_cam;
   char *arv_cam_name;
   ArvDevice *arv_device;
+  guint32 arv_pixel_format;
+  guint32 arv_pixel_format_queried;
+  std::string arv_pixel_format_name;
   ArvStream *arv_stream;
   unsigned char *img_buffer;
   const char *pixel_type;
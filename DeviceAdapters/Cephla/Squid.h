@@ -3,9 +3,14 @@
 
 #include "MMDevice.h"
 #include "DeviceBase.h"
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
 #include <cstdint>
+#include <deque>
 #include <thread>
 #include <mutex>
+#include <vector>
 
 
 #define ERR_PORT_CHANGE_FORBIDDEN    21001 
@@ -82,6 +87,7 @@ extern const char* g_Acceleration;
 extern const char* g_Max_Velocity;
 
 class SquidMonitoringThread;
+class SquidSimulator;
 class SquidXYStage;
 class SquidZStage;
 
@@ -102,9 +108,17 @@ public:
 
    int OnPort(MM::PropertyBase* pProp, MM::ActionType eAct);
    int OnAutoHome(MM::PropertyBase* pProp, MM::ActionType eAct);
+   int OnSimulate(MM::PropertyBase* pProp, MM::ActionType eAct);
+   int OnBatchCommands(MM::PropertyBase* pProp, MM::ActionType eAct);
+   int OnRoundTrip(MM::PropertyBase* pProp, MM::ActionType eAct);
 
    bool IsPortAvailable() { return (port_ != ""); };
    int SendCommand(unsigned char* cmd, unsigned cmdSize);
+   // Commands sent between StartBatch and EndBatch are written to the
+   // controller in a single write by EndBatch. Calls may be nested.
+   void StartBatch();
+   int EndBatch();
+   int ReadFromController(unsigned char* buf, unsigned long bufLength, unsigned long& charsRead);
    int SendMoveCommand(const int cmd, long steps);
    int SetMaxVelocityAndAcceleration(unsigned char axis, double maxVelocity, double acceleration);
    int Home();
@@ -127,8 +141,17 @@ public:
 
 
 private:
+   int WriteToController(const unsigned char* data, unsigned long length);
+
    bool initialized_;
    bool autoHome_;
+   bool simulate_;
+   bool batchProperty_;
+   int batchDepth_;
+   std::vector<unsigned char> batch_;
+   std::chrono::steady_clock::time_point sendTime_;
+   std::atomic_long roundTripUs_;
+   SquidSimulator* simulator_;
    SquidMonitoringThread* monitoringThread_;
    SquidXYStage* xyStageDevice_;
    SquidZStage* zStageDevice_;
@@ -380,13 +403,17 @@ private:
 
 class SquidMessageParser {
 public:
-   SquidMessageParser(unsigned char* inputStream, long inputStreamLength);
+   SquidMessageParser(const unsigned char* inputStream, long inputStreamLength);
    ~SquidMessageParser() {};
-   int GetNextMessage(unsigned char* nextMessage, int& nextMessageLength);
+   // Points nextMessage at the next complete message in the input stream
+   int GetNextMessage(const unsigned char*& nextMessage);
+   // Trailing bytes that do not form a complete message
+   const unsigned char* GetRemaining() const { return inputStream_ + index_; }
+   long GetRemainingLength() const { return inputStreamLength_ - index_; }
    static const int messageMaxLength_ = 24;
 
 private:
-   unsigned char* inputStream_;
+   const unsigned char* inputStream_;
    long inputStreamLength_;
    long index_;
 };
@@ -399,21 +426,62 @@ public:
    int svc();
 
    void Start();
-   void Stop() { stop_ = true; }
+   void Stop();
+   // Called after a command was sent, so that its answer is read right away
+   void Wake();
 
 private:
-   void InterpretMessage(unsigned char* message);
+   void InterpretMessage(const unsigned char* message);
    bool IsBigEndian(void);
-   static const int RCV_BUF_LENGTH = 48; // contains 2 messages.  If set to 24, we crash...
+   static const int RCV_BUF_LENGTH = 64 * SquidMessageParser::messageMaxLength_;
    MM::Core& core_;
    SquidHub& hub_;
    bool debug_;
-   bool stop_;
+   std::atomic_bool stop_;
+   bool woken_;
    long intervalUs_;
+   long busyIntervalUs_;
+   std::mutex wakeMutex_;
+   std::condition_variable wakeCondition_;
    std::thread* ourThread_;
    bool isBigEndian_;
    unsigned int counter_;
    SquidMonitoringThread& operator=(SquidMonitoringThread& /*rhs*/) { assert(false); return *this; }
 };
 
-#endif _SQUID_H_
\ No newline at end of file
+/*
+ * Software model of the Squid controller firmware, used by the hub instead of
+ * the serial port when "Simulate" is set. Executes the 8-byte commands
+ * (checksum, stage moves at the configured maximum velocity, homing) and
+ * produces the 24-byte status messages, both in answer to each command and
+ * at the firmware's regular update interval.
+ */
+class SquidSimulator {
+public:
+   SquidSimulator();
+   ~SquidSimulator() {};
+
+   void Write(const unsigned char* data, unsigned long length);
+   void Read(unsigned char* buf, unsigned long bufLength, unsigned long& charsRead);
+
+   static const int commandLength_ = 8;
+
+private:
+   void Execute(const unsigned char* cmd);
+   void Advance();
+   void QueueStatus();
+
+   std::mutex mutex_;
+   std::deque<unsigned char> output_;
+   std::vector<unsigned char> pendingInput_;
+   double position_[3];
+   double target_[3];
+   double stepsPerMs_[3];
+   unsigned char lastCmdNr_;
+   unsigned char lastCmdAxes_; // bit mask of the axes moved by the last command
+   bool checksumError_;
+   std::chrono::steady_clock::time_point lastAdvance_;
+   std::chrono::steady_clock::time_point lastReport_;
+};
+
+#endif // _SQUID_H_
\ No newline at end of file
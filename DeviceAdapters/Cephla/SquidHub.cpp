@@ -15,6 +15,9 @@ const char* g_Yes = "Yes";
 const char* g_No = "No";
 const char* g_Acceleration = "Acceleration(mm/s^2)";
 const char* g_Max_Velocity = "Max Velocity(mm/s)";
+const char* g_Simulate = "Simulate";
+const char* g_BatchCommands = "Batch commands";
+const char* g_RoundTrip = "Command round trip(ms)";
 
 
 MODULE_API void InitializeModuleData() 
@@ -74,6 +77,10 @@ MODULE_API void DeleteDevice(MM::Device* pDevice)
 SquidHub::SquidHub() :
    initialized_(false),
    autoHome_(false),
+   simulate_(false),
+   batchProperty_(false),
+   batchDepth_(0),
+   simulator_(0),
    monitoringThread_(0),
    xyStageDevice_(0),
    zStageDevice_(0),
@@ -88,6 +95,7 @@ SquidHub::SquidHub() :
    x_ = 0l;
    y_ = 0l;
    z_ = 0l;
+   roundTripUs_ = 0l;
    dac_div_ =  0;
    dac_gains_ = 0;
    xStageBusy_ = false;
@@ -99,6 +107,11 @@ SquidHub::SquidHub() :
    CreateProperty(g_AutoHome, g_No, MM::String, false, pAct, true);
    AddAllowedValue(g_AutoHome, g_Yes);
    AddAllowedValue(g_AutoHome, g_No);
+
+   pAct = new CPropertyAction(this, &SquidHub::OnSimulate);
+   CreateProperty(g_Simulate, g_No, MM::String, false, pAct, true);
+   AddAllowedValue(g_Simulate, g_Yes);
+   AddAllowedValue(g_Simulate, g_No);
 }
 
 
@@ -119,7 +132,10 @@ void SquidHub::GetName(char* name) const
 
 
 int SquidHub::Initialize() {
-   Sleep(200);
+   if (simulate_)
+      simulator_ = new SquidSimulator();
+   else
+      Sleep(200);
 
    monitoringThread_ = new SquidMonitoringThread(*this->GetCoreCallback(), *this, true);
    monitoringThread_->Start();
@@ -131,14 +147,16 @@ int SquidHub::Initialize() {
    for (unsigned i = 2; i < cmdSize; i++) {
       cmd[i] = 0;
    }
+   StartBatch();
    int ret = SendCommand(cmd, cmdSize);
-   if (ret != DEVICE_OK) {
-      return ret;
+   if (ret == DEVICE_OK) {
+      cmd[0] = 1;
+      cmd[1] = 254; // CMD_INITIALIZE_DRIVERS
+      ret = SendCommand(cmd, cmdSize);
    }
-
-   cmd[0] = 1; 
-   cmd[1] = 254; // CMD_INITIALIZE_DRIVERS
-   ret = SendCommand(cmd, cmdSize);
+   int batchRet = EndBatch();
+   if (ret == DEVICE_OK)
+      ret = batchRet;
    if (ret != DEVICE_OK) {
       delete (monitoringThread_);
       monitoringThread_ = 0;
@@ -153,6 +171,14 @@ int SquidHub::Initialize() {
       }
    }
 
+   CPropertyAction* pAct = new CPropertyAction(this, &SquidHub::OnBatchCommands);
+   CreateProperty(g_BatchCommands, g_No, MM::String, false, pAct);
+   AddAllowedValue(g_BatchCommands, g_Yes);
+   AddAllowedValue(g_BatchCommands, g_No);
+
+   pAct = new CPropertyAction(this, &SquidHub::OnRoundTrip);
+   CreateProperty(g_RoundTrip, "0", MM::Float, true, pAct);
+
    initialized_ = true;
 
    return DEVICE_OK;
@@ -165,6 +191,12 @@ int SquidHub::Shutdown() {
       if (monitoringThread_ != 0)
       {
          delete(monitoringThread_);
+         monitoringThread_ = 0;
+      }
+      if (simulator_ != 0)
+      {
+         delete(simulator_);
+         simulator_ = 0;
       }
       initialized_ = false;
    }
@@ -257,20 +289,78 @@ int SquidHub::AssignZStageDevice(SquidZStage* zStageDevice)
 
 int SquidHub::SendCommand(unsigned char* cmd, unsigned cmdSize)
 {
-   std::lock_guard<std::mutex> lck(mutex_);
-   cmd[0] = ++cmdNrSend_;
-   cmd[cmdSize - 1] = crc8ccitt(cmd, cmdSize - 1);
-   if (true) {
-      std::ostringstream os;
-      os << "Sending message: ";
-      for (unsigned int i = 0; i < cmdSize; i++) {
-         os << std::hex << (unsigned int)cmd[i] << " ";
+   int ret;
+   {
+      std::lock_guard<std::mutex> lck(mutex_);
+      cmd[0] = ++cmdNrSend_;
+      cmd[cmdSize - 1] = crc8ccitt(cmd, cmdSize - 1);
+      if (true) {
+         std::ostringstream os;
+         os << "Sending message: ";
+         for (unsigned int i = 0; i < cmdSize; i++) {
+            os << std::hex << (unsigned int)cmd[i] << " ";
+         }
+         LogMessage(os.str().c_str(), false);
+      }
+      if (batchDepth_ > 0)
+      {
+         batch_.insert(batch_.end(), cmd, cmd + cmdSize);
+         return DEVICE_OK;
       }
-      LogMessage(os.str().c_str(), false);
+      ret = WriteToController(cmd, cmdSize);
    }
+   if (monitoringThread_ != 0)
+      monitoringThread_->Wake();
+   return ret;
+}
+
+
+void SquidHub::StartBatch()
+{
+   std::lock_guard<std::mutex> lck(mutex_);
+   batchDepth_++;
+}
+
+
+int SquidHub::EndBatch()
+{
+   int ret = DEVICE_OK;
+   {
+      std::lock_guard<std::mutex> lck(mutex_);
+      if (batchDepth_ == 0 || --batchDepth_ > 0 || batch_.empty())
+         return DEVICE_OK;
+      ret = WriteToController(&batch_[0], (unsigned long)batch_.size());
+      batch_.clear();
+   }
+   if (monitoringThread_ != 0)
+      monitoringThread_->Wake();
+   return ret;
+}
+
+
+// Called with mutex_ held
+int SquidHub::WriteToController(const unsigned char* data, unsigned long length)
+{
    busy_ = true;
    status_ = IN_PROGRESS;
-   return WriteToComPort(port_.c_str(), cmd, cmdSize);
+   sendTime_ = std::chrono::steady_clock::now();
+   if (simulator_ != 0)
+   {
+      simulator_->Write(data, length);
+      return DEVICE_OK;
+   }
+   return WriteToComPort(port_.c_str(), data, length);
+}
+
+
+int SquidHub::ReadFromController(unsigned char* buf, unsigned long bufLength, unsigned long& charsRead)
+{
+   if (simulator_ != 0)
+   {
+      simulator_->Read(buf, bufLength, charsRead);
+      return DEVICE_OK;
+   }
+   return GetCoreCallback()->ReadFromSerial(this, port_.c_str(), buf, bufLength, charsRead);
 }
 
 
@@ -282,6 +372,12 @@ void SquidHub::SetCmdNrReceived(uint8_t cmdNrReceived, uint8_t status)
       if (cmdNrReceived_ == cmdNrSend_)
       {
          status_ = status;
+         if (busy_)
+         {
+            std::lock_guard<std::mutex> lck(mutex_);
+            roundTripUs_ = (long)std::chrono::duration_cast<std::chrono::microseconds>(
+               std::chrono::steady_clock::now() - sendTime_).count();
+         }
          busy_ = false;
       }
    }
@@ -433,6 +529,70 @@ int SquidHub::OnAutoHome(MM::PropertyBase* pProp, MM::ActionType eAct)
 }
 
 
+int SquidHub::OnSimulate(MM::PropertyBase* pProp, MM::ActionType eAct)
+{
+   std::string response;
+   if (eAct == MM::BeforeGet)
+   {
+      response = simulate_ ? g_Yes : g_No;
+      pProp->Set(response.c_str());
+   }
+   else if (eAct == MM::AfterSet)
+   {
+      if (initialized_)
+      {
+         pProp->Set(simulate_ ? g_Yes : g_No);
+         return ERR_PORT_CHANGE_FORBIDDEN;
+      }
+      pProp->Get(response);
+      simulate_ = response == g_Yes;
+   }
+   return DEVICE_OK;
+}
+
+
+/**
+ * While set to Yes, commands from the hub and its peripherals (DA outputs,
+ * stage moves, illumination) are collected instead of sent. Setting it
+ * back to No sends them to the controller in a single write.
+ */
+int SquidHub::OnBatchCommands(MM::PropertyBase* pProp, MM::ActionType eAct)
+{
+   if (eAct == MM::BeforeGet)
+   {
+      pProp->Set(batchProperty_ ? g_Yes : g_No);
+   }
+   else if (eAct == MM::AfterSet)
+   {
+      std::string response;
+      pProp->Get(response);
+      bool batch = response == g_Yes;
+      if (batch == batchProperty_)
+         return DEVICE_OK;
+      batchProperty_ = batch;
+      if (batch)
+         StartBatch();
+      else
+         return EndBatch();
+   }
+   return DEVICE_OK;
+}
+
+
+/**
+ * Time between sending the last command and receiving the controller's
+ * acknowledgement of it
+ */
+int SquidHub::OnRoundTrip(MM::PropertyBase* pProp, MM::ActionType eAct)
+{
+   if (eAct == MM::BeforeGet)
+   {
+      pProp->Set(roundTripUs_.load() / 1000.0);
+   }
+   return DEVICE_OK;
+}
+
+
 int SquidHub::Home()
 {
    const unsigned cmdSize = 8;
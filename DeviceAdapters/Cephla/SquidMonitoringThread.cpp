@@ -4,9 +4,9 @@
 
 /*
  * Utility class for SquidMonitoringThread
- * Takes an input stream and returns messages in the GetNextMessage method
+ * Splits an input stream into messages without copying them
  */
-SquidMessageParser::SquidMessageParser(unsigned char* inputStream, long inputStreamLength) :
+SquidMessageParser::SquidMessageParser(const unsigned char* inputStream, long inputStreamLength) :
    index_(0)
 {
    inputStream_ = inputStream;
@@ -15,31 +15,14 @@ SquidMessageParser::SquidMessageParser(unsigned char* inputStream, long inputStr
 
 /*
  * Provides the next message in the inputStream.
- * Returns 0 on success, -1 when no message was found
+ * Returns 0 on success, -1 when no complete message is left
  */
-int SquidMessageParser::GetNextMessage(unsigned char* nextMessage, int& nextMessageLength) {
-
-   bool msgFound = false;
-   while (!msgFound)
-   {
-      nextMessageLength = 0;
-      while ((index_ < inputStreamLength_) && (nextMessageLength < messageMaxLength_)) {
-         nextMessage[nextMessageLength] = inputStream_[index_];
-         nextMessageLength++;
-         index_++;
-      }
-
-      if (nextMessageLength == messageMaxLength_)
-      {
-         msgFound = true;
-         return 0;
-      }
-      else //  index_ == inputStreamLength_
-      {
-         return -1;
-      }
-   }
-   return -1; // should never be reached
+int SquidMessageParser::GetNextMessage(const unsigned char*& nextMessage) {
+   if (inputStreamLength_ - index_ < messageMaxLength_)
+      return -1;
+   nextMessage = inputStream_ + index_;
+   index_ += messageMaxLength_;
+   return 0;
 }
 
 
@@ -48,7 +31,9 @@ SquidMonitoringThread::SquidMonitoringThread(MM::Core& core, SquidHub& hub, bool
    hub_(hub),
    debug_(debug),
    stop_(true),
-   intervalUs_(10000), // check every 10 ms for new messages, 
+   woken_(false),
+   intervalUs_(10000), // check every 10 ms for new messages when idle,
+   busyIntervalUs_(1000), // and every ms while a command is in progress
    ourThread_(0),
    counter_(0)
 {
@@ -57,8 +42,9 @@ SquidMonitoringThread::SquidMonitoringThread(MM::Core& core, SquidHub& hub, bool
 
 SquidMonitoringThread::~SquidMonitoringThread()
 {
-   stop_ = true;
+   Stop();
    ourThread_->join();
+   delete ourThread_;
    //hub_.LogMessage("Destructing MonitoringThread", true);
 }
 
@@ -74,7 +60,7 @@ SquidMonitoringThread::~SquidMonitoringThread()
 23 - CRC checksum(appears not to be set)
 */
 
-void SquidMonitoringThread::InterpretMessage(unsigned char* message)
+void SquidMonitoringThread::InterpretMessage(const unsigned char* message)
 {
    if (debug_ && (counter_ % 100 == 0)) {
       std::ostringstream os;
@@ -117,78 +103,46 @@ int SquidMonitoringThread::svc() {
 
    //core_.LogMessage(&device_, "Starting MonitoringThread", true);
 
-   unsigned long dataLength;
    unsigned long charsRead = 0;
    unsigned long charsRemaining = 0;
-   unsigned char rcvBuf[RCV_BUF_LENGTH];
-   memset(rcvBuf, 0, RCV_BUF_LENGTH);
+   std::vector<unsigned char> rcvBuf(RCV_BUF_LENGTH);
 
    while (!stop_)
    {
+      // Read and interpret everything that has arrived
       do {
-         if (charsRemaining > (RCV_BUF_LENGTH - SquidMessageParser::messageMaxLength_)) {
-            // for one reason or another, our buffer is overflowing.  Empty it out before we crash
-            charsRemaining = 0;
-         }
-         dataLength = RCV_BUF_LENGTH - charsRemaining;
-
-         // Do the scope monitoring stuff here
-         // MM::MMTime _start = core_.GetCurrentMMTime();
-
-         int ret = core_.ReadFromSerial(&hub_, hub_.port_.c_str(), rcvBuf + charsRemaining, dataLength, charsRead);
-
-         //std::ostringstream os;
-         //os << "Monitoring Thread read from Serial: ";
-         //for (int i = 0; i < charsRead; i++) {
-         //   os << std::hex << (unsigned int)rcvBuf[i] << " ";
-         //}
-         //core_.LogMessage(&hub_, os.str().c_str(), false);
-  
-         // MM::MMTime _end = core_.GetCurrentMMTime();
-         // std::ostringstream os;
-         // MM::MMTime t = _end-_start;
-         // os << "ReadFromSerial took: " << t.sec_ << " seconds and " << t.uSec_ / 1000.0 << " msec";
-         // core_.LogMessage(&device_, os.str().c_str(), true);
+         int ret = hub_.ReadFromController(&rcvBuf[charsRemaining],
+            RCV_BUF_LENGTH - charsRemaining, charsRead);
 
          if (ret != DEVICE_OK) {
             std::ostringstream oss;
             oss << "Monitoring Thread: ERROR while reading from serial port, error code: " << ret;
             core_.LogMessage(&hub_, oss.str().c_str(), false);
+            charsRead = 0;
          }
          else if (charsRead > 0) {
-            SquidMessageParser parser(rcvBuf, charsRead + charsRemaining);
-            do {
-               unsigned char message[RCV_BUF_LENGTH];
-               int messageLength;
-               ret = parser.GetNextMessage(message, messageLength);
-               if (ret == 0) {
-                  // Report 
-                  // and do the real stuff
-                  InterpretMessage(message);
-               }
-               else {
-                  // no more messages, copy remaining (if any) back to beginning of buffer
-                  if (debug_ && messageLength > 0) {
-                     std::ostringstream oos;
-                     oos << "Monitoring Thread no message found!: ";
-                     for (int i = 0; i < messageLength; i++) {
-                        oos << std::hex << (unsigned int)message[i] << " ";
-                        rcvBuf[i] = message[i];
-                     }
-                     //core_.LogMessage(&hub_, os.str().c_str(), false);
-                  }
-                  memset(rcvBuf, 0, RCV_BUF_LENGTH);
-                  for (int i = 0; i < messageLength; i++) {
-                     rcvBuf[i] = message[i];
-                  }
-                  charsRemaining = messageLength;
-               }
-            } while (ret == 0);
+            SquidMessageParser parser(&rcvBuf[0], charsRead + charsRemaining);
+            const unsigned char* message;
+            while (parser.GetNextMessage(message) == 0) {
+               InterpretMessage(message);
+            }
+            // keep the start of an incomplete message for the next read
+            charsRemaining = parser.GetRemainingLength();
+            memmove(&rcvBuf[0], parser.GetRemaining(), charsRemaining);
          }
       } while ((charsRead != 0) && (!stop_));
-      CDeviceUtils::SleepMs(intervalUs_ / 1000);
+
+      // Wait for the next status message. The serial port cannot notify
+      // us, so poll quickly while a command or move is in progress, and
+      // otherwise sleep until a new command is sent (or at the idle
+      // interval, to follow joystick moves).
+      long waitUs = (hub_.XYStageBusy() || hub_.ZStageBusy()) ? busyIntervalUs_ : intervalUs_;
+      std::unique_lock<std::mutex> lock(wakeMutex_);
+      wakeCondition_.wait_for(lock, std::chrono::microseconds(waitUs),
+         [this] { return woken_ || stop_; });
+      woken_ = false;
    }
-    return 0;
+   return 0;
 }
 
 
@@ -198,6 +152,20 @@ void SquidMonitoringThread::Start()
    ourThread_ = new std::thread(&SquidMonitoringThread::svc, this);
 }
 
+void SquidMonitoringThread::Stop()
+{
+   std::lock_guard<std::mutex> lock(wakeMutex_);
+   stop_ = true;
+   wakeCondition_.notify_one();
+}
+
+void SquidMonitoringThread::Wake()
+{
+   std::lock_guard<std::mutex> lock(wakeMutex_);
+   woken_ = true;
+   wakeCondition_.notify_one();
+}
+
 bool SquidMonitoringThread::IsBigEndian(void)
 {
    union {
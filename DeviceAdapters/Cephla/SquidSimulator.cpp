@@ -0,0 +1,192 @@
+#include "Squid.h"
+#include "crc8.h"
+
+/*
+ * Stage geometry and speeds of the default configuration (see
+ * SquidXYStage.cpp): 256 microsteps, 200 full steps per revolution and
+ * screw pitches of 2.54 mm (XY) and 0.3 mm (Z).
+ */
+const double SIM_STEPS_PER_MM[3] = {
+   256 * 200 / 2.54,
+   256 * 200 / 2.54,
+   256 * 200 / 0.3
+};
+const double SIM_DEFAULT_VELOCITY_MM_S[3] = { 25.0, 25.0, 5.0 };
+
+// The firmware sends a status message at least this often
+const long SIM_REPORT_INTERVAL_US = 10000;
+
+// Status messages that nobody reads are dropped beyond this number
+const size_t SIM_MAX_QUEUED_MESSAGES = 64;
+
+
+SquidSimulator::SquidSimulator() :
+   lastCmdNr_(0),
+   lastCmdAxes_(0),
+   checksumError_(false)
+{
+   for (int axis = 0; axis < 3; axis++)
+   {
+      position_[axis] = 0.0;
+      target_[axis] = 0.0;
+      stepsPerMs_[axis] = SIM_DEFAULT_VELOCITY_MM_S[axis] * SIM_STEPS_PER_MM[axis] / 1000.0;
+   }
+   lastAdvance_ = std::chrono::steady_clock::now();
+   lastReport_ = lastAdvance_;
+}
+
+
+/*
+ * Commands arrive in the same way as through the serial port, i.e. possibly
+ * several per write, or split across writes
+ */
+void SquidSimulator::Write(const unsigned char* data, unsigned long length)
+{
+   std::lock_guard<std::mutex> lock(mutex_);
+   Advance();
+   pendingInput_.insert(pendingInput_.end(), data, data + length);
+   // a batch reports "in progress" until all axes it moves have arrived
+   if (pendingInput_.size() >= (size_t) commandLength_)
+      lastCmdAxes_ = 0;
+   size_t offset = 0;
+   while (pendingInput_.size() - offset >= (size_t) commandLength_)
+   {
+      Execute(&pendingInput_[offset]);
+      offset += commandLength_;
+   }
+   pendingInput_.erase(pendingInput_.begin(), pendingInput_.begin() + offset);
+
+   // the firmware answers each (batch of) command(s) right away
+   QueueStatus();
+}
+
+
+void SquidSimulator::Read(unsigned char* buf, unsigned long bufLength, unsigned long& charsRead)
+{
+   std::lock_guard<std::mutex> lock(mutex_);
+   Advance();
+   charsRead = (unsigned long) std::min<size_t>(bufLength, output_.size());
+   std::copy(output_.begin(), output_.begin() + charsRead, buf);
+   output_.erase(output_.begin(), output_.begin() + charsRead);
+}
+
+
+void SquidSimulator::Execute(const unsigned char* cmd)
+{
+   lastCmdNr_ = cmd[0];
+   checksumError_ = crc8ccitt(cmd, commandLength_ - 1) != cmd[commandLength_ - 1];
+   if (checksumError_)
+      return;
+
+   int32_t steps = (int32_t) (((uint32_t) cmd[2] << 24) | ((uint32_t) cmd[3] << 16) |
+      ((uint32_t) cmd[4] << 8) | (uint32_t) cmd[5]);
+
+   switch (cmd[1])
+   {
+   case CMD_MOVE_X:
+   case CMD_MOVE_Y:
+   case CMD_MOVE_Z:
+      target_[cmd[1]] += steps;
+      lastCmdAxes_ |= (unsigned char) (1 << cmd[1]);
+      break;
+   case CMD_MOVETO_X:
+   case CMD_MOVETO_Y:
+   case CMD_MOVETO_Z:
+   {
+      int axis = cmd[1] - CMD_MOVETO_X;
+      target_[axis] = steps;
+      lastCmdAxes_ |= (unsigned char) (1 << axis);
+      break;
+   }
+   case CMD_HOME_OR_ZERO:
+      if (cmd[2] == AXIS_XY)
+      {
+         target_[AXIS_X] = target_[AXIS_Y] = 0.0;
+         lastCmdAxes_ |= (1 << AXIS_X) | (1 << AXIS_Y);
+      }
+      else if (cmd[2] <= AXIS_Z)
+      {
+         target_[cmd[2]] = 0.0;
+         lastCmdAxes_ |= (unsigned char) (1 << cmd[2]);
+      }
+      break;
+   case CMD_SET_MAX_VELOCITY_ACCELERATION:
+      if (cmd[2] <= AXIS_Z)
+      {
+         double velocity = ((cmd[3] << 8) | cmd[4]) / 100.0;
+         stepsPerMs_[cmd[2]] = velocity * SIM_STEPS_PER_MM[cmd[2]] / 1000.0;
+      }
+      break;
+   case CMD_RESET:
+      for (int axis = 0; axis < 3; axis++)
+         position_[axis] = target_[axis] = 0.0;
+      break;
+   default:
+      // illumination, DAC and configuration commands complete immediately
+      break;
+   }
+}
+
+
+/*
+ * Moves the axes up to the current time and queues the regular status
+ * messages that were due in the meantime (at most one, like the firmware,
+ * which reports the current state rather than a history)
+ */
+void SquidSimulator::Advance()
+{
+   std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+   double elapsedMs = std::chrono::duration<double, std::milli>(now - lastAdvance_).count();
+   lastAdvance_ = now;
+   for (int axis = 0; axis < 3; axis++)
+   {
+      double maxMove = stepsPerMs_[axis] * elapsedMs;
+      double distance = target_[axis] - position_[axis];
+      if (std::abs(distance) <= maxMove)
+         position_[axis] = target_[axis];
+      else
+         position_[axis] += distance > 0 ? maxMove : -maxMove;
+   }
+
+   if (std::chrono::duration_cast<std::chrono::microseconds>(now - lastReport_).count() >=
+      SIM_REPORT_INTERVAL_US)
+   {
+      QueueStatus();
+   }
+}
+
+
+// Message layout as described in SquidMonitoringThread.cpp
+void SquidSimulator::QueueStatus()
+{
+   unsigned char message[SquidMessageParser::messageMaxLength_] = { 0 };
+   message[0] = lastCmdNr_;
+   if (checksumError_)
+   {
+      message[1] = CMD_CHECKSUM_ERROR;
+   }
+   else
+   {
+      message[1] = COMPLETED_WITHOUT_ERRORS;
+      for (int axis = 0; axis < 3; axis++)
+      {
+         if ((lastCmdAxes_ & (1 << axis)) && position_[axis] != target_[axis])
+            message[1] = IN_PROGRESS;
+      }
+   }
+   for (int axis = 0; axis < 3; axis++)
+   {
+      uint32_t pos = (uint32_t) (int32_t) position_[axis];
+      message[2 + 4 * axis] = (unsigned char) (pos >> 24);
+      message[3 + 4 * axis] = (unsigned char) (pos >> 16);
+      message[4 + 4 * axis] = (unsigned char) (pos >> 8);
+      message[5 + 4 * axis] = (unsigned char) pos;
+   }
+   message[SquidMessageParser::messageMaxLength_ - 1] =
+      crc8ccitt(message, SquidMessageParser::messageMaxLength_ - 1);
+
+   while (output_.size() >= SIM_MAX_QUEUED_MESSAGES * SquidMessageParser::messageMaxLength_)
+      output_.erase(output_.begin(), output_.begin() + SquidMessageParser::messageMaxLength_);
+   output_.insert(output_.end(), message, message + SquidMessageParser::messageMaxLength_);
+   lastReport_ = lastAdvance_;
+}
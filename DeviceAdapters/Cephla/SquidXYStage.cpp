@@ -176,10 +176,13 @@ int SquidXYStage::Home()
 */
 int SquidXYStage::SetPositionSteps(long xSteps, long ySteps)
 {
+   // both axes go out in a single write, so that they start together
+   hub_->StartBatch();
    int ret = hub_->SendMoveCommand(CMD_MOVETO_X, xSteps);
-   if (ret != DEVICE_OK)
-      return ret;
-   return hub_->SendMoveCommand(CMD_MOVETO_Y, ySteps);
+   if (ret == DEVICE_OK)
+      ret = hub_->SendMoveCommand(CMD_MOVETO_Y, ySteps);
+   int batchRet = hub_->EndBatch();
+   return ret != DEVICE_OK ? ret : batchRet;
 }
 
 
@@ -189,10 +192,12 @@ int SquidXYStage::SetPositionSteps(long xSteps, long ySteps)
 */
 int SquidXYStage::SetRelativePositionSteps(long xSteps, long ySteps)
 {
+   hub_->StartBatch();
    int ret = hub_->SendMoveCommand(CMD_MOVE_X, xSteps);
-   if (ret != DEVICE_OK)
-      return ret;
-   return hub_->SendMoveCommand(CMD_MOVE_Y, ySteps);
+   if (ret == DEVICE_OK)
+      ret = hub_->SendMoveCommand(CMD_MOVE_Y, ySteps);
+   int batchRet = hub_->EndBatch();
+   return ret != DEVICE_OK ? ret : batchRet;
 }
 
 
@@ -213,10 +218,12 @@ int SquidXYStage::OnAcceleration(MM::PropertyBase* pProp, MM::ActionType eAct)
    else if (eAct == MM::AfterSet)
    {
       pProp->Get(acceleration_);
+      hub_->StartBatch();
       int ret = hub_->SetMaxVelocityAndAcceleration(AXIS_X, maxVelocity_, acceleration_);
-      if (ret != DEVICE_OK)
-         return ret;
-      return hub_->SetMaxVelocityAndAcceleration(AXIS_Y, maxVelocity_, acceleration_);
+      if (ret == DEVICE_OK)
+         ret = hub_->SetMaxVelocityAndAcceleration(AXIS_Y, maxVelocity_, acceleration_);
+      int batchRet = hub_->EndBatch();
+      return ret != DEVICE_OK ? ret : batchRet;
    }
    return DEVICE_OK;
 }
@@ -231,10 +238,12 @@ int SquidXYStage::OnMaxVelocity(MM::PropertyBase* pProp, MM::ActionType eAct)
    else if (eAct == MM::AfterSet)
    {
       pProp->Get(maxVelocity_);
+      hub_->StartBatch();
       int ret = hub_->SetMaxVelocityAndAcceleration(AXIS_X, maxVelocity_, acceleration_);
-      if (ret != DEVICE_OK)
-         return ret;
-      return hub_->SetMaxVelocityAndAcceleration(AXIS_Y, maxVelocity_, acceleration_);
+      if (ret == DEVICE_OK)
+         ret = hub_->SetMaxVelocityAndAcceleration(AXIS_Y, maxVelocity_, acceleration_);
+      int batchRet = hub_->EndBatch();
+      return ret != DEVICE_OK ? ret : batchRet;
    }
    return DEVICE_OK;
 }
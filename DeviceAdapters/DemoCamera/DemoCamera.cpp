@@ -1215,6 +1215,7 @@ void MySequenceThread::Start(long numImages, double intervalMs)
    imageCounter_=0;
    stop_ = false;
    suspend_=false;
+   setAttributes(camera_->GetAcquisitionThreadAttributes());
    activate();
    actualDuration_ = MM::MMTime{};
    startTime_= camera_->GetCurrentMMTime();
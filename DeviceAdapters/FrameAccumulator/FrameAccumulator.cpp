@@ -0,0 +1,268 @@
+///////////////////////////////////////////////////////////////////////////////
+// FILE:          FrameAccumulator.cpp
+// PROJECT:       Micro-Manager
+// SUBSYSTEM:     DeviceAdapters
+//-----------------------------------------------------------------------------
+// DESCRIPTION:   Image processor that averages, sums or max-projects camera
+//                frames over a window of N frames.
+//
+// LICENSE:       This file is distributed under the BSD license.
+//                License text is included with the source distribution.
+//
+//                This file is distributed in the hope that it will be useful,
+//                but WITHOUT ANY WARRANTY; without even the implied warranty
+//                of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+//
+//                IN NO EVENT SHALL THE COPYRIGHT OWNER OR
+//                CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+//                INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES.
+
+#include "FrameAccumulator.h"
+
+#include "ModuleInterface.h"
+
+#include <cstring>
+#include <new>
+
+const char* g_DeviceName = "FrameAccumulator";
+
+const char* g_PropMode = "Mode";
+const char* g_PropFrameCount = "FrameCount";
+const char* g_PropOutput = "Output";
+const char* g_PropReset = "Reset";
+
+const char* g_ModeMean = "Mean";
+const char* g_ModeExponentialMean = "Exponential Mean";
+const char* g_ModeSum = "Sum";
+const char* g_ModeMax = "Max Projection";
+
+const char* g_OutputEveryFrame = "Every frame";
+const char* g_OutputEveryNth = "Every Nth frame";
+
+const char* g_ResetIdle = "Idle";
+const char* g_ResetNow = "Reset";
+
+///////////////////////////////////////////////////////////////////////////////
+// Exported MMDevice API
+///////////////////////////////////////////////////////////////////////////////
+
+MODULE_API void InitializeModuleData()
+{
+   RegisterDevice(g_DeviceName, MM::ImageProcessorDevice,
+         "Frame averaging, summation and max projection");
+}
+
+MODULE_API MM::Device* CreateDevice(const char* deviceName)
+{
+   if (deviceName == 0)
+      return 0;
+
+   if (strcmp(deviceName, g_DeviceName) == 0)
+      return new FrameAccumulator();
+
+   return 0;
+}
+
+MODULE_API void DeleteDevice(MM::Device* pDevice)
+{
+   delete pDevice;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// FrameAccumulator
+///////////////////////////////////////////////////////////////////////////////
+
+FrameAccumulator::FrameAccumulator() :
+   initialized_(false),
+   mode_(ImgAccumulator::Mean),
+   frameCount_(4),
+   runningWindow_(true),
+   settingsChanged_(true),
+   framesSinceOutput_(0)
+{
+   InitializeDefaultErrorMessages();
+   SetErrorText(DEVICE_UNSUPPORTED_DATA_FORMAT, "Unsupported image pixel type");
+   SetErrorText(DEVICE_OUT_OF_MEMORY, "Not enough memory for the frame window");
+}
+
+FrameAccumulator::~FrameAccumulator()
+{
+   Shutdown();
+}
+
+void FrameAccumulator::GetName(char* name) const
+{
+   CDeviceUtils::CopyLimitedString(name, g_DeviceName);
+}
+
+int FrameAccumulator::Initialize()
+{
+   if (initialized_)
+      return DEVICE_OK;
+
+   CPropertyAction* pAct = new CPropertyAction(this, &FrameAccumulator::OnMode);
+   int ret = CreateStringProperty(g_PropMode, g_ModeMean, false, pAct);
+   if (ret != DEVICE_OK)
+      return ret;
+   AddAllowedValue(g_PropMode, g_ModeMean);
+   AddAllowedValue(g_PropMode, g_ModeExponentialMean);
+   AddAllowedValue(g_PropMode, g_ModeSum);
+   AddAllowedValue(g_PropMode, g_ModeMax);
+
+   pAct = new CPropertyAction(this, &FrameAccumulator::OnFrameCount);
+   ret = CreateIntegerProperty(g_PropFrameCount, frameCount_, false, pAct);
+   if (ret != DEVICE_OK)
+      return ret;
+   SetPropertyLimits(g_PropFrameCount, 1, ImgAccumulator::MaxLength);
+
+   pAct = new CPropertyAction(this, &FrameAccumulator::OnOutput);
+   ret = CreateStringProperty(g_PropOutput, g_OutputEveryFrame, false, pAct);
+   if (ret != DEVICE_OK)
+      return ret;
+   AddAllowedValue(g_PropOutput, g_OutputEveryFrame);
+   AddAllowedValue(g_PropOutput, g_OutputEveryNth);
+
+   pAct = new CPropertyAction(this, &FrameAccumulator::OnReset);
+   ret = CreateStringProperty(g_PropReset, g_ResetIdle, false, pAct);
+   if (ret != DEVICE_OK)
+      return ret;
+   AddAllowedValue(g_PropReset, g_ResetIdle);
+   AddAllowedValue(g_PropReset, g_ResetNow);
+
+   initialized_ = true;
+   return DEVICE_OK;
+}
+
+int FrameAccumulator::Shutdown()
+{
+   initialized_ = false;
+   return DEVICE_OK;
+}
+
+int FrameAccumulator::Process(unsigned char* buffer, unsigned width, unsigned height, unsigned byteDepth)
+{
+   MMThreadGuard guard(lock_);
+
+   if (settingsChanged_ || !accumulator_.Matches(width, height, byteDepth))
+   {
+      try
+      {
+         if (!accumulator_.Setup(mode_, static_cast<unsigned>(frameCount_),
+               runningWindow_, width, height, byteDepth))
+            return DEVICE_UNSUPPORTED_DATA_FORMAT;
+      }
+      catch (const std::bad_alloc&)
+      {
+         return DEVICE_OUT_OF_MEMORY;
+      }
+      settingsChanged_ = false;
+      framesSinceOutput_ = 0;
+   }
+
+   accumulator_.AddPixels(buffer);
+
+   if (!runningWindow_)
+   {
+      if (++framesSinceOutput_ < frameCount_)
+         return DEVICE_IMAGE_CONSUMED;
+      framesSinceOutput_ = 0;
+   }
+
+   accumulator_.CalculateOutputImage(buffer);
+
+   // Blocks of N frames do not overlap (the exponential mean carries over)
+   if (!runningWindow_ && mode_ != ImgAccumulator::ExponentialMean)
+      accumulator_.ResetPixels();
+
+   return DEVICE_OK;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// Action handlers
+///////////////////////////////////////////////////////////////////////////////
+
+int FrameAccumulator::OnMode(MM::PropertyBase* pProp, MM::ActionType eAct)
+{
+   if (eAct == MM::BeforeGet)
+   {
+      switch (mode_)
+      {
+         case ImgAccumulator::Mean: pProp->Set(g_ModeMean); break;
+         case ImgAccumulator::ExponentialMean: pProp->Set(g_ModeExponentialMean); break;
+         case ImgAccumulator::Sum: pProp->Set(g_ModeSum); break;
+         case ImgAccumulator::Max: pProp->Set(g_ModeMax); break;
+      }
+   }
+   else if (eAct == MM::AfterSet)
+   {
+      std::string value;
+      pProp->Get(value);
+      MMThreadGuard guard(lock_);
+      if (value == g_ModeExponentialMean)
+         mode_ = ImgAccumulator::ExponentialMean;
+      else if (value == g_ModeSum)
+         mode_ = ImgAccumulator::Sum;
+      else if (value == g_ModeMax)
+         mode_ = ImgAccumulator::Max;
+      else
+         mode_ = ImgAccumulator::Mean;
+      settingsChanged_ = true;
+   }
+   return DEVICE_OK;
+}
+
+int FrameAccumulator::OnFrameCount(MM::PropertyBase* pProp, MM::ActionType eAct)
+{
+   if (eAct == MM::BeforeGet)
+   {
+      pProp->Set(frameCount_);
+   }
+   else if (eAct == MM::AfterSet)
+   {
+      long value;
+      pProp->Get(value);
+      if (value < 1 || value > static_cast<long>(ImgAccumulator::MaxLength))
+         return DEVICE_INVALID_PROPERTY_VALUE;
+      MMThreadGuard guard(lock_);
+      frameCount_ = value;
+      settingsChanged_ = true;
+   }
+   return DEVICE_OK;
+}
+
+int FrameAccumulator::OnOutput(MM::PropertyBase* pProp, MM::ActionType eAct)
+{
+   if (eAct == MM::BeforeGet)
+   {
+      pProp->Set(runningWindow_ ? g_OutputEveryFrame : g_OutputEveryNth);
+   }
+   else if (eAct == MM::AfterSet)
+   {
+      std::string value;
+      pProp->Get(value);
+      MMThreadGuard guard(lock_);
+      runningWindow_ = (value != g_OutputEveryNth);
+      settingsChanged_ = true;
+   }
+   return DEVICE_OK;
+}
+
+int FrameAccumulator::OnReset(MM::PropertyBase* pProp, MM::ActionType eAct)
+{
+   if (eAct == MM::BeforeGet)
+   {
+      pProp->Set(g_ResetIdle);
+   }
+   else if (eAct == MM::AfterSet)
+   {
+      std::string value;
+      pProp->Get(value);
+      if (value == g_ResetNow)
+      {
+         MMThreadGuard guard(lock_);
+         accumulator_.ResetPixels();
+         framesSinceOutput_ = 0;
+      }
+   }
+   return DEVICE_OK;
+}
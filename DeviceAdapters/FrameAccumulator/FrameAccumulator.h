@@ -0,0 +1,70 @@
+///////////////////////////////////////////////////////////////////////////////
+// FILE:          FrameAccumulator.h
+// PROJECT:       Micro-Manager
+// SUBSYSTEM:     DeviceAdapters
+//-----------------------------------------------------------------------------
+// DESCRIPTION:   Image processor that averages, sums or max-projects camera
+//                frames over a window of N frames.
+//
+// LICENSE:       This file is distributed under the BSD license.
+//                License text is included with the source distribution.
+//
+//                This file is distributed in the hope that it will be useful,
+//                but WITHOUT ANY WARRANTY; without even the implied warranty
+//                of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+//
+//                IN NO EVENT SHALL THE COPYRIGHT OWNER OR
+//                CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+//                INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES.
+
+#pragma once
+
+#include "ImgAccumulator.h"
+
+#include "DeviceBase.h"
+#include "DeviceThreads.h"
+
+#include <string>
+
+//////////////////////////////////////////////////////////////////////////////
+// FrameAccumulator class
+//
+// In "Every frame" output mode, each frame is replaced by the result over
+// the last N frames (running window). In "Every Nth frame" mode, N frames are
+// accumulated and only the result is inserted into the sequence buffer; the
+// other frames are consumed (DEVICE_IMAGE_CONSUMED), so the camera thread
+// never waits for anything beyond accumulating one frame.
+//////////////////////////////////////////////////////////////////////////////
+class FrameAccumulator : public CImageProcessorBase<FrameAccumulator>
+{
+public:
+   FrameAccumulator();
+   ~FrameAccumulator();
+
+   int Initialize();
+   int Shutdown();
+   void GetName(char* name) const;
+   bool Busy() { return false; }
+
+   int Process(unsigned char* buffer, unsigned width, unsigned height, unsigned byteDepth);
+
+   // action interface
+   // ----------------
+   int OnMode(MM::PropertyBase* pProp, MM::ActionType eAct);
+   int OnFrameCount(MM::PropertyBase* pProp, MM::ActionType eAct);
+   int OnOutput(MM::PropertyBase* pProp, MM::ActionType eAct);
+   int OnReset(MM::PropertyBase* pProp, MM::ActionType eAct);
+
+private:
+   bool initialized_;
+
+   // Settings are applied to the accumulator on the next frame
+   MMThreadLock lock_;
+   ImgAccumulator::Mode mode_;
+   long frameCount_;
+   bool runningWindow_;
+   bool settingsChanged_;
+
+   ImgAccumulator accumulator_; // Guarded by lock_
+   long framesSinceOutput_;
+};
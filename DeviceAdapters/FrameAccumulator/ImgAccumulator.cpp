@@ -0,0 +1,397 @@
+///////////////////////////////////////////////////////////////////////////////
+// FILE:          ImgAccumulator.cpp
+// PROJECT:       Micro-Manager
+// SUBSYSTEM:     DeviceAdapters
+//-----------------------------------------------------------------------------
+// DESCRIPTION:   Frame accumulator (running mean, exponential moving average,
+//                sum and maximum projection over N frames). Generalized from
+//                the TwoPhoton adapter's ImgAccumulator.
+//
+// AUTHOR:        Nenad Amodaj, November 2009 (original ImgAccumulator)
+//
+// COPYRIGHT:     Nenad Amodaj 2011, 100X Imaging Inc 2009
+//
+// LICENSE:       This library is free software; you can redistribute it and/or
+//                modify it under the terms of the GNU Lesser General Public
+//                License as published by the Free Software Foundation.
+//
+//                You should have received a copy of the GNU Lesser General Public
+//                License along with the source distribution; if not, write to
+//                the Free Software Foundation, Inc., 59 Temple Place, Suite 330,
+//                Boston, MA  02111-1307  USA
+//
+//                This file is distributed in the hope that it will be useful,
+//                but WITHOUT ANY WARRANTY; without even the implied warranty
+//                of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+//
+//                IN NO EVENT SHALL THE COPYRIGHT OWNER OR
+//                CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+//                INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES.
+
+#include "ImgAccumulator.h"
+
+#include <algorithm>
+#include <cstring>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define ACCUMULATOR_USE_SSE2
+#include <emmintrin.h>
+#endif
+
+namespace {
+
+#ifdef ACCUMULATOR_USE_SSE2
+
+// Loads a block of samples widened to 32-bit lanes
+template <typename T> struct SseBlock;
+
+template <> struct SseBlock<std::uint8_t>
+{
+   static const std::size_t samples = 16;
+   static void Widen(const std::uint8_t* p, __m128i* out)
+   {
+      const __m128i zero = _mm_setzero_si128();
+      const __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p));
+      const __m128i lo = _mm_unpacklo_epi8(v, zero);
+      const __m128i hi = _mm_unpackhi_epi8(v, zero);
+      out[0] = _mm_unpacklo_epi16(lo, zero);
+      out[1] = _mm_unpackhi_epi16(lo, zero);
+      out[2] = _mm_unpacklo_epi16(hi, zero);
+      out[3] = _mm_unpackhi_epi16(hi, zero);
+   }
+};
+
+template <> struct SseBlock<std::uint16_t>
+{
+   static const std::size_t samples = 8;
+   static void Widen(const std::uint16_t* p, __m128i* out)
+   {
+      const __m128i zero = _mm_setzero_si128();
+      const __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p));
+      out[0] = _mm_unpacklo_epi16(v, zero);
+      out[1] = _mm_unpackhi_epi16(v, zero);
+   }
+};
+
+#endif // ACCUMULATOR_USE_SSE2
+
+// sum += add - sub (sub may be null). Integer arithmetic is exact; the sums
+// are never negative, so intermediate wrap-around cancels.
+template <typename T>
+void Update(std::uint32_t* sum, const T* add, const T* sub, std::size_t n)
+{
+   std::size_t i = 0;
+#ifdef ACCUMULATOR_USE_SSE2
+   const std::size_t block = SseBlock<T>::samples;
+   const std::size_t vecs = block / 4;
+   for (; i + block <= n; i += block)
+   {
+      __m128i a[4];
+      __m128i b[4];
+      SseBlock<T>::Widen(add + i, a);
+      if (sub)
+         SseBlock<T>::Widen(sub + i, b);
+      __m128i* s = reinterpret_cast<__m128i*>(sum + i);
+      for (std::size_t k = 0; k < vecs; ++k)
+      {
+         __m128i v = _mm_add_epi32(_mm_loadu_si128(s + k), a[k]);
+         if (sub)
+            v = _mm_sub_epi32(v, b[k]);
+         _mm_storeu_si128(s + k, v);
+      }
+   }
+#endif
+   if (sub)
+   {
+      for (; i < n; ++i)
+         sum[i] = sum[i] + add[i] - sub[i];
+   }
+   else
+   {
+      for (; i < n; ++i)
+         sum[i] += add[i];
+   }
+}
+
+void MaxInto(std::uint8_t* mx, const std::uint8_t* src, std::size_t n)
+{
+   std::size_t i = 0;
+#ifdef ACCUMULATOR_USE_SSE2
+   for (; i + 16 <= n; i += 16)
+   {
+      __m128i* m = reinterpret_cast<__m128i*>(mx + i);
+      _mm_storeu_si128(m, _mm_max_epu8(_mm_loadu_si128(m),
+               _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + i))));
+   }
+#endif
+   for (; i < n; ++i)
+      mx[i] = (std::max)(mx[i], src[i]);
+}
+
+void MaxInto(std::uint16_t* mx, const std::uint8_t* src, std::size_t n)
+{
+   std::size_t i = 0;
+#ifdef ACCUMULATOR_USE_SSE2
+   // Values are below 256, so the signed 16-bit maximum is correct
+   const __m128i zero = _mm_setzero_si128();
+   for (; i + 16 <= n; i += 16)
+   {
+      const __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + i));
+      __m128i* m = reinterpret_cast<__m128i*>(mx + i);
+      _mm_storeu_si128(m, _mm_max_epi16(_mm_loadu_si128(m), _mm_unpacklo_epi8(v, zero)));
+      _mm_storeu_si128(m + 1, _mm_max_epi16(_mm_loadu_si128(m + 1), _mm_unpackhi_epi8(v, zero)));
+   }
+#endif
+   for (; i < n; ++i)
+      mx[i] = (std::max)(mx[i], static_cast<std::uint16_t>(src[i]));
+}
+
+void MaxInto(std::uint16_t* mx, const std::uint16_t* src, std::size_t n)
+{
+   std::size_t i = 0;
+#ifdef ACCUMULATOR_USE_SSE2
+   // SSE2 has only a signed 16-bit maximum; flip the sign bit
+   const __m128i bias = _mm_set1_epi16(static_cast<short>(0x8000));
+   for (; i + 8 <= n; i += 8)
+   {
+      const __m128i v = _mm_xor_si128(
+            _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + i)), bias);
+      __m128i* m = reinterpret_cast<__m128i*>(mx + i);
+      const __m128i cur = _mm_xor_si128(_mm_loadu_si128(m), bias);
+      _mm_storeu_si128(m, _mm_xor_si128(_mm_max_epi16(cur, v), bias));
+   }
+#endif
+   for (; i < n; ++i)
+      mx[i] = (std::max)(mx[i], src[i]);
+}
+
+} // anonymous namespace
+
+///////////////////////////////////////////////////////////////////////////////
+// ImgAccumulator class
+
+ImgAccumulator::ImgAccumulator() :
+   mode_(Mean),
+   length_(1),
+   runningWindow_(false),
+   width_(0),
+   height_(0),
+   byteDepth_(0),
+   sampleBytes_(1),
+   samples_(0),
+   windowIndex_(0),
+   count_(0)
+{
+}
+
+bool ImgAccumulator::Setup(Mode mode, unsigned length, bool runningWindow,
+      unsigned width, unsigned height, unsigned byteDepth)
+{
+   std::size_t samplesPerPixel;
+   switch (byteDepth)
+   {
+      case 1: sampleBytes_ = 1; samplesPerPixel = 1; break;
+      case 2: sampleBytes_ = 2; samplesPerPixel = 1; break;
+      case 4: sampleBytes_ = 1; samplesPerPixel = 4; break; // RGB32
+      case 8: sampleBytes_ = 2; samplesPerPixel = 4; break; // RGB64
+      default:
+         width_ = height_ = byteDepth_ = 0;
+         return false;
+   }
+
+   mode_ = mode;
+   length_ = (std::max)(1u, (std::min)(length, static_cast<unsigned>(MaxLength)));
+   runningWindow_ = runningWindow;
+   width_ = width;
+   height_ = height;
+   byteDepth_ = byteDepth;
+   samples_ = static_cast<std::size_t>(width) * height * samplesPerPixel;
+
+   // Release buffers not used by the mode
+   std::vector<std::uint32_t>().swap(sum_);
+   std::vector<std::uint16_t>().swap(max_);
+   std::vector<std::uint16_t>().swap(blockMax_);
+   std::vector<float>().swap(ema_);
+   std::vector<unsigned char>().swap(window_);
+
+   switch (mode_)
+   {
+      case Mean:
+      case Sum:
+         sum_.resize(samples_);
+         break;
+      case Max:
+         max_.resize(samples_);
+         if (runningWindow_)
+            blockMax_.resize(samples_);
+         break;
+      case ExponentialMean:
+         ema_.resize(samples_);
+         break;
+   }
+   if (UsesWindow())
+      window_.resize(samples_ * sampleBytes_ * length_);
+
+   ResetPixels();
+   return true;
+}
+
+void ImgAccumulator::ResetPixels()
+{
+   std::fill(sum_.begin(), sum_.end(), 0u);
+   std::fill(max_.begin(), max_.end(), static_cast<std::uint16_t>(0));
+   std::fill(blockMax_.begin(), blockMax_.end(), static_cast<std::uint16_t>(0));
+   std::fill(ema_.begin(), ema_.end(), 0.0f);
+   windowIndex_ = 0;
+   count_ = 0;
+}
+
+void ImgAccumulator::AddPixels(const unsigned char* pixels)
+{
+   if (sampleBytes_ == 1)
+      Add(reinterpret_cast<const std::uint8_t*>(pixels));
+   else
+      Add(reinterpret_cast<const std::uint16_t*>(pixels));
+}
+
+template <typename T>
+void ImgAccumulator::Add(const T* pixels)
+{
+   const bool full = count_ >= length_;
+   T* slot = 0;
+   if (UsesWindow())
+      slot = reinterpret_cast<T*>(window_.data()) + windowIndex_ * samples_;
+
+   switch (mode_)
+   {
+      case Mean:
+      case Sum:
+         // In running-window mode the slot holds the oldest frame once full
+         Update(sum_.data(), pixels, (slot && full) ? slot : 0, samples_);
+         break;
+      case Max:
+         if (slot)
+            AddToMaxWindow(pixels, slot);
+         else
+            MaxInto(max_.data(), pixels, samples_);
+         break;
+      case ExponentialMean:
+      {
+         // Cumulative mean until length_ frames have been seen, so that the
+         // output does not start biased towards zero
+         const float weight = 1.0f / static_cast<float>((std::min)(count_ + 1, length_));
+         float* ema = ema_.data();
+         for (std::size_t i = 0; i < samples_; ++i)
+            ema[i] += (static_cast<float>(pixels[i]) - ema[i]) * weight;
+         break;
+      }
+   }
+
+   if (slot)
+   {
+      if (mode_ != Max) // Already stored
+         std::memcpy(slot, pixels, samples_ * sizeof(T));
+      windowIndex_ = (windowIndex_ + 1) % length_;
+   }
+
+   if (runningWindow_ || mode_ == ExponentialMean)
+      count_ = (std::min)(count_ + 1, length_);
+   else
+      ++count_;
+}
+
+// Called before windowIndex_ and count_ are advanced. windowIndex_ is the
+// position of the frame in its block, since blocks start when the window
+// index wraps to 0.
+template <typename T>
+void ImgAccumulator::AddToMaxWindow(const T* pixels, T* slot)
+{
+   const unsigned position = windowIndex_;
+   // The previous block is complete once the window has been full
+   const bool havePrevious = count_ >= length_;
+   T* frames = reinterpret_cast<T*>(window_.data());
+
+   std::memcpy(slot, pixels, samples_ * sizeof(T));
+   if (position == 0)
+   {
+      for (std::size_t i = 0; i < samples_; ++i)
+         blockMax_[i] = pixels[i];
+   }
+   else
+   {
+      MaxInto(blockMax_.data(), pixels, samples_);
+   }
+
+   if (position + 1 == length_)
+   {
+      // The window is now exactly this block. Replace its frames by the
+      // maxima of their tails for the next block to use.
+      for (unsigned f = length_ - 1; f-- > 0; )
+         MaxInto(frames + f * samples_, frames + (f + 1) * samples_, samples_);
+      max_ = blockMax_;
+   }
+   else if (havePrevious)
+   {
+      // Head of this block plus frames position + 1 onwards of the previous
+      max_ = blockMax_;
+      MaxInto(max_.data(), frames + (position + 1) * samples_, samples_);
+   }
+   else
+   {
+      max_ = blockMax_;
+   }
+}
+
+void ImgAccumulator::CalculateOutputImage(unsigned char* pixels) const
+{
+   if (count_ == 0)
+      return;
+   if (sampleBytes_ == 1)
+      Output(reinterpret_cast<std::uint8_t*>(pixels));
+   else
+      Output(reinterpret_cast<std::uint16_t*>(pixels));
+}
+
+template <typename T>
+void ImgAccumulator::Output(T* pixels) const
+{
+   const std::uint32_t maxValue = (1u << (8 * sizeof(T))) - 1;
+   switch (mode_)
+   {
+      case Mean:
+      {
+         // Rounded integer division by multiplication with a 40-bit
+         // fixed-point reciprocal; exact for all sums below 2^32 and
+         // divisors up to 256
+         const std::uint64_t divisor = count_;
+         const std::uint64_t reciprocal = (std::uint64_t(1) << 40) / divisor + 1;
+         const std::uint32_t half = static_cast<std::uint32_t>(divisor / 2);
+         const std::uint32_t* sum = sum_.data();
+         for (std::size_t i = 0; i < samples_; ++i)
+            pixels[i] = static_cast<T>(((sum[i] + half) * reciprocal) >> 40);
+         break;
+      }
+      case Sum:
+      {
+         const std::uint32_t* sum = sum_.data();
+         for (std::size_t i = 0; i < samples_; ++i)
+            pixels[i] = static_cast<T>((std::min)(sum[i], maxValue));
+         break;
+      }
+      case Max:
+      {
+         const std::uint16_t* mx = max_.data();
+         for (std::size_t i = 0; i < samples_; ++i)
+            pixels[i] = static_cast<T>(mx[i]);
+         break;
+      }
+      case ExponentialMean:
+      {
+         const float* ema = ema_.data();
+         const float maxFloat = static_cast<float>(maxValue);
+         for (std::size_t i = 0; i < samples_; ++i)
+            pixels[i] = static_cast<T>((std::min)(ema[i] + 0.5f, maxFloat));
+         break;
+      }
+   }
+}
@@ -0,0 +1,116 @@
+///////////////////////////////////////////////////////////////////////////////
+// FILE:          ImgAccumulator.h
+// PROJECT:       Micro-Manager
+// SUBSYSTEM:     DeviceAdapters
+//-----------------------------------------------------------------------------
+// DESCRIPTION:   Frame accumulator (running mean, exponential moving average,
+//                sum and maximum projection over N frames). Generalized from
+//                the TwoPhoton adapter's ImgAccumulator.
+//
+// AUTHOR:        Nenad Amodaj, November 2009 (original ImgAccumulator)
+//
+// COPYRIGHT:     Nenad Amodaj 2011, 100X Imaging Inc 2009
+//
+// LICENSE:       This library is free software; you can redistribute it and/or
+//                modify it under the terms of the GNU Lesser General Public
+//                License as published by the Free Software Foundation.
+//
+//                You should have received a copy of the GNU Lesser General Public
+//                License along with the source distribution; if not, write to
+//                the Free Software Foundation, Inc., 59 Temple Place, Suite 330,
+//                Boston, MA  02111-1307  USA
+//
+//                This file is distributed in the hope that it will be useful,
+//                but WITHOUT ANY WARRANTY; without even the implied warranty
+//                of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+//
+//                IN NO EVENT SHALL THE COPYRIGHT OWNER OR
+//                CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+//                INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES.
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+///////////////////////////////////////////////////////////////////////////////
+//
+// ImgAccumulator class
+// ~~~~~~~~~~~~~~~~~~~~
+// Accumulates frames of 8- or 16-bit samples (RGB pixels are treated as 4
+// samples each).
+//
+// Mean and Sum use exact 32-bit integer sums. In running-window mode, the
+// last N frames are kept so that the oldest frame can be subtracted when a
+// new one is added; otherwise frames accumulate until ResetPixels().
+// Exponential mean uses a float state with weight 1/N for the new frame.
+//
+// The running-window maximum splits the frames into blocks of N (van Herk /
+// Gil-Werman): the window is the tail of the previous block plus the head of
+// the current one. The maximum of the head is updated with each frame, and
+// when a block is complete its frames are replaced in place by the maxima of
+// their tails, so that each frame costs a constant number of passes.
+//
+class ImgAccumulator
+{
+public:
+   enum Mode
+   {
+      Mean,
+      ExponentialMean,
+      Sum,
+      Max,
+   };
+
+   static const unsigned MaxLength = 256;
+
+   ImgAccumulator();
+
+   // byteDepth is the camera byte depth (1, 2, 4 or 8). Discards any
+   // accumulated frames. Returns false if the byte depth is not supported.
+   bool Setup(Mode mode, unsigned length, bool runningWindow,
+         unsigned width, unsigned height, unsigned byteDepth);
+   bool Matches(unsigned width, unsigned height, unsigned byteDepth) const
+   { return width == width_ && height == height_ && byteDepth == byteDepth_; }
+
+   Mode GetMode() const { return mode_; }
+   unsigned Length() const { return length_; }
+   bool IsRunningWindow() const { return runningWindow_; }
+
+   void AddPixels(const unsigned char* pixels);
+   // Number of frames contributing to the current output (at most Length())
+   unsigned FrameCount() const { return count_; }
+   // Writes the accumulated image, clipped to the range of the pixel type
+   void CalculateOutputImage(unsigned char* pixels) const;
+   void ResetPixels();
+
+private:
+   template <typename T> void Add(const T* pixels);
+   template <typename T> void Output(T* pixels) const;
+   template <typename T> void AddToMaxWindow(const T* pixels, T* slot);
+
+   bool UsesWindow() const
+   { return runningWindow_ && mode_ != ExponentialMean; }
+
+   Mode mode_;
+   unsigned length_;
+   bool runningWindow_;
+   unsigned width_;
+   unsigned height_;
+   unsigned byteDepth_;
+   unsigned sampleBytes_;
+   std::size_t samples_;
+
+   std::vector<std::uint32_t> sum_; // Mean, Sum
+   std::vector<std::uint16_t> max_; // Max
+   std::vector<std::uint16_t> blockMax_; // Max (running window): current block
+   std::vector<float> ema_; // ExponentialMean
+
+   // Last length_ frames, oldest at windowIndex_ once full. For Max, the
+   // frames of the previous block not yet overwritten hold the maxima of the
+   // tails of that block instead.
+   std::vector<unsigned char> window_;
+   unsigned windowIndex_;
+   unsigned count_;
+};
@@ -0,0 +1,191 @@
+///////////////////////////////////////////////////////////////////////////////
+// FILE:          ImgAccumulator-Tests.cpp
+// PROJECT:       Micro-Manager
+// SUBSYSTEM:     DeviceAdapters
+//-----------------------------------------------------------------------------
+// DESCRIPTION:   Unit tests for the FrameAccumulator's ImgAccumulator
+//
+// LICENSE:       This library is free software; you can redistribute it and/or
+//                modify it under the terms of the GNU Lesser General Public
+//                License as published by the Free Software Foundation.
+//
+//                This file is distributed in the hope that it will be useful,
+//                but WITHOUT ANY WARRANTY; without even the implied warranty
+//                of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+//
+//                IN NO EVENT SHALL THE COPYRIGHT OWNER OR
+//                CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+//                INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES.
+
+#include <gtest/gtest.h>
+
+#include "ImgAccumulator.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <random>
+#include <vector>
+
+namespace {
+
+// 37 samples, so that both the vector and the scalar code paths are used
+const unsigned width = 37;
+const unsigned height = 1;
+
+template <typename T>
+std::vector<std::vector<T>> RandomFrames(unsigned count, unsigned seed)
+{
+   std::mt19937 rng(seed);
+   std::uniform_int_distribution<unsigned> dist(0, (1u << (8 * sizeof(T))) - 1);
+   std::vector<std::vector<T>> frames(count, std::vector<T>(width * height));
+   for (std::vector<T>& frame : frames)
+      for (T& v : frame)
+         v = static_cast<T>(dist(rng));
+   return frames;
+}
+
+// The output for frames [first, last) computed directly
+template <typename T>
+std::vector<T> Reference(ImgAccumulator::Mode mode,
+      const std::vector<std::vector<T>>& frames, size_t first, size_t last)
+{
+   const std::uint32_t maxValue = (1u << (8 * sizeof(T))) - 1;
+   const std::uint32_t n = static_cast<std::uint32_t>(last - first);
+   std::vector<T> out(width * height);
+   for (size_t i = 0; i < out.size(); ++i)
+   {
+      std::uint32_t sum = 0;
+      std::uint32_t mx = 0;
+      for (size_t f = first; f < last; ++f)
+      {
+         sum += frames[f][i];
+         mx = (std::max)(mx, static_cast<std::uint32_t>(frames[f][i]));
+      }
+      switch (mode)
+      {
+         case ImgAccumulator::Mean: out[i] = static_cast<T>((sum + n / 2) / n); break;
+         case ImgAccumulator::Sum: out[i] = static_cast<T>((std::min)(sum, maxValue)); break;
+         case ImgAccumulator::Max: out[i] = static_cast<T>(mx); break;
+         default: break;
+      }
+   }
+   return out;
+}
+
+template <typename T>
+std::vector<T> Output(const ImgAccumulator& acc)
+{
+   std::vector<T> out(width * height);
+   acc.CalculateOutputImage(reinterpret_cast<unsigned char*>(out.data()));
+   return out;
+}
+
+template <typename T>
+void TestRunningWindow(ImgAccumulator::Mode mode, unsigned length)
+{
+   const auto frames = RandomFrames<T>(4 * length + 3, length);
+   ImgAccumulator acc;
+   ASSERT_TRUE(acc.Setup(mode, length, true, width, height, sizeof(T)));
+   for (size_t f = 0; f < frames.size(); ++f)
+   {
+      acc.AddPixels(reinterpret_cast<const unsigned char*>(frames[f].data()));
+      const size_t first = f + 1 > length ? f + 1 - length : 0;
+      ASSERT_EQ((std::min)(f + 1, size_t(length)), acc.FrameCount());
+      ASSERT_EQ(Reference(mode, frames, first, f + 1), Output<T>(acc))
+         << "mode " << mode << ", length " << length << ", frame " << f;
+   }
+}
+
+template <typename T>
+void TestBlocks(ImgAccumulator::Mode mode, unsigned length)
+{
+   const auto frames = RandomFrames<T>(3 * length, length + 100);
+   ImgAccumulator acc;
+   ASSERT_TRUE(acc.Setup(mode, length, false, width, height, sizeof(T)));
+   for (size_t f = 0; f < frames.size(); ++f)
+   {
+      acc.AddPixels(reinterpret_cast<const unsigned char*>(frames[f].data()));
+      const size_t first = f - f % length;
+      ASSERT_EQ(Reference(mode, frames, first, f + 1), Output<T>(acc))
+         << "mode " << mode << ", length " << length << ", frame " << f;
+      if (acc.FrameCount() == length)
+         acc.ResetPixels();
+   }
+}
+
+} // anonymous namespace
+
+TEST(ImgAccumulatorTests, RunningWindowMatchesDirectComputation)
+{
+   const ImgAccumulator::Mode modes[] =
+      { ImgAccumulator::Mean, ImgAccumulator::Sum, ImgAccumulator::Max };
+   for (ImgAccumulator::Mode mode : modes)
+   {
+      for (unsigned length : { 1u, 2u, 3u, 8u })
+      {
+         TestRunningWindow<std::uint8_t>(mode, length);
+         TestRunningWindow<std::uint16_t>(mode, length);
+      }
+   }
+}
+
+TEST(ImgAccumulatorTests, BlocksMatchDirectComputation)
+{
+   const ImgAccumulator::Mode modes[] =
+      { ImgAccumulator::Mean, ImgAccumulator::Sum, ImgAccumulator::Max };
+   for (ImgAccumulator::Mode mode : modes)
+   {
+      for (unsigned length : { 1u, 3u, 8u })
+      {
+         TestBlocks<std::uint8_t>(mode, length);
+         TestBlocks<std::uint16_t>(mode, length);
+      }
+   }
+}
+
+TEST(ImgAccumulatorTests, ExponentialMeanStartsAsCumulativeMean)
+{
+   ImgAccumulator acc;
+   ASSERT_TRUE(acc.Setup(ImgAccumulator::ExponentialMean, 4, true,
+            width, height, 2));
+   std::vector<std::uint16_t> frame(width * height);
+
+   // The first frames are averaged with equal weights
+   std::fill(frame.begin(), frame.end(), std::uint16_t(100));
+   acc.AddPixels(reinterpret_cast<const unsigned char*>(frame.data()));
+   std::fill(frame.begin(), frame.end(), std::uint16_t(200));
+   acc.AddPixels(reinterpret_cast<const unsigned char*>(frame.data()));
+   EXPECT_EQ(std::vector<std::uint16_t>(frame.size(), 150), Output<std::uint16_t>(acc));
+
+   // Then each new frame has weight 1/4
+   acc.AddPixels(reinterpret_cast<const unsigned char*>(frame.data()));
+   acc.AddPixels(reinterpret_cast<const unsigned char*>(frame.data()));
+   EXPECT_EQ(std::vector<std::uint16_t>(frame.size(), 175), Output<std::uint16_t>(acc));
+   std::fill(frame.begin(), frame.end(), std::uint16_t(375));
+   acc.AddPixels(reinterpret_cast<const unsigned char*>(frame.data()));
+   EXPECT_EQ(std::vector<std::uint16_t>(frame.size(), 225), Output<std::uint16_t>(acc));
+   EXPECT_EQ(4u, acc.FrameCount());
+}
+
+TEST(ImgAccumulatorTests, RgbPixelsAreAccumulatedPerComponent)
+{
+   ImgAccumulator acc;
+   ASSERT_TRUE(acc.Setup(ImgAccumulator::Mean, 2, true, 3, 1, 4));
+   const std::uint8_t a[12] = { 10, 20, 30, 0, 1, 2, 3, 0, 255, 255, 255, 0 };
+   const std::uint8_t b[12] = { 20, 40, 60, 0, 1, 2, 4, 0, 0, 255, 1, 0 };
+   acc.AddPixels(a);
+   acc.AddPixels(b);
+   std::uint8_t out[12];
+   acc.CalculateOutputImage(out);
+   const std::uint8_t expected[12] = { 15, 30, 45, 0, 1, 2, 4, 0, 128, 255, 128, 0 };
+   EXPECT_EQ(0, std::memcmp(expected, out, sizeof(out)));
+
+   EXPECT_FALSE(acc.Setup(ImgAccumulator::Mean, 2, true, 3, 1, 3));
+}
+
+int main(int argc, char **argv)
+{
+   ::testing::InitGoogleTest(&argc, argv);
+   return RUN_ALL_TESTS();
+}
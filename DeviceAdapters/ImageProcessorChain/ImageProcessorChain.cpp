@@ -152,7 +152,12 @@ int ImageProcessorChain::Process(unsigned char *pBuffer, unsigned int width, uns
          {
             try
             {
-               pP->Process(pBuffer, width, height,byteDepth);
+               // Later processors do not see images consumed by earlier ones
+               if (pP->Process(pBuffer, width, height,byteDepth) == DEVICE_IMAGE_CONSUMED)
+               {
+                  ret = DEVICE_IMAGE_CONSUMED;
+                  break;
+               }
             }
             catch(...)
             {
@@ -10,6 +10,7 @@ const char* g_Keyword_Left = "Left";
 const char* g_Keyword_Exposure = "Exposure-ms";
 const char* g_Keyword_Binning = "Binning";
 const char* g_Method_Read = "read";
+const char* g_Method_ReadInto = "read_into";
 
 /**
 * Performs exposure and grabs a single image.
@@ -21,7 +22,8 @@ const char* g_Method_Read = "read";
 int CPyCamera::ConnectMethods(const PyObj& methods)
 {
     _check_(PyCameraClass::ConnectMethods(methods));
-    read_ = methods.GetDictItem("read");
+    read_ = methods.GetDictItem(g_Method_Read);
+    readInto_ = methods.GetDictItem(g_Method_ReadInto); // optional, empty if not present
     return CheckError();
 }
 
@@ -228,25 +230,152 @@ int CPyCamera::IsExposureSequenceable(bool& isSequenceable) const
 
 // overriding default implementation which is broken (does not check for nullptr return from buffer)
 int CPyCamera::InsertImage()
+{
+    auto buffer = GetImageBuffer();
+    if (!buffer)
+        return DEVICE_ERR;
+
+    return InsertFrame(buffer, GetImageWidth(), GetImageHeight());
+}
+
+/**
+* Inserts a frame into the sequence buffer.
+* Does not call into Python, so the GIL is not needed.
+*/
+int CPyCamera::InsertFrame(const unsigned char* buffer, unsigned width, unsigned height)
 {
     char label[MM::MaxStrLength];
     this->GetLabel(label);
     Metadata md;
     md.put(MM::g_Keyword_Metadata_CameraLabel, label);
-    auto buffer = GetImageBuffer();
-    if (!buffer)
-        return DEVICE_ERR;
+    auto serialized = md.Serialize();
 
-    int ret = GetCoreCallback()->InsertImage(this, buffer, GetImageWidth(),
-                                             GetImageHeight(), GetImageBytesPerPixel(),
-                                             md.Serialize().c_str());
+    int ret = GetCoreCallback()->InsertImage(this, buffer, width, height, GetImageBytesPerPixel(), serialized.c_str());
     if (!isStopOnOverflow() && ret == DEVICE_BUFFER_OVERFLOW)
     {
         // do not stop on overflow - just reset the buffer
         GetCoreCallback()->ClearImageBuffer(this);
-        return GetCoreCallback()->InsertImage(this, buffer, GetImageWidth(),
-                                              GetImageHeight(), GetImageBytesPerPixel(),
-                                              md.Serialize().c_str());
+        return GetCoreCallback()->InsertImage(this, buffer, width, height, GetImageBytesPerPixel(), serialized.c_str());
     }
     return ret;
 }
+
+/**
+* Starts sequence acquisition in streaming mode.
+* Instead of the default snap-then-insert loop, which calls into Python twice for every frame, a Python thread
+* reads frames into a ring of preallocated buffers (see FrameStream in bootstrap.py) while the sequence thread
+* inserts completed frames into the core without holding the GIL.
+*/
+int CPyCamera::StartSequenceAcquisition(long numImages, double interval_ms, bool stopOnOverflow)
+{
+    std::lock_guard<std::mutex> lock(streamMutex_);
+    if (IsCapturing())
+        return DEVICE_CAMERA_BUSY_ACQUIRING;
+
+    StopStream(); // clean up after a previous sequence that finished by itself
+    _check_(StartStream());
+    int ret = PyCameraClass::StartSequenceAcquisition(numImages, interval_ms, stopOnOverflow);
+    if (ret != DEVICE_OK)
+        StopStream();
+    return ret;
+}
+
+int CPyCamera::StopSequenceAcquisition()
+{
+    _check_(PyCameraClass::StopSequenceAcquisition());
+    std::lock_guard<std::mutex> lock(streamMutex_);
+    if (!IsCapturing())
+        StopStream();
+    return DEVICE_OK;
+}
+
+/**
+* Creates the FrameStream object, which immediately starts reading frames, and obtains pointers to its buffers.
+* Must be called with streamMutex_ locked.
+*/
+int CPyCamera::StartStream()
+{
+    streamWidth_ = GetImageWidth();
+    streamHeight_ = GetImageHeight();
+
+    PyLock lock;
+    auto frameStream = PyObj::g_global_scope.GetDictItem("FrameStream");
+    stream_ = frameStream.Call(read_, readInto_, PyObj(static_cast<long>(streamHeight_)),
+        PyObj(static_cast<long>(streamWidth_)), PyObj(streamBufferCount_));
+    if (!stream_)
+        return CheckError();
+
+    nextFrame_ = stream_.Get("next_frame");
+    auto buffers = stream_.Get("buffers");
+    for (long i = 0; i < streamBufferCount_; i++)
+    {
+        Py_buffer view;
+        if (PyObject_GetBuffer(buffers.GetListItem(i), &view, PyBUF_WRITABLE) == -1)
+        {
+            PyObj::ReportError();
+            StopStream();
+            return CheckError();
+        }
+        streamBuffers_.push_back(view);
+    }
+    streamFrame_ = -1;
+    return CheckError();
+}
+
+/**
+* Stops the Python thread of the stream (waiting for it to finish) and releases the buffers.
+* Must be called with streamMutex_ locked.
+*/
+void CPyCamera::StopStream()
+{
+    if (!stream_)
+        return;
+
+    PyLock lock;
+    stream_.CallMember("stop");
+    for (auto& view : streamBuffers_)
+        PyBuffer_Release(&view);
+    streamBuffers_.clear();
+    nextFrame_.Clear();
+    stream_.Clear();
+    CheckError();
+}
+
+/**
+* Waits for the next frame from the stream and inserts it.
+* The GIL is only held while handing the previous buffer back and picking up the next one.
+* Python releases the GIL while next_frame waits for a frame, so other Python devices are not blocked.
+*/
+int CPyCamera::ThreadRun()
+{
+    long index = -1;
+    while (index < 0)
+    {
+        if (!IsCapturing())
+            return DEVICE_OK;
+
+        auto result = nextFrame_.Call(PyObj(streamFrame_), PyObj(streamPollTimeout_s_));
+        streamFrame_ = -1; // the buffer is owned by Python again
+        if (!result)
+            return CheckError();
+        index = result.as<long>();
+    }
+    streamFrame_ = index;
+
+    return InsertFrame(static_cast<const unsigned char*>(streamBuffers_[index].buf), streamWidth_, streamHeight_);
+}
+
+/**
+* Called when the sequence thread finishes, either because it was stopped or because all images were acquired.
+* Asks the Python thread to stop reading frames, without waiting for it (see StopStream for the cleanup).
+*/
+void CPyCamera::OnThreadExiting()
+{
+    {
+        std::lock_guard<std::mutex> lock(streamMutex_);
+        if (stream_ && !IsCapturing()) // not already restarted
+            stream_.CallMember("halt");
+    }
+    CheckError();
+    PyCameraClass::OnThreadExiting();
+}
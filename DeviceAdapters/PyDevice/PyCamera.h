@@ -1,11 +1,25 @@
 #pragma once
 #include "PyDevice.h"
 #include "buffer.h"
+#include <mutex>
 
 using PyCameraClass = CPyDeviceTemplate<CCameraBase<std::monostate>>;
 class CPyCamera : public PyCameraClass {
     Py_buffer lastFrame_;
     PyObj read_; // the read() method of the camera object
+    PyObj readInto_; // the optional read_into(out) method of the camera object
+
+    // Sequence acquisition: a Python thread fills a ring of buffers (see FrameStream in bootstrap.py),
+    // and the sequence thread inserts them into the core without holding the GIL.
+    static constexpr long streamBufferCount_ = 4;
+    static constexpr double streamPollTimeout_s_ = 0.1;
+    std::mutex streamMutex_; // guards creating and stopping the stream
+    PyObj stream_; // FrameStream object, only set during (or directly after) sequence acquisition
+    PyObj nextFrame_; // the next_frame() method of stream_
+    vector<Py_buffer> streamBuffers_; // views of the buffers of stream_, obtained through the buffer protocol
+    long streamFrame_ = -1; // buffer that was inserted last, handed back to Python with the next call to next_frame
+    unsigned streamWidth_ = 0;
+    unsigned streamHeight_ = 0;
     
 public:
     CPyCamera(const string& id) : PyCameraClass(id)
@@ -31,8 +45,19 @@ public:
     int Shutdown() override;
     int InsertImage() override;
     int ConnectMethods(const PyObj& methods) override;
+    using PyCameraClass::StartSequenceAcquisition;
+    int StartSequenceAcquisition(long numImages, double interval_ms, bool stopOnOverflow) override;
+    int StopSequenceAcquisition() override;
+
+protected:
+    int ThreadRun() override;
+    void OnThreadExiting() override;
 
 private:
+    int StartStream();
+    void StopStream();
+    int InsertFrame(const unsigned char* buffer, unsigned width, unsigned height);
+
     void ReleaseBuffer()
     {
         PyLock lock;
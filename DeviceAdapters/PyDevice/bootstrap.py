@@ -8,6 +8,8 @@ from typing import get_origin, Annotated
 from types import MethodType
 import traceback
 import inspect
+import queue
+import threading
 from enum import Enum
 
 
@@ -238,4 +240,75 @@ class PyDevice:
 
     def __str__(self):
         return f"{self.device_type}({', '.join(str(p) for p in self.properties)})"
+
+
+class FrameStream:
+    """Ring of frame buffers that is filled by a Python thread during sequence acquisition.
+
+    The C++ code obtains the memory of each buffer in `buffers` through the buffer protocol once, when the stream
+    is created, and inserts completed frames into the Micro-Manager sequence buffer without holding the GIL.
+    A buffer is handed back to the Python thread only after it was inserted (see `next_frame`).
+
+    If the camera has a `read_into(out)` method, it is called with a writable (height, width) uint16 view of the
+    buffer to fill. Otherwise, the result of `read()` is copied into the buffer.
+    """
+
+    def __init__(self, read, read_into, height: int, width: int, count: int):
+        self.buffers = [bytearray(2 * height * width) for _ in range(count)]
+        self._views = [memoryview(b).cast('H', (height, width)) for b in self.buffers]
+        self._read = read
+        self._read_into = read_into
+        self._free = queue.SimpleQueue()
+        self._ready = queue.SimpleQueue()
+        self._error = None
+        self._running = True
+        for index in range(count):
+            self._free.put(index)
+        self._thread = threading.Thread(target=self._run, name='PyDevice frame stream', daemon=True)
+        self._thread.start()
+
+    def _run(self):
+        try:
+            while True:
+                index = self._free.get()
+                if not self._running:
+                    return
+                frame = self._views[index]
+                if self._read_into is not None:
+                    self._read_into(frame)
+                else:
+                    image = memoryview(self._read())
+                    if image.shape != frame.shape or image.itemsize != 2 or not image.c_contiguous:
+                        raise ValueError(f"read() should return a c-contiguous {frame.shape} array of 16-bit integers")
+                    frame.cast('B')[:] = image.cast('B')
+                self._ready.put(index)
+        except BaseException as e:
+            self._error = e
+            self._ready.put(-1)
+
+    def next_frame(self, previous: int, timeout: float) -> int:
+        """Returns buffer `previous` (if >= 0) to the ring and waits for the next filled buffer.
+
+        Returns the index of the filled buffer, or -1 if no frame arrived within `timeout` seconds.
+        Re-raises any exception raised by `read` or `read_into`. Called from the C++ code.
+        """
+        if previous >= 0:
+            self._free.put(previous)
+        try:
+            index = self._ready.get(timeout=timeout)
+        except queue.Empty:
+            return -1
+        if index < 0:
+            raise self._error
+        return index
+
+    def halt(self):
+        """Asks the Python thread to stop after the current frame, without waiting for it."""
+        self._running = False
+        self._free.put(-1)
+
+    def stop(self):
+        """Stops the Python thread and waits for it to finish, after which the buffers are no longer written to."""
+        self.halt()
+        self._thread.join()
 # )raw";
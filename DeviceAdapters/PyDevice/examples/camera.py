@@ -26,7 +26,15 @@ class Camera:
         self._noise_type = NoiseType.UNIFORM
 
     def read(self):
-        size = (self._height, self._width)
+        image = np.empty((self._height, self._width), dtype=np.uint16)
+        self.read_into(image)
+        return image
+
+    def read_into(self, out):
+        """Optional method used during sequence acquisition: writes the frame into a preallocated buffer
+        instead of returning a new array. `out` is a (height, width) uint16 buffer."""
+        out = np.asarray(out)
+        size = out.shape
         if self._noise_type == NoiseType.UNIFORM:
             image = self._rng.uniform(self._low, self._high, size)
         elif self._noise_type == NoiseType.EXPONENTIAL:
@@ -35,7 +43,7 @@ class Camera:
             mean = 0.5 * (self._high + self._low)
             std = 0.5 * (self._high - self._low)
             image = self._rng.normal(mean, std, size)
-        return image.astype(np.uint16)
+        np.copyto(out, image, casting='unsafe')
 
     def busy(self):
         return False
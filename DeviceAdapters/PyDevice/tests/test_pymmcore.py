@@ -30,6 +30,37 @@ def test_camera():
     assert frame.shape == (333, 121)
 
 
+def test_camera_sequence():
+    """Sequence acquisition uses the frame stream: frames are read into preallocated buffers by a Python thread"""
+    mmc = pymmcore.CMMCore()
+    mmc.setDeviceAdapterSearchPaths([mm_dir])
+    mmc.loadSystemConfiguration("camera.cfg")
+    mmc.setProperty("cam", "Width", 64)
+    mmc.setProperty("cam", "Height", 48)
+    mmc.setProperty("cam", "Low", 10.0)
+    mmc.setProperty("cam", "High", 20.0)
+
+    frame_count = 50
+    mmc.startSequenceAcquisition(frame_count, 0.0, True)
+    while mmc.isSequenceRunning():
+        mmc.sleep(10)
+    assert mmc.getRemainingImageCount() == frame_count
+    for _ in range(frame_count):
+        frame = mmc.popNextImage()
+        assert frame.shape == (48, 64)
+        assert frame.min() >= 10 and frame.max() <= 20
+
+    # continuous acquisition can be stopped and restarted, and properties remain accessible from Python meanwhile
+    for _ in range(2):
+        mmc.startContinuousSequenceAcquisition(0.0)
+        mmc.sleep(200)
+        assert mmc.getProperty("cam", "Width") == '64'
+        mmc.stopSequenceAcquisition()
+        assert mmc.getRemainingImageCount() > 0
+        assert mmc.getLastImage().shape == (48, 64)
+        mmc.clearCircularBuffer()
+
+
 def test_microscope():
     mmc = pymmcore.CMMCore()
     mmc.setDeviceAdapterSearchPaths([mm_dir])
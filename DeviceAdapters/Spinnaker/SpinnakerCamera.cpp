@@ -4,6 +4,7 @@
 
 #include "SpinnakerCamera.h"
 #include "ModuleInterface.h"
+#include "PackedPixels.h"
 #include <vector>
 #include <string>
 #include <algorithm>
@@ -835,25 +836,9 @@ int SpinnakerCamera::OnLineBoolPropertyChanged(std::string name, MM::PropertyBas
 
 void SpinnakerCamera::Unpack12Bit(uint16_t* unpacked, const uint8_t* packed, size_t width, size_t height, bool flip)
 {
-   unsigned int u_idx;
-   int p_idx;
-   for (u_idx = 0, p_idx = 0; u_idx < width * height; u_idx++)
-   {
-      if (u_idx % 2 == 0)
-      {
-         auto pt = (Unpack12Struct*)(packed + p_idx);
-         if (!flip)
-            unpacked[u_idx] = ((((unsigned short)pt->_1 & 0x0F) << 8) | ((unsigned short)pt->_2));
-         else
-            unpacked[u_idx] = ((((unsigned short)pt->_1 & 0x0F) | ((unsigned short)pt->_2) << 4));
-      }
-      else
-      {
-         auto pt = (Unpack12Struct*)(packed + p_idx);
-         unpacked[u_idx] = ((((unsigned short)pt->_0) << 4) | (((unsigned short)pt->_1) >> 4));
-         p_idx += 3;
-      }
-   }
+   // flip selects Mono12Packed (high bits first) instead of Mono12p
+   PackedPixels::Unpack(flip ? PackedPixels::Mono12Packed : PackedPixels::Mono12p,
+         unpacked, packed, width * height);
 }
 
 void SpinnakerCamera::RGBtoBGRA(uint8_t* data, size_t imageBuffLength)
@@ -36,13 +36,20 @@ const char* deviceName = "TCP/IP serial port adapter";
 
 int TCPIPPort::count_ = 0;
 
+// Size of the reads from the socket; answers longer than this are
+// received in several chunks
+const std::size_t receiveChunkSize = 4096;
+
 TCPIPPort::TCPIPPort(int index) :
 	index_(index),
 	host_("127.0.0.1"),
 	port_(0),
 	initialized_(false),
 	sock_(ios_),
-	answerTimeoutMs_(500)
+	deadline_(ios_),
+	answerTimeoutMs_(500),
+	noDelay_(true),
+	rxChunk_(receiveChunkSize)
 {
 	SetErrorText(ERR_BUFFER_OVERRUN, "Buffer overrun occured during read");
 	SetErrorText(ERR_TERM_TIMEOUT, "Timeout occured during init or read");
@@ -52,6 +59,9 @@ TCPIPPort::TCPIPPort(int index) :
 	CreateProperty("Host", "127.0.0.1", MM::String, false, new CPropertyAction(this, &TCPIPPort::OnHost), true);
 	CreateProperty("TCP Port", "0", MM::Integer, false, new CPropertyAction(this, &TCPIPPort::OnPort), true);
 	CreateProperty("Answer timeout", "500", MM::Integer, false, new CPropertyAction(this, &TCPIPPort::OnAnswerTimeout), false);
+	CreateProperty("TCP_NODELAY", "Yes", MM::String, false, new CPropertyAction(this, &TCPIPPort::OnNoDelay), false);
+	AddAllowedValue("TCP_NODELAY", "Yes");
+	AddAllowedValue("TCP_NODELAY", "No");
 }
 
 TCPIPPort::~TCPIPPort()
@@ -80,17 +90,31 @@ ERRH_START
 
 	boost::system::error_code ec = boost::asio::error::would_block;
 
-	boost::asio::deadline_timer deadline(ios_);
-	deadline.expires_from_now(boost::posix_time::millisec(answerTimeoutMs_));
-	deadline.async_wait(boost::lambda::bind(&TCPIPPort::close_sock, this));
+	deadline_.expires_from_now(boost::posix_time::millisec(answerTimeoutMs_));
+	deadline_.async_wait([this](const boost::system::error_code& error)
+		{
+			if (error != boost::asio::error::operation_aborted)
+				close_sock();
+		});
 	
 	boost::asio::async_connect(sock_, it, boost::lambda::var(ec) = boost::lambda::_1);
 
+	ios_.reset();
 	do ios_.run_one(); while (ec == boost::asio::error::would_block);
 
+	// Complete the timer handler, which must not run during a later read
+	deadline_.cancel();
+	ios_.run();
+
 	if (ec || !sock_.is_open())
 		return ERR_TERM_TIMEOUT;
 
+	// Commands are short and each waits for its answer, so by default
+	// they are sent immediately instead of being held back by Nagle's
+	// algorithm
+	ApplyNoDelay();
+	rxBuffer_.clear();
+
 	initialized_ = true;
 
 	if (index_ == GetCount())
@@ -143,7 +167,62 @@ int TCPIPPort::SetCommand(const char* command, const char* term)
 	ERRH_END
 }
 
-//mostly copied from SerialManager.cpp (Serialport::GetAnswer)
+// Waits up to timeoutMs for data from the socket and appends whatever is
+// available (up to one chunk) to rxBuffer_. Returns false on timeout.
+bool TCPIPPort::ReceiveSome(unsigned long timeoutMs)
+{
+	boost::system::error_code ec;
+	std::size_t bytesRead = 0;
+
+	// Data that has already arrived is read without involving the
+	// io_service
+	if (sock_.available(ec) > 0)
+	{
+		bytesRead = sock_.read_some(boost::asio::buffer(rxChunk_));
+		rxBuffer_.append(&rxChunk_[0], bytesRead);
+		return true;
+	}
+	if (ec)
+		throw boost::system::system_error(ec);
+
+	bool timedOut = false;
+	ec = boost::asio::error::would_block;
+	sock_.async_read_some(boost::asio::buffer(rxChunk_),
+		[&ec, &bytesRead](const boost::system::error_code& error, std::size_t n)
+		{
+			ec = error;
+			bytesRead = n;
+		});
+	deadline_.expires_from_now(boost::posix_time::millisec(timeoutMs));
+	deadline_.async_wait([this, &timedOut](const boost::system::error_code& error)
+		{
+			if (error != boost::asio::error::operation_aborted)
+			{
+				timedOut = true;
+				sock_.cancel();
+			}
+		});
+
+	ios_.reset();
+	while (ec == boost::asio::error::would_block)
+		ios_.run_one();
+
+	// Let the timer handler run so that no handler refers to this frame
+	deadline_.cancel();
+	ios_.run();
+
+	if (timedOut && ec == boost::asio::error::operation_aborted)
+		return false;
+	if (ec)
+		throw boost::system::system_error(ec);
+
+	rxBuffer_.append(&rxChunk_[0], bytesRead);
+	return true;
+}
+
+// Same semantics as SerialManager.cpp (Serialport::GetAnswer), but reading
+// the socket in chunks and waiting on the io_service instead of polling.
+// Data received after the terminator is kept for the next call.
 int TCPIPPort::GetAnswer(char* txt, unsigned maxChars, const char* term)
 {
 ERRH_START
@@ -155,52 +234,39 @@ ERRH_START
 		LogMessage("BUFFER_OVERRUN error occured!");
 		return ERR_BUFFER_OVERRUN;
 	}
-	std::ostringstream logMsg;
-	unsigned long answerOffset = 0;
 	memset(txt, 0, maxChars);
-	char theData = 0;
+
+	const bool hasTerm = (term && term[0]);
+	const std::size_t termLen = hasTerm ? strlen(term) : 0;
+	std::size_t searchFrom = 0;
 
 	MM::MMTime startTime = GetCurrentMMTime();
 	MM::MMTime answerTimeout(answerTimeoutMs_ * 1000.0);
 	MM::MMTime nonTerminatedAnswerTimeout(5.0 * 1000.0); // For bug-compatibility
-	while ((GetCurrentMMTime() - startTime) < answerTimeout)
+	for (;;)
 	{
-		boost::asio::socket_base::bytes_readable command(true);
-		sock_.io_control(command);
-		size_t bytes_readable = command.get();
-
-		if (bytes_readable > 0)
+		if (hasTerm)
 		{
-			sock_.read_some(boost::asio::buffer(&theData, 1));
+			// The terminator may span the previous and the new chunk
+			std::size_t termPos = rxBuffer_.find(term, searchFrom, termLen);
+			if (termPos != std::string::npos && termPos + termLen <= maxChars)
+			{
+				LogAsciiCommunication("GetAnswer", true, rxBuffer_.substr(0, termPos + termLen));
 
-			if (maxChars <= answerOffset)
+				// return the answer without the terminator
+				memcpy(txt, rxBuffer_.data(), termPos);
+				rxBuffer_.erase(0, termPos + termLen);
+				return DEVICE_OK;
+			}
+			if (termPos != std::string::npos || rxBuffer_.size() >= maxChars)
 			{
-				txt[answerOffset] = '\0';
+				memcpy(txt, rxBuffer_.data(), maxChars - 1);
+				rxBuffer_.erase(0, maxChars - 1);
 				LogMessage("BUFFER_OVERRUN error occured!");
 				return ERR_BUFFER_OVERRUN;
 			}
-			txt[answerOffset++] = theData;
-		}
-		else
-		{
-			//Yield to other threads:
-			CDeviceUtils::SleepMs(1);
-		}
-
-		// look for the terminator, if any
-		if (term && term[0])
-		{
-			// check for terminating sequence
-			char* termPos = strstr(txt, term);
-			if (termPos != 0) // found the terminator
-			{
-				LogAsciiCommunication("GetAnswer", true, txt);
-
-				// erase the terminator from the answer:
-				*termPos = '\0';
-
-				return DEVICE_OK;
-			}
+			if (rxBuffer_.size() >= termLen)
+				searchFrom = rxBuffer_.size() - termLen + 1;
 		}
 		else
 		{
@@ -209,10 +275,20 @@ ERRH_START
 			// sure that no device adapter calls us without a terminator. For now,
 			// keep the behavior for the sake of bug-compatibility.
 
+			if (rxBuffer_.size() >= maxChars)
+			{
+				memcpy(txt, rxBuffer_.data(), maxChars - 1);
+				rxBuffer_.erase(0, maxChars - 1);
+				LogMessage("BUFFER_OVERRUN error occured!");
+				return ERR_BUFFER_OVERRUN;
+			}
+
 			MM::MMTime elapsed = GetCurrentMMTime() - startTime;
 			if (elapsed > nonTerminatedAnswerTimeout)
 			{
-				LogAsciiCommunication("GetAnswer", true, txt);
+				memcpy(txt, rxBuffer_.data(), rxBuffer_.size());
+				LogAsciiCommunication("GetAnswer", true, rxBuffer_);
+				rxBuffer_.clear();
 				long millisecs = static_cast<long>(elapsed.getMsec());
 				LogMessage(("GetAnswer without terminator returning after " +
 					boost::lexical_cast<std::string>(millisecs) +
@@ -220,6 +296,15 @@ ERRH_START
 				return DEVICE_OK;
 			}
 		}
+
+		MM::MMTime elapsed = GetCurrentMMTime() - startTime;
+		if (elapsed >= answerTimeout)
+			break;
+		MM::MMTime remaining = answerTimeout - elapsed;
+		if (!hasTerm && nonTerminatedAnswerTimeout - elapsed < remaining)
+			remaining = nonTerminatedAnswerTimeout - elapsed;
+		if (!ReceiveSome(static_cast<unsigned long>(remaining.getMsec()) + 1) && hasTerm)
+			break;
 	}
 
 	LogMessage("TERM_TIMEOUT error occured!");
@@ -250,7 +335,13 @@ int TCPIPPort::Read(unsigned char* buf, unsigned long bufLen, unsigned long& cha
 
 	memset(buf, 0, bufLen);
 
-	charsRead = (unsigned long)boost::asio::read(sock_, boost::asio::buffer(buf, bufLen));
+	// Data left over from GetAnswer comes first
+	charsRead = (unsigned long)std::min<std::size_t>(rxBuffer_.size(), bufLen);
+	memcpy(buf, rxBuffer_.data(), charsRead);
+	rxBuffer_.erase(0, charsRead);
+
+	if (charsRead < bufLen)
+		charsRead += (unsigned long)boost::asio::read(sock_, boost::asio::buffer(buf + charsRead, bufLen - charsRead));
 
 	if (charsRead > 0)
 		LogBinaryCommunication("Read", true, buf, charsRead);
@@ -259,7 +350,21 @@ int TCPIPPort::Read(unsigned char* buf, unsigned long bufLen, unsigned long& cha
 
 int TCPIPPort::Purge()
 {
-	return DEVICE_OK;
+ERRH_START
+	rxBuffer_.clear();
+	if (!initialized_)
+		return DEVICE_OK;
+
+	// Discard data that has arrived but has not been read
+	boost::system::error_code ec;
+	while (sock_.available(ec) > 0 && !ec)
+		sock_.read_some(boost::asio::buffer(rxChunk_));
+ERRH_END
+}
+
+void TCPIPPort::ApplyNoDelay()
+{
+	sock_.set_option(tcp::no_delay(noDelay_));
 }
 
 int TCPIPPort::OnHost(MM::PropertyBase* pProp, MM::ActionType eAct)
@@ -320,6 +425,24 @@ int TCPIPPort::OnAnswerTimeout(MM::PropertyBase* pProp, MM::ActionType eAct)
 	return DEVICE_OK;
 }
 
+int TCPIPPort::OnNoDelay(MM::PropertyBase* pProp, MM::ActionType eAct)
+{
+ERRH_START
+	if (eAct == MM::BeforeGet)
+	{
+		pProp->Set(noDelay_ ? "Yes" : "No");
+	}
+	else if (eAct == MM::AfterSet)
+	{
+		std::string s;
+		pProp->Get(s);
+		noDelay_ = (s == "Yes");
+		if (initialized_)
+			ApplyNoDelay();
+	}
+ERRH_END
+}
+
 int TCPIPPort::GetCount()
 {
 	return count_;
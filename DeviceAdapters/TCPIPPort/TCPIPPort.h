@@ -26,6 +26,8 @@
 #include "boost/asio.hpp"
 
 #include <istream>
+#include <string>
+#include <vector>
 
 #include "MMDevice.h"
 #include "DeviceBase.h"
@@ -67,6 +69,7 @@ public:
 	int OnHost(MM::PropertyBase* pProp, MM::ActionType eAct);
 	int OnPort(MM::PropertyBase* pProp, MM::ActionType eAct);
 	int OnAnswerTimeout(MM::PropertyBase* pProp, MM::ActionType eAct);
+	int OnNoDelay(MM::PropertyBase* pProp, MM::ActionType eAct);
 
 	void close_sock();
 
@@ -81,9 +84,18 @@ private:
 
 	boost::asio::io_service ios_;
 	boost::asio::ip::tcp::socket sock_;
+	boost::asio::deadline_timer deadline_;
 	std::string host_;
 	unsigned short port_;
 	unsigned int answerTimeoutMs_;
+	bool noDelay_;
+
+	// Received data not yet returned by GetAnswer or Read
+	std::string rxBuffer_;
+	std::vector<char> rxChunk_;
+
+	bool ReceiveSome(unsigned long timeoutMs);
+	void ApplyNoDelay();
 
 	void LogAsciiCommunication(const char * prefix, bool isInput, const std::string & data);
 	void LogBinaryCommunication(const char* prefix, bool isInput, const unsigned char* content, std::size_t length);
@@ -1784,6 +1784,30 @@ int CTriggerScopeDAC::SendPropertySequence(const char* propertyName)
 	else
 		return DEVICE_UNSUPPORTED_COMMAND;
 }
+/**
+* Load a whole sequence of voltages and send it to the device
+*/
+int CTriggerScopeDAC::LoadFloatPropertySequence(const char* propertyName, const double* values, unsigned long count) 
+{
+	if(strcmp(propertyName,"Volts")==0)
+	{
+		sequence_.assign(values, values + count);
+		return SendDASequence();
+	}
+	else
+		return DEVICE_UNSUPPORTED_COMMAND;
+}
+
+int CTriggerScopeDAC::LoadIntegerPropertySequence(const char* propertyName, const long* values, unsigned long count) 
+{
+	if(strcmp(propertyName,"Volts")==0)
+	{
+		sequence_.assign(values, values + count);
+		return SendDASequence();
+	}
+	else
+		return DEVICE_UNSUPPORTED_COMMAND;
+}
 
 int CTriggerScopeFocus::WriteToPort(unsigned long value)
 {
@@ -223,7 +223,11 @@ public:
     */
     int SendPropertySequence(const char* propertyName) ;
 
-   //int LoadProperySequence(const char* name, std::vector<double>) ;
+    /**
+    * Load a whole sequence of numeric values at once
+    */
+    int LoadFloatPropertySequence(const char* propertyName, const double* values, unsigned long count) ;
+    int LoadIntegerPropertySequence(const char* propertyName, const long* values, unsigned long count) ;
 
    int OnVolts(MM::PropertyBase* pProp, MM::ActionType eAct);
    int OnMaxVolt(MM::PropertyBase* pProp, MM::ActionType eAct);
@@ -0,0 +1,143 @@
+///////////////////////////////////////////////////////////////////////////////
+// FILE:          DASequencer.cpp
+// PROJECT:       Micro-Manager
+// SUBSYSTEM:     DeviceAdapters
+//-----------------------------------------------------------------------------
+// DESCRIPTION:   Loads the property and stage sequences of the DA-based
+//                utility devices into the sequences of the underlying DAs.
+//
+// LICENSE:       This file is distributed under the BSD license.
+//                License text is included with the source distribution.
+//
+//                This file is distributed in the hope that it will be useful,
+//                but WITHOUT ANY WARRANTY; without even the implied warranty
+//                of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+//
+//                IN NO EVENT SHALL THE COPYRIGHT OWNER OR
+//                CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+//                INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES.
+//
+
+#ifdef _WIN32
+// Prevent windows.h from defining min and max macros,
+// which clash with std::min and std::max.
+#define NOMINMAX
+#endif
+
+#include "Utilities.h"
+
+#include <climits>
+
+
+int DASequencer::GetMaxLength(const std::vector<MM::SignalIO*>& das, long& maxLength)
+{
+   maxLength = LONG_MAX;
+   for (size_t i = 0; i < das.size(); ++i)
+   {
+      if (!das[i])
+         continue;
+
+      bool sequenceable = false;
+      int ret = das[i]->IsDASequenceable(sequenceable);
+      if (ret != DEVICE_OK)
+         return ret;
+      if (!sequenceable)
+      {
+         // One DA switching in software would break the timing of the
+         // others, so the combination is not sequenceable at all
+         maxLength = 0;
+         return DEVICE_OK;
+      }
+
+      long daMaxLength = 0;
+      ret = das[i]->GetDASequenceMaxLength(daMaxLength);
+      if (ret != DEVICE_OK)
+         return ret;
+      if (daMaxLength < maxLength)
+         maxLength = daMaxLength;
+   }
+   if (maxLength == LONG_MAX) // No device?
+      maxLength = 0;
+   return DEVICE_OK;
+}
+
+
+int DASequencer::Load(const std::vector<MM::SignalIO*>& das,
+   const std::vector<std::vector<double> >& sequences)
+{
+   if (sequences.size() != das.size())
+      return DEVICE_ERR;
+
+   for (size_t i = 0; i < das.size(); ++i)
+   {
+      if (!das[i] || sequences[i].empty())
+         continue;
+
+      long maxLength = 0;
+      int ret = GetMaxLength(std::vector<MM::SignalIO*>(1, das[i]), maxLength);
+      if (ret != DEVICE_OK)
+         return ret;
+      if (maxLength == 0)
+         return DEVICE_PROPERTY_NOT_SEQUENCEABLE;
+      if (static_cast<long>(sequences[i].size()) > maxLength)
+         return DEVICE_SEQUENCE_TOO_LARGE;
+
+      ret = das[i]->ClearDASequence();
+      if (ret != DEVICE_OK)
+         return ret;
+      for (std::vector<double>::const_iterator it = sequences[i].begin(),
+         end = sequences[i].end(); it != end; ++it)
+      {
+         ret = das[i]->AddToDASequence(*it);
+         if (ret != DEVICE_OK)
+            return ret;
+      }
+      ret = das[i]->SendDASequence();
+      if (ret != DEVICE_OK)
+         return ret;
+   }
+   return DEVICE_OK;
+}
+
+
+/*
+ * Start and Stop act on all DAs in the list, so pass only those that were
+ * loaded with a sequence.
+ */
+int DASequencer::Start(const std::vector<MM::SignalIO*>& das)
+{
+   for (size_t i = 0; i < das.size(); ++i)
+   {
+      if (!das[i])
+         continue;
+
+      int ret = das[i]->StartDASequence();
+      if (ret != DEVICE_OK)
+      {
+         // Do not leave part of the DAs waiting for triggers
+         for (size_t j = 0; j < i; ++j)
+         {
+            if (das[j])
+               das[j]->StopDASequence();
+         }
+         return ret;
+      }
+   }
+   return DEVICE_OK;
+}
+
+
+int DASequencer::Stop(const std::vector<MM::SignalIO*>& das)
+{
+   int result = DEVICE_OK;
+   for (size_t i = 0; i < das.size(); ++i)
+   {
+      if (!das[i])
+         continue;
+
+      int ret = das[i]->StopDASequence();
+      if (ret != DEVICE_OK && result == DEVICE_OK)
+         result = ret;
+   }
+   return result;
+}
@@ -32,13 +32,17 @@
 
 #include "Utilities.h"
 
+#include <boost/lexical_cast.hpp>
+
 extern const char* g_DeviceNameDAShutter;
 extern const char* g_NoDevice;
 
 
 DAShutter::DAShutter() :
    DADeviceName_(g_NoDevice),
-   initialized_(false)
+   initialized_(false),
+   sequenceOpenVolts_(0.0),
+   gateOpenBeforeSequence_(false)
 {
    InitializeDefaultErrorMessages();
 
@@ -186,5 +190,80 @@ int DAShutter::OnState(MM::PropertyBase* pProp, MM::ActionType eAct)
          open = true;
       return SetOpen(open);
    }
+   else if (eAct == MM::IsSequenceable)
+   {
+      // The gate can not be sequenced, so a State sequence is played as
+      // a voltage sequence, with the gate kept open while it runs
+      MM::SignalIO* da = (MM::SignalIO*)GetDevice(DADeviceName_.c_str());
+      long maxSeqLen = 0;
+      int ret = DASequencer::GetMaxLength(std::vector<MM::SignalIO*>(1, da), maxSeqLen);
+      if (ret != DEVICE_OK)
+         return ret;
+      pProp->SetSequenceable(maxSeqLen);
+   }
+   else if (eAct == MM::AfterLoadSequence)
+   {
+      MM::SignalIO* da = (MM::SignalIO*)GetDevice(DADeviceName_.c_str());
+      if (da == 0)
+         return ERR_NO_DA_DEVICE;
+
+      // "Open" is the voltage the DA is currently set to, "closed" is 0 V
+      double minVolts = 0.0, maxVolts = 0.0;
+      int ret = da->GetLimits(minVolts, maxVolts);
+      if (ret != DEVICE_OK)
+         return ret;
+      ret = da->GetSignal(sequenceOpenVolts_);
+      if (ret != DEVICE_OK)
+         sequenceOpenVolts_ = maxVolts;
+      double closedVolts = (minVolts > 0.0 || maxVolts < 0.0) ? minVolts : 0.0;
+
+      std::vector<std::string> sequence = pProp->GetSequence();
+      std::vector<std::vector<double> > voltages(1);
+      for (std::vector<std::string>::const_iterator it = sequence.begin(),
+         end = sequence.end(); it != end; ++it)
+      {
+         long state;
+         try
+         {
+            state = boost::lexical_cast<long>(*it);
+         }
+         catch (boost::bad_lexical_cast&)
+         {
+            return DEVICE_ERR;
+         }
+         voltages[0].push_back(state == 1 ? sequenceOpenVolts_ : closedVolts);
+      }
+      return DASequencer::Load(std::vector<MM::SignalIO*>(1, da), voltages);
+   }
+   else if (eAct == MM::StartSequence)
+   {
+      MM::SignalIO* da = (MM::SignalIO*)GetDevice(DADeviceName_.c_str());
+      if (da == 0)
+         return ERR_NO_DA_DEVICE;
+      int ret = GetOpen(gateOpenBeforeSequence_);
+      if (ret != DEVICE_OK)
+         return ret;
+      ret = SetOpen(true);
+      if (ret != DEVICE_OK)
+         return ret;
+      ret = DASequencer::Start(std::vector<MM::SignalIO*>(1, da));
+      if (ret != DEVICE_OK)
+         SetOpen(gateOpenBeforeSequence_);
+      return ret;
+   }
+   else if (eAct == MM::StopSequence)
+   {
+      MM::SignalIO* da = (MM::SignalIO*)GetDevice(DADeviceName_.c_str());
+      if (da == 0)
+         return ERR_NO_DA_DEVICE;
+      int ret = DASequencer::Stop(std::vector<MM::SignalIO*>(1, da));
+      if (ret != DEVICE_OK)
+         return ret;
+      // Leave the DA at its "open" voltage, with the gate as it was
+      ret = da->SetSignal(sequenceOpenVolts_);
+      if (ret != DEVICE_OK)
+         return ret;
+      return SetOpen(gateOpenBeforeSequence_);
+   }
    return DEVICE_OK;
 }
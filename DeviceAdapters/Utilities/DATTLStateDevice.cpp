@@ -251,11 +251,7 @@ int DATTLStateDevice::OnState(MM::PropertyBase* pProp, MM::ActionType eAct)
          MM::SignalIO* da = static_cast<MM::SignalIO*>(GetDevice(daDeviceLabels_[i].c_str()));
          if (da)
          {
-            int ret;
-            if (invert_)
-               ret = da->SetSignal((mask & (1 << i)) ? 0.0 : ttlVoltage_);
-            else
-               ret = da->SetSignal((mask & (1 << i)) ? ttlVoltage_ : 0.0);
+            int ret = da->SetSignal(GetVoltage(mask, i));
             lastChangeTime_ = GetCurrentMMTime();
             if (ret != DEVICE_OK)
                return ret;
@@ -264,34 +260,10 @@ int DATTLStateDevice::OnState(MM::PropertyBase* pProp, MM::ActionType eAct)
    }
    else if (eAct == MM::IsSequenceable)
    {
-      bool allSequenceable = true;
-      long maxSeqLen = LONG_MAX;
-      for (unsigned int i = 0; i < numberOfDADevices_; ++i)
-      {
-         MM::SignalIO* da = static_cast<MM::SignalIO*>(GetDevice(daDeviceLabels_[i].c_str()));
-         if (da)
-         {
-            bool sequenceable = false;
-            int ret = da->IsDASequenceable(sequenceable);
-            if (ret != DEVICE_OK)
-               return ret;
-            if (sequenceable)
-            {
-               long daMaxLen = 0;
-               ret = da->GetDASequenceMaxLength(daMaxLen);
-               if (ret != DEVICE_OK)
-                  return ret;
-               if (daMaxLen < maxSeqLen)
-                  maxSeqLen = daMaxLen;
-            }
-            else
-            {
-               allSequenceable = false;
-            }
-         }
-      }
-      if (maxSeqLen == LONG_MAX) // No device?
-         maxSeqLen = 0;
+      long maxSeqLen = 0;
+      int ret = DASequencer::GetMaxLength(GetDAs(), maxSeqLen);
+      if (ret != DEVICE_OK)
+         return ret;
       pProp->SetSequenceable(maxSeqLen);
    }
    else if (eAct == MM::AfterLoadSequence)
@@ -311,63 +283,50 @@ int DATTLStateDevice::OnState(MM::PropertyBase* pProp, MM::ActionType eAct)
          }
       }
 
+      std::vector<std::vector<double> > sequences(numberOfDADevices_);
       for (unsigned int i = 0; i < numberOfDADevices_; ++i)
       {
-         MM::SignalIO* da = static_cast<MM::SignalIO*>(GetDevice(daDeviceLabels_[i].c_str()));
-
-         if (da)
+         for (std::vector<long>::const_iterator it = values.begin(),
+            end = values.end(); it != end; ++it)
          {
-            int ret = da->ClearDASequence();
-            if (ret != DEVICE_OK)
-               return ret;
-            for (std::vector<long>::const_iterator it = values.begin(),
-               end = values.end(); it != end; ++it)
-            {
-               if (invert_)
-                  ret = da->AddToDASequence((*it & (1 << i)) ? 0.0 : ttlVoltage_);
-               else
-                  ret = da->AddToDASequence((*it & (1 << i)) ? ttlVoltage_ : 0.0);
-               if (ret != DEVICE_OK)
-                  return ret;
-            }
-            ret = da->SendDASequence();
-            if (ret != DEVICE_OK)
-               return ret;
+            sequences[i].push_back(GetVoltage(*it, i));
          }
       }
+      return DASequencer::Load(GetDAs(), sequences);
    }
    else if (eAct == MM::StartSequence)
    {
-      for (unsigned int i = 0; i < numberOfDADevices_; ++i)
-      {
-         MM::SignalIO* da = static_cast<MM::SignalIO*>(GetDevice(daDeviceLabels_[i].c_str()));
-
-         if (da)
-         {
-            int ret = da->StartDASequence();
-            if (ret != DEVICE_OK)
-               return ret;
-         }
-      }
+      return DASequencer::Start(GetDAs());
    }
    else if (eAct == MM::StopSequence)
    {
-      for (unsigned int i = 0; i < numberOfDADevices_; ++i)
-      {
-         MM::SignalIO* da = static_cast<MM::SignalIO*>(GetDevice(daDeviceLabels_[i].c_str()));
-
-         if (da)
-         {
-            int ret = da->StopDASequence();
-            if (ret != DEVICE_OK)
-               return ret;
-         }
-      }
+      return DASequencer::Stop(GetDAs());
    }
    return DEVICE_OK;
 }
 
 
+std::vector<MM::SignalIO*> DATTLStateDevice::GetDAs() const
+{
+   std::vector<MM::SignalIO*> das;
+   for (unsigned int i = 0; i < numberOfDADevices_; ++i)
+   {
+      das.push_back(static_cast<MM::SignalIO*>(GetDevice(daDeviceLabels_[i].c_str())));
+   }
+   return das;
+}
+
+
+// TTL level of DA index for the given state
+double DATTLStateDevice::GetVoltage(long mask, unsigned int index) const
+{
+   bool high = (mask & (1 << index)) != 0;
+   if (invert_)
+      high = !high;
+   return high ? ttlVoltage_ : 0.0;
+}
+
+
 int DATTLStateDevice::OnInvert(MM::PropertyBase* pProp, MM::ActionType eAct)
 {
    if (eAct == MM::BeforeGet)
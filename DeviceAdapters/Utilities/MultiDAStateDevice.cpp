@@ -45,8 +45,11 @@ MultiDAStateDevice::MultiDAStateDevice() :
    maxVoltage_(5.0),
    initialized_(false),
    mask_(0L),
-   lastChangeTime_(0, 0)
+   lastChangeTime_(0, 0),
+   runningSequences_(0)
 {
+   SetErrorText(ERR_VOLT_OUT_OF_RANGE, "The voltage sequence contains a value outside the voltage range");
+
    CPropertyAction* pAct = new CPropertyAction(this,
       &MultiDAStateDevice::OnNumberOfDADevices);
    CreateIntegerProperty("NumberOfDADevices",
@@ -84,6 +87,9 @@ int MultiDAStateDevice::Initialize()
       daDeviceLabels_.push_back("");
       voltages_.push_back(0.0);
    }
+   stateSequence_.clear();
+   voltageSequences_.assign(numberOfDADevices_, std::vector<double>());
+   sequencedDAs_.assign(numberOfDADevices_, false);
 
    // Get labels of DA (SignalIO) devices
    std::vector<std::string> daDevices;
@@ -170,6 +176,9 @@ int MultiDAStateDevice::Shutdown()
 
    daDeviceLabels_.clear();
    voltages_.clear();
+   stateSequence_.clear();
+   voltageSequences_.clear();
+   sequencedDAs_.clear();
 
    initialized_ = false;
    return DEVICE_OK;
@@ -303,35 +312,10 @@ int MultiDAStateDevice::OnState(MM::PropertyBase* pProp, MM::ActionType eAct)
    }
    else if (eAct == MM::IsSequenceable)
    {
-      bool allSequenceable = true;
-      long maxSeqLen = LONG_MAX;
-      for (unsigned int i = 0; i < numberOfDADevices_; ++i)
-      {
-         MM::SignalIO* da = static_cast<MM::SignalIO*>(GetDevice(daDeviceLabels_[i].c_str()));
-
-         if (da)
-         {
-            bool sequenceable = false;
-            int ret = da->IsDASequenceable(sequenceable);
-            if (ret != DEVICE_OK)
-               return ret;
-            if (sequenceable)
-            {
-               long daMaxLen = 0;
-               ret = da->GetDASequenceMaxLength(daMaxLen);
-               if (ret != DEVICE_OK)
-                  return ret;
-               if (daMaxLen < maxSeqLen)
-                  maxSeqLen = daMaxLen;
-            }
-            else
-            {
-               allSequenceable = false;
-            }
-         }
-      }
-      if (maxSeqLen == LONG_MAX) // No device?
-         maxSeqLen = 0;
+      long maxSeqLen = 0;
+      int ret = DASequencer::GetMaxLength(GetDAs(), maxSeqLen);
+      if (ret != DEVICE_OK)
+         return ret;
       pProp->SetSequenceable(maxSeqLen);
    }
    else if (eAct == MM::AfterLoadSequence)
@@ -351,56 +335,16 @@ int MultiDAStateDevice::OnState(MM::PropertyBase* pProp, MM::ActionType eAct)
          }
       }
 
-      for (unsigned int i = 0; i < numberOfDADevices_; ++i)
-      {
-         MM::SignalIO* da = static_cast<MM::SignalIO*>(GetDevice(daDeviceLabels_[i].c_str()));
-
-         if (da)
-         {
-            int ret = da->ClearDASequence();
-            if (ret != DEVICE_OK)
-               return ret;
-            for (std::vector<long>::const_iterator it = values.begin(),
-               end = values.end(); it != end; ++it)
-            {
-               double volts = voltages_[i];
-               ret = da->AddToDASequence(*it & (1 << i) ? volts : 0.0);
-               if (ret != DEVICE_OK)
-                  return ret;
-            }
-            ret = da->SendDASequence();
-            if (ret != DEVICE_OK)
-               return ret;
-         }
-      }
+      stateSequence_ = values;
+      return LoadSequences(values.size());
    }
    else if (eAct == MM::StartSequence)
    {
-      for (unsigned int i = 0; i < numberOfDADevices_; ++i)
-      {
-         MM::SignalIO* da = static_cast<MM::SignalIO*>(GetDevice(daDeviceLabels_[i].c_str()));
-
-         if (da)
-         {
-            int ret = da->StartDASequence();
-            if (ret != DEVICE_OK)
-               return ret;
-         }
-      }
+      return StartSequences();
    }
    else if (eAct == MM::StopSequence)
    {
-      for (unsigned int i = 0; i < numberOfDADevices_; ++i)
-      {
-         MM::SignalIO* da = static_cast<MM::SignalIO*>(GetDevice(daDeviceLabels_[i].c_str()));
-
-         if (da)
-         {
-            int ret = da->StopDASequence();
-            if (ret != DEVICE_OK)
-               return ret;
-         }
-      }
+      return StopSequences();
    }
    return DEVICE_OK;
 }
@@ -429,5 +373,154 @@ int MultiDAStateDevice::OnVoltage(MM::PropertyBase* pProp, MM::ActionType eAct,
             return ret;
       }
    }
+   else if (eAct == MM::IsSequenceable)
+   {
+      // Only this channel's DA has to follow a voltage sequence
+      MM::SignalIO* da = static_cast<MM::SignalIO*>(GetDevice(daDeviceLabels_[i].c_str()));
+      long maxSeqLen = 0;
+      if (da)
+      {
+         int ret = DASequencer::GetMaxLength(std::vector<MM::SignalIO*>(1, da), maxSeqLen);
+         if (ret != DEVICE_OK)
+            return ret;
+      }
+      pProp->SetSequenceable(maxSeqLen);
+   }
+   else if (eAct == MM::AfterLoadSequence)
+   {
+      const std::vector<double>& values = pProp->GetFloatSequence();
+      for (std::vector<double>::const_iterator it = values.begin(),
+         end = values.end(); it != end; ++it)
+      {
+         if (*it < minVoltage_ || *it > maxVoltage_)
+            return ERR_VOLT_OUT_OF_RANGE;
+      }
+
+      voltageSequences_[i] = values;
+      return LoadSequences(values.size());
+   }
+   else if (eAct == MM::StartSequence)
+   {
+      return StartSequences();
+   }
+   else if (eAct == MM::StopSequence)
+   {
+      return StopSequences();
+   }
    return DEVICE_OK;
 }
+
+
+std::vector<MM::SignalIO*> MultiDAStateDevice::GetDAs() const
+{
+   std::vector<MM::SignalIO*> das;
+   for (unsigned int i = 0; i < numberOfDADevices_; ++i)
+   {
+      das.push_back(static_cast<MM::SignalIO*>(GetDevice(daDeviceLabels_[i].c_str())));
+   }
+   return das;
+}
+
+
+// The state the DAs are set to outside of sequences, taking the gate into account
+long MultiDAStateDevice::GetOutputMask()
+{
+   bool gateOpen;
+   GetGateOpen(gateOpen);
+   long mask = mask_;
+   if (!gateOpen)
+   {
+      GetProperty(MM::g_Keyword_Closed_Position, mask);
+   }
+   return mask;
+}
+
+
+/*
+ * Combines the State sequence and the voltage sequences into one voltage
+ * sequence per DA, after one of them was (re)loaded with the given length.
+ * Properties that are not sequenced contribute their current value.  A DA is
+ * only loaded if its output can change during the sequence, so that e.g. a
+ * voltage sequence for one channel does not require the other DAs to be
+ * sequenceable.
+ */
+int MultiDAStateDevice::LoadSequences(size_t length)
+{
+   // The core loads all sequences of an acquisition with the same length;
+   // anything else is left over from an earlier acquisition
+   if (stateSequence_.size() != length)
+      stateSequence_.clear();
+   for (unsigned int i = 0; i < numberOfDADevices_; ++i)
+   {
+      if (voltageSequences_[i].size() != length)
+         voltageSequences_[i].clear();
+   }
+
+   std::vector<MM::SignalIO*> das = GetDAs();
+   std::vector<std::vector<double> > sequences(numberOfDADevices_);
+   long mask = GetOutputMask();
+   for (unsigned int i = 0; i < numberOfDADevices_; ++i)
+   {
+      sequencedDAs_[i] = das[i] && (!stateSequence_.empty() || !voltageSequences_[i].empty());
+      if (!sequencedDAs_[i])
+         continue;
+      for (size_t k = 0; k < length; ++k)
+      {
+         if (!stateSequence_.empty())
+            mask = stateSequence_[k];
+         double volts = voltageSequences_[i].empty() ? voltages_[i] : voltageSequences_[i][k];
+         sequences[i].push_back((mask & (1 << i)) ? volts : 0.0);
+      }
+   }
+   return DASequencer::Load(das, sequences);
+}
+
+
+/*
+ * The State property and each of the voltage properties are started and
+ * stopped separately by the core, but all DAs have to run together: they are
+ * started with the first property and stopped with the last one.
+ */
+int MultiDAStateDevice::StartSequences()
+{
+   if (runningSequences_++ > 0)
+      return DEVICE_OK;
+
+   std::vector<MM::SignalIO*> das = GetDAs();
+   for (unsigned int i = 0; i < numberOfDADevices_; ++i)
+   {
+      if (!sequencedDAs_[i])
+         das[i] = 0;
+   }
+   int ret = DASequencer::Start(das);
+   if (ret != DEVICE_OK)
+      runningSequences_ = 0;
+   return ret;
+}
+
+
+int MultiDAStateDevice::StopSequences()
+{
+   if (runningSequences_ > 1)
+   {
+      --runningSequences_;
+      return DEVICE_OK;
+   }
+   runningSequences_ = 0;
+
+   std::vector<MM::SignalIO*> das = GetDAs();
+   for (unsigned int i = 0; i < numberOfDADevices_; ++i)
+   {
+      if (!sequencedDAs_[i])
+         das[i] = 0;
+   }
+   int ret = DASequencer::Stop(das);
+
+   // The next acquisition loads its own sequences
+   stateSequence_.clear();
+   for (unsigned int i = 0; i < numberOfDADevices_; ++i)
+   {
+      voltageSequences_[i].clear();
+   }
+   return ret;
+}
@@ -361,6 +361,26 @@ private:
 };
 
 
+/**
+ * DASequencer: Loads sequences of a DA-based utility device into the DAs it
+ * drives.  Each DA gets its own voltage sequence; all sequences have the same
+ * length, so that the DAs step through them together on a shared trigger.
+ * Null entries in the list of DAs (unassigned channels) are skipped.
+ */
+class DASequencer
+{
+public:
+   // Maximum length that all DAs support; 0 if any of them is not sequenceable
+   static int GetMaxLength(const std::vector<MM::SignalIO*>& das, long& maxLength);
+   // sequences[i] is sent to das[i]; DAs with an empty sequence are left
+   // alone and need not be sequenceable
+   static int Load(const std::vector<MM::SignalIO*>& das,
+      const std::vector<std::vector<double> >& sequences);
+   static int Start(const std::vector<MM::SignalIO*>& das);
+   static int Stop(const std::vector<MM::SignalIO*>& das);
+};
+
+
 /**
  * DAMonochromator: Use DA device as monochromator
  * Also acts as a shutter (using a particular wavelength as "closed")
@@ -441,6 +461,9 @@ private:
    std::vector<std::string> availableDAs_;
    std::string DADeviceName_;
    bool initialized_;
+   // Restored when a State sequence stops
+   double sequenceOpenVolts_;
+   bool gateOpenBeforeSequence_;
 };
 
 /**
@@ -618,6 +641,9 @@ private:
    int OnInvert(MM::PropertyBase* pProp, MM::ActionType eAct);
    int OnTTLLevel(MM::PropertyBase* pProp, MM::ActionType eAct);
 
+   std::vector<MM::SignalIO*> GetDAs() const;
+   double GetVoltage(long mask, unsigned int index) const;
+
 private:
    // Invariant: daDeviceLabels_ and daDevices_ are always size
    // numberOfDADevices_ once Initialize() returns.
@@ -734,6 +760,12 @@ private:
    int OnState(MM::PropertyBase* pProp, MM::ActionType eAct);
    int OnVoltage(MM::PropertyBase* pProp, MM::ActionType eAct, long index);
 
+   std::vector<MM::SignalIO*> GetDAs() const;
+   long GetOutputMask();
+   int LoadSequences(size_t length);
+   int StartSequences();
+   int StopSequences();
+
 private:
    // Invariant: daDeviceLabels_, daDevices_, and voltages_ are always size
    // numberOfDADevices_ once Initialize() returns.
@@ -752,6 +784,13 @@ private:
    long mask_;
 
    MM::MMTime lastChangeTime_;
+
+   // The State sequence and the per-DA voltage sequences are combined into
+   // one voltage sequence per DA; empty while not sequencing.
+   std::vector<long> stateSequence_;
+   std::vector<std::vector<double> > voltageSequences_;
+   std::vector<bool> sequencedDAs_; // DAs that were sent a sequence
+   int runningSequences_;
 };
 
 
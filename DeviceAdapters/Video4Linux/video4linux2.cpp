@@ -39,6 +39,17 @@ strace -f java -Djava.library.path=/usr/lib/micro-manager -classpath /usr/share/
 *              - USB ID 1871:7670 Aveo Technology Corp. (uvcvideo) - COLEMETER(R) USB 2.0 Digital Microscope
 *              - USB ID 046d:0826 Logitech, Inc. HD Webcam C525
 *
+* Sequence acquisition keeps BufferCount driver buffers queued. Frames
+* are dequeued without blocking once poll() reports them, converted
+* (with SSE2 where available) and requeued before being handed to the
+* core. Gaps in the driver sequence numbers are counted as dropped frames
+* (DroppedFrames property). Devices that do not offer YUYV are captured
+* as NV12 if possible.
+*
+* To test without a camera, load the vivid virtual video driver
+* (sudo modprobe vivid) and set DevicePath to the capture node it
+* creates (see v4l2-ctl --list-devices).
+*
 */
 // LICENSE:       This file is distributed under the "LGPL" license.
 //
@@ -72,9 +83,15 @@ strace -f java -Djava.library.path=/usr/lib/micro-manager -classpath /usr/share/
 #include <cstring>
 #include <cerrno>
 #include <sys/mman.h>
+#include <poll.h>
 
 #include <pthread.h>
 
+#if defined(__SSE2__)
+#define V4L2_USE_SSE2
+#include <emmintrin.h>
+#endif
+
 using namespace std;
 
 const char
@@ -83,10 +100,17 @@ const char
   *gPropertyDevicePath = "DevicePath",
   *gPropertyDevicePathDefault = "/dev/video0",
   *gPropertyNameResolution = "Resolution",
-  *gResolutionDefault = "640x480";
+  *gResolutionDefault = "640x480",
+  *gPropertyBufferCount = "BufferCount",
+  *gPropertyDroppedFrames = "DroppedFrames";
 
 const long gWidthDefault = 640,
-           gHeightDefault = 480;
+           gHeightDefault = 480,
+           gBufferCountDefault = 4,
+           gBufferCountMax = 32;
+
+// How long to wait for the driver to deliver a frame
+const int gFrameTimeoutMs = 10000;
 
 struct VidBuffer {
   void *start;
@@ -97,11 +121,157 @@ struct VidBuffer {
 typedef struct State State;
 struct State {
   int W, H, fd;
+  unsigned int pixelformat;  // V4L2_PIX_FMT_YUYV or V4L2_PIX_FMT_NV12
+  unsigned int bytesperline; // of the Y plane for NV12
   struct VidBuffer *buffers;
   unsigned int buffers_count;
   struct v4l2_buffer *buf;
 };
 
+/* YUV to RGBA32 (stored as BGRA) conversion with the integer BT.601
+ * coefficients. The SSE2 path gives the same results as the scalar one;
+ * it converts 8 pixels at a time from 8 Y samples and the 4 U/V pairs
+ * that go with them. */
+
+static inline unsigned char clip(int val)
+{
+  if (val <= 0)
+    return 0;
+  else if (val >= 255)
+    return 255;
+  else
+    return val;
+}
+
+static inline void yuvPairToBgra(int y0, int y1, int u, int v, unsigned char* out)
+{
+  int c = y0 - 16;
+  int d = u - 128;
+  int e = v - 128;
+  out[0] = clip((298 * c + 516 * d + 128) >> 8); // blue
+  out[1] = clip((298 * c - 100 * d - 208 * e + 128) >> 8); // green
+  out[2] = clip((298 * c + 409 * e + 128) >> 8); // red
+  out[3] = 255; // alpha
+  c = y1 - 16;
+  out[4] = clip((298 * c + 516 * d + 128) >> 8);
+  out[5] = clip((298 * c - 100 * d - 208 * e + 128) >> 8);
+  out[6] = clip((298 * c + 409 * e + 128) >> 8);
+  out[7] = 255;
+}
+
+#ifdef V4L2_USE_SSE2
+static inline __m128i coefficientPair(short a, short b)
+{
+  return _mm_set1_epi32((int)(((unsigned)(unsigned short)b << 16) | (unsigned short)a));
+}
+
+// y: Y0..Y7, uv: U0 V0 U1 V1 U2 V2 U3 V3, as 16-bit lanes
+static inline void yuv8ToBgra(__m128i y, __m128i uv, unsigned char* out)
+{
+  const __m128i lowWord = _mm_set1_epi32(0xFFFF);
+  const __m128i u = _mm_and_si128(uv, lowWord);
+  const __m128i v = _mm_srli_epi32(uv, 16);
+  const __m128i c = _mm_sub_epi16(y, _mm_set1_epi16(16));
+  const __m128i d = _mm_sub_epi16(_mm_or_si128(u, _mm_slli_epi32(u, 16)), _mm_set1_epi16(128));
+  const __m128i e = _mm_sub_epi16(_mm_or_si128(v, _mm_slli_epi32(v, 16)), _mm_set1_epi16(128));
+  const __m128i one = _mm_set1_epi16(1);
+
+  const __m128i kB = coefficientPair(298, 516);
+  const __m128i kG = coefficientPair(298, -100);
+  const __m128i kGe = coefficientPair(-208, 128);
+  const __m128i kR = coefficientPair(298, 409);
+  const __m128i round = _mm_set1_epi32(128);
+
+  __m128i cd = _mm_unpacklo_epi16(c, d);
+  __m128i ce = _mm_unpacklo_epi16(c, e);
+  __m128i e1 = _mm_unpacklo_epi16(e, one);
+  __m128i bLo = _mm_srai_epi32(_mm_add_epi32(_mm_madd_epi16(cd, kB), round), 8);
+  __m128i gLo = _mm_srai_epi32(_mm_add_epi32(_mm_madd_epi16(cd, kG), _mm_madd_epi16(e1, kGe)), 8);
+  __m128i rLo = _mm_srai_epi32(_mm_add_epi32(_mm_madd_epi16(ce, kR), round), 8);
+
+  cd = _mm_unpackhi_epi16(c, d);
+  ce = _mm_unpackhi_epi16(c, e);
+  e1 = _mm_unpackhi_epi16(e, one);
+  __m128i bHi = _mm_srai_epi32(_mm_add_epi32(_mm_madd_epi16(cd, kB), round), 8);
+  __m128i gHi = _mm_srai_epi32(_mm_add_epi32(_mm_madd_epi16(cd, kG), _mm_madd_epi16(e1, kGe)), 8);
+  __m128i rHi = _mm_srai_epi32(_mm_add_epi32(_mm_madd_epi16(ce, kR), round), 8);
+
+  // Saturating packs do the clipping
+  const __m128i br = _mm_packus_epi16(_mm_packs_epi32(bLo, bHi), _mm_packs_epi32(rLo, rHi));
+  const __m128i ga = _mm_packus_epi16(_mm_packs_epi32(gLo, gHi), _mm_set1_epi16(255));
+  const __m128i bg = _mm_unpacklo_epi8(br, ga);
+  const __m128i ra = _mm_unpackhi_epi8(br, ga);
+  _mm_storeu_si128((__m128i*)out, _mm_unpacklo_epi16(bg, ra));
+  _mm_storeu_si128((__m128i*)(out + 16), _mm_unpackhi_epi16(bg, ra));
+}
+#endif
+
+static void yuyvToBgra(const State* state, const unsigned char* in, unsigned char* out)
+{
+  for (int j = 0; j < state->H; j++) {
+    const unsigned char* src = in + (size_t)j * state->bytesperline;
+    unsigned char* dst = out + (size_t)j * state->W * 4;
+    int i = 0;
+#ifdef V4L2_USE_SSE2
+    const __m128i lowByte = _mm_set1_epi16(0xFF);
+    for (; i + 8 <= state->W; i += 8) {
+      __m128i px = _mm_loadu_si128((const __m128i*)(src + 2 * i));
+      yuv8ToBgra(_mm_and_si128(px, lowByte), _mm_srli_epi16(px, 8), dst + 4 * i);
+    }
+#endif
+    for (; i + 2 <= state->W; i += 2) {
+      const unsigned char* p = src + 2 * i;
+      yuvPairToBgra(p[0], p[2], p[1], p[3], dst + 4 * i);
+    }
+  }
+}
+
+static void yuyvToGray(const State* state, const unsigned char* in, unsigned char* out)
+{
+  for (int j = 0; j < state->H; j++) {
+    const unsigned char* src = in + (size_t)j * state->bytesperline;
+    unsigned char* dst = out + (size_t)j * state->W;
+    int i = 0;
+#ifdef V4L2_USE_SSE2
+    const __m128i lowByte = _mm_set1_epi16(0xFF);
+    for (; i + 16 <= state->W; i += 16) {
+      __m128i a = _mm_and_si128(_mm_loadu_si128((const __m128i*)(src + 2 * i)), lowByte);
+      __m128i b = _mm_and_si128(_mm_loadu_si128((const __m128i*)(src + 2 * i + 16)), lowByte);
+      _mm_storeu_si128((__m128i*)(dst + i), _mm_packus_epi16(a, b));
+    }
+#endif
+    for (; i < state->W; i++)
+      dst[i] = src[2 * i];
+  }
+}
+
+static void nv12ToBgra(const State* state, const unsigned char* in, unsigned char* out)
+{
+  const unsigned char* uvPlane = in + (size_t)state->bytesperline * state->H;
+  for (int j = 0; j < state->H; j++) {
+    const unsigned char* y = in + (size_t)j * state->bytesperline;
+    const unsigned char* uv = uvPlane + (size_t)(j / 2) * state->bytesperline;
+    unsigned char* dst = out + (size_t)j * state->W * 4;
+    int i = 0;
+#ifdef V4L2_USE_SSE2
+    const __m128i zero = _mm_setzero_si128();
+    for (; i + 8 <= state->W; i += 8) {
+      __m128i y16 = _mm_unpacklo_epi8(_mm_loadl_epi64((const __m128i*)(y + i)), zero);
+      __m128i uv16 = _mm_unpacklo_epi8(_mm_loadl_epi64((const __m128i*)(uv + i)), zero);
+      yuv8ToBgra(y16, uv16, dst + 4 * i);
+    }
+#endif
+    for (; i + 2 <= state->W; i += 2)
+      yuvPairToBgra(y[i], y[i + 1], uv[i], uv[i + 1], dst + 4 * i);
+  }
+}
+
+static void nv12ToGray(const State* state, const unsigned char* in, unsigned char* out)
+{
+  for (int j = 0; j < state->H; j++)
+    memcpy(out + (size_t)j * state->W, in + (size_t)j * state->bytesperline, state->W);
+}
+
 class PixelType {
   public:
     PixelType(string propertyValue, unsigned bytesPerPixel, unsigned numberOfComponents, unsigned bitDepth) :
@@ -135,13 +305,10 @@ class PixelType8Bit : public PixelType {
 
     virtual void convertV4l2ToOutput(
         State *state, unsigned char* in, unsigned char* output) const {
-      int i,j;
-      for (j = 0; j < state->H; j++) {
-        int wj = state->W * j;
-        for (i = 0; i < state->W; i++) {
-          output[i + wj] = in[2*i + 2*wj];
-        }
-      }
+      if (state->pixelformat == V4L2_PIX_FMT_NV12)
+        nv12ToGray(state, in, output);
+      else
+        yuyvToGray(state, in, output);
     }
 };
 string PixelType8Bit::PROPERTY_VALUE = "8bit";
@@ -157,39 +324,12 @@ class PixelTypeYUYV : public PixelType {
 
     virtual void convertV4l2ToOutput(
         State *state, unsigned char* ptrIn, unsigned char* ptrOut) const {
-      /* Convert YUYV to RGBA32, apparently mm does only display colors
+      /* Convert to RGBA32, apparently mm does only display colors
        * in this format */
-      for (int i = 0;  i < state->W * state->H / 2; ++i) {
-        int y0 = ptrIn[0];
-        int u0 = ptrIn[1];
-        int y1 = ptrIn[2];
-        int v0 = ptrIn[3];
-        ptrIn += 4;
-        int c = y0 - 16;
-        int d = u0 - 128;
-        int e = v0 - 128;
-
-        ptrOut[0] = clip((298 * c + 516 * d + 128) >> 8); // blue
-        ptrOut[1] = clip((298 * c - 100 * d - 208 * e + 128) >> 8); // green
-        ptrOut[2] = clip((298 * c + 409 * e + 128) >> 8); // red
-        ptrOut[4] = 255; // alpha
-        c = y1 - 16;
-        ptrOut[4] = clip((298 * c + 516 * d + 128) >> 8); // blue
-        ptrOut[5] = clip((298 * c - 100 * d - 208 * e + 128) >> 8); // green
-        ptrOut[6] = clip((298 * c + 409 * e + 128) >> 8); // red
-        ptrOut[7] = 255; // alpha
-        ptrOut += 8;
-      }
-    }
-
-  private:
-    inline unsigned char clip(int val) const {
-      if (val <= 0)
-        return 0;
-      else if (val >= 255)
-        return 255;
+      if (state->pixelformat == V4L2_PIX_FMT_NV12)
+        nv12ToBgra(state, ptrIn, ptrOut);
       else
-        return val;
+        yuyvToBgra(state, ptrIn, ptrOut);
     }
 };
 string PixelTypeYUYV::PROPERTY_VALUE = "YUYV";
@@ -204,9 +344,14 @@ public:
   // little as possible, don't access hardware, do everything else in
   // Initialize()
   V4L2() :
-    pixelType(&PIXELTYPE_8BIT)
+    pixelType(&PIXELTYPE_8BIT),
+    stopOnOverflow_(false),
+    lastSequence_(0),
+    sequenceValid_(false),
+    droppedFrames_(0)
   {
     initialized_ = 0;
+    memset(state, 0, sizeof(state));
   }
 
   // Shutdown is always called before destructor, in any case release
@@ -241,6 +386,18 @@ public:
     if (nRet != DEVICE_OK)
       return nRet;
 
+    // Driver buffers
+    pAct = new CPropertyAction(this, &V4L2::OnBufferCount);
+    nRet = CreateIntegerProperty(gPropertyBufferCount, gBufferCountDefault, false, pAct);
+    if (nRet != DEVICE_OK)
+      return nRet;
+    SetPropertyLimits(gPropertyBufferCount, 2, gBufferCountMax);
+
+    pAct = new CPropertyAction(this, &V4L2::OnDroppedFrames);
+    nRet = CreateIntegerProperty(gPropertyDroppedFrames, 0, true, pAct);
+    if (nRet != DEVICE_OK)
+      return nRet;
+
     // Binning
     pAct = new CPropertyAction(this, &V4L2::OnBinning);
     nRet = CreateProperty(MM::g_Keyword_Binning, "1", MM::Integer, false, pAct);
@@ -302,12 +459,29 @@ public:
   // blocks until exposure is finished
   int SnapImage()
   {
-    unsigned char* data = VideoTakeBuffer();
-    pixelType->convertV4l2ToOutput(state, data, const_cast<unsigned char*>(imageBuffer.GetPixels()));
-    VideoReturnBuffer();
+    // Frames that were already waiting were exposed before the snap was
+    // requested; hand them back and wait for a new one
+    while (VideoDequeue(0) == DEVICE_OK)
+      VideoReturnBuffer();
+
+    int ret = VideoDequeue(gFrameTimeoutMs);
+    if (ret != DEVICE_OK)
+      return ret;
+    ConvertAndReturnBuffer();
     return DEVICE_OK;
   }
 
+  int StartSequenceAcquisition(long numImages, double interval_ms, bool stopOnOverflow)
+  {
+    if (IsCapturing())
+      return DEVICE_CAMERA_BUSY_ACQUIRING;
+
+    stopOnOverflow_ = stopOnOverflow;
+    sequenceValid_ = false;
+    droppedFrames_ = 0;
+    return CCameraBase<V4L2>::StartSequenceAcquisition(numImages, interval_ms, stopOnOverflow);
+  }
+
   // waits for camera readout
   const unsigned char* GetImageBuffer()
   {
@@ -465,6 +639,34 @@ public:
     return DEVICE_OK;
   }
 
+  int OnBufferCount(MM::PropertyBase* pProp, MM::ActionType eAct)
+  {
+    if (eAct == MM::AfterSet) {
+      if (IsCapturing())
+         return DEVICE_CAMERA_BUSY_ACQUIRING;
+
+      long count;
+      pProp->Get(count);
+      if (initialized_ && (unsigned long)count == state->buffers_count)
+        return DEVICE_OK;
+
+      ostringstream msg;
+      msg << "buffer count changed to " << count;
+      LogMessage(msg.str());
+      return reinitializeDeviceIfRunning();
+    }
+
+    return DEVICE_OK;
+  }
+
+  int OnDroppedFrames(MM::PropertyBase* pProp, MM::ActionType eAct)
+  {
+    if (eAct == MM::BeforeGet) {
+      pProp->Set(droppedFrames_);
+    }
+    return DEVICE_OK;
+  }
+
   int OnGain(MM::PropertyBase* pProp, MM::ActionType eAct)
   {
     if(eAct == MM::BeforeGet){
@@ -482,7 +684,55 @@ public:
      isSequenceable = false; 
      return DEVICE_OK;
   }
-  
+
+protected:
+
+  // Called repeatedly by the sequence thread. The driver keeps filling
+  // the other queued buffers while this one is converted.
+  int ThreadRun()
+  {
+    int ret = VideoDequeue(gFrameTimeoutMs);
+    if (ret != DEVICE_OK)
+      return ret;
+
+    // The driver numbers every frame, including those it had to drop
+    // because no buffer was queued
+    if (sequenceValid_ && state->buf->sequence > lastSequence_ + 1) {
+      droppedFrames_ += state->buf->sequence - lastSequence_ - 1;
+      ostringstream msg;
+      msg << "driver dropped " << (state->buf->sequence - lastSequence_ - 1)
+          << " frame(s) before sequence number " << state->buf->sequence;
+      LogMessage(msg.str(), true);
+    }
+    lastSequence_ = state->buf->sequence;
+    sequenceValid_ = true;
+
+    Metadata md;
+    char label[MM::MaxStrLength];
+    GetLabel(label);
+    md.put(MM::g_Keyword_Metadata_CameraLabel, label);
+    md.put(MM::g_Keyword_Metadata_ImageNumber, CDeviceUtils::ConvertToString(GetImageCounter()));
+    if ((state->buf->flags & V4L2_BUF_FLAG_TIMESTAMP_MASK) == V4L2_BUF_FLAG_TIMESTAMP_MONOTONIC) {
+      long long timestamp = (long long)state->buf->timestamp.tv_sec * 1000000000LL +
+        (long long)state->buf->timestamp.tv_usec * 1000LL;
+      md.put(MM::g_Keyword_Metadata_HardwareTimestamp_ns, timestamp);
+    }
+
+    ConvertAndReturnBuffer();
+
+    const string serialized = md.Serialize();
+    ret = GetCoreCallback()->InsertImage(this, imageBuffer.GetPixels(),
+        GetImageWidth(), GetImageHeight(), GetImageBytesPerPixel(),
+        serialized.c_str());
+    if (!stopOnOverflow_ && ret == DEVICE_BUFFER_OVERFLOW) {
+      GetCoreCallback()->ClearImageBuffer(this);
+      ret = GetCoreCallback()->InsertImage(this, imageBuffer.GetPixels(),
+          GetImageWidth(), GetImageHeight(), GetImageBytesPerPixel(),
+          serialized.c_str());
+    }
+    return ret;
+  }
+
 private:
 
   bool
@@ -510,6 +760,13 @@ private:
       return false;
     }
 
+    long requestedBuffers = gBufferCountDefault;
+    ret = GetProperty(gPropertyBufferCount, requestedBuffers);
+    if (ret != DEVICE_OK) {
+      LogMessage("could not read buffer count property");
+      return false;
+    }
+
     ret = initDevice(devicePath, requestedWidth, requestedHeight);
     if (ret != DEVICE_OK)
       return false;
@@ -518,7 +775,7 @@ private:
     memset(&reqbuf, 0, sizeof(reqbuf));
     reqbuf.type   = V4L2_BUF_TYPE_VIDEO_CAPTURE;
     reqbuf.memory = V4L2_MEMORY_MMAP;
-    reqbuf.count = 4;
+    reqbuf.count = (unsigned) requestedBuffers;
 
     if (-1 == tryIoctl(state->fd, VIDIOC_REQBUFS, &reqbuf)) {
       ostringstream msg;
@@ -534,7 +791,7 @@ private:
     }
 
     ostringstream bufMsg;
-    bufMsg << "got " << reqbuf.count << " out of 4 requested buffers";
+    bufMsg << "got " << reqbuf.count << " out of " << requestedBuffers << " requested buffers";
     LogMessage(bufMsg.str().c_str());
 
     state->buffers = (struct VidBuffer*)calloc(reqbuf.count, sizeof(*(state->buffers)));
@@ -596,7 +853,9 @@ private:
     struct v4l2_capability cap;
     struct v4l2_format fmt;
 
-    state->fd = open(devicePath, O_RDWR);
+    // Non-blocking, so that VIDIOC_DQBUF returns EAGAIN instead of
+    // waiting; frames are waited for with poll()
+    state->fd = open(devicePath, O_RDWR | O_NONBLOCK);
   
     if (-1 == state->fd) {
       LogMessage("could not open the video device");
@@ -622,18 +881,31 @@ private:
       return DEVICE_ERR;
     }
 
-    memset(&fmt, 0, sizeof(fmt));
-
-    fmt.type                = V4L2_BUF_TYPE_VIDEO_CAPTURE;
-    fmt.fmt.pix.pixelformat = V4L2_PIX_FMT_YUYV;
-    fmt.fmt.pix.field       = V4L2_FIELD_INTERLACED;
-    fmt.fmt.pix.height      = (unsigned) requestedWidth;
-    fmt.fmt.pix.width       = (unsigned) requestedHeight;
+    // YUYV is preferred; the driver substitutes a format it supports if
+    // it does not offer YUYV, in which case NV12 is tried
+    const unsigned int formats[] = { V4L2_PIX_FMT_YUYV, V4L2_PIX_FMT_NV12 };
+    for (unsigned int f = 0; f < sizeof(formats) / sizeof(formats[0]); f++) {
+      memset(&fmt, 0, sizeof(fmt));
+
+      fmt.type                = V4L2_BUF_TYPE_VIDEO_CAPTURE;
+      fmt.fmt.pix.pixelformat = formats[f];
+      fmt.fmt.pix.field       = V4L2_FIELD_INTERLACED;
+      fmt.fmt.pix.width       = (unsigned) requestedWidth;
+      fmt.fmt.pix.height      = (unsigned) requestedHeight;
+
+      if (-1 == tryIoctl(state->fd, VIDIOC_S_FMT, &fmt)) {
+        ostringstream msg;
+        msg << "error: could not set format: " << strerror(errno);
+        LogMessage(msg.str().c_str());
+        return DEVICE_ERR;
+      }
+      if (fmt.fmt.pix.pixelformat == formats[f])
+        break;
+    }
 
-    if (-1 == tryIoctl(state->fd, VIDIOC_S_FMT, &fmt)) {
-      ostringstream msg;
-      msg << "error: could not set format YUYV: " << strerror(errno);
-      LogMessage(msg.str().c_str());
+    if (fmt.fmt.pix.pixelformat != V4L2_PIX_FMT_YUYV &&
+        fmt.fmt.pix.pixelformat != V4L2_PIX_FMT_NV12) {
+      LogMessage("error: device supports neither YUYV nor NV12 capture");
       return DEVICE_ERR;
     }
 
@@ -655,11 +927,17 @@ private:
 
     state->W = fmt.fmt.pix.width;
     state->H = fmt.fmt.pix.height;
+    state->pixelformat = fmt.fmt.pix.pixelformat;
+    state->bytesperline = fmt.fmt.pix.bytesperline;
+    if (state->bytesperline == 0) {
+      state->bytesperline = state->pixelformat == V4L2_PIX_FMT_YUYV ?
+        2 * state->W : state->W;
+    }
 
     ostringstream formatMsg;
     formatMsg << "device is configured for " << state->W << "x" << state->H << " pixel"
-              << " and " << fmt.fmt.pix.bytesperline << " bytes per line ("
-              << (fmt.fmt.pix.bytesperline / state->H) <<" bpp)";
+              << (state->pixelformat == V4L2_PIX_FMT_NV12 ? " NV12" : " YUYV")
+              << " and " << state->bytesperline << " bytes per line";
     LogMessage(formatMsg.str().c_str());
     return DEVICE_OK;
   }
@@ -680,6 +958,7 @@ private:
       munmap(state->buffers[i].start, state->buffers[i].length);
     close(state->fd);
     free(state->buf);
+    free(state->buffers);
   
     state->fd = 0;
     state->W = 0;
@@ -690,23 +969,53 @@ private:
     return true;
   }
 
-  /*  has to be followed by a call to videoreturnbuffer */
-  unsigned char*
-  VideoTakeBuffer()
+  /* Dequeues the next filled buffer into state->buf, waiting up to
+   * timeoutMs for one. Has to be followed by a call to
+   * VideoReturnBuffer if successful. */
+  int
+  VideoDequeue(int timeoutMs)
   {
-    memset(state->buf, 0, sizeof(struct v4l2_buffer));
-    state->buf->type = V4L2_BUF_TYPE_VIDEO_CAPTURE;
-    state->buf->memory = V4L2_MEMORY_MMAP;
-    // By default VIDIOC_DQBUF blocks when no buffer is in the outgoing queue
-    if (-1 == tryIoctl(state->fd, VIDIOC_DQBUF, state->buf)) {
-      ostringstream msg;
-      msg << "error: could not prepare next image buffer: " << strerror(errno);
-      LogMessage(msg.str().c_str());
-      assert(false);
+    for (;;) {
+      memset(state->buf, 0, sizeof(struct v4l2_buffer));
+      state->buf->type = V4L2_BUF_TYPE_VIDEO_CAPTURE;
+      state->buf->memory = V4L2_MEMORY_MMAP;
+      if (0 == ioctl(state->fd, VIDIOC_DQBUF, state->buf))
+        break;
+      if (errno == EINTR)
+        continue;
+      if (errno != EAGAIN) {
+        ostringstream msg;
+        msg << "error: could not dequeue image buffer: " << strerror(errno);
+        LogMessage(msg.str().c_str());
+        return DEVICE_ERR;
+      }
+      if (timeoutMs == 0)
+        return DEVICE_CAMERA_BUSY_ACQUIRING;
+
+      struct pollfd pfd;
+      pfd.fd = state->fd;
+      pfd.events = POLLIN;
+      pfd.revents = 0;
+      int result = poll(&pfd, 1, timeoutMs);
+      if (0 == result) {
+        LogMessage("timeout waiting for image buffer");
+        return DEVICE_SNAP_IMAGE_FAILED;
+      }
+      else if (-1 == result && EINTR != errno) {
+        return DEVICE_ERR;
+      }
     }
 
     assert(state->buf->index < state->buffers_count);
-    return (unsigned char*)state->buffers[state->buf->index].start;
+    return DEVICE_OK;
+  }
+
+  void
+  ConvertAndReturnBuffer()
+  {
+    unsigned char* data = (unsigned char*)state->buffers[state->buf->index].start;
+    pixelType->convertV4l2ToOutput(state, data, const_cast<unsigned char*>(imageBuffer.GetPixels()));
+    VideoReturnBuffer();
   }
   
   void
@@ -797,6 +1106,10 @@ private:
   State state[1];
   ImgBuffer imageBuffer;
   PixelType *pixelType;
+  bool stopOnOverflow_;
+  unsigned int lastSequence_;
+  bool sequenceValid_;
+  long droppedFrames_;
 };
 
 MODULE_API void InitializeModuleData()
@@ -0,0 +1,337 @@
+///////////////////////////////////////////////////////////////////////////////
+// FILE:          CapabilityCache.cpp
+// PROJECT:       Micro-Manager
+// SUBSYSTEM:     MMCore
+//-----------------------------------------------------------------------------
+// DESCRIPTION:   On-disk cache of the devices offered by adapter modules and
+//                of the peripherals installed in hubs.
+//
+// LICENSE:       This file is distributed under the "Lesser GPL" (LGPL) license.
+//                License text is included with the source distribution.
+//
+//                This file is distributed in the hope that it will be useful,
+//                but WITHOUT ANY WARRANTY; without even the implied warranty
+//                of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+//
+//                IN NO EVENT SHALL THE COPYRIGHT OWNER OR
+//                CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+//                INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES.
+
+#include "CapabilityCache.h"
+
+#include <sys/types.h>
+#include <sys/stat.h>
+
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+
+namespace mm {
+
+namespace {
+
+const char* const g_FileHeader = "MMCapabilityCache\t1";
+
+std::string
+Escape(const std::string& s)
+{
+   std::string out;
+   out.reserve(s.size());
+   for (char c : s)
+   {
+      switch (c)
+      {
+         case '\\': out += "\\\\"; break;
+         case '\t': out += "\\t"; break;
+         case '\n': out += "\\n"; break;
+         case '\r': out += "\\r"; break;
+         default: out += c;
+      }
+   }
+   return out;
+}
+
+std::string
+Unescape(const std::string& s)
+{
+   std::string out;
+   out.reserve(s.size());
+   for (size_t i = 0; i < s.size(); ++i)
+   {
+      if (s[i] != '\\' || i + 1 == s.size())
+      {
+         out += s[i];
+         continue;
+      }
+      switch (s[++i])
+      {
+         case 't': out += '\t'; break;
+         case 'n': out += '\n'; break;
+         case 'r': out += '\r'; break;
+         default: out += s[i];
+      }
+   }
+   return out;
+}
+
+std::vector<std::string>
+SplitFields(const std::string& line)
+{
+   std::vector<std::string> fields;
+   size_t start = 0;
+   for (;;)
+   {
+      size_t tab = line.find('\t', start);
+      fields.push_back(Unescape(line.substr(start, tab - start)));
+      if (tab == std::string::npos)
+         return fields;
+      start = tab + 1;
+   }
+}
+
+} // anonymous namespace
+
+bool
+ModuleFileIdentity::Read(const std::string& filename)
+{
+#ifdef _WIN32
+   struct _stat64 st;
+   if (_stat64(filename.c_str(), &st) != 0)
+      return false;
+#else
+   struct stat st;
+   if (stat(filename.c_str(), &st) != 0)
+      return false;
+#endif
+   path = filename;
+   size = static_cast<long long>(st.st_size);
+#ifdef __linux__
+   mtime = static_cast<long long>(st.st_mtim.tv_sec) * 1000000000LL +
+      st.st_mtim.tv_nsec;
+#else
+   mtime = static_cast<long long>(st.st_mtime);
+#endif
+   return true;
+}
+
+CapabilityCache::CapabilityCache(const std::string& filename) :
+   filename_(filename)
+{
+   Load();
+}
+
+const CapabilityCache::ModuleEntry*
+CapabilityCache::FindEntry(const std::string& module,
+      const ModuleFileIdentity& file) const
+{
+   std::map<std::string, ModuleEntry>::const_iterator it =
+      modules_.find(module);
+   if (it == modules_.end() || !(it->second.file == file))
+      return 0;
+   return &it->second;
+}
+
+CapabilityCache::ModuleEntry&
+CapabilityCache::Entry(const std::string& module,
+      const ModuleFileIdentity& file, long moduleVersion,
+      long interfaceVersion)
+{
+   ModuleEntry& entry = modules_[module];
+   if (!(entry.file == file) || entry.moduleVersion != moduleVersion ||
+         entry.interfaceVersion != interfaceVersion)
+   {
+      entry = ModuleEntry();
+      entry.file = file;
+      entry.moduleVersion = moduleVersion;
+      entry.interfaceVersion = interfaceVersion;
+      entry.hasDevices = false;
+   }
+   return entry;
+}
+
+bool
+CapabilityCache::GetDevices(const std::string& module,
+      const ModuleFileIdentity& file,
+      std::vector<CachedDevice>& devices) const
+{
+   std::lock_guard<std::mutex> lock(mutex_);
+   const ModuleEntry* entry = FindEntry(module, file);
+   if (!entry || !entry->hasDevices)
+      return false;
+   devices = entry->devices;
+   return true;
+}
+
+void
+CapabilityCache::SetDevices(const std::string& module,
+      const ModuleFileIdentity& file, long moduleVersion,
+      long interfaceVersion, const std::vector<CachedDevice>& devices)
+{
+   std::lock_guard<std::mutex> lock(mutex_);
+   ModuleEntry& entry = Entry(module, file, moduleVersion, interfaceVersion);
+   entry.hasDevices = true;
+   entry.devices = devices;
+   Save();
+}
+
+bool
+CapabilityCache::GetPeripherals(const std::string& module,
+      const ModuleFileIdentity& file, const std::string& hubFingerprint,
+      std::vector<std::pair<std::string, std::string> >& peripherals) const
+{
+   std::lock_guard<std::mutex> lock(mutex_);
+   const ModuleEntry* entry = FindEntry(module, file);
+   if (!entry)
+      return false;
+   std::map<std::string, std::vector<std::pair<std::string, std::string> > >::
+      const_iterator it = entry->hubs.find(hubFingerprint);
+   if (it == entry->hubs.end())
+      return false;
+   peripherals = it->second;
+   return true;
+}
+
+void
+CapabilityCache::SetPeripherals(const std::string& module,
+      const ModuleFileIdentity& file, long moduleVersion,
+      long interfaceVersion, const std::string& hubFingerprint,
+      const std::vector<std::pair<std::string, std::string> >& peripherals)
+{
+   std::lock_guard<std::mutex> lock(mutex_);
+   ModuleEntry& entry = Entry(module, file, moduleVersion, interfaceVersion);
+   entry.hubs[hubFingerprint] = peripherals;
+   Save();
+}
+
+void
+CapabilityCache::InvalidatePeripherals(const std::string& module,
+      const std::string& hubFingerprint)
+{
+   std::lock_guard<std::mutex> lock(mutex_);
+   std::map<std::string, ModuleEntry>::iterator it = modules_.find(module);
+   if (it != modules_.end() && it->second.hubs.erase(hubFingerprint))
+      Save();
+}
+
+void
+CapabilityCache::Validate(const std::string& module, long moduleVersion,
+      long interfaceVersion)
+{
+   std::lock_guard<std::mutex> lock(mutex_);
+   std::map<std::string, ModuleEntry>::iterator it = modules_.find(module);
+   if (it == modules_.end())
+      return;
+   if (it->second.moduleVersion != moduleVersion ||
+         it->second.interfaceVersion != interfaceVersion)
+   {
+      modules_.erase(it);
+      Save();
+   }
+}
+
+void
+CapabilityCache::Invalidate(const std::string& module)
+{
+   std::lock_guard<std::mutex> lock(mutex_);
+   if (modules_.erase(module))
+      Save();
+}
+
+void
+CapabilityCache::Clear()
+{
+   std::lock_guard<std::mutex> lock(mutex_);
+   modules_.clear();
+   Save();
+}
+
+void
+CapabilityCache::Load()
+{
+   std::ifstream in(filename_.c_str());
+   std::string line;
+   if (!std::getline(in, line) || line != g_FileHeader)
+      return;
+
+   // Lines apply to the module (and hub) most recently named
+   std::map<std::string, ModuleEntry> modules;
+   ModuleEntry* module = 0;
+   std::vector<std::pair<std::string, std::string> >* hub = 0;
+   while (std::getline(in, line))
+   {
+      std::vector<std::string> f = SplitFields(line);
+      if (f[0] == "Module" && f.size() == 7)
+      {
+         module = &modules[f[1]];
+         module->file.path = f[2];
+         module->file.size = std::atoll(f[3].c_str());
+         module->file.mtime = std::atoll(f[4].c_str());
+         module->moduleVersion = std::atol(f[5].c_str());
+         module->interfaceVersion = std::atol(f[6].c_str());
+         module->hasDevices = false;
+         hub = 0;
+      }
+      else if (f[0] == "Devices" && f.size() == 1 && module)
+         module->hasDevices = true;
+      else if (f[0] == "Device" && f.size() == 4 && module)
+      {
+         CachedDevice device;
+         device.name = f[1];
+         device.type = std::atol(f[2].c_str());
+         device.description = f[3];
+         module->devices.push_back(device);
+      }
+      else if (f[0] == "Hub" && f.size() == 2 && module)
+         hub = &module->hubs[f[1]];
+      else if (f[0] == "Peripheral" && f.size() == 3 && hub)
+         hub->push_back(std::make_pair(f[1], f[2]));
+      else
+         return; // Malformed; ignore the whole file
+   }
+   modules_.swap(modules);
+}
+
+void
+CapabilityCache::Save() const
+{
+   // Write a new file and put it in place, so that an interrupted write
+   // does not leave a truncated file
+   const std::string tempName = filename_ + ".tmp";
+   {
+      std::ofstream out(tempName.c_str(), std::ios::out | std::ios::trunc);
+      if (!out)
+         return;
+      out << g_FileHeader << '\n';
+      for (std::map<std::string, ModuleEntry>::const_iterator
+            it = modules_.begin(), end = modules_.end(); it != end; ++it)
+      {
+         const ModuleEntry& m = it->second;
+         out << "Module\t" << Escape(it->first) << '\t' <<
+            Escape(m.file.path) << '\t' << m.file.size << '\t' <<
+            m.file.mtime << '\t' << m.moduleVersion << '\t' <<
+            m.interfaceVersion << '\n';
+         if (m.hasDevices)
+            out << "Devices\n";
+         for (const CachedDevice& d : m.devices)
+            out << "Device\t" << Escape(d.name) << '\t' << d.type << '\t' <<
+               Escape(d.description) << '\n';
+         for (std::map<std::string, std::vector<std::pair<std::string,
+               std::string> > >::const_iterator h = m.hubs.begin();
+               h != m.hubs.end(); ++h)
+         {
+            out << "Hub\t" << Escape(h->first) << '\n';
+            for (const std::pair<std::string, std::string>& p : h->second)
+               out << "Peripheral\t" << Escape(p.first) << '\t' <<
+                  Escape(p.second) << '\n';
+         }
+      }
+      if (!out)
+         return;
+   }
+#ifdef _WIN32
+   std::remove(filename_.c_str());
+#endif
+   std::rename(tempName.c_str(), filename_.c_str());
+}
+
+} // namespace mm
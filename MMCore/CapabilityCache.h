@@ -0,0 +1,128 @@
+///////////////////////////////////////////////////////////////////////////////
+// FILE:          CapabilityCache.h
+// PROJECT:       Micro-Manager
+// SUBSYSTEM:     MMCore
+//-----------------------------------------------------------------------------
+// DESCRIPTION:   On-disk cache of the devices offered by adapter modules and
+//                of the peripherals installed in hubs.
+//
+// LICENSE:       This file is distributed under the "Lesser GPL" (LGPL) license.
+//                License text is included with the source distribution.
+//
+//                This file is distributed in the hope that it will be useful,
+//                but WITHOUT ANY WARRANTY; without even the implied warranty
+//                of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+//
+//                IN NO EVENT SHALL THE COPYRIGHT OWNER OR
+//                CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+//                INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES.
+
+#pragma once
+
+#include <map>
+#include <mutex>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace mm {
+
+/**
+ * Identifies the build of an adapter module file without loading it.
+ */
+struct ModuleFileIdentity
+{
+   std::string path;
+   long long size;
+   long long mtime;
+
+   ModuleFileIdentity() : size(-1), mtime(0) {}
+   // False if the file does not exist
+   bool Read(const std::string& filename);
+   bool operator==(const ModuleFileIdentity& other) const
+   { return path == other.path && size == other.size && mtime == other.mtime; }
+};
+
+struct CachedDevice
+{
+   std::string name;
+   std::string description;
+   long type;
+
+   bool operator==(const CachedDevice& other) const
+   {
+      return name == other.name && description == other.description &&
+         type == other.type;
+   }
+};
+
+/**
+ * Device lists and installed peripherals, saved to a file and reused across
+ * sessions.
+ *
+ * Entries belong to a module and are only returned while the module file is
+ * unchanged. When the module is loaded, its version and device interface
+ * version are checked against those recorded (Validate()); the Core also
+ * drops a module's entries when loading a device from it fails. Hub entries
+ * are additionally keyed by a fingerprint of the hub (e.g. its port), and
+ * are dropped when one of the hub's peripherals fails to initialize.
+ *
+ * The file is rewritten after each change. A missing or malformed file is
+ * treated as empty. All member functions are thread-safe.
+ */
+class CapabilityCache
+{
+public:
+   explicit CapabilityCache(const std::string& filename);
+
+   std::string GetFilename() const { return filename_; }
+
+   bool GetDevices(const std::string& module, const ModuleFileIdentity& file,
+         std::vector<CachedDevice>& devices) const;
+   void SetDevices(const std::string& module, const ModuleFileIdentity& file,
+         long moduleVersion, long interfaceVersion,
+         const std::vector<CachedDevice>& devices);
+
+   // Peripherals are (name, description) pairs
+   bool GetPeripherals(const std::string& module,
+         const ModuleFileIdentity& file, const std::string& hubFingerprint,
+         std::vector<std::pair<std::string, std::string> >& peripherals) const;
+   void SetPeripherals(const std::string& module,
+         const ModuleFileIdentity& file, long moduleVersion,
+         long interfaceVersion, const std::string& hubFingerprint,
+         const std::vector<std::pair<std::string, std::string> >& peripherals);
+   void InvalidatePeripherals(const std::string& module,
+         const std::string& hubFingerprint);
+
+   // Drops the module's entries if they were recorded for other versions
+   void Validate(const std::string& module, long moduleVersion,
+         long interfaceVersion);
+   void Invalidate(const std::string& module);
+   void Clear();
+
+private:
+   struct ModuleEntry
+   {
+      ModuleFileIdentity file;
+      long moduleVersion;
+      long interfaceVersion;
+      bool hasDevices;
+      std::vector<CachedDevice> devices;
+      std::map<std::string,
+         std::vector<std::pair<std::string, std::string> > > hubs;
+   };
+
+   ModuleEntry& Entry(const std::string& module,
+         const ModuleFileIdentity& file, long moduleVersion,
+         long interfaceVersion);
+   const ModuleEntry* FindEntry(const std::string& module,
+         const ModuleFileIdentity& file) const;
+   void Load();
+   void Save() const;
+
+   const std::string filename_;
+   mutable std::mutex mutex_;
+   std::map<std::string, ModuleEntry> modules_;
+};
+
+} // namespace mm
@@ -30,9 +30,11 @@
 
 #include "../MMDevice/DeviceUtils.h"
 
+#include <algorithm>
 #include <chrono>
-#include <cstdio>
-#include <ctime>
+#include <cstdlib>
+#include <cstring>
+#include <iterator>
 #include <memory>
 #include <string>
 
@@ -53,27 +55,40 @@ const long adjustThreshold = LONG_MAX / 2;
 // division by zero can be added.
 const unsigned long maxCBSize = 10000000;
 
-CircularBuffer::CircularBuffer(unsigned int memorySizeMB) :
+CircularBuffer::CircularBuffer(unsigned int memorySizeMB,
+      std::shared_ptr<ThreadPool> threadPool) :
    width_(0), 
    height_(0), 
    pixDepth_(0), 
+   bitDepth_(0),
    imageCounter_(0), 
    insertIndex_(0), 
    saveIndex_(0), 
+   pinnedIndex_(-1),
    memorySizeMB_(memorySizeMB), 
    overflow_(false),
-   threadPool_(std::make_shared<ThreadPool>()),
-   tasksMemCopy_(std::make_shared<TaskSet_CopyMemory>(threadPool_))
+   statsEnabled_(false),
+   histogramBins_(256),
+   packingEnabled_(false),
+   packed_(false),
+   packedFormat_(PackedPixels::Mono12p),
+   threadPool_(threadPool ? threadPool : std::make_shared<ThreadPool>()),
+   tasksMemCopy_(std::make_shared<TaskSet_CopyMemory>(threadPool_)),
+   waiters_(0),
+   interrupts_(0)
 {
 }
 
 CircularBuffer::~CircularBuffer() {}
 
-bool CircularBuffer::Initialize(unsigned channels, unsigned int w, unsigned int h, unsigned int pixDepth)
+bool CircularBuffer::Initialize(unsigned channels, unsigned int w, unsigned int h, unsigned int pixDepth, unsigned int bitDepth)
 {
+   std::lock_guard<std::mutex> popGuard(popMutex_);
    MMThreadGuard guard(g_bufferLock);
    imageNumbers_.clear();
+   clockFits_.clear();
    startTime_ = std::chrono::steady_clock::now();
+   bitDepth_ = bitDepth;
 
    bool ret = true;
    try
@@ -81,7 +96,13 @@ bool CircularBuffer::Initialize(unsigned channels, unsigned int w, unsigned int
       if (w == 0 || h==0 || pixDepth == 0 || channels == 0)
          return false; // does not make sense
 
-      if (w == width_ && height_ == h && pixDepth_ == pixDepth && channels == numChannels_)
+      const bool packed = packingEnabled_ && pixDepth == 2 &&
+         bitDepth > 0 && bitDepth <= 12;
+      const PackedPixels::Format packedFormat = bitDepth <= 10 ?
+         PackedPixels::Mono10p : PackedPixels::Mono12p;
+
+      if (w == width_ && height_ == h && pixDepth_ == pixDepth && channels == numChannels_ &&
+            packed == packed_ && (!packed || packedFormat == packedFormat_))
          if (frameArray_.size() > 0)
             return true; // nothing to change
 
@@ -89,6 +110,9 @@ bool CircularBuffer::Initialize(unsigned channels, unsigned int w, unsigned int
       height_ = h;
       pixDepth_ = pixDepth;
       numChannels_ = channels;
+      packed_ = packed;
+      packedFormat_ = packedFormat;
+      unpackedImages_.clear();
 
       insertIndex_ = 0;
       saveIndex_ = 0;
@@ -97,7 +121,9 @@ bool CircularBuffer::Initialize(unsigned channels, unsigned int w, unsigned int
       // calculate the size of the entire buffer array once all images get allocated
       // the actual size at the time of the creation is going to be less, because
       // images are not allocated until pixels become available
-      unsigned long frameSizeBytes = width_ * height_ * pixDepth_ * numChannels_;
+      unsigned long frameSizeBytes = packed_ ?
+         (unsigned long)PackedPixels::PackedBytes(packedFormat_, width_ * height_) * numChannels_ :
+         width_ * height_ * pixDepth_ * numChannels_;
       unsigned long cbSize = (unsigned long) ((memorySizeMB_ * bytesInMB) / frameSizeBytes);
 
       if (cbSize == 0) 
@@ -120,6 +146,7 @@ bool CircularBuffer::Initialize(unsigned channels, unsigned int w, unsigned int
       for (unsigned long i=0; i<frameArray_.size(); i++)
       {
          frameArray_[i].Resize(w, h, pixDepth);
+         frameArray_[i].SetPacking(packed_, packedFormat_);
          frameArray_[i].Preallocate(numChannels_);
       }
    }
@@ -134,12 +161,27 @@ bool CircularBuffer::Initialize(unsigned channels, unsigned int w, unsigned int
 
 void CircularBuffer::Clear() 
 {
+   std::lock_guard<std::mutex> popGuard(popMutex_);
    MMThreadGuard guard(g_bufferLock); 
    insertIndex_=0; 
    saveIndex_=0; 
    overflow_ = false;
    startTime_ = std::chrono::steady_clock::now();
    imageNumbers_.clear();
+   clockFits_.clear();
+}
+
+void CircularBuffer::SetFrameStatistics(bool enabled, unsigned histogramBins)
+{
+   MMThreadGuard guard(g_bufferLock);
+   statsEnabled_ = enabled;
+   histogramBins_ = histogramBins;
+}
+
+void CircularBuffer::SetPacking(bool enabled)
+{
+   MMThreadGuard guard(g_bufferLock);
+   packingEnabled_ = enabled;
 }
 
 unsigned long CircularBuffer::GetSize() const
@@ -164,31 +206,16 @@ unsigned long CircularBuffer::GetRemainingImageCount() const
    return (unsigned long)(insertIndex_ - saveIndex_);
 }
 
-static std::string FormatLocalTime(std::chrono::time_point<std::chrono::system_clock> tp) {
-   using namespace std::chrono;
-   auto us = duration_cast<microseconds>(tp.time_since_epoch());
-   auto secs = duration_cast<seconds>(us);
-   auto whole = duration_cast<microseconds>(secs);
-   auto frac = static_cast<int>((us - whole).count());
-
-   // As of C++14/17, it is simpler (and probably faster) to use C functions for
-   // date-time formatting
-
-   std::time_t t(secs.count()); // time_t is seconds on platforms we support
-   std::tm *ptm;
-#ifdef _WIN32 // Windows localtime() is documented thread-safe
-   ptm = std::localtime(&t);
-#else // POSIX has localtime_r()
-   std::tm tmstruct;
-   ptm = localtime_r(&t, &tmstruct);
-#endif
-
-   // Format as "yyyy-mm-dd hh:mm:ss.uuuuuu" (26 chars)
-   const char *timeFmt = "%Y-%m-%d %H:%M:%S";
-   char buf[32];
-   std::size_t len = std::strftime(buf, sizeof(buf), timeFmt, ptm);
-   std::snprintf(buf + len, sizeof(buf) - len, ".%06d", frac);
-   return buf;
+bool CircularBuffer::GetHardwareClockFit(const std::string& cameraLabel,
+      mm::ClockDriftEstimator& fit) const
+{
+   MMThreadGuard guard(g_bufferLock);
+   std::map<std::string, mm::ClockDriftEstimator>::const_iterator it =
+      clockFits_.find(cameraLabel);
+   if (it == clockFits_.end())
+      return false;
+   fit = it->second;
+   return true;
 }
 
 /**
@@ -224,20 +251,37 @@ bool CircularBuffer::InsertMultiChannel(const unsigned char* pixArray, unsigned
  
     mm::ImgBuffer* pImg;
     unsigned long singleChannelSize = (unsigned long)width * height * byteDepth;
+    bool computeStats;
+    unsigned histogramBins;
+    unsigned bitDepth;
+    bool packed;
  
     {
        MMThreadGuard guard(g_bufferLock);
+
+       computeStats = statsEnabled_ && mm::FrameStatistics::IsSupported(byteDepth, nComponents);
+       histogramBins = histogramBins_;
+       bitDepth = bitDepth_;
+       packed = packed_;
  
        // check image dimensions
        if (width != width_ || height != height_ || byteDepth != pixDepth_)
           throw CMMError("Incompatible image dimensions in the circular buffer", MMERR_CircularBufferIncompatibleImage);
  
-       bool overflowed = (insertIndex_ - saveIndex_) >= static_cast<long>(frameArray_.size());
+       const long oldestIndex = pinnedIndex_ >= 0 ? pinnedIndex_ : saveIndex_;
+       bool overflowed = (insertIndex_ - oldestIndex) >= static_cast<long>(frameArray_.size());
        if (overflowed) {
           overflow_ = true;
           return false;
        }
     }
+
+    // All channels of the frame share the timestamp; text tags are only
+    // rendered when the metadata is read
+    mm::FrameTimestamp timestamp = mm::FrameTimestamp::Now();
+    const long long startNs = std::chrono::duration_cast<std::chrono::nanoseconds>(
+          startTime_.time_since_epoch()).count();
+    timestamp.elapsedNs = timestamp.monotonicNs - startNs;
  
     for (unsigned i=0; i<numChannels; i++)
     {
@@ -265,23 +309,33 @@ bool CircularBuffer::InsertMultiChannel(const unsigned char* pixArray, unsigned
          // insert image number. 
          md.put(MM::g_Keyword_Metadata_ImageNumber, CDeviceUtils::ConvertToString(imageNumbers_[cameraName]));
          ++imageNumbers_[cameraName];
+
+         // Fit the camera clock against ours, once per frame
+         if (i == 0 && md.HasTag(MM::g_Keyword_Metadata_HardwareTimestamp_ns))
+         {
+            const std::string hwValue =
+               md.GetSingleTag(MM::g_Keyword_Metadata_HardwareTimestamp_ns).GetValue();
+            char* end = 0;
+            const long long hwNs = std::strtoll(hwValue.c_str(), &end, 10);
+            if (end != hwValue.c_str())
+            {
+               mm::ClockDriftEstimator& fit = clockFits_[cameraName];
+               fit.AddSample(hwNs, timestamp.monotonicNs);
+               timestamp.hasHardwareHost = true;
+               timestamp.hardwareHostNs = fit.ToHostNs(hwNs);
+            }
+         }
       }
 
-      if (!md.HasTag(MM::g_Keyword_Elapsed_Time_ms))
+      // If the time tag was not supplied by the camera, it is derived from the
+      // hardware timestamp if available (free of arrival jitter), otherwise
+      // from the insertion time
+      timestamp.renderElapsed = !md.HasTag(MM::g_Keyword_Elapsed_Time_ms);
+      if (timestamp.renderElapsed && timestamp.hasHardwareHost)
       {
-         // if time tag was not supplied by the camera insert current timestamp
-         using namespace std::chrono;
-         auto elapsed = steady_clock::now() - startTime_;
-         md.PutImageTag(MM::g_Keyword_Elapsed_Time_ms,
-            std::to_string(duration_cast<milliseconds>(elapsed).count()));
+         timestamp.elapsedNs = timestamp.hardwareHostNs - startNs;
       }
 
-      // Note: It is not ideal to use local time. I think this tag is rarely
-      // used. Consider replacing with UTC (micro)seconds-since-epoch (with
-      // different tag key) after addressing current usage.
-      auto now = std::chrono::system_clock::now();
-      md.PutImageTag(MM::g_Keyword_Metadata_TimeInCore, FormatLocalTime(now));
-
       md.PutImageTag(MM::g_Keyword_Metadata_Width, width);
       md.PutImageTag(MM::g_Keyword_Metadata_Height, height);
       if (byteDepth == 1)
@@ -300,14 +354,44 @@ bool CircularBuffer::InsertMultiChannel(const unsigned char* pixArray, unsigned
       else
          md.PutImageTag(MM::g_Keyword_PixelType, MM::g_Keyword_PixelType_Unknown);
 
-      pImg->SetMetadata(md);
       //pImg->SetPixels(pixArray + i * singleChannelSize);
       // TODO: In MMCore the ImgBuffer::GetPixels() returns const pointer.
       //       It would be better to have something like ImgBuffer::GetPixelsRW() in MMDevice.
       //       Or even better - pass tasksMemCopy_ to ImgBuffer constructor
       //       and utilize parallel copy also in single snap acquisitions.
-      tasksMemCopy_->MemCopy((void*)pImg->GetPixels(),
-            pixArray + i * singleChannelSize, singleChannelSize);
+      if (packed)
+      {
+         const unsigned char* channelPixels = pixArray + i * singleChannelSize;
+         if (computeStats)
+         {
+            frameStats_.Reset(histogramBins, bitDepth, byteDepth, width * height);
+            frameStats_.Accumulate(channelPixels, width * height);
+            frameStats_.Finalize();
+            frameStats_.AddToMetadata(md);
+         }
+         // Saturated values would mean the camera misreports its bit
+         // depth; the frame is rejected rather than stored altered
+         if (pImg->SetPixels(channelPixels) > 0)
+            throw CMMError("Pixel values exceed the bit depth of " +
+                  std::to_string(bitDepth) + " bits reported by the camera",
+                  MMERR_CircularBufferIncompatibleImage);
+      }
+      else if (computeStats)
+      {
+         // Statistics are computed in the same pass as the copy, while the
+         // pixels are in cache
+         tasksMemCopy_->MemCopy((void*)pImg->GetPixels(),
+               pixArray + i * singleChannelSize, singleChannelSize,
+               byteDepth, histogramBins, bitDepth, frameStats_);
+         frameStats_.AddToMetadata(md);
+      }
+      else
+      {
+         tasksMemCopy_->MemCopy((void*)pImg->GetPixels(),
+               pixArray + i * singleChannelSize, singleChannelSize);
+      }
+      pImg->SetMetadata(md);
+      pImg->SetTimestamp(timestamp);
    }
 
    {
@@ -320,8 +404,11 @@ bool CircularBuffer::InsertMultiChannel(const unsigned char* pixArray, unsigned
          // adjust buffer indices to avoid overflowing integer size
          insertIndex_ -= adjustThreshold;
          saveIndex_ -= adjustThreshold;
+         if (pinnedIndex_ >= 0)
+            pinnedIndex_ -= adjustThreshold;
       }
    }
+   NotifyWaiters();
 
    return true;
 }
@@ -359,7 +446,7 @@ const mm::ImgBuffer* CircularBuffer::GetNthFromTopImageBuffer(long n,
       targetIndex += (long) frameArray_.size();
    targetIndex %= frameArray_.size();
 
-   return frameArray_[targetIndex].FindImage(channel);
+   return Unpacked(frameArray_[targetIndex].FindImage(channel));
 }
 
 const unsigned char* CircularBuffer::GetNextImage()
@@ -379,6 +466,146 @@ const mm::ImgBuffer* CircularBuffer::GetNextImageBuffer(unsigned channel)
       return 0;
 
    long targetIndex = saveIndex_ % frameArray_.size();
+   // Unpack before releasing the slot to the inserting thread
+   const mm::ImgBuffer* img = Unpacked(frameArray_[targetIndex].FindImage(channel));
    ++saveIndex_;
-   return frameArray_[targetIndex].FindImage(channel);
+   return img;
+}
+
+unsigned long CircularBuffer::PopNextImages(unsigned channel,
+      unsigned long maxCount, unsigned char* dest, std::size_t destSize,
+      std::vector<Metadata>* metadata, std::size_t* copiedImageSize)
+{
+   std::lock_guard<std::mutex> popGuard(popMutex_);
+
+   // Only the range of slots is taken under the lock. The slots are removed
+   // from the buffer but stay pinned, so the inserting thread treats them as
+   // unread (and reports overflow rather than overwrite them) until they have
+   // been copied.
+   std::size_t imageSize;
+   long first;
+   long count;
+   {
+      MMThreadGuard guard(g_bufferLock);
+
+      imageSize = (std::size_t)width_ * height_ * pixDepth_;
+      if (imageSize == 0)
+         return 0;
+      count = insertIndex_ - saveIndex_;
+      if (static_cast<unsigned long>(count) > maxCount)
+         count = static_cast<long>(maxCount);
+      if (static_cast<std::size_t>(count) > destSize / imageSize)
+         count = static_cast<long>(destSize / imageSize);
+      // All frames have the same channels allocated
+      if (count == 0 || !frameArray_[saveIndex_ % frameArray_.size()].FindImage(channel))
+         return 0;
+
+      first = saveIndex_;
+      pinnedIndex_ = first;
+      saveIndex_ += count;
+   }
+   if (copiedImageSize)
+      *copiedImageSize = imageSize;
+
+   try
+   {
+      const std::size_t firstMetadata = metadata ? metadata->size() : 0;
+      if (metadata)
+         metadata->resize(firstMetadata + count);
+      for (long i = 0; i < count; ++i)
+      {
+         const mm::ImgBuffer* img =
+            frameArray_[(first + i) % frameArray_.size()].FindImage(channel);
+         img->CopyPixelsUnpackedTo(dest + i * imageSize);
+         if (metadata)
+            img->GetMetadata((*metadata)[firstMetadata + i]);
+      }
+   }
+   catch (...)
+   {
+      MMThreadGuard guard(g_bufferLock);
+      pinnedIndex_ = -1;
+      throw;
+   }
+
+   {
+      MMThreadGuard guard(g_bufferLock);
+      pinnedIndex_ = -1;
+   }
+   return static_cast<unsigned long>(count);
+}
+
+std::size_t CircularBuffer::ImageSize() const
+{
+   MMThreadGuard guard(g_bufferLock);
+   return (std::size_t)width_ * height_ * pixDepth_;
+}
+
+bool CircularBuffer::WaitForImages(unsigned long count,
+      std::chrono::steady_clock::time_point deadline)
+{
+   std::unique_lock<std::mutex> lock(waitMutex_);
+   const unsigned long interrupts = interrupts_;
+   ++waiters_;
+   // Images are counted with waitMutex_ held, so an insert that completes
+   // after the count cannot notify before this thread waits
+   bool available;
+   while (!(available = GetRemainingImageCount() >= count) &&
+         interrupts_ == interrupts)
+   {
+      if (waitCv_.wait_until(lock, deadline) == std::cv_status::timeout)
+      {
+         available = GetRemainingImageCount() >= count;
+         break;
+      }
+   }
+   --waiters_;
+   return available;
+}
+
+void CircularBuffer::Interrupt()
+{
+   std::lock_guard<std::mutex> lock(waitMutex_);
+   ++interrupts_;
+   waitCv_.notify_all();
+}
+
+// Called without g_bufferLock held
+void CircularBuffer::NotifyWaiters()
+{
+   std::lock_guard<std::mutex> lock(waitMutex_);
+   if (waiters_ > 0)
+      waitCv_.notify_all();
+}
+
+// Called with g_bufferLock held
+const mm::ImgBuffer* CircularBuffer::Unpacked(const mm::ImgBuffer* img) const
+{
+   if (!img || !img->IsPacked())
+      return img;
+
+   const std::thread::id reader = std::this_thread::get_id();
+   auto it = std::find_if(unpackedImages_.begin(), unpackedImages_.end(),
+         [&](const std::pair<std::thread::id, std::unique_ptr<mm::ImgBuffer>>& entry)
+         { return entry.first == reader; });
+   if (it != unpackedImages_.end())
+   {
+      unpackedImages_.splice(unpackedImages_.begin(), unpackedImages_, it);
+   }
+   else if (unpackedImages_.size() < maxUnpackedImages_)
+   {
+      unpackedImages_.emplace_front(reader, std::unique_ptr<mm::ImgBuffer>(
+               new mm::ImgBuffer(img->Width(), img->Height(), img->Depth())));
+   }
+   else
+   {
+      // Take over the image of the thread that has not read for the longest
+      unpackedImages_.splice(unpackedImages_.begin(), unpackedImages_,
+            std::prev(unpackedImages_.end()));
+      unpackedImages_.front().first = reader;
+   }
+
+   mm::ImgBuffer* unpacked = unpackedImages_.front().second.get();
+   img->CopyUnpackedTo(*unpacked);
+   return unpacked;
 }
@@ -27,12 +27,22 @@
 #include "Error.h"
 #include "ErrorCodes.h"
 #include "FrameBuffer.h"
+#include "FrameStatistics.h"
+#include "FrameTimestamps.h"
 
 #include "../MMDevice/DeviceThreads.h"
 #include "../MMDevice/MMDevice.h"
+#include "../MMDevice/PackedPixels.h"
 
 #include <chrono>
+#include <condition_variable>
+#include <list>
+#include <map>
 #include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <utility>
 #include <vector>
 
 #ifdef _MSC_VER
@@ -52,12 +62,17 @@ class TaskSet_CopyMemory;
 class CircularBuffer
 {
 public:
-   CircularBuffer(unsigned int memorySizeMB);
+   // Image copies are run on the given pool; if null, the buffer creates its
+   // own pool
+   CircularBuffer(unsigned int memorySizeMB,
+         std::shared_ptr<ThreadPool> threadPool = nullptr);
    ~CircularBuffer();
 
    unsigned GetMemorySizeMB() const { return memorySizeMB_; }
 
-   bool Initialize(unsigned channels, unsigned int xSize, unsigned int ySize, unsigned int pixDepth);
+   // bitDepth is the number of significant bits per pixel, used for frame
+   // statistics; 0 means the full range of the pixel type
+   bool Initialize(unsigned channels, unsigned int xSize, unsigned int ySize, unsigned int pixDepth, unsigned int bitDepth = 0);
    unsigned long GetSize() const;
    unsigned long GetFreeSize() const;
    unsigned long GetRemainingImageCount() const;
@@ -76,34 +91,109 @@ public:
    const mm::ImgBuffer* GetNthFromTopImageBuffer(unsigned long n) const;
    const mm::ImgBuffer* GetNthFromTopImageBuffer(long n, unsigned channel) const;
    const mm::ImgBuffer* GetNextImageBuffer(unsigned channel);
+   // Removes up to maxCount images, copying the given channel of each to
+   // consecutive imageSize-byte blocks of dest and appending their metadata
+   // to metadata, if not null; returns the number of images removed, and
+   // sets copiedImageSize, if not null, to the size of each. The copies are
+   // made without g_bufferLock held; the slots being copied are not
+   // overwritten meanwhile.
+   unsigned long PopNextImages(unsigned channel, unsigned long maxCount,
+         unsigned char* dest, std::size_t destSize,
+         std::vector<Metadata>* metadata,
+         std::size_t* copiedImageSize = 0);
+   std::size_t ImageSize() const;
+
+   // Blocks until at least count images are available, Interrupt() is
+   // called, or the deadline passes; returns whether count images are
+   // available. Inserting threads wake waiters as soon as an image is in.
+   bool WaitForImages(unsigned long count,
+         std::chrono::steady_clock::time_point deadline);
+   // Wakes all threads blocked in WaitForImages()
+   void Interrupt();
    void Clear(); 
 
    bool Overflow() {MMThreadGuard guard(g_bufferLock); return overflow_;}
 
+   // When enabled, single-component 8- and 16-bit frames get Statistics-*
+   // metadata tags, computed while the pixels are copied into the buffer
+   void SetFrameStatistics(bool enabled, unsigned histogramBins);
+   bool IsFrameStatisticsEnabled() const {MMThreadGuard guard(g_bufferLock); return statsEnabled_;}
+
+   // When enabled, 16-bit frames with a bit depth of at most 12 are stored
+   // packed (Mono10p or Mono12p), so that more frames fit in the buffer.
+   // Frames with values beyond the bit depth are rejected. Takes effect at
+   // the next Initialize(). Frames are unpacked when read, into a buffer kept
+   // for the reading thread: the returned images remain valid until the same
+   // thread reads another image, or the buffer is initialized again. Buffers
+   // are kept for the few threads that read most recently; a thread that
+   // stops reading may have its buffer taken over by another.
+   void SetPacking(bool enabled);
+   bool IsPackingEnabled() const {MMThreadGuard guard(g_bufferLock); return packingEnabled_;}
+   bool IsPacked() const {MMThreadGuard guard(g_bufferLock); return packed_;}
+
+   // Gets the fit of the camera's hardware timestamps against the host
+   // monotonic clock since the buffer was last cleared; returns false if the
+   // camera has not sent frames with hardware timestamps
+   bool GetHardwareClockFit(const std::string& cameraLabel, mm::ClockDriftEstimator& fit) const;
+
    mutable MMThreadLock g_bufferLock;
    mutable MMThreadLock g_insertLock;
 
 private:
+   const mm::ImgBuffer* Unpacked(const mm::ImgBuffer* img) const;
+   void NotifyWaiters();
+
    unsigned int width_;
    unsigned int height_;
    unsigned int pixDepth_;
+   unsigned int bitDepth_;
    long imageCounter_;
    std::chrono::time_point<std::chrono::steady_clock> startTime_;
    std::map<std::string, long> imageNumbers_;
+   std::map<std::string, mm::ClockDriftEstimator> clockFits_;
 
    // Invariants:
    // 0 <= saveIndex_ <= insertIndex_
    // insertIndex_ - saveIndex_ <= frameArray_.size()
    long insertIndex_;
    long saveIndex_;
+   // First slot still being copied by PopNextImages(), which the inserting
+   // thread must not reach; -1 if none. Then
+   // 0 <= pinnedIndex_ <= saveIndex_ and
+   // insertIndex_ - pinnedIndex_ <= frameArray_.size()
+   long pinnedIndex_;
 
    unsigned long memorySizeMB_;
    unsigned int numChannels_;
    bool overflow_;
    std::vector<mm::FrameBuffer> frameArray_;
 
+   bool statsEnabled_;
+   unsigned histogramBins_;
+   mm::FrameStatistics frameStats_; // Guarded by g_insertLock
+
+   bool packingEnabled_;
+   bool packed_;
+   PackedPixels::Format packedFormat_;
+   // One unpacked image per reading thread, so that no thread's image is
+   // overwritten by another thread's read; most recent reader first, and at
+   // most maxUnpackedImages_ of them
+   static const std::size_t maxUnpackedImages_ = 4;
+   mutable std::list<std::pair<std::thread::id, std::unique_ptr<mm::ImgBuffer>>> unpackedImages_;
+
    std::shared_ptr<ThreadPool> threadPool_;
    std::shared_ptr<TaskSet_CopyMemory> tasksMemCopy_;
+
+   // Serializes PopNextImages() with Initialize() and Clear(), so that the
+   // slots it copies outside g_bufferLock stay allocated and in place. May be
+   // held while taking g_bufferLock, never the other way around.
+   std::mutex popMutex_;
+
+   // May be held while taking g_bufferLock, never the other way around
+   std::mutex waitMutex_;
+   std::condition_variable waitCv_;
+   unsigned waiters_; // Guarded by waitMutex_
+   unsigned long interrupts_; // Guarded by waitMutex_
 };
 
 #if defined(__GNUC__) && !defined(__clang__)
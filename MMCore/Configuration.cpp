@@ -22,6 +22,7 @@
 #include "../MMDevice/MMDevice.h"
 #include "Error.h"
 
+#include <atomic>
 #include <cstring>
 #include <fstream>
 #include <sstream>
@@ -36,6 +37,18 @@
 #pragma GCC diagnostic ignored "-Wdeprecated"
 #endif
 
+namespace {
+
+// Revisions are unique across all configurations, so that a configuration
+// replaced by assignment is still seen as modified.
+unsigned long long NextRevision()
+{
+   static std::atomic<unsigned long long> lastRevision(0);
+   return ++lastRevision;
+}
+
+} // anonymous namespace
+
 std::string PropertySetting::generateKey(const char* device, const char* prop)
 {
    std::string key(device);
@@ -175,6 +188,7 @@ void Configuration::addSetting(const PropertySetting& setting)
       index_[setting.getKey()] = (int)settings_.size();
       settings_.push_back(setting);
    }
+   revision_ = NextRevision();
 }
 
 /**
@@ -198,5 +212,6 @@ void Configuration::deleteSetting(const char* device, const char* prop)
    {
       index_[settings_[i].getKey()] = i;
    }
+   revision_ = NextRevision();
 
 }
\ No newline at end of file
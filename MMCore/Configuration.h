@@ -98,7 +98,7 @@ class Configuration
 {
 public:
 
-   Configuration() {}
+   Configuration() : revision_(0) {}
    ~Configuration() {}
 
    /**
@@ -119,10 +119,17 @@ public:
     */
    size_t size() const {return settings_.size();}
    std::string getVerbose() const;
+
+   /**
+    * Returns a number that changes whenever the contents are modified.
+    * Copies share the revision of their original until either is modified.
+    */
+   unsigned long long getRevision() const {return revision_;}
  
 private:
    std::vector<PropertySetting> settings_;
    std::map<std::string, int> index_;
+   unsigned long long revision_;
 };
 
 #if defined(__GNUC__) && !defined(__clang__)
@@ -31,6 +31,7 @@
 #include "CircularBuffer.h"
 #include "CoreCallback.h"
 #include "DeviceManager.h"
+#include "ThreadPool.h"
 
 #include <cassert>
 #include <chrono>
@@ -260,7 +261,8 @@ int CoreCallback::InsertImage(const MM::Device* caller, const unsigned char* buf
          MM::ImageProcessor* ip = GetImageProcessor(caller);
          if( NULL != ip)
          {
-            ip->Process(const_cast<unsigned char*>(buf), width, height, byteDepth);
+            if (ip->Process(const_cast<unsigned char*>(buf), width, height, byteDepth) == DEVICE_IMAGE_CONSUMED)
+               return DEVICE_OK;
          }
       }
       if (core_->cbuf_->InsertImage(buf, width, height, byteDepth, &md))
@@ -292,7 +294,8 @@ int CoreCallback::InsertImage(const MM::Device* caller, const unsigned char* buf
          MM::ImageProcessor* ip = GetImageProcessor(caller);
          if( NULL != ip)
          {
-            ip->Process(const_cast<unsigned char*>(buf), width, height, byteDepth);
+            if (ip->Process(const_cast<unsigned char*>(buf), width, height, byteDepth) == DEVICE_IMAGE_CONSUMED)
+               return DEVICE_OK;
          }
       }
       if (core_->cbuf_->InsertImage(buf, width, height, byteDepth, nComponents, &md))
@@ -313,11 +316,13 @@ int CoreCallback::InsertImage(const MM::Device* caller, const ImgBuffer & imgBuf
    MM::ImageProcessor* ip = GetImageProcessor(caller);
    if( NULL != ip)
    {
-      ip->Process(p, imgBuf.Width(), imgBuf.Height(), imgBuf.Depth());
+      if (ip->Process(p, imgBuf.Width(), imgBuf.Height(), imgBuf.Depth()) == DEVICE_IMAGE_CONSUMED)
+         return DEVICE_OK;
    }
 
+   // Already processed above
    return InsertImage(caller, imgBuf.GetPixels(), imgBuf.Width(), 
-      imgBuf.Height(), imgBuf.Depth(), &md);
+      imgBuf.Height(), imgBuf.Depth(), &md, false);
 }
 
 void CoreCallback::ClearImageBuffer(const MM::Device* /*caller*/)
@@ -350,7 +355,8 @@ int CoreCallback::InsertMultiChannel(const MM::Device* caller,
       MM::ImageProcessor* ip = GetImageProcessor(caller);
       if( NULL != ip)
       {
-         ip->Process( const_cast<unsigned char*>(buf), width, height, byteDepth);
+         if (ip->Process( const_cast<unsigned char*>(buf), width, height, byteDepth) == DEVICE_IMAGE_CONSUMED)
+            return DEVICE_OK;
       }
       if (core_->cbuf_->InsertMultiChannel(buf, numChannels, width, height, byteDepth, &md))
          return DEVICE_OK;
@@ -378,6 +384,9 @@ int CoreCallback::AcqFinished(const MM::Device* caller, int /*statusCode*/)
       return DEVICE_ERR;
    }
 
+   // Threads waiting for images that will not arrive check again
+   core_->cbuf_->Interrupt();
+
    std::shared_ptr<DeviceInstance> currentCamera =
       core_->currentCameraDevice_.lock();
 
@@ -1077,3 +1086,25 @@ MM::MMTime CoreCallback::GetCurrentMMTime()
 {
    return MM::MMTime::fromUs(SteadyMicroseconds());
 }
+
+int CoreCallback::RunInParallel(const MM::Device*,
+      void (*func)(void* context, unsigned index), void* context,
+      unsigned count, bool critical)
+{
+   if (!func)
+      return DEVICE_INVALID_INPUT_PARAM;
+   core_->threadPool_->ParallelFor(count,
+         [func, context](size_t index)
+         { func(context, static_cast<unsigned>(index)); },
+         critical ? ThreadPool::Priority::Critical :
+         ThreadPool::Priority::Background);
+   return DEVICE_OK;
+}
+
+int CoreCallback::GetAcquisitionThreadPlacement(const MM::Device*,
+      int& priority, unsigned long long& cpuMask)
+{
+   priority = static_cast<int>(core_->acquisitionThreadPriority_);
+   cpuMask = core_->acquisitionThreadCPUMask_;
+   return DEVICE_OK;
+}
@@ -61,6 +61,12 @@ public:
    MM::Device* GetDevice(const MM::Device* caller, const char* label);
 
    MM::PortType GetSerialPortType(const char* portName) const;
+
+   int RunInParallel(const MM::Device* caller,
+         void (*func)(void* context, unsigned index), void* context,
+         unsigned count, bool critical);
+   int GetAcquisitionThreadPlacement(const MM::Device* caller,
+         int& priority, unsigned long long& cpuMask);
  
    int SetSerialProperties(const char* portName,
                            const char* answerTimeout,
@@ -156,6 +156,31 @@ void CorePropertyCollection::Execute(const char* propName, const char* value)
    {
       core_->setTimeoutMs(atol(value));
    }
+   else if (strcmp(propName, MM::g_Keyword_CoreInitializationTimeoutMs) == 0)
+   {
+      core_->setDeviceInitializationTimeoutMs(atol(value));
+   }
+   else if (strcmp(propName, MM::g_Keyword_CoreAcquisitionThreadPriority) == 0 ||
+         strcmp(propName, MM::g_Keyword_CoreAcquisitionThreadCPUs) == 0)
+   {
+      try
+      {
+         std::vector<long> cpus;
+         if (strcmp(propName, MM::g_Keyword_CoreAcquisitionThreadPriority) == 0)
+            core_->setAcquisitionThreadPriority(atol(value));
+         else if (ParseCPUList(value, cpus))
+            core_->setAcquisitionThreadCPUs(cpus);
+         else
+            throw CMMError("Invalid CPU list " + ToQuotedString(value) +
+                  " (expected CPU numbers or ranges separated by spaces)",
+                  MMERR_InvalidCoreValue);
+      }
+      catch (const CMMError&)
+      {
+         Refresh(); // Restore the value in effect
+         throw;
+      }
+   }
    else if (strcmp(propName, MM::g_Keyword_CoreChannelGroup) == 0)
    {
       core_->setChannelGroup(value);
@@ -238,6 +263,16 @@ void CorePropertyCollection::Refresh()
    // Timeout for Device Busy checking
    Set(MM::g_Keyword_CoreTimeoutMs, CDeviceUtils::ConvertToString(core_->getTimeoutMs()));
 
+   // Timeout for device initialization
+   Set(MM::g_Keyword_CoreInitializationTimeoutMs,
+         CDeviceUtils::ConvertToString(core_->getDeviceInitializationTimeoutMs()));
+
+   // Scheduling of acquisition threads
+   Set(MM::g_Keyword_CoreAcquisitionThreadPriority,
+         CDeviceUtils::ConvertToString(core_->getAcquisitionThreadPriority()));
+   Set(MM::g_Keyword_CoreAcquisitionThreadCPUs,
+         FormatCPUList(core_->getAcquisitionThreadCPUs()).c_str());
+
    // Channel group
    Set(MM::g_Keyword_CoreChannelGroup, core_->getChannelGroup().c_str());
 
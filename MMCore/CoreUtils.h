@@ -27,7 +27,12 @@
 
 #include "../MMDevice/MMDevice.h"
 
+#include <algorithm>
+#include <cctype>
+#include <cstdlib>
+#include <sstream>
 #include <string>
+#include <vector>
 
 
 inline std::string ToString(int d) { return std::to_string(d); }
@@ -76,6 +81,57 @@ inline std::string ToString(const MM::DeviceType d)
    return "Invalid";
 }
 
+// Formats CPU numbers as used in Core property values: numbers and ranges
+// separated by spaces, e.g. "2-3 6"
+inline std::string FormatCPUList(std::vector<long> cpus)
+{
+   std::sort(cpus.begin(), cpus.end());
+   cpus.erase(std::unique(cpus.begin(), cpus.end()), cpus.end());
+   std::ostringstream oss;
+   for (size_t i = 0; i < cpus.size(); )
+   {
+      size_t last = i;
+      while (last + 1 < cpus.size() && cpus[last + 1] == cpus[last] + 1)
+         ++last;
+      if (i > 0)
+         oss << ' ';
+      oss << cpus[i];
+      if (last > i)
+         oss << '-' << cpus[last];
+      i = last + 1;
+   }
+   return oss.str();
+}
+
+// Parses the form written by FormatCPUList(); returns false if malformed
+inline bool ParseCPUList(const std::string& s, std::vector<long>& cpus)
+{
+   cpus.clear();
+   std::istringstream iss(s);
+   std::string item;
+   while (iss >> item)
+   {
+      if (!std::isdigit(static_cast<unsigned char>(item[0])))
+         return false;
+      char* end = 0;
+      const long first = std::strtol(item.c_str(), &end, 10);
+      long last = first;
+      if (*end == '-')
+      {
+         const char* rangeEnd = end + 1;
+         if (!std::isdigit(static_cast<unsigned char>(*rangeEnd)))
+            return false;
+         last = std::strtol(rangeEnd, &end, 10);
+      }
+      // More CPUs than any machine has are taken as a typo
+      if (*end != '\0' || last < first || last > 4095)
+         return false;
+      for (long cpu = first; cpu <= last; ++cpu)
+         cpus.push_back(cpu);
+   }
+   return true;
+}
+
 template <typename T>
 inline std::string ToQuotedString(const T& d)
 { return "\"" + ToString(d) + "\""; }
@@ -155,6 +155,24 @@ DeviceManager::UnloadAllDevices()
 }
 
 
+void
+DeviceManager::AbandonDevice(const std::string& label)
+{
+   for (DeviceIterator it = devices_.begin(), end = devices_.end(); it != end; ++it)
+   {
+      if (it->first == label)
+      {
+         // Deliberately leaked, so that the device is never deleted and its
+         // module never unloaded
+         new std::shared_ptr<DeviceInstance>(it->second);
+         deviceRawPtrIndex_.erase(it->second->GetRawPtr());
+         devices_.erase(it);
+         break;
+      }
+   }
+}
+
+
 namespace
 {
    class DevicePairMatcheslabel
@@ -74,6 +74,14 @@ public:
     */
    void UnloadAllDevices();
 
+   /**
+    * \brief Remove a device without shutting it down or destroying it.
+    *
+    * For a device stuck in a call that does not return; the device object
+    * and its adapter module are leaked.
+    */
+   void AbandonDevice(const std::string& label);
+
    /**
     * \brief Get a device by label.
     */
@@ -29,6 +29,8 @@
 #include "../Logging/Logger.h"
 #include "../MMCore.h"
 
+#include <cstdio>
+
 
 int
 DeviceInstance::LogMessage(const char* msg, bool debugOnly)
@@ -122,6 +124,25 @@ DeviceInstance::ThrowIfError(int code, const std::string& message) const
    throw e;
 }
 
+void
+DeviceInstance::CheckPropertySettable(const std::string& name) const
+{
+   if (initialized_ && GetPropertyInitStatus(name.c_str())) {
+      // Note: Some features (port scanning) may depend on setting serial port
+      // properties post-init. We may want to exclude SerialManager from this
+      // check (regardless of whether strictInitializationChecks is enabled).
+      if (mm::features::flags().strictInitializationChecks)
+      {
+         ThrowError("Cannot set pre-init property after initialization");
+      }
+      else
+      {
+         LOG_WARNING(Logger()) << "Setting of pre-init property (" << name <<
+            ") not permitted on initialized device (this will be an error in a future version of MMCore; for now we continue with the operation anyway, even though it might not be safe)";
+      }
+   }
+}
+
 void
 DeviceInstance::RequireInitialized(const char* operation) const
 {
@@ -171,8 +192,9 @@ DeviceInstance::GetProperty(const std::string& name) const
 {
    DeviceStringBuffer valueBuf(this, "GetProperty");
    int err = pImpl_->GetProperty(name.c_str(), valueBuf.GetBuffer());
-   ThrowIfError(err, "Cannot get value of property " +
-         ToQuotedString(name));
+   if (err != DEVICE_OK)
+      ThrowIfError(err, "Cannot get value of property " +
+            ToQuotedString(name));
    return valueBuf.Get();
 }
 
@@ -180,33 +202,99 @@ void
 DeviceInstance::SetProperty(const std::string& name,
       const std::string& value) const
 {
-   if (initialized_ && GetPropertyInitStatus(name.c_str())) {
-      // Note: Some features (port scanning) may depend on setting serial port
-      // properties post-init. We may want to exclude SerialManager from this
-      // check (regardless of whether strictInitializationChecks is enabled).
-      if (mm::features::flags().strictInitializationChecks)
-      {
-         ThrowError("Cannot set pre-init property after initialization");
-      }
-      else
-      {
-         LOG_WARNING(Logger()) << "Setting of pre-init property (" << name <<
-            ") not permitted on initialized device (this will be an error in a future version of MMCore; for now we continue with the operation anyway, even though it might not be safe)";
-      }
-   }
+   CheckPropertySettable(name);
 
    LOG_DEBUG(Logger()) << "Will set property \"" << name << "\" to \"" <<
       value << "\"";
 
    int err = pImpl_->SetProperty(name.c_str(), value.c_str());
 
-   ThrowIfError(err, "Cannot set property " + ToQuotedString(name) +
-         " to " + ToQuotedString(value));
+   if (err != DEVICE_OK)
+      ThrowIfError(err, "Cannot set property " + ToQuotedString(name) +
+            " to " + ToQuotedString(value));
 
    LOG_DEBUG(Logger()) << "Did set property \"" << name << "\" to \"" <<
       value << "\"";
 }
 
+bool
+DeviceInstance::GetFloatPropertyValue(const std::string& name,
+      double& value) const
+{
+   int err = pImpl_->GetFloatPropertyValue(name.c_str(), value);
+   if (err == DEVICE_INVALID_PROPERTY_TYPE)
+      return false;
+   if (err != DEVICE_OK)
+      ThrowIfError(err, "Cannot get value of property " +
+            ToQuotedString(name));
+   return true;
+}
+
+bool
+DeviceInstance::GetIntegerPropertyValue(const std::string& name,
+      long& value) const
+{
+   int err = pImpl_->GetIntegerPropertyValue(name.c_str(), value);
+   if (err == DEVICE_INVALID_PROPERTY_TYPE)
+      return false;
+   if (err != DEVICE_OK)
+      ThrowIfError(err, "Cannot get value of property " +
+            ToQuotedString(name));
+   return true;
+}
+
+bool
+DeviceInstance::SetFloatPropertyValue(const std::string& name,
+      double value) const
+{
+   CheckPropertySettable(name);
+
+   // Formatted once, as streaming a number is slow even if not logged
+   char text[32];
+   std::snprintf(text, sizeof(text), "%g", value);
+
+   LOG_DEBUG(Logger()) << "Will set property \"" << name << "\" to " <<
+      text;
+
+   int err = pImpl_->SetFloatPropertyValue(name.c_str(), value);
+   if (err == DEVICE_INVALID_PROPERTY_TYPE)
+      return false;
+
+   if (err != DEVICE_OK)
+      ThrowIfError(err, "Cannot set property " + ToQuotedString(name) +
+            " to " + text);
+
+   LOG_DEBUG(Logger()) << "Did set property \"" << name << "\" to " <<
+      text;
+   return true;
+}
+
+bool
+DeviceInstance::SetIntegerPropertyValue(const std::string& name,
+      long value) const
+{
+   CheckPropertySettable(name);
+
+   // Formatted once, as streaming a number is slow even if not logged
+   char text[32];
+   std::snprintf(text, sizeof(text), "%ld", value);
+
+   LOG_DEBUG(Logger()) << "Will set property \"" << name << "\" to " <<
+      text;
+
+   int err = pImpl_->SetIntegerPropertyValue(name.c_str(), value);
+   if (err == DEVICE_INVALID_PROPERTY_TYPE)
+      return false;
+
+   if (err != DEVICE_OK)
+      ThrowIfError(err, "Cannot set property " + ToQuotedString(name) +
+            " to " + text);
+
+   LOG_DEBUG(Logger()) << "Did set property \"" << name << "\" to " <<
+      text;
+   return true;
+}
+
 bool
 DeviceInstance::HasProperty(const std::string& name) const
 { return pImpl_->HasProperty(name.c_str()); }
@@ -335,6 +423,20 @@ DeviceInstance::SendPropertySequence(const char* propertyName)
    ThrowIfError(pImpl_->SendPropertySequence(propertyName));
 }
 
+void
+DeviceInstance::LoadPropertySequence(const char* propertyName, const std::vector<double>& values)
+{
+   ThrowIfError(pImpl_->LoadFloatPropertySequence(propertyName,
+            values.data(), static_cast<unsigned long>(values.size())));
+}
+
+void
+DeviceInstance::LoadPropertySequence(const char* propertyName, const std::vector<long>& values)
+{
+   ThrowIfError(pImpl_->LoadIntegerPropertySequence(propertyName,
+            values.data(), static_cast<unsigned long>(values.size())));
+}
+
 std::string
 DeviceInstance::GetErrorText(int code) const
 {
@@ -383,6 +485,9 @@ void
 DeviceInstance::Shutdown()
 {
    // Note we do not require device to be initialized before calling Shutdown().
+   // Holding the module lock serializes this with an Initialize() that may
+   // still be running on another thread.
+   MMThreadGuard guard(GetAdapterModule()->GetLock());
    initialized_ = false;
    ThrowIfError(pImpl_->Shutdown());
 }
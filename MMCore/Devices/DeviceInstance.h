@@ -117,6 +117,7 @@ protected:
    void ThrowError(const std::string& message) const;
    void ThrowIfError(int code) const;
    void ThrowIfError(int code, const std::string& message) const;
+   void CheckPropertySettable(const std::string& name) const;
    void RequireInitialized(const char *) const;
 
    /// Utility class for getting fixed-length strings from the device interface.
@@ -186,6 +187,12 @@ private:
 public:
    std::string GetProperty(const std::string& name) const;
    void SetProperty(const std::string& name, const std::string& value) const;
+   // These return false, without error, if the property does not support
+   // typed access (see MM::Device); the string form must then be used
+   bool GetFloatPropertyValue(const std::string& name, double& value) const;
+   bool GetIntegerPropertyValue(const std::string& name, long& value) const;
+   bool SetFloatPropertyValue(const std::string& name, double value) const;
+   bool SetIntegerPropertyValue(const std::string& name, long value) const;
    bool HasProperty(const std::string& name) const;
 private:
    // Exposed through GetPropertyNames() only
@@ -206,6 +213,8 @@ public:
    void ClearPropertySequence(const char* propertyName);
    void AddToPropertySequence(const char* propertyName, const char* value);
    void SendPropertySequence(const char* propertyName);
+   void LoadPropertySequence(const char* propertyName, const std::vector<double>& values);
+   void LoadPropertySequence(const char* propertyName, const std::vector<long>& values);
    std::string GetErrorText(int code) const;
    bool Busy();
    double GetDelayMs() const;
@@ -78,4 +78,7 @@
 #define MMERR_CreatePeripheralFailed   50
 #define MMERR_PropertyNotInCache       51
 #define MMERR_BadAffineTransform       52
+#define MMERR_BufferTooSmall           53
+#define MMERR_DeviceInitializationTimeout 54
+#define MMERR_ImageConsumedByProcessor 55
 #endif //_ERRORCODES_H_
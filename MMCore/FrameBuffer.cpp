@@ -24,31 +24,72 @@
 namespace mm {
 
 ImgBuffer::ImgBuffer(unsigned xSize, unsigned ySize, unsigned pixDepth) :
-   pixels_(0), width_(xSize), height_(ySize), pixDepth_(pixDepth)
+   pixels_(0), width_(xSize), height_(ySize), pixDepth_(pixDepth),
+   packed_(false), packedFormat_(PackedPixels::Mono12p)
 {
    pixels_ = new unsigned char[xSize * ySize * pixDepth];
    memset(pixels_, 0, xSize * ySize * pixDepth);
 }
 
+ImgBuffer::ImgBuffer(unsigned xSize, unsigned ySize, PackedPixels::Format format) :
+   pixels_(0), width_(xSize), height_(ySize), pixDepth_(2),
+   packed_(true), packedFormat_(format)
+{
+   pixels_ = new unsigned char[StorageBytes()];
+   memset(pixels_, 0, StorageBytes());
+}
+
 ImgBuffer::~ImgBuffer()
 {
    delete[] pixels_;
 }
 
+std::size_t ImgBuffer::StorageBytes() const
+{
+   const std::size_t pixelCount = static_cast<std::size_t>(width_) * height_;
+   if (packed_)
+      return PackedPixels::PackedBytes(packedFormat_, pixelCount);
+   return pixelCount * pixDepth_;
+}
+
 const unsigned char* ImgBuffer::GetPixels() const
 {
    return pixels_;
 }
 
-void ImgBuffer::SetPixels(const void* pix)
+std::size_t ImgBuffer::SetPixels(const void* pix)
 {
+   if (packed_)
+      return PackedPixels::Pack(packedFormat_, pixels_,
+            static_cast<const unsigned short*>(pix),
+            static_cast<std::size_t>(width_) * height_);
    memcpy((void*)pixels_, pix, width_ * height_ * pixDepth_);
+   return 0;
+}
+
+void ImgBuffer::CopyUnpackedTo(ImgBuffer& dest) const
+{
+   CopyPixelsUnpackedTo(dest.pixels_);
+   dest.metadata_ = metadata_;
+   dest.timestamp_ = timestamp_;
+}
+
+void ImgBuffer::CopyPixelsUnpackedTo(unsigned char* dest) const
+{
+   if (packed_)
+      PackedPixels::Unpack(packedFormat_,
+            reinterpret_cast<unsigned short*>(dest), pixels_,
+            static_cast<std::size_t>(width_) * height_);
+   else
+      memcpy(dest, pixels_, width_ * height_ * pixDepth_);
 }
 
 void ImgBuffer::Resize(unsigned xSize, unsigned ySize, unsigned pixDepth)
 {
    // re-allocate internal buffer if it is not big enough
-   if (width_ * height_ * pixDepth_ < xSize * ySize * pixDepth)
+   const std::size_t oldBytes = StorageBytes();
+   packed_ = false;
+   if (oldBytes < xSize * ySize * pixDepth)
    {
       delete[] pixels_;
       pixels_ = new unsigned char [xSize * ySize * pixDepth];
@@ -62,16 +103,16 @@ void ImgBuffer::Resize(unsigned xSize, unsigned ySize, unsigned pixDepth)
 void ImgBuffer::Resize(unsigned xSize, unsigned ySize)
 {
    // re-allocate internal buffer if it is not big enough
-   if (width_ * height_ < xSize * ySize)
+   const std::size_t oldBytes = StorageBytes();
+   width_ = xSize;
+   height_ = ySize;
+   if (oldBytes < StorageBytes())
    {
       delete[] pixels_;
-      pixels_ = new unsigned char[xSize * ySize * pixDepth_];
+      pixels_ = new unsigned char[StorageBytes()];
    }
 
-   width_ = xSize;
-   height_ = ySize;
-
-   memset(pixels_, 0, width_ * height_ * pixDepth_);
+   memset(pixels_, 0, StorageBytes());
 }
 
 void ImgBuffer::SetMetadata(const Metadata& md)
@@ -83,19 +124,36 @@ void ImgBuffer::SetMetadata(const Metadata& md)
     metadata_.Restore(md.Serialize().c_str());
 }
 
+Metadata ImgBuffer::GetMetadata() const
+{
+   Metadata md(metadata_);
+   timestamp_.AddToMetadata(md);
+   return md;
+}
+
+void ImgBuffer::GetMetadata(Metadata& md) const
+{
+   md = metadata_;
+   timestamp_.AddToMetadata(md);
+}
+
 
 ///////////////////////////////////////////////////////////////////////////////
 // FrameBuffer class
 ///////////////////////////////////////////////////////////////////////////////
 
-FrameBuffer::FrameBuffer(unsigned xSize, unsigned ySize, unsigned byteDepth)
+FrameBuffer::FrameBuffer(unsigned xSize, unsigned ySize, unsigned byteDepth) :
+   packed_(false),
+   packedFormat_(PackedPixels::Mono12p)
 {
    width_ = xSize;
    height_ = ySize;
    depth_ = byteDepth;
 }
 
-FrameBuffer::FrameBuffer()
+FrameBuffer::FrameBuffer() :
+   packed_(false),
+   packedFormat_(PackedPixels::Mono12p)
 {
    width_ = 0;
    height_ = 0;
@@ -133,6 +191,13 @@ void FrameBuffer::Resize(unsigned xSize, unsigned ySize, unsigned byteDepth)
    width_ = xSize;
    height_ = ySize;
    depth_ = byteDepth;
+   packed_ = false;
+}
+
+void FrameBuffer::SetPacking(bool packed, PackedPixels::Format format)
+{
+   packed_ = packed && depth_ == 2;
+   packedFormat_ = format;
 }
 
 bool FrameBuffer::SetPixels(unsigned channel, const unsigned char* pixels)
@@ -174,7 +239,9 @@ ImgBuffer* FrameBuffer::InsertNewImage(unsigned channel)
 {
    if (channel >= channels_.size())
       channels_.resize(channel + 1, 0);
-   ImgBuffer* img = new ImgBuffer(width_, height_, depth_);
+   ImgBuffer* img = packed_ ?
+      new ImgBuffer(width_, height_, packedFormat_) :
+      new ImgBuffer(width_, height_, depth_);
    channels_[channel] = img;
    return img;
 }
@@ -18,8 +18,12 @@
 
 #pragma once
 
+#include "FrameTimestamps.h"
+
 #include "../MMDevice/ImageMetadata.h"
+#include "../MMDevice/PackedPixels.h"
 
+#include <cstddef>
 #include <string>
 #include <vector>
 #include <map>
@@ -32,25 +36,47 @@ class ImgBuffer
    unsigned int width_;
    unsigned int height_;
    unsigned int pixDepth_;
+   bool packed_;
+   PackedPixels::Format packedFormat_;
    Metadata metadata_;
+   FrameTimestamp timestamp_;
 
 public:
    ImgBuffer(unsigned xSize, unsigned ySize, unsigned pixDepth);
+   // 16-bit image stored in a packed format: SetPixels() takes 16-bit pixels
+   // and GetPixels() returns the packed data
+   ImgBuffer(unsigned xSize, unsigned ySize, PackedPixels::Format format);
    ~ImgBuffer();
 
    unsigned int Width() const {return width_;}
    unsigned int Height() const {return height_;}
    unsigned int Depth() const {return pixDepth_;}
-   void SetPixels(const void* pixArray);
+   bool IsPacked() const {return packed_;}
+   // Returns the number of pixel values saturated by packing (0 if the image
+   // is not packed)
+   std::size_t SetPixels(const void* pixArray);
    const unsigned char* GetPixels() const;
+   // Copies the pixels, unpacked if necessary, the metadata and the timestamp
+   // to an unpacked image of the same size and depth
+   void CopyUnpackedTo(ImgBuffer& dest) const;
+   // Copies the pixels, unpacked if necessary, to Width() * Height() *
+   // Depth() bytes at dest
+   void CopyPixelsUnpackedTo(unsigned char* dest) const;
 
    void Resize(unsigned xSize, unsigned ySize, unsigned pixDepth);
    void Resize(unsigned xSize, unsigned ySize);
 
    void SetMetadata(const Metadata& md);
-   const Metadata& GetMetadata() const {return metadata_;}
+   void SetTimestamp(const FrameTimestamp& ts) {timestamp_ = ts;}
+   const FrameTimestamp& GetTimestamp() const {return timestamp_;}
+   // Returns the stored metadata, with the timestamp tags rendered
+   Metadata GetMetadata() const;
+   // As above, assigning to md; avoids a copy when filling a container
+   void GetMetadata(Metadata& md) const;
 
 private:
+   std::size_t StorageBytes() const;
+
    ImgBuffer& operator=(const ImgBuffer&);
 };
 
@@ -62,6 +88,8 @@ class FrameBuffer
    unsigned int width_;
    unsigned int height_;
    unsigned int depth_;
+   bool packed_;
+   PackedPixels::Format packedFormat_;
 
 public:
    FrameBuffer(unsigned xSize, unsigned ySize, unsigned byteDepth);
@@ -69,6 +97,8 @@ public:
    ~FrameBuffer();
 
    void Resize(unsigned xSize, unsigned ySize, unsigned pixDepth);
+   // Images allocated after this call store 16-bit pixels packed
+   void SetPacking(bool packed, PackedPixels::Format format);
    void Clear();
    void Preallocate(unsigned channels);
 
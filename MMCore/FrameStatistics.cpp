@@ -0,0 +1,203 @@
+///////////////////////////////////////////////////////////////////////////////
+// FILE:          FrameStatistics.cpp
+// PROJECT:       Micro-Manager
+// SUBSYSTEM:     MMCore
+//-----------------------------------------------------------------------------
+// DESCRIPTION:   Per-frame pixel statistics (histogram, min/max/mean,
+//                saturation), computed while frames are copied into the
+//                circular buffer.
+//
+// LICENSE:       This file is distributed under the "Lesser GPL" (LGPL) license.
+//                License text is included with the source distribution.
+//
+//                This file is distributed in the hope that it will be useful,
+//                but WITHOUT ANY WARRANTY; without even the implied warranty
+//                of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+//
+//                IN NO EVENT SHALL THE COPYRIGHT OWNER OR
+//                CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+//                INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES.
+
+#include "FrameStatistics.h"
+
+#include "../MMDevice/ImageMetadata.h"
+#include "../MMDevice/MMDeviceConstants.h"
+
+#include <algorithm>
+#include <cassert>
+#include <string>
+
+namespace mm {
+
+namespace {
+
+// Below this many 16-bit pixels, clearing and scanning a 65536-entry table
+// costs more than updating min/max/sum per pixel.
+const std::size_t minPixelsForCounts16 = 1 << 16;
+
+unsigned Log2(unsigned v)
+{
+   unsigned n = 0;
+   while (v > 1)
+   {
+      v >>= 1;
+      ++n;
+   }
+   return n;
+}
+
+} // anonymous namespace
+
+FrameStatistics::FrameStatistics() :
+   bitDepth_(8),
+   byteDepth_(1),
+   maxValue_(255),
+   binShift_(0),
+   useCounts_(false),
+   histogram_(256),
+   count_(0),
+   sum_(0),
+   saturated_(0),
+   min_(~0u),
+   max_(0)
+{
+}
+
+void FrameStatistics::Reset(unsigned histogramBins, unsigned bitDepth,
+      unsigned byteDepth, std::size_t expectedPixels)
+{
+   assert(byteDepth == 1 || byteDepth == 2);
+   const unsigned typeBits = 8 * byteDepth;
+   byteDepth_ = byteDepth;
+   bitDepth_ = (bitDepth == 0 || bitDepth > typeBits) ? typeBits : bitDepth;
+   maxValue_ = (1u << bitDepth_) - 1;
+
+   unsigned binBits = Log2(histogramBins == 0 ? 1 : histogramBins);
+   if (binBits > bitDepth_)
+      binBits = bitDepth_;
+   binShift_ = bitDepth_ - binBits;
+   histogram_.assign(std::size_t(1) << binBits, 0);
+
+   useCounts_ = byteDepth == 1 || expectedPixels >= minPixelsForCounts16;
+   if (useCounts_)
+      counts_.assign(std::size_t(1) << typeBits, 0);
+
+   count_ = 0;
+   sum_ = 0;
+   saturated_ = 0;
+   min_ = ~0u;
+   max_ = 0;
+}
+
+template <typename T>
+void FrameStatistics::AccumulateCounts(const T* pixels, std::size_t pixelCount)
+{
+   std::uint32_t* counts = counts_.data();
+   for (std::size_t i = 0; i < pixelCount; ++i)
+      ++counts[pixels[i]];
+}
+
+template <typename T>
+void FrameStatistics::AccumulateDirect(const T* pixels, std::size_t pixelCount)
+{
+   std::uint64_t* hist = histogram_.data();
+   const unsigned maxValue = maxValue_;
+   const unsigned shift = binShift_;
+   std::uint64_t sum = 0;
+   std::uint64_t saturated = 0;
+   unsigned lo = min_;
+   unsigned hi = max_;
+   for (std::size_t i = 0; i < pixelCount; ++i)
+   {
+      const unsigned v = pixels[i];
+      sum += v;
+      lo = (std::min)(lo, v);
+      hi = (std::max)(hi, v);
+      saturated += v >= maxValue;
+      ++hist[(std::min)(v, maxValue) >> shift];
+   }
+   sum_ += sum;
+   saturated_ += saturated;
+   min_ = lo;
+   max_ = hi;
+   count_ += pixelCount;
+}
+
+void FrameStatistics::Accumulate(const unsigned char* pixels, std::size_t pixelCount)
+{
+   if (byteDepth_ == 1)
+   {
+      if (useCounts_)
+         AccumulateCounts(pixels, pixelCount);
+      else
+         AccumulateDirect(pixels, pixelCount);
+   }
+   else
+   {
+      const unsigned short* pix16 = reinterpret_cast<const unsigned short*>(pixels);
+      if (useCounts_)
+         AccumulateCounts(pix16, pixelCount);
+      else
+         AccumulateDirect(pix16, pixelCount);
+   }
+}
+
+void FrameStatistics::Finalize()
+{
+   if (!useCounts_)
+      return;
+
+   for (std::size_t v = 0; v < counts_.size(); ++v)
+   {
+      const std::uint32_t c = counts_[v];
+      if (c == 0)
+         continue;
+      const unsigned value = static_cast<unsigned>(v);
+      min_ = (std::min)(min_, value);
+      max_ = (std::max)(max_, value);
+      sum_ += static_cast<std::uint64_t>(value) * c;
+      count_ += c;
+      if (value >= maxValue_)
+         saturated_ += c;
+      histogram_[(std::min)(value, maxValue_) >> binShift_] += c;
+   }
+   useCounts_ = false;
+}
+
+void FrameStatistics::Merge(const FrameStatistics& other)
+{
+   Finalize();
+   assert(!other.useCounts_);
+   assert(histogram_.size() == other.histogram_.size());
+   if (other.count_ == 0)
+      return;
+   for (std::size_t i = 0; i < histogram_.size(); ++i)
+      histogram_[i] += other.histogram_[i];
+   count_ += other.count_;
+   sum_ += other.sum_;
+   saturated_ += other.saturated_;
+   min_ = (std::min)(min_, other.min_);
+   max_ = (std::max)(max_, other.max_);
+}
+
+void FrameStatistics::AddToMetadata(Metadata& md) const
+{
+   md.PutImageTag(MM::g_Keyword_Metadata_StatsMin, GetMin());
+   md.PutImageTag(MM::g_Keyword_Metadata_StatsMax, GetMax());
+   md.PutImageTag(MM::g_Keyword_Metadata_StatsMean, GetMean());
+   md.PutImageTag(MM::g_Keyword_Metadata_StatsSaturated, GetSaturatedCount());
+   md.PutImageTag(MM::g_Keyword_Metadata_StatsBitDepth, GetBitDepth());
+
+   // Comma-separated bin counts
+   std::string hist;
+   hist.reserve(histogram_.size() * 4);
+   for (std::size_t i = 0; i < histogram_.size(); ++i)
+   {
+      if (i > 0)
+         hist += ',';
+      hist += std::to_string(histogram_[i]);
+   }
+   md.PutImageTag(MM::g_Keyword_Metadata_StatsHistogram, hist);
+}
+
+} // namespace mm
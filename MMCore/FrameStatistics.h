@@ -0,0 +1,99 @@
+///////////////////////////////////////////////////////////////////////////////
+// FILE:          FrameStatistics.h
+// PROJECT:       Micro-Manager
+// SUBSYSTEM:     MMCore
+//-----------------------------------------------------------------------------
+// DESCRIPTION:   Per-frame pixel statistics (histogram, min/max/mean,
+//                saturation), computed while frames are copied into the
+//                circular buffer.
+//
+// LICENSE:       This file is distributed under the "Lesser GPL" (LGPL) license.
+//                License text is included with the source distribution.
+//
+//                This file is distributed in the hope that it will be useful,
+//                but WITHOUT ANY WARRANTY; without even the implied warranty
+//                of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+//
+//                IN NO EVENT SHALL THE COPYRIGHT OWNER OR
+//                CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+//                INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES.
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+class Metadata;
+
+namespace mm {
+
+/**
+ * Accumulates statistics of a single-component 8- or 16-bit frame.
+ *
+ * Usage: Reset(), then Accumulate() any number of times over consecutive
+ * parts of the frame, then Finalize(). Finalized statistics of parts of the
+ * same frame (e.g. computed on different threads) can be combined with
+ * Merge().
+ *
+ * The histogram covers the range [0, 2^bitDepth) with the given number of
+ * equal-width bins; larger values are counted in the last bin. Pixels with
+ * values of 2^bitDepth - 1 or above are counted as saturated.
+ */
+class FrameStatistics
+{
+public:
+   FrameStatistics();
+
+   static bool IsSupported(unsigned byteDepth, unsigned nComponents)
+   { return nComponents == 1 && (byteDepth == 1 || byteDepth == 2); }
+
+   // histogramBins must be a power of 2; it is reduced to 2^bitDepth if
+   // larger. expectedPixels is used to choose the counting strategy.
+   void Reset(unsigned histogramBins, unsigned bitDepth, unsigned byteDepth,
+         std::size_t expectedPixels);
+   void Accumulate(const unsigned char* pixels, std::size_t pixelCount);
+   void Finalize();
+   void Merge(const FrameStatistics& other);
+
+   // Adds the Statistics-* tags to the frame metadata
+   void AddToMetadata(Metadata& md) const;
+
+   unsigned GetBitDepth() const { return bitDepth_; }
+   unsigned GetByteDepth() const { return byteDepth_; }
+   unsigned GetHistogramBins() const { return static_cast<unsigned>(histogram_.size()); }
+
+   std::uint64_t GetPixelCount() const { return count_; }
+   unsigned GetMin() const { return count_ ? min_ : 0; }
+   unsigned GetMax() const { return max_; }
+   double GetMean() const
+   { return count_ ? static_cast<double>(sum_) / static_cast<double>(count_) : 0.0; }
+   std::uint64_t GetSaturatedCount() const { return saturated_; }
+   const std::vector<std::uint64_t>& GetHistogram() const { return histogram_; }
+
+private:
+   template <typename T>
+   void AccumulateDirect(const T* pixels, std::size_t pixelCount);
+   template <typename T>
+   void AccumulateCounts(const T* pixels, std::size_t pixelCount);
+
+   unsigned bitDepth_;
+   unsigned byteDepth_;
+   unsigned maxValue_;
+   unsigned binShift_;
+
+   // For large frames, values are first counted at full resolution (one
+   // increment per pixel); min/max/sum and the binned histogram are derived
+   // from the counts in Finalize().
+   bool useCounts_;
+   std::vector<std::uint32_t> counts_;
+
+   std::vector<std::uint64_t> histogram_;
+   std::uint64_t count_;
+   std::uint64_t sum_;
+   std::uint64_t saturated_;
+   unsigned min_;
+   unsigned max_;
+};
+
+} // namespace mm
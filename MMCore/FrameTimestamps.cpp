@@ -0,0 +1,199 @@
+///////////////////////////////////////////////////////////////////////////////
+// FILE:          FrameTimestamps.cpp
+// PROJECT:       Micro-Manager
+// SUBSYSTEM:     MMCore
+//-----------------------------------------------------------------------------
+// DESCRIPTION:   Integer nanosecond timestamps recorded for frames inserted
+//                into the circular buffer, and a running fit of camera
+//                hardware clocks against the host clock.
+//
+// LICENSE:       This file is distributed under the "Lesser GPL" (LGPL) license.
+//                License text is included with the source distribution.
+//
+//                This file is distributed in the hope that it will be useful,
+//                but WITHOUT ANY WARRANTY; without even the implied warranty
+//                of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+//
+//                IN NO EVENT SHALL THE COPYRIGHT OWNER OR
+//                CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+//                INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES.
+
+#include "FrameTimestamps.h"
+
+#include "../MMDevice/ImageMetadata.h"
+#include "../MMDevice/MMDeviceConstants.h"
+
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <ctime>
+#include <string>
+
+namespace mm {
+
+namespace {
+
+std::string FormatLocalTime(std::int64_t utcNs)
+{
+   // Floor division, for completeness (times before the epoch)
+   std::int64_t secs = utcNs / 1000000000;
+   std::int64_t nanos = utcNs % 1000000000;
+   if (nanos < 0)
+   {
+      nanos += 1000000000;
+      --secs;
+   }
+   const int frac = static_cast<int>(nanos / 1000);
+
+   // As of C++14/17, it is simpler (and probably faster) to use C functions for
+   // date-time formatting
+
+   std::time_t t(secs); // time_t is seconds on platforms we support
+   std::tm *ptm;
+#ifdef _WIN32 // Windows localtime() is documented thread-safe
+   ptm = std::localtime(&t);
+#else // POSIX has localtime_r()
+   std::tm tmstruct;
+   ptm = localtime_r(&t, &tmstruct);
+#endif
+
+   // Format as "yyyy-mm-dd hh:mm:ss.uuuuuu" (26 chars)
+   const char *timeFmt = "%Y-%m-%d %H:%M:%S";
+   char buf[32];
+   std::size_t len = std::strftime(buf, sizeof(buf), timeFmt, ptm);
+   std::snprintf(buf + len, sizeof(buf) - len, ".%06d", frac);
+   return buf;
+}
+
+} // anonymous namespace
+
+FrameTimestamp::FrameTimestamp() :
+   valid(false),
+   monotonicNs(0),
+   utcNs(0),
+   renderElapsed(false),
+   elapsedNs(0),
+   hasHardwareHost(false),
+   hardwareHostNs(0)
+{
+}
+
+FrameTimestamp FrameTimestamp::Now()
+{
+   using namespace std::chrono;
+   FrameTimestamp ts;
+   ts.valid = true;
+   ts.monotonicNs = duration_cast<nanoseconds>(
+         steady_clock::now().time_since_epoch()).count();
+   ts.utcNs = duration_cast<nanoseconds>(
+         system_clock::now().time_since_epoch()).count();
+   return ts;
+}
+
+void FrameTimestamp::AddToMetadata(Metadata& md) const
+{
+   if (!valid)
+      return;
+
+   if (renderElapsed)
+   {
+      // Microsecond resolution
+      char buf[32];
+      std::snprintf(buf, sizeof(buf), "%.3f", static_cast<double>(elapsedNs) / 1e6);
+      md.PutImageTag(MM::g_Keyword_Elapsed_Time_ms, buf);
+   }
+
+   // Local time, kept for compatibility; the UTC nanosecond tag is the
+   // unambiguous one
+   md.PutImageTag(MM::g_Keyword_Metadata_TimeInCore, FormatLocalTime(utcNs));
+
+   md.PutImageTag(MM::g_Keyword_Metadata_TimeInCoreUTC_ns, std::to_string(utcNs));
+   md.PutImageTag(MM::g_Keyword_Metadata_TimeInCoreMonotonic_ns,
+         std::to_string(monotonicNs));
+   if (hasHardwareHost)
+      md.PutImageTag(MM::g_Keyword_Metadata_HardwareTimestampHost_ns,
+            std::to_string(hardwareHostNs));
+}
+
+ClockDriftEstimator::ClockDriftEstimator()
+{
+   Reset();
+}
+
+void ClockDriftEstimator::Reset()
+{
+   x0_ = 0;
+   y0_ = 0;
+   n_ = 0;
+   meanX_ = 0.0;
+   meanY_ = 0.0;
+   sxx_ = 0.0;
+   sxy_ = 0.0;
+   rss_ = 0.0;
+}
+
+void ClockDriftEstimator::AddSample(std::int64_t deviceNs, std::int64_t hostNs)
+{
+   if (n_ == 0)
+   {
+      x0_ = deviceNs;
+      y0_ = hostNs;
+   }
+   // The fit is of the host-minus-device offset, which stays small, rather
+   // than of the host time itself; this keeps the residual sum of squares
+   // free of cancellation error in long sequences
+   const double x = static_cast<double>(deviceNs - x0_);
+   const double y = static_cast<double>((hostNs - y0_) - (deviceNs - x0_));
+
+   // The residual sum of squares is updated from the error of predicting
+   // the new sample with the previous fit (recursive least squares), which
+   // avoids the cancellation of computing it from the second moments
+   if (n_ >= 2 && sxx_ > 0.0)
+   {
+      const double dxOld = x - meanX_;
+      const double e = y - (meanY_ + sxy_ / sxx_ * dxOld);
+      const double leverage = 1.0 / static_cast<double>(n_) + dxOld * dxOld / sxx_;
+      rss_ += e * e / (1.0 + leverage);
+   }
+
+   // Welford-style update of means and co-moments
+   ++n_;
+   const double dx = x - meanX_;
+   const double dy = y - meanY_;
+   meanX_ += dx / static_cast<double>(n_);
+   meanY_ += dy / static_cast<double>(n_);
+   sxx_ += dx * (x - meanX_);
+   sxy_ += dx * (y - meanY_);
+}
+
+double ClockDriftEstimator::GetOffsetSlope() const
+{
+   if (n_ < 2 || sxx_ <= 0.0)
+      return 0.0;
+   return sxy_ / sxx_;
+}
+
+double ClockDriftEstimator::GetDriftPpm() const
+{
+   if (!HasFit())
+      return 0.0;
+   return GetOffsetSlope() * 1e6;
+}
+
+double ClockDriftEstimator::GetJitterNs() const
+{
+   if (!HasFit())
+      return 0.0;
+   return std::sqrt(rss_ / static_cast<double>(n_ - 2));
+}
+
+std::int64_t ClockDriftEstimator::ToHostNs(std::int64_t deviceNs) const
+{
+   if (n_ == 0)
+      return deviceNs;
+   const double x = static_cast<double>(deviceNs - x0_);
+   const double offset = meanY_ + GetOffsetSlope() * (x - meanX_);
+   return y0_ + (deviceNs - x0_) + static_cast<std::int64_t>(std::llround(offset));
+}
+
+} // namespace mm
@@ -0,0 +1,101 @@
+///////////////////////////////////////////////////////////////////////////////
+// FILE:          FrameTimestamps.h
+// PROJECT:       Micro-Manager
+// SUBSYSTEM:     MMCore
+//-----------------------------------------------------------------------------
+// DESCRIPTION:   Integer nanosecond timestamps recorded for frames inserted
+//                into the circular buffer, and a running fit of camera
+//                hardware clocks against the host clock.
+//
+// LICENSE:       This file is distributed under the "Lesser GPL" (LGPL) license.
+//                License text is included with the source distribution.
+//
+//                This file is distributed in the hope that it will be useful,
+//                but WITHOUT ANY WARRANTY; without even the implied warranty
+//                of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+//
+//                IN NO EVENT SHALL THE COPYRIGHT OWNER OR
+//                CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+//                INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES.
+
+#pragma once
+
+#include <cstdint>
+
+class Metadata;
+
+namespace mm {
+
+/**
+ * Times recorded when a frame is inserted into the circular buffer.
+ *
+ * Only integers are stored at insertion; the corresponding text metadata
+ * tags are rendered by AddToMetadata() when the metadata is read.
+ */
+struct FrameTimestamp
+{
+   FrameTimestamp();
+
+   // Capture the host clocks
+   static FrameTimestamp Now();
+
+   // Adds ElapsedTime-ms (unless supplied by the camera), TimeReceivedByCore
+   // and the nanosecond timestamp tags
+   void AddToMetadata(Metadata& md) const;
+
+   bool valid;
+   std::int64_t monotonicNs; // steady_clock
+   std::int64_t utcNs; // system_clock, since the Unix epoch
+   bool renderElapsed; // false if the camera supplied ElapsedTime-ms
+   std::int64_t elapsedNs; // since the start of the sequence
+   bool hasHardwareHost;
+   std::int64_t hardwareHostNs; // hardware timestamp on the steady_clock
+};
+
+/**
+ * Running least-squares fit of host clock against a device clock.
+ *
+ * Each frame carrying a hardware timestamp adds a (device, host) sample.
+ * The fitted slope gives the relative drift of the device clock, and the
+ * residuals give the jitter of frame arrival at the host. Device timestamps
+ * can be mapped to the host clock with the fitted line.
+ */
+class ClockDriftEstimator
+{
+public:
+   ClockDriftEstimator();
+
+   void Reset();
+   void AddSample(std::int64_t deviceNs, std::int64_t hostNs);
+
+   std::uint64_t GetSampleCount() const { return n_; }
+   // Drift and jitter require at least 3 samples
+   bool HasFit() const { return n_ >= 3; }
+
+   // Rate of the host clock relative to the device clock, minus 1, in parts
+   // per million
+   double GetDriftPpm() const;
+   // RMS of the residuals of the host times from the fit
+   double GetJitterNs() const;
+
+   // Maps a device timestamp to the host clock (plain offset until 2 samples
+   // have been seen)
+   std::int64_t ToHostNs(std::int64_t deviceNs) const;
+
+private:
+   // Slope of (host - device) against device time
+   double GetOffsetSlope() const;
+
+   // Samples are taken relative to the first one, so that doubles keep
+   // nanosecond precision for sequences of any practical length
+   std::int64_t x0_;
+   std::int64_t y0_;
+   std::uint64_t n_;
+   double meanX_;
+   double meanY_;
+   double sxx_;
+   double sxy_;
+   double rss_; // Residual sum of squares
+};
+
+} // namespace mm
@@ -0,0 +1,245 @@
+///////////////////////////////////////////////////////////////////////////////
+// FILE:          ImageTags.cpp
+// PROJECT:       Micro-Manager
+// SUBSYSTEM:     MMCore
+//-----------------------------------------------------------------------------
+// DESCRIPTION:   Assembly of per-image tags as a JSON object.
+//
+// LICENSE:       This file is distributed under the "Lesser GPL" (LGPL) license.
+//                License text is included with the source distribution.
+//
+//                This file is distributed in the hope that it will be useful,
+//                but WITHOUT ANY WARRANTY; without even the implied warranty
+//                of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+//
+//                IN NO EVENT SHALL THE COPYRIGHT OWNER OR
+//                CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+//                INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES.
+
+#include "ImageTags.h"
+
+#include "Configuration.h"
+#include "../MMDevice/ImageMetadata.h"
+
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <utility>
+#include <vector>
+
+namespace mm {
+
+void
+AppendJSONString(std::string& out, const std::string& value)
+{
+   out += '"';
+   for (std::string::const_iterator it = value.begin(), end = value.end();
+         it != end; ++it)
+   {
+      const unsigned char c = static_cast<unsigned char>(*it);
+      switch (c)
+      {
+         case '"': out += "\\\""; break;
+         case '\\': out += "\\\\"; break;
+         case '\b': out += "\\b"; break;
+         case '\f': out += "\\f"; break;
+         case '\n': out += "\\n"; break;
+         case '\r': out += "\\r"; break;
+         case '\t': out += "\\t"; break;
+         default:
+            if (c < 0x20)
+            {
+               char escaped[8];
+               snprintf(escaped, sizeof(escaped), "\\u%04x", c);
+               out += escaped;
+            }
+            else
+               out += static_cast<char>(c);
+      }
+   }
+   out += '"';
+}
+
+std::string
+FormatJSONNumber(double value)
+{
+   // JSON has no representation for NaN or infinity
+   if (!std::isfinite(value))
+      return "null";
+
+   char text[32];
+   if (value == std::floor(value) && std::fabs(value) < 1e15)
+   {
+      snprintf(text, sizeof(text), "%lld.0", static_cast<long long>(value));
+      return text;
+   }
+
+   // 15 significant digits are exact for most values; 17 always are
+   for (int precision = 15; precision <= 17; ++precision)
+   {
+      snprintf(text, sizeof(text), "%.*g", precision, value);
+      if (strtod(text, 0) == value)
+         break;
+   }
+   std::string result(text);
+   if (result.find_first_of(".e") == std::string::npos)
+      result += ".0";
+   return result;
+}
+
+std::shared_ptr<const SystemStateTags>
+MakeSystemStateTags(const Configuration& stateCache)
+{
+   std::shared_ptr<SystemStateTags> tags = std::make_shared<SystemStateTags>();
+   tags->revision = stateCache.getRevision();
+   for (size_t i = 0; i < stateCache.size(); ++i)
+   {
+      PropertySetting setting = stateCache.getSetting(i);
+      tags->values[setting.getDeviceLabel() + "-" +
+         setting.getPropertyName()] = setting.getPropertyValue();
+   }
+
+   for (std::map<std::string, std::string>::const_iterator
+         it = tags->values.begin(), end = tags->values.end(); it != end; ++it)
+   {
+      if (!tags->json.empty())
+         tags->json += ',';
+      AppendJSONString(tags->json, it->first);
+      tags->json += ':';
+      AppendJSONString(tags->json, it->second);
+   }
+   return tags;
+}
+
+ImageTags::ImageTags(const Metadata& md,
+      std::shared_ptr<const SystemStateTags> systemState) :
+   md_(md),
+   systemState_(systemState)
+{
+}
+
+std::string&
+ImageTags::Tag(const std::string& key)
+{
+   for (std::vector<std::pair<std::string, std::string> >::iterator
+         it = tags_.begin(), end = tags_.end(); it != end; ++it)
+   {
+      if (it->first == key)
+         return it->second;
+   }
+   tags_.push_back(std::make_pair(key, std::string()));
+   return tags_.back().second;
+}
+
+bool
+ImageTags::IsSet(const std::string& key) const
+{
+   for (std::vector<std::pair<std::string, std::string> >::const_iterator
+         it = tags_.begin(), end = tags_.end(); it != end; ++it)
+   {
+      if (it->first == key)
+         return true;
+   }
+   return false;
+}
+
+void
+ImageTags::SetString(const std::string& key, const std::string& value)
+{
+   std::string& encoded = Tag(key);
+   encoded.clear();
+   AppendJSONString(encoded, value);
+}
+
+void
+ImageTags::SetInteger(const std::string& key, long long value)
+{
+   char text[32];
+   snprintf(text, sizeof(text), "%lld", value);
+   Tag(key) = text;
+}
+
+void
+ImageTags::SetFloat(const std::string& key, double value)
+{
+   Tag(key) = FormatJSONNumber(value);
+}
+
+bool
+ImageTags::Has(const std::string& key) const
+{
+   std::string value;
+   return IsSet(key) || GetString(key, value);
+}
+
+bool
+ImageTags::GetString(const std::string& key, std::string& value) const
+{
+   if (IsSet(key))
+      return false;
+   if (systemState_)
+   {
+      std::map<std::string, std::string>::const_iterator found =
+         systemState_->values.find(key);
+      if (found != systemState_->values.end())
+      {
+         value = found->second;
+         return true;
+      }
+   }
+   try
+   {
+      value = md_.GetSingleTag(key.c_str()).GetValue();
+      return true;
+   }
+   catch (const MetadataKeyError&)
+   {
+      return false;
+   }
+}
+
+std::string
+ImageTags::ToJSON() const
+{
+   std::string json;
+   json.reserve(systemState_ ? systemState_->json.size() + 1024 : 1024);
+   json += '{';
+   for (std::vector<std::pair<std::string, std::string> >::const_iterator
+         it = tags_.begin(), end = tags_.end(); it != end; ++it)
+   {
+      if (json.size() > 1)
+         json += ',';
+      AppendJSONString(json, it->first);
+      json += ':';
+      json += it->second;
+   }
+
+   // System state keys always contain the device label and a hyphen, so
+   // they are never shadowed by the tags set directly.
+   if (systemState_ && !systemState_->json.empty())
+   {
+      if (json.size() > 1)
+         json += ',';
+      json += systemState_->json;
+   }
+
+   std::vector<std::string> keys = md_.GetKeys();
+   for (std::vector<std::string>::const_iterator it = keys.begin(),
+         end = keys.end(); it != end; ++it)
+   {
+      if (IsSet(*it))
+         continue;
+      if (systemState_ && systemState_->values.count(*it))
+         continue;
+      if (json.size() > 1)
+         json += ',';
+      AppendJSONString(json, *it);
+      json += ':';
+      AppendJSONString(json, md_.GetSingleTag(it->c_str()).GetValue());
+   }
+   json += '}';
+   return json;
+}
+
+} // namespace mm
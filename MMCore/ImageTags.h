@@ -0,0 +1,91 @@
+///////////////////////////////////////////////////////////////////////////////
+// FILE:          ImageTags.h
+// PROJECT:       Micro-Manager
+// SUBSYSTEM:     MMCore
+//-----------------------------------------------------------------------------
+// DESCRIPTION:   Assembly of per-image tags as a JSON object.
+//
+// LICENSE:       This file is distributed under the "Lesser GPL" (LGPL) license.
+//                License text is included with the source distribution.
+//
+//                This file is distributed in the hope that it will be useful,
+//                but WITHOUT ANY WARRANTY; without even the implied warranty
+//                of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+//
+//                IN NO EVENT SHALL THE COPYRIGHT OWNER OR
+//                CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+//                INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES.
+
+#pragma once
+
+#include <map>
+#include <memory>
+#include <string>
+#include <utility>
+#include <vector>
+
+class Configuration;
+class Metadata;
+
+namespace mm {
+
+// Appends the quoted, escaped JSON form of the string
+void AppendJSONString(std::string& out, const std::string& value);
+
+// Shortest form that reads back as the same double; always contains a
+// decimal point or exponent so that it is not read back as an integer
+std::string FormatJSONNumber(double value);
+
+/**
+ * The system state cache encoded as image tags.
+ *
+ * Each setting becomes a "<label>-<property>" string tag. Instances are
+ * immutable and are regenerated only when the revision of the state cache
+ * changes.
+ */
+struct SystemStateTags
+{
+   unsigned long long revision;
+   std::map<std::string, std::string> values;
+   // The encoded members, comma-separated, without braces
+   std::string json;
+};
+
+std::shared_ptr<const SystemStateTags> MakeSystemStateTags(
+      const Configuration& stateCache);
+
+/**
+ * Per-image tags, assembled into a single JSON object.
+ *
+ * Tags set directly take precedence over the system state tags, which take
+ * precedence over the image metadata. Keys are unique in the output, and
+ * tags set directly are written in the order they were first set.
+ */
+class ImageTags
+{
+public:
+   ImageTags(const Metadata& md,
+         std::shared_ptr<const SystemStateTags> systemState);
+
+   void SetString(const std::string& key, const std::string& value);
+   void SetInteger(const std::string& key, long long value);
+   void SetFloat(const std::string& key, double value);
+
+   bool Has(const std::string& key) const;
+   // The string value of a system state or metadata tag; false if absent or
+   // if the tag was set directly
+   bool GetString(const std::string& key, std::string& value) const;
+
+   std::string ToJSON() const;
+
+private:
+   std::string& Tag(const std::string& key);
+   bool IsSet(const std::string& key) const;
+
+   const Metadata& md_;
+   std::shared_ptr<const SystemStateTags> systemState_;
+   // Encoded values, in the order set; there are few enough for linear search
+   std::vector<std::pair<std::string, std::string> > tags_;
+};
+
+} // namespace mm
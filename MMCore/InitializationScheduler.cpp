@@ -0,0 +1,403 @@
+///////////////////////////////////////////////////////////////////////////////
+// FILE:          InitializationScheduler.cpp
+// PROJECT:       Micro-Manager
+// SUBSYSTEM:     MMCore
+//-----------------------------------------------------------------------------
+// DESCRIPTION:   Initializes devices concurrently in dependency order, with a
+//                per-device timeout.
+//
+// LICENSE:       This file is distributed under the "Lesser GPL" (LGPL) license.
+//                License text is included with the source distribution.
+//
+//                This file is distributed in the hope that it will be useful,
+//                but WITHOUT ANY WARRANTY; without even the implied warranty
+//                of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+//
+//                IN NO EVENT SHALL THE COPYRIGHT OWNER OR
+//                CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+//                INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES.
+
+#include "InitializationScheduler.h"
+
+#include "Error.h"
+
+#include <algorithm>
+#include <condition_variable>
+#include <deque>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <set>
+#include <thread>
+
+namespace mm {
+
+void
+PendingInitializations::Add(const std::string& label)
+{
+   std::lock_guard<std::mutex> lock(mutex_);
+   labels_.insert(label);
+}
+
+void
+PendingInitializations::Remove(const std::string& label)
+{
+   std::lock_guard<std::mutex> lock(mutex_);
+   labels_.erase(label);
+   cv_.notify_all();
+}
+
+std::vector<std::string>
+PendingInitializations::GetLabels() const
+{
+   std::lock_guard<std::mutex> lock(mutex_);
+   return std::vector<std::string>(labels_.begin(), labels_.end());
+}
+
+bool
+PendingInitializations::WaitForAll(std::chrono::milliseconds timeout)
+{
+   std::unique_lock<std::mutex> lock(mutex_);
+   return cv_.wait_for(lock, timeout, [this] { return labels_.empty(); });
+}
+
+void
+PendingInitializations::WaitForAll()
+{
+   std::unique_lock<std::mutex> lock(mutex_);
+   cv_.wait(lock, [this] { return labels_.empty(); });
+}
+
+namespace {
+
+// Completion state shared with the worker threads, which may outlive Run()
+// if their device times out
+struct Completions
+{
+   std::mutex mutex;
+   std::condition_variable cv;
+   std::vector<bool> done;
+   std::vector<std::exception_ptr> errors;
+   std::vector<std::chrono::steady_clock::time_point> endTimes;
+};
+
+std::string
+ErrorMessage(std::exception_ptr error)
+{
+   try
+   {
+      std::rethrow_exception(error);
+   }
+   catch (const CMMError& e)
+   {
+      return e.getFullMsg();
+   }
+   catch (const std::exception& e)
+   {
+      return e.what();
+   }
+   catch (...)
+   {
+      return "Unknown exception";
+   }
+}
+
+long long
+Milliseconds(std::chrono::steady_clock::duration d)
+{
+   return std::chrono::duration_cast<std::chrono::milliseconds>(d).count();
+}
+
+} // anonymous namespace
+
+const char*
+ToString(InitializationRecord::Result result)
+{
+   switch (result)
+   {
+      case InitializationRecord::Succeeded: return "Succeeded";
+      case InitializationRecord::Failed: return "Failed";
+      case InitializationRecord::TimedOut: return "TimedOut";
+      case InitializationRecord::Skipped: return "Skipped";
+   }
+   return "";
+}
+
+InitializationScheduler::InitializationScheduler(logging::Logger logger) :
+   logger_(logger)
+{
+}
+
+void
+InitializationScheduler::Add(const std::string& label, const void* group,
+      const std::vector<std::string>& dependencies,
+      std::function<void()> initialize)
+{
+   Device device;
+   device.label = label;
+   device.group = group;
+   device.dependencies = dependencies;
+   device.initialize = initialize;
+   devices_.push_back(device);
+}
+
+std::vector<InitializationRecord>
+InitializationScheduler::Run(unsigned maxWorkers,
+      std::chrono::milliseconds timeout)
+{
+   typedef std::chrono::steady_clock Clock;
+   const size_t n = devices_.size();
+   if (maxWorkers == 0)
+      maxWorkers = 1;
+
+   std::vector<InitializationRecord> records(n);
+   for (size_t i = 0; i < n; ++i)
+   {
+      records[i].label = devices_[i].label;
+      records[i].result = InitializationRecord::Skipped;
+      records[i].start = Clock::duration::zero();
+      records[i].duration = Clock::duration::zero();
+   }
+
+   std::map<std::string, size_t> indices;
+   for (size_t i = 0; i < n; ++i)
+      indices[devices_[i].label] = i;
+
+   std::vector<std::vector<size_t> > dependents(n);
+   std::vector<size_t> remaining(n, 0);
+   for (size_t i = 0; i < n; ++i)
+   {
+      std::set<size_t> deps;
+      for (const std::string& dep : devices_[i].dependencies)
+      {
+         std::map<std::string, size_t>::const_iterator found =
+            indices.find(dep);
+         if (found != indices.end() && found->second != i)
+            deps.insert(found->second);
+      }
+      for (size_t d : deps)
+         dependents[d].push_back(i);
+      remaining[i] = deps.size();
+   }
+
+   // Order topologically; devices left over are in (or depend on) a cycle
+   std::vector<size_t> order;
+   {
+      std::vector<size_t> indegree = remaining;
+      std::deque<size_t> ready;
+      for (size_t i = 0; i < n; ++i)
+         if (indegree[i] == 0)
+            ready.push_back(i);
+      while (!ready.empty())
+      {
+         const size_t i = ready.front();
+         ready.pop_front();
+         order.push_back(i);
+         for (size_t d : dependents[i])
+            if (--indegree[d] == 0)
+               ready.push_back(d);
+      }
+   }
+
+   // Length of the longest chain of dependents, including the device itself
+   std::vector<size_t> height(n, 0);
+   for (std::vector<size_t>::reverse_iterator it = order.rbegin();
+         it != order.rend(); ++it)
+   {
+      size_t h = 0;
+      for (size_t d : dependents[*it])
+         h = (std::max)(h, height[d]);
+      height[*it] = h + 1;
+   }
+
+   enum State { Waiting, Running, Finished };
+   std::vector<State> states(n, Waiting);
+
+   // Skips the waiting dependents of a device that did not succeed
+   std::function<void(size_t)> skipDependents = [&](size_t i)
+   {
+      for (size_t d : dependents[i])
+      {
+         if (states[d] != Waiting)
+            continue;
+         states[d] = Finished;
+         records[d].message = "Depends on " + devices_[i].label +
+            ", which was not initialized";
+         LOG_WARNING(logger_) << "Skipping initialization of device " <<
+            devices_[d].label << ": " << records[d].message;
+         skipDependents(d);
+      }
+   };
+
+   for (size_t i = 0; i < n; ++i)
+   {
+      if (height[i] == 0 && states[i] == Waiting)
+      {
+         states[i] = Finished;
+         records[i].message = "Dependency cycle";
+         LOG_ERROR(logger_) << "Skipping initialization of device " <<
+            devices_[i].label << ": dependency cycle";
+      }
+   }
+
+   std::shared_ptr<Completions> completions = std::make_shared<Completions>();
+   completions->done.assign(n, false);
+   completions->errors.resize(n);
+   completions->endTimes.resize(n);
+
+   std::vector<std::thread> threads(n);
+   std::vector<size_t> running;
+   std::set<const void*> busyGroups;
+   const Clock::time_point t0 = Clock::now();
+   std::vector<Clock::time_point> startTimes(n);
+
+   for (;;)
+   {
+      while (running.size() < maxWorkers)
+      {
+         size_t next = n;
+         for (size_t i = 0; i < n; ++i)
+         {
+            if (states[i] != Waiting || remaining[i] > 0 ||
+                  busyGroups.count(devices_[i].group))
+               continue;
+            if (next == n || height[i] > height[next])
+               next = i;
+         }
+         if (next == n)
+            break;
+
+         states[next] = Running;
+         running.push_back(next);
+         busyGroups.insert(devices_[next].group);
+         startTimes[next] = Clock::now();
+         LOG_INFO(logger_) << "Will initialize device " << devices_[next].label;
+
+         std::function<void()> initialize = devices_[next].initialize;
+         std::shared_ptr<Completions> shared = completions;
+         threads[next] = std::thread([initialize, shared, next]
+         {
+            std::exception_ptr error;
+            try
+            {
+               initialize();
+            }
+            catch (...)
+            {
+               error = std::current_exception();
+            }
+            std::lock_guard<std::mutex> lock(shared->mutex);
+            shared->done[next] = true;
+            shared->errors[next] = error;
+            shared->endTimes[next] = Clock::now();
+            shared->cv.notify_all();
+         });
+      }
+
+      if (running.empty())
+         break;
+
+      std::vector<size_t> finished;
+      std::vector<size_t> timedOut;
+      {
+         std::unique_lock<std::mutex> lock(completions->mutex);
+         auto anyDone = [&]
+         {
+            for (size_t i : running)
+               if (completions->done[i])
+                  return true;
+            return false;
+         };
+         if (timeout.count() > 0)
+         {
+            Clock::time_point deadline = Clock::time_point::max();
+            for (size_t i : running)
+               deadline = (std::min)(deadline, startTimes[i] + timeout);
+            completions->cv.wait_until(lock, deadline, anyDone);
+         }
+         else
+         {
+            completions->cv.wait(lock, anyDone);
+         }
+
+         const Clock::time_point now = Clock::now();
+         for (size_t i : running)
+         {
+            if (completions->done[i])
+            {
+               finished.push_back(i);
+               records[i].error = completions->errors[i];
+               records[i].duration = completions->endTimes[i] - startTimes[i];
+            }
+            else if (timeout.count() > 0 && now >= startTimes[i] + timeout)
+            {
+               timedOut.push_back(i);
+            }
+         }
+      }
+
+      for (size_t i : finished)
+      {
+         threads[i].join();
+         states[i] = Finished;
+         records[i].start = startTimes[i] - t0;
+         busyGroups.erase(devices_[i].group);
+         if (records[i].error)
+         {
+            records[i].result = InitializationRecord::Failed;
+            records[i].message = ErrorMessage(records[i].error);
+            LOG_ERROR(logger_) << "Failed to initialize device " <<
+               devices_[i].label << ": " << records[i].message;
+            skipDependents(i);
+         }
+         else
+         {
+            records[i].result = InitializationRecord::Succeeded;
+            LOG_INFO(logger_) << "Did initialize device " <<
+               devices_[i].label << " (" <<
+               Milliseconds(records[i].duration) << " ms)";
+            for (size_t d : dependents[i])
+               --remaining[d];
+         }
+      }
+
+      for (size_t i : timedOut)
+      {
+         // The initialization function may still return, but nobody will be
+         // waiting for it
+         threads[i].detach();
+         states[i] = Finished;
+         records[i].result = InitializationRecord::TimedOut;
+         records[i].start = startTimes[i] - t0;
+         records[i].duration = timeout;
+         records[i].message = "Did not finish initializing within " +
+            std::to_string(timeout.count()) + " ms";
+         LOG_ERROR(logger_) << "Giving up on device " << devices_[i].label <<
+            ": " << records[i].message;
+         skipDependents(i);
+
+         // The group stays busy for good
+         for (size_t j = 0; j < n; ++j)
+         {
+            if (states[j] != Waiting || devices_[j].group != devices_[i].group)
+               continue;
+            states[j] = Finished;
+            records[j].message = "Shares its adapter module with " +
+               devices_[i].label + ", which timed out";
+            LOG_WARNING(logger_) << "Skipping initialization of device " <<
+               devices_[j].label << ": " << records[j].message;
+            skipDependents(j);
+         }
+      }
+
+      std::vector<size_t> stillRunning;
+      for (size_t i : running)
+         if (states[i] == Running)
+            stillRunning.push_back(i);
+      running.swap(stillRunning);
+   }
+
+   return records;
+}
+
+} // namespace mm
@@ -0,0 +1,132 @@
+///////////////////////////////////////////////////////////////////////////////
+// FILE:          InitializationScheduler.h
+// PROJECT:       Micro-Manager
+// SUBSYSTEM:     MMCore
+//-----------------------------------------------------------------------------
+// DESCRIPTION:   Initializes devices concurrently in dependency order, with a
+//                per-device timeout.
+//
+// LICENSE:       This file is distributed under the "Lesser GPL" (LGPL) license.
+//                License text is included with the source distribution.
+//
+//                This file is distributed in the hope that it will be useful,
+//                but WITHOUT ANY WARRANTY; without even the implied warranty
+//                of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+//
+//                IN NO EVENT SHALL THE COPYRIGHT OWNER OR
+//                CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+//                INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES.
+
+#pragma once
+
+#include "Logging/Logger.h"
+
+#include <chrono>
+#include <condition_variable>
+#include <exception>
+#include <functional>
+#include <mutex>
+#include <set>
+#include <string>
+#include <vector>
+
+namespace mm {
+
+/**
+ * How the initialization of one device ended, and when it ran.
+ */
+struct InitializationRecord
+{
+   enum Result { Succeeded, Failed, TimedOut, Skipped };
+
+   std::string label;
+   Result result;
+   // Relative to the start of InitializationScheduler::Run(); both are zero
+   // for skipped devices. For timed-out devices, the duration is the timeout.
+   std::chrono::steady_clock::duration start;
+   std::chrono::steady_clock::duration duration;
+   // The error thrown by a failed device, if any
+   std::exception_ptr error;
+   // Why the device failed or was skipped
+   std::string message;
+};
+
+const char* ToString(InitializationRecord::Result result);
+
+/**
+ * The labels of devices whose initialization has not returned.
+ *
+ * Shared (through a shared_ptr) between the Core and initialization functions
+ * run by InitializationScheduler, so that a device that timed out is still
+ * known to be inside its Initialize() and is not shut down or unloaded under
+ * it.
+ */
+class PendingInitializations
+{
+public:
+   void Add(const std::string& label);
+   void Remove(const std::string& label);
+   std::vector<std::string> GetLabels() const;
+
+   // Waits until no device is pending; returns false if some still are after
+   // the timeout
+   bool WaitForAll(std::chrono::milliseconds timeout);
+   void WaitForAll();
+
+private:
+   mutable std::mutex mutex_;
+   std::condition_variable cv_;
+   std::set<std::string> labels_;
+};
+
+/**
+ * Runs device initialization functions on worker threads.
+ *
+ * A device is started once all of its dependencies have succeeded, and is
+ * skipped if any of them fails, times out, or is skipped. Devices in the same
+ * group (in practice, from the same adapter module, whose devices share a
+ * lock) are never started concurrently. Among the devices ready to start,
+ * those heading the longest chain of dependents go first.
+ *
+ * Each device gets its own thread. A device that has not finished within the
+ * timeout is given up on: its thread is detached and left to finish on its
+ * own, and the remaining devices of its group are skipped, because they would
+ * wait for the module lock it still holds. Initialization functions must
+ * therefore not refer to objects that may be destroyed after Run() returns,
+ * and callers must not shut down such a device until it has returned (see
+ * PendingInitializations).
+ */
+class InitializationScheduler
+{
+public:
+   explicit InitializationScheduler(logging::Logger logger);
+
+   // Dependencies on labels that were never added are ignored
+   void Add(const std::string& label, const void* group,
+         const std::vector<std::string>& dependencies,
+         std::function<void()> initialize);
+
+   /**
+    * Initializes all devices, running at most maxWorkers at once and giving
+    * up on each after timeout (no limit if zero).
+    *
+    * Returns one record per device, in the order they were added. Does not
+    * throw on device errors; they are reported in the records.
+    */
+   std::vector<InitializationRecord> Run(unsigned maxWorkers,
+         std::chrono::milliseconds timeout);
+
+private:
+   struct Device
+   {
+      std::string label;
+      const void* group;
+      std::vector<std::string> dependencies;
+      std::function<void()> initialize;
+   };
+
+   logging::Logger logger_;
+   std::vector<Device> devices_;
+};
+
+} // namespace mm
@@ -58,6 +58,8 @@ public:
    std::vector<std::string> GetAvailableDeviceNames() const;
    std::string GetDeviceDescription(const std::string& deviceName) const;
    MM::DeviceType GetAdvertisedDeviceType(const std::string& deviceName) const;
+   long GetModuleVersion() const;
+   long GetDeviceInterfaceVersion() const;
 
    std::shared_ptr<DeviceInstance> LoadDevice(CMMCore* core,
          const std::string& name, const std::string& label,
@@ -98,8 +100,6 @@ private:
 
    // Wrappers around raw module interface functions
    void InitializeModuleData();
-   long GetModuleVersion() const;
-   long GetDeviceInterfaceVersion() const;
    unsigned GetNumberOfDevices() const;
    bool GetDeviceName(unsigned index, char* buf, unsigned bufLen) const;
    bool GetDeviceDescription(const char* deviceName,
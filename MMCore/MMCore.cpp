@@ -41,6 +41,7 @@
 #include "../MMDevice/DeviceUtils.h"
 #include "../MMDevice/ImageMetadata.h"
 #include "../MMDevice/ModuleInterface.h"
+#include "CapabilityCache.h"
 #include "CircularBuffer.h"
 #include "ConfigGroup.h"
 #include "Configuration.h"
@@ -50,18 +51,25 @@
 #include "CoreUtils.h"
 #include "DeviceManager.h"
 #include "Devices/DeviceInstances.h"
+#include "ImageTags.h"
+#include "InitializationScheduler.h"
 #include "LogManager.h"
 #include "MMCore.h"
 #include "MMEventCallback.h"
 #include "PluginManager.h"
+#include "PropertyHandles.h"
+#include "SystemConfigurationFile.h"
+#include "ThreadPool.h"
 
 #include <algorithm>
 #include <cassert>
 #include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
 #include <cstring>
 #include <deque>
 #include <fstream>
-#include <future>
 #include <map>
 #include <set>
 #include <sstream>
@@ -112,7 +120,7 @@
  * (Keep the 3 numbers on one line to make it easier to look at diffs when
  * merging/rebasing.)
  */
-const int MMCore_versionMajor = 11, MMCore_versionMinor = 3, MMCore_versionPatch = 0;
+const int MMCore_versionMajor = 11, MMCore_versionMinor = 17, MMCore_versionPatch = 0;
 
 
 ///////////////////////////////////////////////////////////////////////////////
@@ -131,6 +139,10 @@ CMMCore::CMMCore() :
    everSnapped_(false),
    pollingIntervalMs_(10),
    timeoutMs_(5000),
+   initializationTimeoutMs_(0),
+   pendingInitializations_(std::make_shared<mm::PendingInitializations>()),
+   acquisitionThreadPriority_(0),
+   acquisitionThreadCPUMask_(0),
    autoShutter_(true),
    callback_(0),
    configGroups_(0),
@@ -138,8 +150,13 @@ CMMCore::CMMCore() :
    externalCallback_(0),
    pixelSizeGroup_(0),
    cbuf_(0),
+   frameStatisticsEnabled_(false),
+   frameStatisticsBins_(256),
+   circularBufferPacking_(false),
    pluginManager_(new CPluginManager()),
    deviceManager_(new mm::DeviceManager()),
+   propertyHandles_(new mm::PropertyHandleTable()),
+   threadPool_(std::make_shared<ThreadPool>()),
    pPostedErrorsLock_(NULL)
 {
    configGroups_ = new ConfigGroupCollection();
@@ -151,7 +168,7 @@ CMMCore::CMMCore() :
    callback_ = new CoreCallback(this);
 
    const unsigned seqBufMegabytes = (sizeof(void*) > 4) ? 250 : 25;
-   cbuf_ = new CircularBuffer(seqBufMegabytes);
+   cbuf_ = new CircularBuffer(seqBufMegabytes, threadPool_);
 
    nullAffine_ = new std::vector<double>(6);
    for (int i = 0; i < 6; i++) {
@@ -167,6 +184,22 @@ CMMCore::CMMCore() :
  */
 CMMCore::~CMMCore()
 {
+   // A device that timed out during initialization cannot be shut down until
+   // it returns. Give it one more timeout, then leave it (and its module)
+   // loaded rather than block exit; it must not call back into the Core once
+   // this object is gone.
+   if (!pendingInitializations_->WaitForAll(std::chrono::milliseconds(timeoutMs_)))
+   {
+      std::vector<std::string> labels = pendingInitializations_->GetLabels();
+      for (size_t i = 0; i < labels.size(); i++)
+      {
+         LOG_ERROR(coreLogger_) << "Device " << labels[i] <<
+            " has not finished initializing; leaving it loaded";
+         deviceManager_->AbandonDevice(labels[i]);
+         pendingInitializations_->Remove(labels[i]);
+      }
+   }
+
    try
    {
       // TODO We should attempt to continue cleanup beyond the first device
@@ -200,10 +233,11 @@ CMMCore::~CMMCore()
  *   attempted on a device that is not successfully initialized. When disabled,
  *   no exception is thrown and a warning is logged (and the operation may
  *   potentially cause incorrect behavior or a crash).
- * - "ParallelDeviceInitialization" (default: enabled) When enabled, serial ports
- *   are initialized in serial order, and all other devices are in parallel, using 
- *   multiple threads, one per device module.  Early testing shows this to be 
- *   reliable, but switch this off when issues are encountered during 
+ * - "ParallelDeviceInitialization" (default: enabled) When enabled, devices
+ *   are initialized in parallel, using multiple threads, as soon as their
+ *   parent hub and serial port are initialized. Devices from the
+ *   same device module are initialized one at a time. Early testing shows this
+ *   to be reliable, but switch this off when issues are encountered during
  *   device initialization.
  *
  * Permanently enabled features:
@@ -380,6 +414,14 @@ std::string CMMCore::getVersionInfo() const
 std::vector<std::string>
 CMMCore::getAvailableDevices(const char* moduleName) throw (CMMError)
 {
+   if (capabilityCache_)
+   {
+      std::vector<std::string> names;
+      for (const mm::CachedDevice& device : GetCachedAvailableDevices(moduleName))
+         names.push_back(device.name);
+      return names;
+   }
+
    std::shared_ptr<LoadedDeviceAdapter> module =
       pluginManager_->GetDeviceAdapter(moduleName);
    return module->GetAvailableDeviceNames();
@@ -393,6 +435,14 @@ CMMCore::getAvailableDeviceDescriptions(const char* moduleName) throw (CMMError)
 {
    // XXX It is a little silly that we return the list of descriptions, rather
    // than provide access to the description of each device.
+   if (capabilityCache_)
+   {
+      std::vector<std::string> descriptions;
+      for (const mm::CachedDevice& device : GetCachedAvailableDevices(moduleName))
+         descriptions.push_back(device.description);
+      return descriptions;
+   }
+
    std::shared_ptr<LoadedDeviceAdapter> module =
       pluginManager_->GetDeviceAdapter(moduleName);
    std::vector<std::string> names = module->GetAvailableDeviceNames();
@@ -414,6 +464,14 @@ CMMCore::getAvailableDeviceTypes(const char* moduleName) throw (CMMError)
 {
    // XXX It is a little silly that we return the list of types, rather than
    // provide access to the type of each device.
+   if (capabilityCache_)
+   {
+      std::vector<long> types;
+      for (const mm::CachedDevice& device : GetCachedAvailableDevices(moduleName))
+         types.push_back(device.type);
+      return types;
+   }
+
    std::shared_ptr<LoadedDeviceAdapter> module =
       pluginManager_->GetDeviceAdapter(moduleName);
    std::vector<std::string> names = module->GetAvailableDeviceNames();
@@ -428,6 +486,62 @@ CMMCore::getAvailableDeviceTypes(const char* moduleName) throw (CMMError)
    return types;
 }
 
+/**
+ * Enables a file-backed cache of the devices available in each device adapter
+ * module and of the peripherals detected by each hub.
+ *
+ * With the cache enabled, getAvailableDevices() and related functions answer
+ * from the cache without loading the module, as long as the module file is
+ * unchanged and the module has not been loaded in this session. Likewise,
+ * getInstalledDevices() answers from the cache when a hub with the same
+ * pre-initialization property values has been queried before, skipping
+ * peripheral detection. Entries for a module are discarded when the module is
+ * loaded and reports a different version, and when loading a device from it
+ * fails. A hub's peripherals are discarded when one of them fails to
+ * initialize, and can be detected again with getInstalledDevices(const char*,
+ * bool).
+ *
+ * The file is created if it does not exist, and rewritten as entries are
+ * added. The cache is disabled by default.
+ *
+ * @param filename   the cache file, or an empty string to disable the cache
+ */
+void
+CMMCore::setDeviceCapabilityCacheFile(const char* filename) throw (CMMError)
+{
+   if (!filename)
+      throw CMMError("Null filename");
+
+   if (!*filename)
+   {
+      capabilityCache_.reset();
+      LOG_INFO(coreLogger_) << "Device capability cache disabled";
+      return;
+   }
+   capabilityCache_ = std::make_shared<mm::CapabilityCache>(filename);
+   LOG_INFO(coreLogger_) << "Device capability cache file set to " << filename;
+}
+
+/**
+ * Returns the device capability cache file, or an empty string if the cache
+ * is disabled.
+ */
+std::string
+CMMCore::getDeviceCapabilityCacheFile()
+{
+   return capabilityCache_ ? capabilityCache_->GetFilename() : std::string();
+}
+
+/**
+ * Discards all entries in the device capability cache, if enabled.
+ */
+void
+CMMCore::clearDeviceCapabilityCache()
+{
+   if (capabilityCache_)
+      capabilityCache_->Clear();
+}
+
 /**
  * Returns the module and device interface versions.
  */
@@ -452,48 +566,59 @@ Configuration CMMCore::getSystemState()
    Configuration config;
    std::vector<std::string> devices = deviceManager_->GetDeviceList();
    for (std::vector<std::string>::const_iterator i = devices.begin(), dend = devices.end(); i != dend; ++i)
+      appendDeviceState(config, *i);
+
+   appendDeviceState(config, MM::g_Keyword_CoreDevice);
+   return config;
+}
+
+/*
+ * Adds the current values of all properties of a device (or the Core) to a
+ * Configuration.
+ */
+void CMMCore::appendDeviceState(Configuration& config, const std::string& label)
+{
+   if (IsCoreDeviceLabel(label.c_str()))
    {
-      std::shared_ptr<DeviceInstance> pDev = deviceManager_->GetDevice(*i);
-      mm::DeviceModuleLockGuard guard(pDev);
-      std::vector<std::string> propertyNames = pDev->GetPropertyNames();
-      for (std::vector<std::string>::const_iterator it = propertyNames.begin(), end = propertyNames.end();
-            it != end; ++it)
+      std::vector<std::string> coreProps = properties_->GetNames();
+      for (unsigned i=0; i < coreProps.size(); i++)
       {
-         std::string val;
-         try
-         {
-            val = pDev->GetProperty(*it);
-         }
-         catch (const CMMError&)
-         {
-            // XXX BUG This should not be ignored, but the interface does not
-            // allow throwing from this function. Keeping old behavior for now.
-         }
-
-         bool readOnly = false;
-         try
-         {
-            readOnly = pDev->GetPropertyReadOnly(it->c_str());
-         }
-         catch (const CMMError&)
-         {
-            // XXX BUG This should not be ignored, but the interface does not
-            // allow throwing from this function. Keeping old behavior for now.
-         }
-         config.addSetting(PropertySetting(i->c_str(), it->c_str(), val.c_str(), readOnly));
+         std::string name = coreProps[i];
+         std::string val = properties_->Get(name.c_str());
+         config.addSetting(PropertySetting(MM::g_Keyword_CoreDevice, name.c_str(), val.c_str(), properties_->IsReadOnly(name.c_str())));
       }
+      return;
    }
 
-   // add core properties
-   std::vector<std::string> coreProps = properties_->GetNames();
-   for (unsigned i=0; i < coreProps.size(); i++)
+   std::shared_ptr<DeviceInstance> pDev = deviceManager_->GetDevice(label);
+   mm::DeviceModuleLockGuard guard(pDev);
+   std::vector<std::string> propertyNames = pDev->GetPropertyNames();
+   for (std::vector<std::string>::const_iterator it = propertyNames.begin(), end = propertyNames.end();
+         it != end; ++it)
    {
-      std::string name = coreProps[i];
-      std::string val = properties_->Get(name.c_str());
-      config.addSetting(PropertySetting(MM::g_Keyword_CoreDevice, name.c_str(), val.c_str(), properties_->IsReadOnly(name.c_str())));
-   }
+      std::string val;
+      try
+      {
+         val = pDev->GetProperty(*it);
+      }
+      catch (const CMMError&)
+      {
+         // XXX BUG This should not be ignored, but the interface does not
+         // allow throwing from this function. Keeping old behavior for now.
+      }
 
-   return config;
+      bool readOnly = false;
+      try
+      {
+         readOnly = pDev->GetPropertyReadOnly(it->c_str());
+      }
+      catch (const CMMError&)
+      {
+         // XXX BUG This should not be ignored, but the interface does not
+         // allow throwing from this function. Keeping old behavior for now.
+      }
+      config.addSetting(PropertySetting(label.c_str(), it->c_str(), val.c_str(), readOnly));
+   }
 }
 
 /**
@@ -692,6 +817,9 @@ void CMMCore::loadDevice(const char* label, const char* moduleName, const char*
    {
       std::shared_ptr<LoadedDeviceAdapter> module =
          pluginManager_->GetDeviceAdapter(moduleName);
+      if (capabilityCache_)
+         capabilityCache_->Validate(moduleName, module->GetModuleVersion(),
+               module->GetDeviceInterfaceVersion());
       std::shared_ptr<DeviceInstance> pDevice =
          deviceManager_->LoadDevice(module, deviceName, label, this,
                deviceLogger, coreLogger);
@@ -699,6 +827,8 @@ void CMMCore::loadDevice(const char* label, const char* moduleName, const char*
    }
    catch (const CMMError& e)
    {
+      if (capabilityCache_)
+         capabilityCache_->Invalidate(moduleName);
       throw CMMError("Failed to load device " + ToQuotedString(deviceName) +
             " from adapter module " + ToQuotedString(moduleName),
             e);
@@ -769,6 +899,7 @@ void CMMCore::unloadDevice(const char* label///< the name of the device to unloa
    std::shared_ptr<DeviceInstance> pDevice = deviceManager_->GetDevice(label);
 
    try {
+      waitForPendingInitializations();
       mm::DeviceModuleLockGuard guard(pDevice);
       LOG_DEBUG(coreLogger_) << "Will unload device " << label;
       deviceManager_->UnloadDevice(pDevice);
@@ -787,6 +918,7 @@ void CMMCore::unloadDevice(const char* label///< the name of the device to unloa
 void CMMCore::unloadAllDevices() throw (CMMError)
 {
    try {
+      waitForPendingInitializations();
       configGroups_->Clear();
 
       //selected channel group is no longer valid
@@ -849,12 +981,43 @@ void CMMCore::reset() throw (CMMError)
 }
 
 
+namespace {
+
+std::string
+FormatTimelineEntry(const mm::InitializationRecord& record)
+{
+   using std::chrono::duration_cast;
+   using std::chrono::milliseconds;
+   return record.label + "\t" +
+      std::to_string(duration_cast<milliseconds>(record.start).count()) + "\t" +
+      std::to_string(duration_cast<milliseconds>(record.duration).count()) + "\t" +
+      mm::ToString(record.result);
+}
+
+} // anonymous namespace
+
+// Throws if a device that timed out during initialization has still not
+// returned after the Core timeout, since it must not be shut down or unloaded
+// under its Initialize()
+void CMMCore::waitForPendingInitializations() throw (CMMError)
+{
+   if (pendingInitializations_->WaitForAll(std::chrono::milliseconds(timeoutMs_)))
+      return;
+   std::vector<std::string> labels = pendingInitializations_->GetLabels();
+   if (labels.empty())
+      return;
+   throw CMMError("Cannot unload devices while device " +
+         ToQuotedString(labels.front()) + " has not finished initializing",
+         MMERR_DeviceInitializationTimeout);
+}
+
 /**
  * Calls Initialize() method for each loaded device.
  * Parallel implemnetation should be faster
  */
 void CMMCore::initializeAllDevices() throw (CMMError)
 {
+   initializationTimeline_.clear();
    if (this->isFeatureEnabled("ParallelDeviceInitialization"))
    {
       initializeAllDevicesParallel();
@@ -876,6 +1039,7 @@ void CMMCore::initializeAllDevicesSerial() throw (CMMError)
    std::vector<std::string> devices = deviceManager_->GetDeviceList();
    LOG_INFO(coreLogger_) << "Will initialize " << devices.size() << " devices";
 
+   const auto t0 = std::chrono::steady_clock::now();
    for (size_t i = 0; i < devices.size(); i++)
    {
       std::shared_ptr<DeviceInstance> pDevice;
@@ -888,7 +1052,24 @@ void CMMCore::initializeAllDevicesSerial() throw (CMMError)
       }
       mm::DeviceModuleLockGuard guard(pDevice);
       LOG_INFO(coreLogger_) << "Will initialize device " << devices[i];
-      pDevice->Initialize();
+      mm::InitializationRecord record;
+      record.label = devices[i];
+      record.result = mm::InitializationRecord::Failed;
+      record.start = std::chrono::steady_clock::now() - t0;
+      try
+      {
+         pDevice->Initialize();
+      }
+      catch (const CMMError&)
+      {
+         record.duration = std::chrono::steady_clock::now() - t0 - record.start;
+         initializationTimeline_.push_back(FormatTimelineEntry(record));
+         InvalidateCachedPeripherals(pDevice->GetParentID());
+         throw;
+      }
+      record.result = mm::InitializationRecord::Succeeded;
+      record.duration = std::chrono::steady_clock::now() - t0 - record.start;
+      initializationTimeline_.push_back(FormatTimelineEntry(record));
       LOG_INFO(coreLogger_) << "Did initialize device " << devices[i];
 
       assignDefaultRole(pDevice);
@@ -902,128 +1083,184 @@ void CMMCore::initializeAllDevicesSerial() throw (CMMError)
 
 /**
  * Calls Initialize() method for each loaded device.
- * This implementation initializes devices on separate threads, one per device module (adapter).
+ * This implementation initializes devices on multiple threads, as soon as the
+ * devices they depend on are initialized: a peripheral depends on its parent
+ * hub, and a device depends on the serial port named by its "Port" property.
+ * Devices that are neither peripherals nor have a "Port" property depend on
+ * all serial ports. Devices from the same device module (adapter) are initialized
+ * one at a time, because they share the module lock. Devices that do not
+ * finish within the initialization timeout are given up on, as are the
+ * devices that depend on a failed device.
  * This method also initializes allowed values for core properties, based
  * on the collection of loaded devices.
  */
 void CMMCore::initializeAllDevicesParallel() throw (CMMError)
 {
+   // Device initialization mostly waits on hardware, so this can exceed the
+   // number of processors
+   const unsigned maxInitializationThreads = 16;
+
    std::vector<std::string> devices = deviceManager_->GetDeviceList();
    LOG_INFO(coreLogger_) << "Will initialize " << devices.size() << " devices";
-   
-   std::map<std::shared_ptr<LoadedDeviceAdapter>, std::vector<std::pair<std::shared_ptr<DeviceInstance>, std::string>>> moduleMap;
-   std::vector<std::shared_ptr<DeviceInstance>> ports;
 
-   // first round, collect all DeviceAdapters
+   std::vector<std::shared_ptr<DeviceInstance> > pDevices;
+   std::set<std::string> ports;
    for (size_t i = 0; i < devices.size(); i++)
    {
-      std::shared_ptr<DeviceInstance> pDevice;
       try {
-         pDevice = deviceManager_->GetDevice(devices[i]);
+         pDevices.push_back(deviceManager_->GetDevice(devices[i]));
       }
       catch (CMMError& err) {
          logError(devices[i].c_str(), err.getMsg().c_str());
          throw;
       }
-      if (pDevice->GetType() == MM::SerialDevice)
+      if (pDevices.back()->GetType() == MM::SerialDevice)
+         ports.insert(devices[i]);
+   }
+
+   mm::InitializationScheduler scheduler(coreLogger_);
+   for (size_t i = 0; i < devices.size(); i++)
+   {
+      std::shared_ptr<DeviceInstance> pDevice = pDevices[i];
+      std::vector<std::string> dependencies;
+      if (pDevice->GetType() != MM::SerialDevice)
       {
-         ports.push_back(pDevice);
+         mm::DeviceModuleLockGuard guard(pDevice);
+         std::string parent = pDevice->GetParentID();
+         if (!parent.empty())
+            dependencies.push_back(parent);
+         if (pDevice->HasProperty(MM::g_Keyword_Port))
+            dependencies.push_back(pDevice->GetProperty(MM::g_Keyword_Port));
+         else if (parent.empty())
+            // May name its port in a differently named property
+            dependencies.insert(dependencies.end(), ports.begin(), ports.end());
       }
-      else {
-         std::shared_ptr<LoadedDeviceAdapter> pAdapter;
-         pAdapter = pDevice->GetAdapterModule();
 
-         if (moduleMap.find(pAdapter) == moduleMap.end())
-         {
-            std::vector<std::pair<std::shared_ptr<DeviceInstance>, std::string>> pDevices;
-            pDevices.push_back(make_pair(pDevice, devices[i]));
-            moduleMap.insert({ pAdapter, pDevices });
-         }
-         else
-         {
-            moduleMap.find(pAdapter)->second.push_back(make_pair(pDevice, devices[i]));
-         }
-      }
+      // Captures only the device and the pending set, since it may outlive
+      // this call if it times out
+      std::shared_ptr<mm::PendingInitializations> pending =
+         pendingInitializations_;
+      const std::string label = devices[i];
+      pending->Add(label);
+      scheduler.Add(label, pDevice->GetAdapterModule().get(),
+            dependencies, [pDevice, pending, label] {
+               try
+               {
+                  mm::DeviceModuleLockGuard guard(pDevice);
+                  pDevice->Initialize();
+               }
+               catch (...)
+               {
+                  pending->Remove(label);
+                  throw;
+               }
+               pending->Remove(label);
+            });
    }
 
-   // Initialize ports first.  This should be fast, so no need to go parallel (also could not hurt really)
-   for (std::shared_ptr<DeviceInstance> pPort : ports)
+   std::vector<mm::InitializationRecord> records = scheduler.Run(
+         maxInitializationThreads,
+         std::chrono::milliseconds(initializationTimeoutMs_));
+
+   // Only the devices that timed out can still be running (skipped ones
+   // never started)
+   for (size_t i = 0; i < records.size(); i++)
    {
-      mm::DeviceModuleLockGuard guard(pPort);
-      LOG_INFO(coreLogger_) << "Will initialize device " << pPort->GetLabel();
-      pPort->Initialize();
-      LOG_INFO(coreLogger_) << "Did initialize device " << pPort->GetLabel();
+      if (records[i].result != mm::InitializationRecord::TimedOut)
+         pendingInitializations_->Remove(devices[i]);
    }
 
-   // second round, spin up threads to initialize non-port devices, one thread per module
-   std::vector<std::future<int>> futures;
-   std::map<std::shared_ptr<LoadedDeviceAdapter>, std::vector<std::pair<std::shared_ptr<DeviceInstance>, std::string>>>::iterator it;
-   for (it = moduleMap.begin(); it != moduleMap.end(); it++)
+   // The hardware attached to the hub of a failed peripheral may no longer
+   // match the hub's cached peripherals
+   if (capabilityCache_)
    {
-      auto f = std::async(std::launch::async, &CMMCore::initializeVectorOfDevices, this, it->second);
-      futures.push_back(std::move(f));
-   }
-   for (int i = 0; i < futures.size(); i++) {
-      // Note: we could do a 'f.wait_for(std::chrono::seconds(20)' to wait up to 20 seconds before giving up
-      // which would avoid hanging with devices that hang in their initialize function
-      try
-      {
-         futures[i].get();
-      }
-      catch (...)
+      for (size_t i = 0; i < records.size(); i++)
       {
-         std::exception_ptr pex = std::current_exception();
-         // The std::future returned by std::async is special and its destructor blocks until the future completes.
-         // This is okay if there are 0 or 1 errors total(the successful initializations run to completion and the exception is propagated).
-         // When there are 2 or more errors, however, the second exception would be thrown in the destructor of the future, 
-         // and throwing anything in a destructor is very bad(might terminate by default).
-         for (int j = i + 1; j < futures.size(); j++)
+         if (records[i].result != mm::InitializationRecord::Failed)
+            continue;
+         std::string parent;
          {
-            try
-            {
-               futures[j].get();
-            }
-            catch (std::exception exj) {
-               // ignore these exceptions;
-            }
+            mm::DeviceModuleLockGuard guard(pDevices[i]);
+            parent = pDevices[i]->GetParentID();
          }
-         // Rethrow the first exception
-         std::rethrow_exception(pex);
+         InvalidateCachedPeripherals(parent);
       }
    }
 
+   std::vector<mm::InitializationRecord> timeline = records;
+   std::stable_sort(timeline.begin(), timeline.end(),
+         [](const mm::InitializationRecord& a, const mm::InitializationRecord& b)
+         {
+            // Skipped devices, which never started, go last
+            if ((a.result == mm::InitializationRecord::Skipped) !=
+                  (b.result == mm::InitializationRecord::Skipped))
+               return b.result == mm::InitializationRecord::Skipped;
+            return a.start < b.start;
+         });
+   LOG_INFO(coreLogger_) << "Device initialization timeline " <<
+      "(label, start ms, duration ms, result):";
+   for (size_t i = 0; i < timeline.size(); i++)
+   {
+      initializationTimeline_.push_back(FormatTimelineEntry(timeline[i]));
+      LOG_INFO(coreLogger_) << "  " << initializationTimeline_.back();
+   }
+
    // assign default roles syncronously
-   for (it = moduleMap.begin(); it != moduleMap.end(); it++)
+   std::vector<std::string> notInitialized;
+   const mm::InitializationRecord* firstProblem = 0;
+   const mm::InitializationRecord* firstSkipped = 0;
+   for (size_t i = 0; i < records.size(); i++)
    {
-      std::vector<std::pair<std::shared_ptr<DeviceInstance>, std::string>> pDevices = it->second;
-      for (int i = 0; i < pDevices.size(); i++)
+      if (records[i].result == mm::InitializationRecord::Succeeded)
       {
-         assignDefaultRole(pDevices[i].first);
+         assignDefaultRole(pDevices[i]);
+         continue;
       }
+      notInitialized.push_back(devices[i]);
+      if (records[i].result == mm::InitializationRecord::Skipped)
+      {
+         if (!firstSkipped)
+            firstSkipped = &records[i];
+      }
+      else if (!firstProblem)
+         firstProblem = &records[i];
    }
-   LOG_INFO(coreLogger_) << "Finished initializing " << devices.size() << " devices";
+   LOG_INFO(coreLogger_) << "Finished initializing " <<
+      (devices.size() - notInitialized.size()) << " of " << devices.size() <<
+      " devices";
 
    updateCoreProperties();
-   // not sure if this cleanup is needed, but should not hurt:
-   moduleMap.clear();
-   ports.clear();
-}
 
+   if (notInitialized.empty())
+      return;
 
-/**
- * This helper function is executed by a single thread, allowing initializeAllDevices to operate multi-threaded.
- * All devices are supposed to originate from the same device adapter
- */
-int CMMCore::initializeVectorOfDevices(std::vector<std::pair<std::shared_ptr<DeviceInstance>, std::string>> pDevices) {
-   for (int i = 0; i < pDevices.size(); i++) {
-      std::shared_ptr<DeviceInstance> pDevice = pDevices[i].first;
-
-      mm::DeviceModuleLockGuard guard(pDevice);
-      LOG_INFO(coreLogger_) << "Will initialize device " << pDevices[i].second;
-      pDevice->Initialize();
-      LOG_INFO(coreLogger_) << "Did initialize device " << pDevices[i].second;
+   std::string msg = "Failed to initialize " +
+      std::to_string(notInitialized.size()) + " of " +
+      std::to_string(devices.size()) + " devices (";
+   for (size_t i = 0; i < notInitialized.size(); i++)
+      msg += (i > 0 ? ", " : "") + notInitialized[i];
+   msg += ")";
+
+   // Only a dependency cycle skips devices without any failing
+   if (!firstProblem)
+      throw CMMError(msg + ": " + firstSkipped->label + ": " +
+            firstSkipped->message);
+   if (firstProblem->result == mm::InitializationRecord::TimedOut)
+      throw CMMError(msg, MMERR_DeviceInitializationTimeout,
+            CMMError("Device " + ToQuotedString(firstProblem->label) + ": " +
+               firstProblem->message, MMERR_DeviceInitializationTimeout));
+   try
+   {
+      std::rethrow_exception(firstProblem->error);
+   }
+   catch (const CMMError& err)
+   {
+      throw CMMError(msg, err.getCode(), err);
+   }
+   catch (...)
+   {
+      throw CMMError(msg + ": " + firstProblem->message);
    }
-   return DEVICE_OK;
 }
 
 /**
@@ -1071,7 +1308,15 @@ void CMMCore::initializeDevice(const char* label ///< the device to initialize
    mm::DeviceModuleLockGuard guard(pDevice);
 
    LOG_INFO(coreLogger_) << "Will initialize device " << label;
-   pDevice->Initialize();
+   try
+   {
+      pDevice->Initialize();
+   }
+   catch (const CMMError&)
+   {
+      InvalidateCachedPeripherals(pDevice->GetParentID());
+      throw;
+   }
    LOG_INFO(coreLogger_) << "Did initialize device " << label;
 
    updateCoreProperties();
@@ -1100,6 +1345,168 @@ CMMCore::getDeviceInitializationState(const char* label) const throw (CMMError)
    return DeviceInitializationState::Uninitialized;
 }
 
+/**
+ * Sets how long initializeAllDevices() waits for each device to initialize.
+ *
+ * A device that takes longer is reported as failed and its initialization is
+ * abandoned (it keeps running in the background), as is the initialization of
+ * devices depending on it and of the other devices from its device adapter.
+ * Only applies when the "ParallelDeviceInitialization" feature is enabled.
+ * Also available as the Core property "InitializationTimeoutMs".
+ *
+ * @param timeoutMs the timeout per device, or 0 (the default) to wait
+ * indefinitely
+ */
+void CMMCore::setDeviceInitializationTimeoutMs(long timeoutMs) throw (CMMError)
+{
+   if (timeoutMs < 0)
+      throw CMMError("Negative initialization timeout", MMERR_InvalidContents);
+   initializationTimeoutMs_ = timeoutMs;
+   properties_->Set(MM::g_Keyword_CoreInitializationTimeoutMs,
+         CDeviceUtils::ConvertToString(timeoutMs));
+}
+
+/**
+ * Returns the per-device initialization timeout, or 0 if there is none.
+ */
+long CMMCore::getDeviceInitializationTimeoutMs()
+{
+   return initializationTimeoutMs_;
+}
+
+/**
+ * Returns when each device was initialized by the last call to
+ * initializeAllDevices().
+ *
+ * Each entry has four tab-separated fields: the device label, the start time
+ * relative to the start of initialization in milliseconds, the duration in
+ * milliseconds, and the result: "Succeeded", "Failed", "TimedOut", or
+ * "Skipped" (not attempted because a device it depends on was not
+ * initialized). Entries are in order of start time; skipped devices are
+ * last.
+ */
+std::vector<std::string> CMMCore::getDeviceInitializationTimeline()
+{
+   return initializationTimeline_;
+}
+
+/**
+ * Returns the number of threads in the Core's thread pool.
+ *
+ * The pool runs the Core's own parallel work, such as copying images into the
+ * circular buffer, and the work that device adapters submit through
+ * MM::Core::RunInParallel(). Its size is the number of hardware threads.
+ */
+unsigned CMMCore::getThreadPoolSize()
+{
+   return static_cast<unsigned>(threadPool_->GetSize());
+}
+
+/**
+ * Restricts the threads of the Core's thread pool to the given CPUs.
+ *
+ * This can be used to keep image copying off the CPUs that a camera driver
+ * uses. Supported on Linux and Windows (CPUs 0 to 63 only).
+ *
+ * @param cpus the CPU numbers, starting from 0, or an empty vector to allow
+ * all CPUs
+ */
+void CMMCore::setThreadPoolAffinity(const std::vector<long>& cpus) throw (CMMError)
+{
+   std::vector<unsigned> cpuNumbers;
+   for (long cpu : cpus)
+   {
+      if (cpu < 0)
+         throw CMMError("Negative CPU number", MMERR_InvalidContents);
+      cpuNumbers.push_back(static_cast<unsigned>(cpu));
+   }
+   if (!threadPool_->SetAffinity(cpuNumbers))
+      throw CMMError("Cannot set the CPU affinity of the thread pool");
+   if (cpus.empty())
+      LOG_INFO(coreLogger_) << "Thread pool allowed to run on all CPUs";
+   else
+      LOG_INFO(coreLogger_) << "Thread pool restricted to " << cpus.size() <<
+         " CPUs";
+}
+
+/**
+ * Sets the scheduling priority for the threads in which cameras acquire
+ * images.
+ *
+ * Real-time priority keeps the intervals between frames steady when the
+ * computer is busy with other work, at the expense of that work. On Linux and
+ * macOS it usually requires privileges (e.g. CAP_SYS_NICE or an rtprio limit
+ * on Linux); without them the threads run with normal priority. The setting
+ * applies to sequence acquisitions started afterwards, by cameras that support
+ * it. Also available as the Core property "AcquisitionThreadPriority".
+ *
+ * @param priority 0 (the default) for normal scheduling, or a real-time
+ * priority from 1 (lowest) to 99 (highest)
+ */
+void CMMCore::setAcquisitionThreadPriority(long priority) throw (CMMError)
+{
+   if (priority < 0 || priority > 99)
+      throw CMMError("Acquisition thread priority must be from 0 to 99",
+            MMERR_InvalidContents);
+   acquisitionThreadPriority_ = priority;
+   properties_->Set(MM::g_Keyword_CoreAcquisitionThreadPriority,
+         CDeviceUtils::ConvertToString(priority));
+   LOG_INFO(coreLogger_) << "Acquisition thread priority set to " << priority;
+}
+
+/**
+ * Returns the acquisition thread priority; 0 means normal scheduling.
+ */
+long CMMCore::getAcquisitionThreadPriority()
+{
+   return acquisitionThreadPriority_;
+}
+
+/**
+ * Restricts the threads in which cameras acquire images to the given CPUs.
+ *
+ * Together with operating system settings that keep other work off those
+ * CPUs (e.g. isolcpus on Linux), this keeps the acquisition threads from
+ * being delayed by other threads. Supported on Linux and Windows. The setting
+ * applies to sequence acquisitions started afterwards, by cameras that support
+ * it. Also available as the Core property "AcquisitionThreadCPUs", with a
+ * value such as "2-3 6".
+ *
+ * @param cpus the CPU numbers, from 0 to 63, or an empty vector (the default)
+ * to allow all CPUs
+ */
+void CMMCore::setAcquisitionThreadCPUs(const std::vector<long>& cpus) throw (CMMError)
+{
+   unsigned long long mask = 0;
+   for (long cpu : cpus)
+   {
+      if (cpu < 0 || cpu > 63)
+         throw CMMError("Acquisition thread CPU numbers must be from 0 to 63",
+               MMERR_InvalidContents);
+      mask |= 1ULL << cpu;
+   }
+   acquisitionThreadCPUMask_ = mask;
+   const std::string cpuList = FormatCPUList(cpus);
+   properties_->Set(MM::g_Keyword_CoreAcquisitionThreadCPUs, cpuList.c_str());
+   LOG_INFO(coreLogger_) << "Acquisition thread CPUs set to " <<
+      (cpuList.empty() ? std::string("all") : cpuList);
+}
+
+/**
+ * Returns the CPUs allowed for acquisition threads; empty means all CPUs.
+ */
+std::vector<long> CMMCore::getAcquisitionThreadCPUs()
+{
+   const unsigned long long mask = acquisitionThreadCPUMask_;
+   std::vector<long> cpus;
+   for (long cpu = 0; cpu < 64; ++cpu)
+   {
+      if (mask & (1ULL << cpu))
+         cpus.push_back(cpu);
+   }
+   return cpus;
+}
+
 
 
 /**
@@ -2677,7 +3084,8 @@ bool CMMCore::getShutterOpen() throw (CMMError)
  * (see: https://en.wikipedia.org/wiki/RGBA_color_model).
  *
  * @return a pointer to the internal image buffer.
- * @throws CMMError   when the camera returns no data
+ * @throws CMMError   when the camera returns no data, or when the image
+ *                    processor consumes the image
  */
 void* CMMCore::getImage() throw (CMMError)
 {
@@ -2714,7 +3122,10 @@ void* CMMCore::getImage() throw (CMMError)
             currentImageProcessor_.lock();
          if (imageProcessor)
 	      {
-            imageProcessor->Process((unsigned char*)pBuf, camera->GetImageWidth(),  camera->GetImageHeight(), camera->GetImageBytesPerPixel() );
+            // As for images the camera inserts, a consumed image (e.g. one
+            // taken into an average) is not passed on
+            if (imageProcessor->Process((unsigned char*)pBuf, camera->GetImageWidth(),  camera->GetImageHeight(), camera->GetImageBytesPerPixel() ) == DEVICE_IMAGE_CONSUMED)
+               throw CMMError(getCoreErrorText(MMERR_ImageConsumedByProcessor).c_str(), MMERR_ImageConsumedByProcessor);
 	      }
 		} catch( CMMError& e){
 			throw e;
@@ -2761,7 +3172,10 @@ void* CMMCore::getImage(unsigned channelNr) throw (CMMError)
             currentImageProcessor_.lock();
          if (imageProcessor)
 	      {
-            imageProcessor->Process((unsigned char*)pBuf, camera->GetImageWidth(),  camera->GetImageHeight(), camera->GetImageBytesPerPixel() );
+            // As for images the camera inserts, a consumed image (e.g. one
+            // taken into an average) is not passed on
+            if (imageProcessor->Process((unsigned char*)pBuf, camera->GetImageWidth(),  camera->GetImageHeight(), camera->GetImageBytesPerPixel() ) == DEVICE_IMAGE_CONSUMED)
+               throw CMMError(getCoreErrorText(MMERR_ImageConsumedByProcessor).c_str(), MMERR_ImageConsumedByProcessor);
 	      }
 		} catch( CMMError& e){
 			throw e;
@@ -2830,7 +3244,7 @@ void CMMCore::startSequenceAcquisition(long numImages, double intervalMs, bool s
 
 		try
 		{
-			if (!cbuf_->Initialize(camera->GetNumberOfChannels(), camera->GetImageWidth(), camera->GetImageHeight(), camera->GetImageBytesPerPixel()))
+			if (!cbuf_->Initialize(camera->GetNumberOfChannels(), camera->GetImageWidth(), camera->GetImageHeight(), camera->GetImageBytesPerPixel(), camera->GetBitDepth()))
 			{
 				logError(getDeviceName(camera).c_str(), getCoreErrorText(MMERR_CircularBufferFailedToInitialize).c_str());
 				throw CMMError(getCoreErrorText(MMERR_CircularBufferFailedToInitialize).c_str(), MMERR_CircularBufferFailedToInitialize);
@@ -2874,7 +3288,7 @@ void CMMCore::startSequenceAcquisition(const char* label, long numImages, double
       throw CMMError(getCoreErrorText(MMERR_NotAllowedDuringSequenceAcquisition).c_str(),
                      MMERR_NotAllowedDuringSequenceAcquisition);
 
-   if (!cbuf_->Initialize(pCam->GetNumberOfChannels(), pCam->GetImageWidth(), pCam->GetImageHeight(), pCam->GetImageBytesPerPixel()))
+   if (!cbuf_->Initialize(pCam->GetNumberOfChannels(), pCam->GetImageWidth(), pCam->GetImageHeight(), pCam->GetImageBytesPerPixel(), pCam->GetBitDepth()))
    {
       logError(getDeviceName(pCam).c_str(), getCoreErrorText(MMERR_CircularBufferFailedToInitialize).c_str());
       throw CMMError(getCoreErrorText(MMERR_CircularBufferFailedToInitialize).c_str(), MMERR_CircularBufferFailedToInitialize);
@@ -2925,7 +3339,7 @@ void CMMCore::initializeCircularBuffer() throw (CMMError)
    if (camera)
    {
       mm::DeviceModuleLockGuard guard(camera);
-      if (!cbuf_->Initialize(camera->GetNumberOfChannels(), camera->GetImageWidth(), camera->GetImageHeight(), camera->GetImageBytesPerPixel()))
+      if (!cbuf_->Initialize(camera->GetNumberOfChannels(), camera->GetImageWidth(), camera->GetImageHeight(), camera->GetImageBytesPerPixel(), camera->GetBitDepth()))
       {
          logError(getDeviceName(camera).c_str(), getCoreErrorText(MMERR_CircularBufferFailedToInitialize).c_str());
          throw CMMError(getCoreErrorText(MMERR_CircularBufferFailedToInitialize).c_str(), MMERR_CircularBufferFailedToInitialize);
@@ -2977,7 +3391,7 @@ void CMMCore::startContinuousSequenceAcquisition(double intervalMs) throw (CMMEr
             ,MMERR_NotAllowedDuringSequenceAcquisition);
       }
 
-      if (!cbuf_->Initialize(camera->GetNumberOfChannels(), camera->GetImageWidth(), camera->GetImageHeight(), camera->GetImageBytesPerPixel()))
+      if (!cbuf_->Initialize(camera->GetNumberOfChannels(), camera->GetImageWidth(), camera->GetImageHeight(), camera->GetImageBytesPerPixel(), camera->GetBitDepth()))
       {
          logError(getDeviceName(camera).c_str(), getCoreErrorText(MMERR_CircularBufferFailedToInitialize).c_str());
          throw CMMError(getCoreErrorText(MMERR_CircularBufferFailedToInitialize).c_str(), MMERR_CircularBufferFailedToInitialize);
@@ -3097,7 +3511,7 @@ void* CMMCore::getLastImageMD(unsigned channel, unsigned slice, Metadata& md) co
    const mm::ImgBuffer* pBuf = cbuf_->GetTopImageBuffer(channel);
    if (pBuf != 0)
    {
-      md = pBuf->GetMetadata();
+      pBuf->GetMetadata(md);
       return const_cast<unsigned char*>(pBuf->GetPixels());
    }
    else
@@ -3138,7 +3552,7 @@ void* CMMCore::getNBeforeLastImageMD(unsigned long n, Metadata& md) const throw
    const mm::ImgBuffer* pBuf = cbuf_->GetNthFromTopImageBuffer(n);
    if (pBuf != 0)
    {
-      md = pBuf->GetMetadata();
+      pBuf->GetMetadata(md);
       return const_cast<unsigned char*>(pBuf->GetPixels());
    }
    else
@@ -3180,7 +3594,7 @@ void* CMMCore::popNextImageMD(unsigned channel, unsigned slice, Metadata& md) th
    const mm::ImgBuffer* pBuf = cbuf_->GetNextImageBuffer(channel);
    if (pBuf != 0)
    {
-      md = pBuf->GetMetadata();
+      pBuf->GetMetadata(md);
       return const_cast<unsigned char*>(pBuf->GetPixels());
    }
    else
@@ -3195,6 +3609,219 @@ void* CMMCore::popNextImageMD(Metadata& md) throw (CMMError)
    return popNextImageMD(0, 0, md);
 }
 
+/**
+ * Copies the pixels of the last snapped image into a caller-supplied buffer.
+ *
+ * Unlike getImage(), no memory is allocated for the copy, so the caller can
+ * reuse its buffers from frame to frame.
+ *
+ * @param buffer        the destination
+ * @param bufferSize    the size of the destination, in bytes
+ * @return the number of bytes copied
+ */
+unsigned long CMMCore::getImageInto(void* buffer,
+      unsigned long bufferSize) throw (CMMError)
+{
+   return getImageInto(0, buffer, bufferSize);
+}
+
+/**
+ * Copies the pixels of one channel of the last snapped image into a
+ * caller-supplied buffer.
+ *
+ * @param cameraChannelIndex  the camera channel
+ * @param buffer              the destination
+ * @param bufferSize          the size of the destination, in bytes
+ * @return the number of bytes copied
+ */
+unsigned long CMMCore::getImageInto(unsigned cameraChannelIndex, void* buffer,
+      unsigned long bufferSize) throw (CMMError)
+{
+   const unsigned long imageSize = getImageBufferSize();
+   CheckImageDestination(buffer, bufferSize, imageSize);
+   const void* pixels = getImage(cameraChannelIndex);
+   std::memcpy(buffer, pixels, imageSize);
+   return imageSize;
+}
+
+/**
+ * Copies the pixels of the image last inserted into the circular buffer
+ * into a caller-supplied buffer, and provides its metadata.
+ *
+ * @param buffer        the destination
+ * @param bufferSize    the size of the destination, in bytes
+ * @param md            receives the image metadata
+ * @return the number of bytes copied
+ */
+unsigned long CMMCore::getLastImageInto(void* buffer, unsigned long bufferSize,
+      Metadata& md) throw (CMMError)
+{
+   const mm::ImgBuffer* pBuf = cbuf_->GetTopImageBuffer(0);
+   if (pBuf == 0)
+      throw CMMError(getCoreErrorText(MMERR_CircularBufferEmpty).c_str(), MMERR_CircularBufferEmpty);
+   return CopyImageInto(*pBuf, buffer, bufferSize, md);
+}
+
+/**
+ * Gets and removes the next image from the circular buffer, copying its
+ * pixels into a caller-supplied buffer and providing its metadata.
+ *
+ * The image is not removed if the buffer is too small for it.
+ *
+ * @param buffer        the destination
+ * @param bufferSize    the size of the destination, in bytes
+ * @param md            receives the image metadata
+ * @return the number of bytes copied
+ */
+unsigned long CMMCore::popNextImageInto(void* buffer, unsigned long bufferSize,
+      Metadata& md) throw (CMMError)
+{
+   return popNextImageInto(0, buffer, bufferSize, md);
+}
+
+/**
+ * Gets and removes the next image of a camera channel from the circular
+ * buffer, copying its pixels into a caller-supplied buffer and providing its
+ * metadata.
+ *
+ * The image is not removed if the buffer is too small for it.
+ *
+ * @param channel       the camera channel
+ * @param buffer        the destination
+ * @param bufferSize    the size of the destination, in bytes
+ * @param md            receives the image metadata
+ * @return the number of bytes copied
+ */
+unsigned long CMMCore::popNextImageInto(unsigned channel, void* buffer,
+      unsigned long bufferSize, Metadata& md) throw (CMMError)
+{
+   CheckImageDestination(buffer, bufferSize,
+         static_cast<unsigned long>(cbuf_->ImageSize()));
+   // The slot stays held until the copy is done, and the image is left in
+   // place if it does not fit
+   std::vector<Metadata> mdVec;
+   std::size_t imageSize = 0;
+   if (cbuf_->PopNextImages(channel, 1, static_cast<unsigned char*>(buffer),
+            bufferSize, &mdVec, &imageSize) == 0)
+   {
+      // The circular buffer may have been reinitialized since it was checked
+      CheckImageDestination(buffer, bufferSize,
+            static_cast<unsigned long>(cbuf_->ImageSize()));
+      throw CMMError(getCoreErrorText(MMERR_CircularBufferEmpty).c_str(), MMERR_CircularBufferEmpty);
+   }
+   md = mdVec.front();
+   return static_cast<unsigned long>(imageSize);
+}
+
+/**
+ * Gets and removes up to maxCount images from the circular buffer in one
+ * call, copying their pixels one after another into a caller-supplied buffer.
+ *
+ * This avoids the per-image overhead of popNextImage() (and, from the
+ * language wrappers, of a call per image) when images are small and
+ * frequent. Image i occupies bytes [i * size, (i + 1) * size), where size is
+ * the size of one image (see getImageBufferSize()). No more images are
+ * removed than fit in the buffer. Unlike popNextImage(), an empty circular
+ * buffer is not an error.
+ *
+ * @param maxCount      the maximum number of images to remove
+ * @param buffer        the destination
+ * @param bufferSize    the size of the destination, in bytes
+ * @return the number of images removed
+ */
+unsigned long CMMCore::popNextImages(unsigned long maxCount, void* buffer,
+      unsigned long bufferSize) throw (CMMError)
+{
+   CheckImageDestination(buffer, bufferSize,
+         static_cast<unsigned long>(cbuf_->ImageSize()));
+   return cbuf_->PopNextImages(0, maxCount,
+         static_cast<unsigned char*>(buffer), bufferSize, 0);
+}
+
+/**
+ * Gets and removes up to maxCount images from the circular buffer in one
+ * call, copying their pixels into a caller-supplied buffer and providing
+ * their metadata.
+ *
+ * See popNextImages(unsigned long, void*, unsigned long).
+ *
+ * @param maxCount      the maximum number of images to remove
+ * @param buffer        the destination
+ * @param bufferSize    the size of the destination, in bytes
+ * @param md            replaced with the metadata of each image removed
+ * @return the number of images removed
+ */
+unsigned long CMMCore::popNextImages(unsigned long maxCount, void* buffer,
+      unsigned long bufferSize, std::vector<Metadata>& md) throw (CMMError)
+{
+   return popNextImages(0, maxCount, buffer, bufferSize, md);
+}
+
+/**
+ * Gets and removes up to maxCount images from the circular buffer in one
+ * call, copying the pixels of one camera channel of each into a
+ * caller-supplied buffer and providing their metadata.
+ *
+ * See popNextImages(unsigned long, void*, unsigned long).
+ *
+ * @param channel       the camera channel
+ * @param maxCount      the maximum number of images to remove
+ * @param buffer        the destination
+ * @param bufferSize    the size of the destination, in bytes
+ * @param md            replaced with the metadata of each image removed
+ * @return the number of images removed
+ */
+unsigned long CMMCore::popNextImages(unsigned channel, unsigned long maxCount,
+      void* buffer, unsigned long bufferSize,
+      std::vector<Metadata>& md) throw (CMMError)
+{
+   CheckImageDestination(buffer, bufferSize,
+         static_cast<unsigned long>(cbuf_->ImageSize()));
+   md.clear();
+   return cbuf_->PopNextImages(channel, maxCount,
+         static_cast<unsigned char*>(buffer), bufferSize, &md);
+}
+
+/**
+ * Returns the tags of an image as a JSON object.
+ *
+ * The tags combine the image metadata, the system state cache (as
+ * "<label>-<property>" tags) and the standard tags describing the current
+ * camera, pixel size and channel, in increasing order of precedence. This is
+ * the tag set of a TaggedImage, assembled without a call into the Core for
+ * each tag. The system state part is encoded once and reused for as long as
+ * the system state cache is unchanged.
+ *
+ * The camera binning is taken from the system state cache when present,
+ * otherwise it is read from the camera.
+ *
+ * @param md                         the image metadata
+ * @param includeSystemStateCache    whether to include the system state cache
+ */
+std::string CMMCore::getTaggedImageTags(const Metadata& md,
+      bool includeSystemStateCache) throw (CMMError)
+{
+   return GetImageTagsJSON(md, 0, includeSystemStateCache);
+}
+
+/**
+ * Returns the tags of an image from a multi-channel camera as a JSON object.
+ *
+ * In addition to the tags returned by getTaggedImageTags(const Metadata&,
+ * bool), sets CameraChannelIndex and ChannelIndex unless the image already
+ * has a CameraChannelIndex tag, and sets Camera and Channel to the physical
+ * camera of the channel unless the image already has a Camera tag.
+ *
+ * @param md                         the image metadata
+ * @param cameraChannelIndex         the camera channel of the image
+ * @param includeSystemStateCache    whether to include the system state cache
+ */
+std::string CMMCore::getTaggedImageTags(const Metadata& md,
+      unsigned cameraChannelIndex, bool includeSystemStateCache) throw (CMMError)
+{
+   return GetImageTagsJSON(md, &cameraChannelIndex, includeSystemStateCache);
+}
+
 /**
  * Removes all images from the circular buffer.
  *
@@ -3217,7 +3844,7 @@ void CMMCore::setCircularBufferMemoryFootprint(unsigned sizeMB ///< n megabytes
       sizeMB << " MB";
 	try
 	{
-		cbuf_ = new CircularBuffer(sizeMB);
+		cbuf_ = new CircularBuffer(sizeMB, threadPool_);
 	}
 	catch (std::bad_alloc& ex)
 	{
@@ -3227,6 +3854,8 @@ void CMMCore::setCircularBufferMemoryFootprint(unsigned sizeMB ///< n megabytes
 		throw CMMError(messs.str().c_str() , MMERR_OutOfMemory);
 	}
 	if (NULL == cbuf_) throw CMMError(getCoreErrorText(MMERR_OutOfMemory).c_str(), MMERR_OutOfMemory);
+   cbuf_->SetFrameStatistics(frameStatisticsEnabled_, frameStatisticsBins_);
+   cbuf_->SetPacking(circularBufferPacking_);
 
 
 	try
@@ -3237,7 +3866,7 @@ void CMMCore::setCircularBufferMemoryFootprint(unsigned sizeMB ///< n megabytes
       if (camera)
 		{
          mm::DeviceModuleLockGuard guard(camera);
-         if (!cbuf_->Initialize(camera->GetNumberOfChannels(), camera->GetImageWidth(), camera->GetImageHeight(), camera->GetImageBytesPerPixel()))
+         if (!cbuf_->Initialize(camera->GetNumberOfChannels(), camera->GetImageWidth(), camera->GetImageHeight(), camera->GetImageBytesPerPixel(), camera->GetBitDepth()))
 				throw CMMError(getCoreErrorText(MMERR_CircularBufferFailedToInitialize).c_str(), MMERR_CircularBufferFailedToInitialize);
 		}
 
@@ -3254,6 +3883,149 @@ void CMMCore::setCircularBufferMemoryFootprint(unsigned sizeMB ///< n megabytes
       throw CMMError(getCoreErrorText(MMERR_OutOfMemory).c_str(), MMERR_OutOfMemory);
 }
 
+/**
+ * Enables or disables packed storage of images in the circular buffer.
+ *
+ * When enabled, 16-bit images from cameras reporting a bit depth of 10 or
+ * less are stored in the Mono10p layout (10 bits per pixel), and those with
+ * a bit depth of 11 or 12 in the Mono12p layout (12 bits per pixel), so
+ * that 60% or 33% more images fit in the same memory footprint. Images with
+ * pixel values exceeding the bit depth are rejected, and the camera is told
+ * that the image is incompatible. Images are unpacked when they are
+ * retrieved; the pointers returned by getLastImage(), popNextImage() and
+ * related functions then refer to a buffer kept for the calling thread,
+ * which is reused at that thread's next retrieval, so the pixels should be
+ * copied before the same thread retrieves further images.
+ *
+ * The setting takes effect the next time the buffer is initialized (for
+ * example when a sequence acquisition is started).
+ *
+ * @param enable  true to store eligible images packed
+ */
+void CMMCore::enableCircularBufferPacking(bool enable)
+{
+   circularBufferPacking_ = enable;
+   cbuf_->SetPacking(circularBufferPacking_);
+   LOG_DEBUG(coreLogger_) << "Circular buffer packing " <<
+      (enable ? "enabled" : "disabled");
+}
+
+/**
+ * Returns whether eligible images are stored packed in the circular buffer.
+ */
+bool CMMCore::isCircularBufferPackingEnabled()
+{
+   return circularBufferPacking_;
+}
+
+/**
+ * Enables or disables computation of frame statistics for images inserted
+ * into the circular buffer.
+ *
+ * When enabled, the minimum, maximum, mean, number of saturated pixels and a
+ * histogram are computed while each frame is copied into the buffer, and
+ * are attached to the image metadata (tags Statistics-Min, Statistics-Max,
+ * Statistics-Mean, Statistics-SaturatedPixels, Statistics-BitDepth and
+ * Statistics-Histogram, the latter a comma-separated list of bin counts).
+ * The statistics can thus be read with getLastImageMD() or popNextImageMD()
+ * without touching the pixels.
+ *
+ * Saturation and the histogram range are based on the camera bit depth at
+ * the time the sequence acquisition was started. Only single-component 8-
+ * and 16-bit images are supported; other pixel types are stored without
+ * statistics.
+ *
+ * @param enable  true to compute frame statistics
+ */
+void CMMCore::enableFrameStatistics(bool enable)
+{
+   frameStatisticsEnabled_ = enable;
+   cbuf_->SetFrameStatistics(frameStatisticsEnabled_, frameStatisticsBins_);
+   LOG_DEBUG(coreLogger_) << "Frame statistics " <<
+      (enable ? "enabled" : "disabled");
+}
+
+/**
+ * Returns whether frame statistics are computed for images inserted into
+ * the circular buffer.
+ */
+bool CMMCore::isFrameStatisticsEnabled()
+{
+   return frameStatisticsEnabled_;
+}
+
+/**
+ * Sets the number of histogram bins used for frame statistics.
+ *
+ * The bins evenly divide the range of the camera bit depth. If the number of
+ * bins exceeds the number of possible pixel values, one bin per value is
+ * used.
+ *
+ * @param bins  number of bins; must be a power of 2 between 1 and 65536
+ */
+void CMMCore::setFrameStatisticsHistogramBins(unsigned bins) throw (CMMError)
+{
+   if (bins == 0 || bins > 65536 || (bins & (bins - 1)) != 0)
+      throw CMMError("Number of histogram bins must be a power of 2 between 1 and 65536 (got " +
+            ToString(bins) + ")");
+   frameStatisticsBins_ = bins;
+   cbuf_->SetFrameStatistics(frameStatisticsEnabled_, frameStatisticsBins_);
+}
+
+/**
+ * Returns the number of histogram bins used for frame statistics.
+ */
+unsigned CMMCore::getFrameStatisticsHistogramBins()
+{
+   return frameStatisticsBins_;
+}
+
+/**
+ * Returns the drift of a camera's hardware clock relative to the host clock.
+ *
+ * Cameras that provide hardware timestamps set the HardwareTimestamp-ns tag
+ * on each frame. The Core fits a line between these and the host monotonic
+ * clock at insertion into the circular buffer, over all frames since the
+ * buffer was last cleared (e.g. by starting a sequence acquisition). The
+ * fitted line is also used to add the HardwareTimestamp-HostMonotonic-ns tag
+ * and, if the camera does not set it, the ElapsedTime-ms tag.
+ *
+ * @return the rate of the host clock relative to the camera clock, minus 1,
+ *         in parts per million
+ * @param cameraLabel  the camera label
+ */
+double CMMCore::getHardwareTimestampDriftPpm(const char* cameraLabel) throw (CMMError)
+{
+   if (!cameraLabel)
+      throw CMMError("Null device label", MMERR_NullPointerException);
+   mm::ClockDriftEstimator fit;
+   if (!cbuf_->GetHardwareClockFit(cameraLabel, fit) || !fit.HasFit())
+      throw CMMError("Not enough frames with hardware timestamps have been received from camera " +
+            ToQuotedString(cameraLabel));
+   return fit.GetDriftPpm();
+}
+
+/**
+ * Returns the jitter of frame arrival relative to a camera's hardware clock.
+ *
+ * This is the RMS deviation of the host monotonic times at which frames were
+ * inserted into the circular buffer from the line fitted against the
+ * hardware timestamps. See getHardwareTimestampDriftPpm().
+ *
+ * @return the RMS jitter in microseconds
+ * @param cameraLabel  the camera label
+ */
+double CMMCore::getHardwareTimestampJitterUs(const char* cameraLabel) throw (CMMError)
+{
+   if (!cameraLabel)
+      throw CMMError("Null device label", MMERR_NullPointerException);
+   mm::ClockDriftEstimator fit;
+   if (!cbuf_->GetHardwareClockFit(cameraLabel, fit) || !fit.HasFit())
+      throw CMMError("Not enough frames with hardware timestamps have been received from camera " +
+            ToQuotedString(cameraLabel));
+   return fit.GetJitterNs() / 1000.0;
+}
+
 /**
  * Returns the size of the Circular Buffer in MB
  */
@@ -3278,6 +4050,59 @@ long CMMCore::getRemainingImageCount()
    return 0;
 }
 
+/**
+ * Blocks until an image is available in the circular buffer.
+ *
+ * Equivalent to waitForImageCount(1, timeoutMs).
+ *
+ * @param timeoutMs     the maximum time to wait, in milliseconds
+ * @return whether an image is available
+ */
+bool CMMCore::waitForNextImage(long timeoutMs) throw (CMMError)
+{
+   return waitForImageCount(1, timeoutMs);
+}
+
+/**
+ * Blocks until at least count images are available in the circular buffer.
+ *
+ * The calling thread is woken as soon as the camera inserts the image it is
+ * waiting for, rather than polling getRemainingImageCount(). Returns early,
+ * with false, if the current camera is not running a sequence acquisition and
+ * fewer than count images are available, as no more images would arrive.
+ *
+ * @param count         the number of images to wait for
+ * @param timeoutMs     the maximum time to wait, in milliseconds
+ * @return whether count images are available
+ */
+bool CMMCore::waitForImageCount(long count, long timeoutMs) throw (CMMError)
+{
+   if (timeoutMs < 0)
+      throw CMMError("Negative timeout", MMERR_InvalidContents);
+   if (count <= 0)
+      return true;
+
+   const std::chrono::steady_clock::time_point deadline =
+      std::chrono::steady_clock::now() + std::chrono::milliseconds(timeoutMs);
+   for (;;)
+   {
+      if (getRemainingImageCount() >= count)
+         return true;
+      if (!isSequenceRunning())
+         return getRemainingImageCount() >= count;
+      const std::chrono::steady_clock::time_point now =
+         std::chrono::steady_clock::now();
+      if (now >= deadline)
+         return false;
+
+      // Inserts end the wait at once. The end of the acquisition interrupts
+      // it too, but the camera may report that it is still running for a
+      // moment after that; the slice bounds how long this can go unnoticed.
+      cbuf_->WaitForImages(static_cast<unsigned long>(count),
+            std::min(deadline, now + std::chrono::milliseconds(100)));
+   }
+}
+
 /**
  * Returns the total number of images that can be stored in the buffer
  */
@@ -3803,6 +4628,69 @@ std::string CMMCore::getProperty(const char* label, const char* propName) throw
    return value;
 }
 
+static double ParsePropertyNumber(const std::string& text,
+      const char* label, const char* propName)
+{
+   const char* begin = text.c_str();
+   char* end = 0;
+   double value = std::strtod(begin, &end);
+   if (end == begin || *end != '\0')
+      throw CMMError("Value " + ToQuotedString(text) + " of property " +
+            ToQuotedString(propName) + " of device " + ToQuotedString(label) +
+            " is not a number");
+   return value;
+}
+
+/**
+ * Returns the value of a numeric property for the specified device.
+ *
+ * For Float properties the value is transferred from the device without
+ * conversion to text. Other properties are read as text and parsed; an
+ * exception is thrown if the value is not a number.
+ *
+ * @return the property value
+ * @param label      the device label
+ * @param propName   the property name
+ */
+double CMMCore::getPropertyAsDouble(const char* label, const char* propName) throw (CMMError)
+{
+   if (!IsCoreDeviceLabel(label))
+   {
+      std::shared_ptr<DeviceInstance> pDevice = deviceManager_->GetDevice(label);
+      CheckPropertyName(propName);
+      double value;
+      if (GetPropertyValue(pDevice, label, propName, value))
+         return value;
+   }
+   return ParsePropertyNumber(getProperty(label, propName), label, propName);
+}
+
+/**
+ * Returns the value of a numeric property for the specified device.
+ *
+ * For Integer properties the value is transferred from the device without
+ * conversion to text. Other properties are read as text and parsed; an
+ * exception is thrown if the value is not a number. Fractional values are
+ * truncated toward zero.
+ *
+ * @return the property value
+ * @param label      the device label
+ * @param propName   the property name
+ */
+long CMMCore::getPropertyAsLong(const char* label, const char* propName) throw (CMMError)
+{
+   if (!IsCoreDeviceLabel(label))
+   {
+      std::shared_ptr<DeviceInstance> pDevice = deviceManager_->GetDevice(label);
+      CheckPropertyName(propName);
+      long value;
+      if (GetPropertyValue(pDevice, label, propName, value))
+         return value;
+   }
+   return static_cast<long>(
+         ParsePropertyNumber(getProperty(label, propName), label, propName));
+}
+
 /**
  * Returns the cached property value for the specified device.
 
@@ -3894,6 +4782,11 @@ void CMMCore::setProperty(const char* label, const char* propName,
 void CMMCore::setProperty(const char* label, const char* propName,
                           const long propValue) throw (CMMError)
 {
+   CheckDeviceLabel(label);
+   CheckPropertyName(propName);
+   if (!IsCoreDeviceLabel(label) && SetPropertyValue(
+            deviceManager_->GetDevice(label), label, propName, propValue))
+      return;
    setProperty(label, propName, ToString(propValue).c_str());
 }
 
@@ -3907,7 +4800,7 @@ void CMMCore::setProperty(const char* label, const char* propName,
 void CMMCore::setProperty(const char* label, const char* propName,
                           const float propValue) throw (CMMError)
 {
-   setProperty(label, propName, ToString(propValue).c_str());
+   setProperty(label, propName, static_cast<double>(propValue));
 }
 
 /**
@@ -3917,10 +4810,143 @@ void CMMCore::setProperty(const char* label, const char* propName,
  * @param propName       the property name
  * @param propValue      the new property value
  */
-void CMMCore::setProperty(const char* label, const char* propName,
-                          const double propValue) throw (CMMError)
+void CMMCore::setProperty(const char* label, const char* propName,
+                          const double propValue) throw (CMMError)
+{
+   CheckDeviceLabel(label);
+   CheckPropertyName(propName);
+   if (!IsCoreDeviceLabel(label) && SetPropertyValue(
+            deviceManager_->GetDevice(label), label, propName, propValue))
+      return;
+   setProperty(label, propName, ToString(propValue).c_str());
+}
+
+/**
+ * Resolves a device property for repeated access.
+ *
+ * The returned handle can be passed to getPropertyByHandle() and
+ * setPropertyByHandle(), which skip validating and looking up the device
+ * label and property name on each call. Resolving the same property again
+ * returns the same handle. Handles stay valid for the lifetime of the Core;
+ * if the device is unloaded, the handle refers to whatever device is later
+ * loaded under the same label.
+ *
+ * @return the property handle
+ * @param label      the device label
+ * @param propName   the property name
+ */
+long CMMCore::getPropertyHandle(const char* label, const char* propName) throw (CMMError)
+{
+   CheckPropertyName(propName);
+   if (IsCoreDeviceLabel(label))
+   {
+      if (!properties_->Has(propName))
+         throw CMMError("Core has no property " + ToQuotedString(propName),
+               MMERR_InvalidCoreProperty);
+      return propertyHandles_->Add(label, propName,
+            std::shared_ptr<DeviceInstance>());
+   }
+
+   std::shared_ptr<DeviceInstance> pDevice = deviceManager_->GetDevice(label);
+   {
+      mm::DeviceModuleLockGuard guard(pDevice);
+      if (!pDevice->HasProperty(propName))
+         throw CMMError("Device " + ToQuotedString(label) +
+               " has no property " + ToQuotedString(propName));
+   }
+   return propertyHandles_->Add(label, propName, pDevice);
+}
+
+/**
+ * Returns the value of a property resolved with getPropertyHandle().
+ *
+ * @return the property value
+ * @param handle   the property handle
+ */
+std::string CMMCore::getPropertyByHandle(long handle) throw (CMMError)
+{
+   std::shared_ptr<const mm::PropertyHandleTarget> target =
+      propertyHandles_->Get(handle);
+   if (IsCoreDeviceLabel(target->label.c_str()))
+      return properties_->Get(target->name.c_str());
+   std::shared_ptr<DeviceInstance> pDevice = GetPropertyHandleDevice(*target);
+
+   std::string value;
+   {
+      mm::DeviceModuleLockGuard guard(pDevice);
+      value = pDevice->GetProperty(target->name);
+   }
+
+   PropertySetting s(target->label.c_str(), target->name.c_str(), value.c_str());
+   {
+      MMThreadGuard scg(stateCacheLock_);
+      stateCache_.addSetting(s);
+   }
+   return value;
+}
+
+/**
+ * Changes the value of a property resolved with getPropertyHandle().
+ *
+ * @param handle      the property handle
+ * @param propValue   the new property value
+ */
+void CMMCore::setPropertyByHandle(long handle, const char* propValue) throw (CMMError)
+{
+   CheckPropertyValue(propValue);
+   std::shared_ptr<const mm::PropertyHandleTarget> target =
+      propertyHandles_->Get(handle);
+   if (IsCoreDeviceLabel(target->label.c_str()))
+   {
+      setProperty(target->label.c_str(), target->name.c_str(), propValue);
+      return;
+   }
+   std::shared_ptr<DeviceInstance> pDevice = GetPropertyHandleDevice(*target);
+
+   {
+      mm::DeviceModuleLockGuard guard(pDevice);
+      pDevice->SetProperty(target->name, propValue);
+   }
+
+   PropertySetting s(target->label.c_str(), target->name.c_str(), propValue);
+   {
+      MMThreadGuard scg(stateCacheLock_);
+      stateCache_.addSetting(s);
+   }
+}
+
+/**
+ * Changes the value of a property resolved with getPropertyHandle().
+ *
+ * @param handle      the property handle
+ * @param propValue   the new property value
+ */
+void CMMCore::setPropertyByHandle(long handle, const long propValue) throw (CMMError)
+{
+   std::shared_ptr<const mm::PropertyHandleTarget> target =
+      propertyHandles_->Get(handle);
+   if (!IsCoreDeviceLabel(target->label.c_str()) &&
+         SetPropertyValue(GetPropertyHandleDevice(*target),
+            target->label.c_str(), target->name.c_str(), propValue))
+      return;
+   setPropertyByHandle(handle, ToString(propValue).c_str());
+}
+
+/**
+ * Changes the value of a property resolved with getPropertyHandle().
+ *
+ * @param handle      the property handle
+ * @param propValue   the new property value
+ */
+void CMMCore::setPropertyByHandle(long handle, const double propValue) throw (CMMError)
 {
-   setProperty(label, propName, ToString(propValue).c_str());
+   std::shared_ptr<const mm::PropertyHandleTarget> target =
+      propertyHandles_->Get(handle);
+   if (!IsCoreDeviceLabel(target->label.c_str()) &&
+         SetPropertyValue(GetPropertyHandleDevice(*target),
+            target->label.c_str(), target->name.c_str(), propValue))
+      return;
+   setPropertyByHandle(handle, ToString(propValue).c_str());
 }
 
 
@@ -4118,6 +5144,51 @@ void CMMCore::loadPropertySequence(const char* label, const char* propName, std:
    pDevice->SendPropertySequence(propName);
 }
 
+/**
+ * Transfer a sequence of numeric values to the device in one call.
+ *
+ * Equivalent to loading the same values as strings, but the device receives
+ * them as an array, without conversion to and from text. Use for long
+ * sequences of Float properties (e.g. analog waveforms).
+ *
+ * @param label           the device name
+ * @param propName        the property label
+ * @param eventSequence   the values that the device will step through in response to external triggers
+ */
+void CMMCore::loadPropertySequence(const char* label, const char* propName, const std::vector<double>& eventSequence) throw (CMMError)
+{
+   if (IsCoreDeviceLabel(label))
+      throw CMMError("Core properties are not sequenceable",
+            MMERR_InvalidCoreProperty);
+   std::shared_ptr<DeviceInstance> pDevice = deviceManager_->GetDevice(label);
+   CheckPropertyName(propName);
+
+   mm::DeviceModuleLockGuard guard(pDevice);
+   pDevice->LoadPropertySequence(propName, eventSequence);
+}
+
+/**
+ * Transfer a sequence of integer values to the device in one call.
+ *
+ * Integer counterpart of loadPropertySequence() with a vector of doubles,
+ * for Integer properties (e.g. states or digital output patterns).
+ *
+ * @param label           the device name
+ * @param propName        the property label
+ * @param eventSequence   the values that the device will step through in response to external triggers
+ */
+void CMMCore::loadPropertySequence(const char* label, const char* propName, const std::vector<long>& eventSequence) throw (CMMError)
+{
+   if (IsCoreDeviceLabel(label))
+      throw CMMError("Core properties are not sequenceable",
+            MMERR_InvalidCoreProperty);
+   std::shared_ptr<DeviceInstance> pDevice = deviceManager_->GetDevice(label);
+   CheckPropertyName(propName);
+
+   mm::DeviceModuleLockGuard guard(pDevice);
+   pDevice->LoadPropertySequence(propName, eventSequence);
+}
+
 /**
  * Returns the intrinsic property type.
  */
@@ -6655,8 +7726,8 @@ void CMMCore::saveSystemConfiguration(const char* fileName) throw (CMMError)
  * Format specification:
  * Each line consists of a number of string fields separated by "," (comma) characters.
  * Lines beginning with "#" are ignored (can be used for comments).
- * Each line in the file will be parsed by the system and as a result a corresponding command
- * will be immediately executed.
+ * The whole file is parsed first, and nothing is loaded if any line is malformed. The
+ * commands are then executed in order.
  * The first field in the line always specifies the command from the following set of values:
  *    Device - executes loadDevice()
  *    Label - executes defineStateLabel() command
@@ -6705,213 +7776,161 @@ void CMMCore::loadSystemConfigurationImpl(const char* fileName) throw (CMMError)
    if (!fileName)
       throw CMMError("Null filename");
 
-   std::ifstream is;
-   is.open(fileName, std::ios_base::in);
-   if (!is.is_open())
+   const std::chrono::steady_clock::time_point startTime =
+      std::chrono::steady_clock::now();
+
+   std::vector<mm::SystemConfigurationCommand> commands;
    {
-      logError(fileName, getCoreErrorText(MMERR_FileOpenFailed).c_str());
-      throw CMMError(ToQuotedString(fileName) + ": " + getCoreErrorText(MMERR_FileOpenFailed),
-            MMERR_FileOpenFailed);
+      std::ifstream is;
+      is.open(fileName, std::ios_base::in);
+      if (!is.is_open())
+      {
+         logError(fileName, getCoreErrorText(MMERR_FileOpenFailed).c_str());
+         throw CMMError(ToQuotedString(fileName) + ": " + getCoreErrorText(MMERR_FileOpenFailed),
+               MMERR_FileOpenFailed);
+      }
+      commands = mm::ParseSystemConfiguration(is);
    }
 
-   // Process commands
-   const int maxLineLength = 4 * MM::MaxStrLength + 4; // accommodate up to 4 strings and delimiters
-   char line[maxLineLength+1];
-   std::vector<std::string> tokens;
-
-   int lineCount = 0;
+   const std::chrono::steady_clock::time_point parsedTime =
+      std::chrono::steady_clock::now();
 
-   while(is.getline(line, maxLineLength, '\n'))
+   typedef mm::SystemConfigurationCommand Command;
+   const Command* current = 0;
+   try
    {
-      // strip a potential Windows/dos CR
-      std::istringstream il(line);
-      il.getline(line, maxLineLength, '\r');
-
-      lineCount++;
-      if (strlen(line) > 0)
+      // Reject the file before anything is loaded if any line is malformed
+      for (std::vector<Command>::const_iterator it = commands.begin(), end = commands.end(); it != end; ++it)
       {
-         if (line[0] == '#')
+         if (it->kind == Command::Invalid)
          {
-            // comment, so skip processing
-            continue;
+            current = &*it;
+            throw CMMError(getCoreErrorText(MMERR_InvalidCFGEntry) + " (" +
+                  ToQuotedString(it->line) + ")",
+                  MMERR_InvalidCFGEntry);
          }
+      }
 
-         // parse tokens
-         tokens.clear();
-         CDeviceUtils::Tokenize(line, tokens, MM::g_FieldDelimiters);
+      // Load all the adapter modules at once; any errors are reported by the
+      // Device line that fails
+      std::vector<std::string> modules;
+      for (std::vector<Command>::const_iterator it = commands.begin(), end = commands.end(); it != end; ++it)
+      {
+         if (it->kind == Command::Device)
+            modules.push_back(it->args[1]);
+      }
+      pluginManager_->LoadDeviceAdapters(modules);
 
-         try
+      for (size_t i = 0; i < commands.size(); ++i)
+      {
+         current = &commands[i];
+         const std::vector<std::string>& args = current->args;
+         switch (current->kind)
          {
+            case Command::Device:
+               loadDevice(args[0].c_str(), args[1].c_str(), args[2].c_str());
+               break;
 
-            // non-empty and non-comment lines mush have at least one token
-            if (tokens.size() < 1)
-               throw CMMError(getCoreErrorText(MMERR_InvalidCFGEntry) + " (" +
-                     ToQuotedString(line) + ")",
-                     MMERR_InvalidCFGEntry);
-
-            if(tokens[0].compare(MM::g_CFGCommand_Device) == 0)
-            {
-               // load device command
-               // -------------------
-               if (tokens.size() != 4)
-                  throw CMMError(getCoreErrorText(MMERR_InvalidCFGEntry) + " (" +
-                        ToQuotedString(line) + ")",
-                        MMERR_InvalidCFGEntry);
-               loadDevice(tokens[1].c_str(), tokens[2].c_str(), tokens[3].c_str());
-            }
-            else if(tokens[0].compare(MM::g_CFGCommand_Property) == 0)
-            {
-               // set property command
-               // --------------------
-               if (tokens.size() == 4)
-                  setProperty(tokens[1].c_str(), tokens[2].c_str(), tokens[3].c_str());
-               else if (tokens.size() == 3)
-                  // ...assuming here that the last missing toke represents an empty string
-                  setProperty(tokens[1].c_str(), tokens[2].c_str(), "");
-               else
-                  throw CMMError(getCoreErrorText(MMERR_InvalidCFGEntry) + " (" +
-                        ToQuotedString(line) + ")",
-                        MMERR_InvalidCFGEntry);
-            }
-            else if(tokens[0].compare(MM::g_CFGCommand_Delay) == 0)
-            {
-               // set delay command
-               // -----------------
-               if (tokens.size() != 3)
-                  throw CMMError(getCoreErrorText(MMERR_InvalidCFGEntry) + " (" +
-                        ToQuotedString(line) + ")",
-                        MMERR_InvalidCFGEntry);
-               setDeviceDelayMs(tokens[1].c_str(), atof(tokens[2].c_str()));
-            }
-            else if(tokens[0].compare(MM::g_CFGCommand_FocusDirection) == 0)
-            {
-               // set focus direction command
-               // ---------------------------
-               if (tokens.size() != 3)
-                  throw CMMError(getCoreErrorText(MMERR_InvalidCFGEntry) + " (" +
-                        ToQuotedString(line) + ")",
-                        MMERR_InvalidCFGEntry);
-               setFocusDirection(tokens[1].c_str(), atol(tokens[2].c_str()));
-            }
-            else if(tokens[0].compare(MM::g_CFGCommand_Label) == 0)
-            {
-               // define label command
-               // --------------------
-               if (tokens.size() != 4)
-                  throw CMMError(getCoreErrorText(MMERR_InvalidCFGEntry) + " (" +
-                        ToQuotedString(line) + ")",
-                        MMERR_InvalidCFGEntry);
-               defineStateLabel(tokens[1].c_str(), atol(tokens[2].c_str()), tokens[3].c_str());
-            }
-            else if(tokens[0].compare(MM::g_CFGCommand_Configuration) == 0)
-            {
-               // define configuration command
-               // ----------------------------
-               if (tokens.size() != 5)
-                  throw CMMError(getCoreErrorText(MMERR_InvalidCFGEntry) + " (" +
-                        ToQuotedString(line) + ")",
-                        MMERR_InvalidCFGEntry);
-               LOG_WARNING(coreLogger_) << "Obsolete command " << tokens[0] <<
-                  " ignored in configuration file";
-            }
-            else if(tokens[0].compare(MM::g_CFGCommand_ConfigGroup) == 0)
-            {
-               // define grouped configuration command
-               // ------------------------------------
-               if (tokens.size() == 6)
-                  defineConfig(tokens[1].c_str(), tokens[2].c_str(), tokens[3].c_str(), tokens[4].c_str(), tokens[5].c_str());
-               else if (tokens.size() == 5)
+            case Command::Property:
+               if (IsCoreDeviceLabel(args[0].c_str()))
                {
-                  // we will assume here that the last (missing) token is representing an empty string
-                  defineConfig(tokens[1].c_str(), tokens[2].c_str(), tokens[3].c_str(), tokens[4].c_str(), "");
+                  setProperty(args[0].c_str(), args[1].c_str(), args[2].c_str());
                }
-               else if (tokens.size() == 2)
-                  defineConfigGroup(tokens[1].c_str());
-               else
-                  throw CMMError(getCoreErrorText(MMERR_InvalidCFGEntry) + " (" +
-                        ToQuotedString(line) + ")",
-                        MMERR_InvalidCFGEntry);
-            }
-            else if(tokens[0].compare(MM::g_CFGCommand_ConfigPixelSize) == 0)
-            {
-               // define pixel size configuration command
-               // ---------------------------------------
-               if (tokens.size() == 5)
-                  definePixelSizeConfig(tokens[1].c_str(), tokens[2].c_str(), tokens[3].c_str(), tokens[4].c_str());
-               else
-                  throw CMMError(getCoreErrorText(MMERR_InvalidCFGEntry) + " (" +
-                        ToQuotedString(line) + ")",
-                        MMERR_InvalidCFGEntry);
-            }
-            else if(tokens[0].compare(MM::g_CFGCommand_PixelSize_um) == 0)
-            {
-               // set pixel size
-               // --------------
-               if (tokens.size() == 3)
-                  setPixelSizeUm(tokens[1].c_str(), atof(tokens[2].c_str()));
                else
-                  throw CMMError(getCoreErrorText(MMERR_InvalidCFGEntry) + " (" +
-                        ToQuotedString(line) + ")",
-                        MMERR_InvalidCFGEntry);
-            }
-            else if(tokens[0].compare(MM::g_CFGCommand_PixelSizeAffine) == 0)
-            {
-               // set affine transform
-               // --------------
-               //
-               if (tokens.size() == 8)
                {
-                  std::vector<double> *affineT = new std::vector<double>(6);
-                  for (int i = 0; i < 6; i++)
+                  // Set the properties on consecutive lines for the same
+                  // device together, and add them to the state cache at once
+                  const std::string& label = args[0];
+                  CheckDeviceLabel(label.c_str());
+                  std::shared_ptr<DeviceInstance> pDevice =
+                     deviceManager_->GetDevice(label);
+                  std::vector<PropertySetting> settings;
                   {
-                     affineT->at(i) = atof(tokens[i + 2].c_str());
+                     mm::DeviceModuleLockGuard guard(pDevice);
+                     for (; i < commands.size() &&
+                           commands[i].kind == Command::Property &&
+                           commands[i].args[0] == label; ++i)
+                     {
+                        current = &commands[i];
+                        const std::string& propName = current->args[1];
+                        const std::string& propValue = current->args[2];
+                        CheckPropertyName(propName.c_str());
+                        CheckPropertyValue(propValue.c_str());
+                        pDevice->SetProperty(propName, propValue);
+                        settings.push_back(PropertySetting(label.c_str(),
+                                 propName.c_str(), propValue.c_str()));
+                     }
+                     --i;
                   }
-                  setPixelSizeAffine(tokens[1].c_str(), *affineT);
-                  delete affineT;
+                  MMThreadGuard scg(stateCacheLock_);
+                  for (std::vector<PropertySetting>::const_iterator it = settings.begin(), end = settings.end(); it != end; ++it)
+                     stateCache_.addSetting(*it);
                }
-               else
-                  throw CMMError(getCoreErrorText(MMERR_InvalidCFGEntry) + " (" +
-                        ToQuotedString(line) + ")",
-                        MMERR_InvalidCFGEntry);
-            }
-            else if(tokens[0].compare(MM::g_CFGCommand_Equipment) == 0)
-            {
-              // Property blocks have been removed
-              throw CMMError(getCoreErrorText(MMERR_InvalidCFGEntry) + " (" +
-                    ToQuotedString(line) + ")",
-                    MMERR_InvalidCFGEntry);
-            }
-            else if(tokens[0].compare(MM::g_CFGCommand_ImageSynchro) == 0)
-            {
-               // ImageSynchro has been removed
-               throw CMMError(getCoreErrorText(MMERR_InvalidCFGEntry) + " (" +
-                     ToQuotedString(line) + ")",
-                     MMERR_InvalidCFGEntry);
-            }
-            else if(tokens[0].compare(MM::g_CFGCommand_ParentID) == 0)
+               break;
+
+            case Command::Delay:
+               setDeviceDelayMs(args[0].c_str(), atof(args[1].c_str()));
+               break;
+
+            case Command::FocusDirection:
+               setFocusDirection(args[0].c_str(), atol(args[1].c_str()));
+               break;
+
+            case Command::Label:
+               defineStateLabel(args[0].c_str(), atol(args[1].c_str()), args[2].c_str());
+               break;
+
+            case Command::ObsoleteConfig:
+               LOG_WARNING(coreLogger_) << "Obsolete command " <<
+                  MM::g_CFGCommand_Configuration <<
+                  " ignored in configuration file";
+               break;
+
+            case Command::ConfigGroup:
+               defineConfigGroup(args[0].c_str());
+               break;
+
+            case Command::ConfigPreset:
+               defineConfig(args[0].c_str(), args[1].c_str(), args[2].c_str(), args[3].c_str(), args[4].c_str());
+               break;
+
+            case Command::ConfigPixelSize:
+               definePixelSizeConfig(args[0].c_str(), args[1].c_str(), args[2].c_str(), args[3].c_str());
+               break;
+
+            case Command::PixelSizeUm:
+               setPixelSizeUm(args[0].c_str(), atof(args[1].c_str()));
+               break;
+
+            case Command::PixelSizeAffine:
             {
-               // set parent ID
-               // -------------
-               if (tokens.size() != 3)
-                  throw CMMError(getCoreErrorText(MMERR_InvalidCFGEntry) + " (" +
-                        ToQuotedString(line) + ")",
-                        MMERR_InvalidCFGEntry);
-
-               setParentLabel(tokens[1].c_str(), tokens[2].c_str());
+               std::vector<double> affineT(6);
+               for (int j = 0; j < 6; j++)
+                  affineT[j] = atof(args[j + 1].c_str());
+               setPixelSizeAffine(args[0].c_str(), affineT);
+               break;
             }
 
-         }
-         catch (CMMError& err)
-         {
-            if (externalCallback_)
-               externalCallback_->onSystemConfigurationLoaded();
-            std::ostringstream errorText;
-            errorText << "Line " << lineCount << ": " << line << '\n';
-            errorText << err.getFullMsg() << "\n\n";
-            throw CMMError(errorText.str().c_str(), MMERR_InvalidConfigurationFile);
+            case Command::Parent:
+               setParentLabel(args[0].c_str(), args[1].c_str());
+               break;
+
+            case Command::Invalid:
+               break;
          }
       }
    }
+   catch (CMMError& err)
+   {
+      if (externalCallback_)
+         externalCallback_->onSystemConfigurationLoaded();
+      if (!current)
+         throw;
+      std::ostringstream errorText;
+      errorText << "Line " << current->lineNumber << ": " << current->line << '\n';
+      errorText << err.getFullMsg() << "\n\n";
+      throw CMMError(errorText.str().c_str(), MMERR_InvalidConfigurationFile);
+   }
 
    updateAllowedChannelGroups();
 
@@ -6926,9 +7945,20 @@ void CMMCore::loadSystemConfigurationImpl(const char* fileName) throw (CMMError)
       this->setConfig(MM::g_CFGGroup_System, MM::g_CFGGroup_System_Startup);
    }
 
+   // Setting the preset can change devices outside it (e.g. through a hub),
+   // so everything is read again
    waitForSystem();
    updateSystemStateCache();
 
+   const std::chrono::steady_clock::time_point endTime =
+      std::chrono::steady_clock::now();
+   LOG_INFO(coreLogger_) << "Loaded system configuration " << fileName <<
+      " (" << commands.size() << " commands): parsed in " <<
+      std::chrono::duration_cast<std::chrono::microseconds>(parsedTime - startTime).count() / 1000.0 <<
+      " ms, applied in " <<
+      std::chrono::duration_cast<std::chrono::microseconds>(endTime - parsedTime).count() / 1000.0 <<
+      " ms";
+
    if (externalCallback_)
    {
       externalCallback_->onSystemConfigurationLoaded();
@@ -7246,6 +8276,9 @@ void CMMCore::InitializeErrorMessages()
    errorText_[MMERR_NullPointerException] = "Null Pointer Exception.";
    errorText_[MMERR_CreatePeripheralFailed] = "Hub failed to create specified peripheral device.";
    errorText_[MMERR_BadAffineTransform] = "Bad affine transform.  Affine transforms need to have 6 numbers; 2 rows of 3 column.";
+   errorText_[MMERR_BufferTooSmall] = "Buffer is too small for the image.";
+   errorText_[MMERR_DeviceInitializationTimeout] = "Device did not finish initializing within the initialization timeout.";
+   errorText_[MMERR_ImageConsumedByProcessor] = "The image was consumed by the image processor.";
 }
 
 void CMMCore::CreateCoreProperties()
@@ -7304,6 +8337,16 @@ void CMMCore::CreateCoreProperties()
    CoreProperty propBusyTimeoutMs;
    properties_->Add(MM::g_Keyword_CoreTimeoutMs, propBusyTimeoutMs);
 
+   // Time after which we give up on a device that is initializing
+   CoreProperty propInitTimeoutMs;
+   properties_->Add(MM::g_Keyword_CoreInitializationTimeoutMs, propInitTimeoutMs);
+
+   // Scheduling of the threads in which cameras acquire images
+   CoreProperty propAcqThreadPriority;
+   properties_->Add(MM::g_Keyword_CoreAcquisitionThreadPriority, propAcqThreadPriority);
+   CoreProperty propAcqThreadCPUs;
+   properties_->Add(MM::g_Keyword_CoreAcquisitionThreadCPUs, propAcqThreadCPUs);
+
    properties_->Refresh();
 }
 
@@ -7379,6 +8422,332 @@ bool CMMCore::IsCoreDeviceLabel(const char* label) const throw (CMMError)
    return (strcmp(label, MM::g_Keyword_CoreDevice) == 0);
 }
 
+std::shared_ptr<DeviceInstance> CMMCore::GetPropertyHandleDevice(
+      const mm::PropertyHandleTarget& target) throw (CMMError)
+{
+   std::shared_ptr<DeviceInstance> pDevice = target.device.lock();
+   if (pDevice)
+      return pDevice;
+
+   // The device has been unloaded; use the one now loaded under the label
+   pDevice = deviceManager_->GetDevice(target.label);
+   propertyHandles_->Add(target.label, target.name, pDevice);
+   return pDevice;
+}
+
+// The state cache holds values as text. Typed access succeeds only for Float
+// and Integer properties, so the text is what MM::FloatProperty and
+// MM::IntegerProperty would have returned.
+static std::string FormatFloatPropertyValue(double value)
+{
+   // Round to 4 decimal places as the property does, so that halfway values
+   // are not rounded differently by snprintf
+   value = (value >= 0.0) ? std::floor(value * 1e4 + 0.5) / 1e4 :
+      std::ceil(value * 1e4 - 0.5) / 1e4;
+   char buf[64];
+   std::snprintf(buf, sizeof(buf), "%.4f", value);
+   return buf;
+}
+
+bool CMMCore::GetPropertyValue(std::shared_ptr<DeviceInstance> pDevice,
+      const char* label, const char* propName, double& value) throw (CMMError)
+{
+   {
+      mm::DeviceModuleLockGuard guard(pDevice);
+      if (!pDevice->GetFloatPropertyValue(propName, value))
+         return false;
+   }
+   PropertySetting s(label, propName, FormatFloatPropertyValue(value).c_str());
+   MMThreadGuard scg(stateCacheLock_);
+   stateCache_.addSetting(s);
+   return true;
+}
+
+bool CMMCore::GetPropertyValue(std::shared_ptr<DeviceInstance> pDevice,
+      const char* label, const char* propName, long& value) throw (CMMError)
+{
+   {
+      mm::DeviceModuleLockGuard guard(pDevice);
+      if (!pDevice->GetIntegerPropertyValue(propName, value))
+         return false;
+   }
+   PropertySetting s(label, propName, ToString(value).c_str());
+   MMThreadGuard scg(stateCacheLock_);
+   stateCache_.addSetting(s);
+   return true;
+}
+
+bool CMMCore::SetPropertyValue(std::shared_ptr<DeviceInstance> pDevice,
+      const char* label, const char* propName, double value) throw (CMMError)
+{
+   {
+      mm::DeviceModuleLockGuard guard(pDevice);
+      if (!pDevice->SetFloatPropertyValue(propName, value))
+         return false;
+   }
+   PropertySetting s(label, propName, FormatFloatPropertyValue(value).c_str());
+   MMThreadGuard scg(stateCacheLock_);
+   stateCache_.addSetting(s);
+   return true;
+}
+
+bool CMMCore::SetPropertyValue(std::shared_ptr<DeviceInstance> pDevice,
+      const char* label, const char* propName, long value) throw (CMMError)
+{
+   {
+      mm::DeviceModuleLockGuard guard(pDevice);
+      if (!pDevice->SetIntegerPropertyValue(propName, value))
+         return false;
+   }
+   PropertySetting s(label, propName, ToString(value).c_str());
+   MMThreadGuard scg(stateCacheLock_);
+   stateCache_.addSetting(s);
+   return true;
+}
+
+void CMMCore::CheckImageDestination(const void* buffer,
+      unsigned long bufferSize, unsigned long imageSize) const throw (CMMError)
+{
+   if (!buffer)
+      throw CMMError("Null image buffer", MMERR_NullPointerException);
+   if (bufferSize < imageSize)
+      throw CMMError(getCoreErrorText(MMERR_BufferTooSmall) + " (" +
+            ToString(bufferSize) + " bytes; " + ToString(imageSize) +
+            " bytes needed)", MMERR_BufferTooSmall);
+}
+
+unsigned long CMMCore::CopyImageInto(const mm::ImgBuffer& image, void* buffer,
+      unsigned long bufferSize, Metadata& md) const throw (CMMError)
+{
+   const unsigned long imageSize = static_cast<unsigned long>(image.Width()) *
+      image.Height() * image.Depth();
+   // The circular buffer may have been reinitialized since it was checked
+   CheckImageDestination(buffer, bufferSize, imageSize);
+   std::memcpy(buffer, image.GetPixels(), imageSize);
+   image.GetMetadata(md);
+   return imageSize;
+}
+
+std::shared_ptr<const mm::SystemStateTags> CMMCore::GetSystemStateTags() const
+{
+   MMThreadGuard scg(stateCacheLock_);
+   if (!systemStateTags_ ||
+         systemStateTags_->revision != stateCache_.getRevision())
+      systemStateTags_ = mm::MakeSystemStateTags(stateCache_);
+   return systemStateTags_;
+}
+
+std::vector<mm::CachedDevice>
+CMMCore::GetCachedAvailableDevices(const char* moduleName) throw (CMMError)
+{
+   if (!moduleName)
+      throw CMMError("Null device adapter module name");
+   const std::string name(moduleName);
+
+   mm::ModuleFileIdentity file;
+   const bool haveFile = file.Read(pluginManager_->GetModuleFilename(name));
+   std::vector<mm::CachedDevice> cached;
+   const bool haveCached = haveFile &&
+      capabilityCache_->GetDevices(name, file, cached);
+
+   // Once the module is loaded, asking it is cheap, and its answer is
+   // authoritative
+   if (haveCached && !pluginManager_->IsModuleLoaded(name))
+      return cached;
+
+   std::shared_ptr<LoadedDeviceAdapter> module =
+      pluginManager_->GetDeviceAdapter(name);
+   std::vector<mm::CachedDevice> devices;
+   for (const std::string& deviceName : module->GetAvailableDeviceNames())
+   {
+      mm::CachedDevice device;
+      device.name = deviceName;
+      device.description = module->GetDeviceDescription(deviceName);
+      device.type =
+         static_cast<long>(module->GetAdvertisedDeviceType(deviceName));
+      devices.push_back(device);
+   }
+   if (haveFile && !(haveCached && devices == cached))
+   {
+      capabilityCache_->SetDevices(name, file, module->GetModuleVersion(),
+            module->GetDeviceInterfaceVersion(), devices);
+   }
+   return devices;
+}
+
+std::vector<std::pair<std::string, std::string> >
+CMMCore::GetCachedInstalledDevices(std::shared_ptr<HubInstance> pHub,
+      bool refresh) throw (CMMError)
+{
+   mm::DeviceModuleLockGuard guard(pHub);
+   std::shared_ptr<LoadedDeviceAdapter> module = pHub->GetAdapterModule();
+   const std::string moduleName = module->GetName();
+
+   // An uninitialized hub is left to fail in the usual way
+   mm::ModuleFileIdentity file;
+   const bool haveFile = pHub->IsInitialized() &&
+      file.Read(pluginManager_->GetModuleFilename(moduleName));
+   const std::string fingerprint =
+      haveFile ? GetHubFingerprint(pHub) : std::string();
+
+   std::vector<std::pair<std::string, std::string> > peripherals;
+   if (haveFile && !refresh && capabilityCache_->GetPeripherals(moduleName,
+            file, fingerprint, peripherals))
+      return peripherals;
+
+   for (const std::string& name : pHub->GetInstalledPeripheralNames())
+   {
+      peripherals.push_back(std::make_pair(name,
+               pHub->GetInstalledPeripheralDescription(name)));
+   }
+   if (haveFile)
+   {
+      capabilityCache_->SetPeripherals(moduleName, file,
+            module->GetModuleVersion(), module->GetDeviceInterfaceVersion(),
+            fingerprint, peripherals);
+   }
+   return peripherals;
+}
+
+// The caller must hold the hub's module lock
+std::string
+CMMCore::GetHubFingerprint(std::shared_ptr<HubInstance> pHub) throw (CMMError)
+{
+   // What the hub finds depends on what it is connected to, which is set
+   // through its pre-initialization properties
+   std::string fingerprint = pHub->GetName();
+   for (const std::string& prop : pHub->GetPropertyNames())
+   {
+      if (pHub->GetPropertyInitStatus(prop.c_str()))
+         fingerprint += "\n" + prop + "=" + pHub->GetProperty(prop);
+   }
+   return fingerprint;
+}
+
+void CMMCore::InvalidateCachedPeripherals(const std::string& hubLabel)
+{
+   if (!capabilityCache_ || hubLabel.empty())
+      return;
+   try
+   {
+      std::shared_ptr<HubInstance> pHub =
+         deviceManager_->GetDeviceOfType<HubInstance>(hubLabel);
+      mm::DeviceModuleLockGuard guard(pHub);
+      capabilityCache_->InvalidatePeripherals(
+            pHub->GetAdapterModule()->GetName(), GetHubFingerprint(pHub));
+   }
+   catch (const CMMError& e)
+   {
+      // The hub is gone or cannot be queried; its entry, if any, is then
+      // only used for a hub that answers the same way
+      LOG_WARNING(coreLogger_) << "Cannot drop the cached peripherals of " <<
+         hubLabel << ": " << e.getMsg();
+   }
+}
+
+std::string CMMCore::GetImageTagsJSON(const Metadata& md,
+      const unsigned* cameraChannelIndex,
+      bool includeSystemStateCache) throw (CMMError)
+{
+   std::shared_ptr<const mm::SystemStateTags> systemState =
+      GetSystemStateTags();
+   mm::ImageTags tags(md, includeSystemStateCache ? systemState :
+         std::shared_ptr<const mm::SystemStateTags>());
+
+   tags.SetInteger("BitDepth", getImageBitDepth());
+   tags.SetFloat("PixelSizeUm", getPixelSizeUm(true));
+   std::string affine;
+   std::vector<double> affineTransform = getPixelSizeAffine(true);
+   if (affineTransform.size() == 6)
+   {
+      for (size_t i = 0; i < affineTransform.size(); ++i)
+      {
+         if (i > 0)
+            affine += ';';
+         affine += mm::FormatJSONNumber(affineTransform[i]);
+      }
+   }
+   tags.SetString("PixelSizeAffine", affine);
+
+   int x, y, xSize, ySize;
+   getROI(x, y, xSize, ySize);
+   tags.SetString("ROI", ToString(x) + "-" + ToString(y) + "-" +
+         ToString(xSize) + "-" + ToString(ySize));
+   tags.SetInteger("Width", getImageWidth());
+   tags.SetInteger("Height", getImageHeight());
+
+   std::string pixelType;
+   switch (getBytesPerPixel())
+   {
+      case 1:
+         pixelType = "GRAY8";
+         break;
+      case 2:
+         pixelType = "GRAY16";
+         break;
+      case 4:
+         pixelType = getNumberOfComponents() == 1 ? "GRAY32" : "RGB32";
+         break;
+      case 8:
+         pixelType = "RGB64";
+         break;
+   }
+   tags.SetString("PixelType", pixelType);
+
+   tags.SetInteger("Frame", 0);
+   tags.SetInteger("FrameIndex", 0);
+   tags.SetString("Position", "Default");
+   tags.SetInteger("PositionIndex", 0);
+   tags.SetInteger("Slice", 0);
+   tags.SetInteger("SliceIndex", 0);
+   std::string channel = getCurrentConfigFromCache(getChannelGroup().c_str());
+   if (channel.empty())
+      channel = "Default";
+   tags.SetString("Channel", channel);
+   tags.SetInteger("ChannelIndex", 0);
+
+   std::string camera = getCameraDevice();
+   if (!camera.empty())
+   {
+      std::map<std::string, std::string>::const_iterator binning =
+         systemState->values.find(camera + "-" + MM::g_Keyword_Binning);
+      if (binning != systemState->values.end())
+         tags.SetString("Binning", binning->second);
+      else
+      {
+         try
+         {
+            tags.SetString("Binning",
+                  getProperty(camera.c_str(), MM::g_Keyword_Binning));
+         }
+         catch (const CMMError&)
+         {
+         }
+      }
+   }
+
+   if (cameraChannelIndex)
+   {
+      if (!tags.Has("CameraChannelIndex"))
+      {
+         tags.SetInteger("CameraChannelIndex", *cameraChannelIndex);
+         tags.SetInteger("ChannelIndex", *cameraChannelIndex);
+      }
+      std::string coreCamera, physicalCamera;
+      if (!tags.Has("Camera") &&
+            tags.GetString(std::string(MM::g_Keyword_CoreDevice) + "-" +
+               MM::g_Keyword_CoreCamera, coreCamera) &&
+            tags.GetString(coreCamera + "-Physical Camera " +
+               ToString(1 + *cameraChannelIndex), physicalCamera))
+      {
+         tags.SetString("Camera", physicalCamera);
+         tags.SetString("Channel", physicalCamera);
+      }
+   }
+
+   return tags.ToJSON();
+}
+
 /**
  * Set all properties in a configuration
  * Upon error, don't stop, but try to set all failed properties again
@@ -7683,10 +9052,37 @@ MM::DeviceDetectionStatus CMMCore::detectDevice(const char* label)
  * @param hubDeviceLabel    the label for the device of type Hub
  */
 std::vector<std::string> CMMCore::getInstalledDevices(const char* hubDeviceLabel) throw (CMMError)
+{
+   return getInstalledDevices(hubDeviceLabel, false);
+}
+
+/**
+ * Performs auto-detection of child devices that are attached to a Hub device,
+ * as getInstalledDevices(const char*) does.
+ *
+ * With refresh set, the hub is asked even if the device capability cache has
+ * an answer, and the cache is updated with what the hub finds. Use this when
+ * the hardware connected to the hub may have changed, e.g. in a configuration
+ * wizard.
+ *
+ * @param hubDeviceLabel    the label for the device of type Hub
+ * @param refresh           whether to bypass the device capability cache
+ */
+std::vector<std::string> CMMCore::getInstalledDevices(const char* hubDeviceLabel,
+      bool refresh) throw (CMMError)
 {
    std::shared_ptr<HubInstance> pHub =
       deviceManager_->GetDeviceOfType<HubInstance>(hubDeviceLabel);
 
+   if (capabilityCache_)
+   {
+      std::vector<std::string> names;
+      for (const std::pair<std::string, std::string>& peripheral :
+            GetCachedInstalledDevices(pHub, refresh))
+         names.push_back(peripheral.first);
+      return names;
+   }
+
    mm::DeviceModuleLockGuard guard(pHub);
    return pHub->GetInstalledPeripheralNames();
 }
@@ -7703,6 +9099,19 @@ std::string CMMCore::getInstalledDeviceDescription(const char* hubLabel, const c
       deviceManager_->GetDeviceOfType<HubInstance>(hubLabel);
    CheckDeviceLabel(deviceLabel);
 
+   if (capabilityCache_)
+   {
+      for (const std::pair<std::string, std::string>& peripheral :
+            GetCachedInstalledDevices(pHub, false))
+      {
+         if (peripheral.first == deviceLabel)
+            return peripheral.second.empty() ? "N/A" : peripheral.second;
+      }
+      throw CMMError("No peripheral with name " +
+            ToQuotedString(deviceLabel) + " installed in hub " +
+            ToQuotedString(hubLabel));
+   }
+
    std::string description;
    {
       mm::DeviceModuleLockGuard guard(pHub);
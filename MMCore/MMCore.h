@@ -66,6 +66,7 @@
 #include "ErrorCodes.h"
 #include "Logging/Logger.h"
 
+#include <atomic>
 #include <cstring>
 #include <deque>
 #include <map>
@@ -95,11 +96,13 @@ class CorePropertyCollection;
 class MMEventCallback;
 class Metadata;
 class PixelSizeConfigGroup;
+class ThreadPool;
 
 class AutoFocusInstance;
 class CameraInstance;
 class DeviceInstance;
 class GalvoInstance;
+class HubInstance;
 class ImageProcessorInstance;
 class SLMInstance;
 class ShutterInstance;
@@ -109,8 +112,15 @@ class XYStageInstance;
 class CMMCore;
 
 namespace mm {
+   class CapabilityCache;
+   struct CachedDevice;
    class DeviceManager;
+   class ImgBuffer;
    class LogManager;
+   class PendingInitializations;
+   class PropertyHandleTable;
+   struct PropertyHandleTarget;
+   struct SystemStateTags;
 } // namespace mm
 
 typedef unsigned int* imgRGB32;
@@ -163,6 +173,15 @@ public:
    void initializeAllDevices() throw (CMMError);
    void initializeDevice(const char* label) throw (CMMError);
    DeviceInitializationState getDeviceInitializationState(const char* label) const throw (CMMError);
+   void setDeviceInitializationTimeoutMs(long timeoutMs) throw (CMMError);
+   long getDeviceInitializationTimeoutMs();
+   std::vector<std::string> getDeviceInitializationTimeline();
+   unsigned getThreadPoolSize();
+   void setThreadPoolAffinity(const std::vector<long>& cpus) throw (CMMError);
+   void setAcquisitionThreadPriority(long priority) throw (CMMError);
+   long getAcquisitionThreadPriority();
+   void setAcquisitionThreadCPUs(const std::vector<long>& cpus) throw (CMMError);
+   std::vector<long> getAcquisitionThreadCPUs();
    void reset() throw (CMMError);
 
    void unloadLibrary(const char* moduleName) throw (CMMError);
@@ -212,6 +231,10 @@ public:
    std::vector<std::string> getAvailableDevices(const char* library) throw (CMMError);
    std::vector<std::string> getAvailableDeviceDescriptions(const char* library) throw (CMMError);
    std::vector<long> getAvailableDeviceTypes(const char* library) throw (CMMError);
+
+   void setDeviceCapabilityCacheFile(const char* filename) throw (CMMError);
+   std::string getDeviceCapabilityCacheFile();
+   void clearDeviceCapabilityCache();
    ///@}
 
    /** \name Generic device control.
@@ -229,12 +252,20 @@ public:
    std::vector<std::string> getDevicePropertyNames(const char* label) throw (CMMError);
    bool hasProperty(const char* label, const char* propName) throw (CMMError);
    std::string getProperty(const char* label, const char* propName) throw (CMMError);
+   double getPropertyAsDouble(const char* label, const char* propName) throw (CMMError);
+   long getPropertyAsLong(const char* label, const char* propName) throw (CMMError);
    void setProperty(const char* label, const char* propName, const char* propValue) throw (CMMError);
    void setProperty(const char* label, const char* propName, const bool propValue) throw (CMMError);
    void setProperty(const char* label, const char* propName, const long propValue) throw (CMMError);
    void setProperty(const char* label, const char* propName, const float propValue) throw (CMMError);
    void setProperty(const char* label, const char* propName, const double propValue) throw (CMMError);
 
+   long getPropertyHandle(const char* label, const char* propName) throw (CMMError);
+   std::string getPropertyByHandle(long handle) throw (CMMError);
+   void setPropertyByHandle(long handle, const char* propValue) throw (CMMError);
+   void setPropertyByHandle(long handle, const long propValue) throw (CMMError);
+   void setPropertyByHandle(long handle, const double propValue) throw (CMMError);
+
    std::vector<std::string> getAllowedPropertyValues(const char* label, const char* propName) throw (CMMError);
    bool isPropertyReadOnly(const char* label, const char* propName) throw (CMMError);
    bool isPropertyPreInit(const char* label, const char* propName) throw (CMMError);
@@ -248,6 +279,8 @@ public:
    void stopPropertySequence(const char* label, const char* propName) throw (CMMError);
    long getPropertySequenceMaxLength(const char* label, const char* propName) throw (CMMError);
    void loadPropertySequence(const char* label, const char* propName, std::vector<std::string> eventSequence) throw (CMMError);
+   void loadPropertySequence(const char* label, const char* propName, const std::vector<double>& eventSequence) throw (CMMError);
+   void loadPropertySequence(const char* label, const char* propName, const std::vector<long>& eventSequence) throw (CMMError);
 
    bool deviceBusy(const char* label) throw (CMMError);
    void waitForDevice(const char* label) throw (CMMError);
@@ -418,7 +451,33 @@ public:
       const throw (CMMError);
    void* popNextImageMD(Metadata& md) throw (CMMError);
 
+   unsigned long getImageInto(void* buffer,
+         unsigned long bufferSize) throw (CMMError);
+   unsigned long getImageInto(unsigned cameraChannelIndex, void* buffer,
+         unsigned long bufferSize) throw (CMMError);
+   unsigned long getLastImageInto(void* buffer, unsigned long bufferSize,
+         Metadata& md) throw (CMMError);
+   unsigned long popNextImageInto(void* buffer, unsigned long bufferSize,
+         Metadata& md) throw (CMMError);
+   unsigned long popNextImageInto(unsigned channel, void* buffer,
+         unsigned long bufferSize, Metadata& md) throw (CMMError);
+   unsigned long popNextImages(unsigned long maxCount, void* buffer,
+         unsigned long bufferSize) throw (CMMError);
+   unsigned long popNextImages(unsigned long maxCount, void* buffer,
+         unsigned long bufferSize, std::vector<Metadata>& md) throw (CMMError);
+   unsigned long popNextImages(unsigned channel, unsigned long maxCount,
+         void* buffer, unsigned long bufferSize,
+         std::vector<Metadata>& md) throw (CMMError);
+
+   std::string getTaggedImageTags(const Metadata& md,
+         bool includeSystemStateCache) throw (CMMError);
+   std::string getTaggedImageTags(const Metadata& md,
+         unsigned cameraChannelIndex,
+         bool includeSystemStateCache) throw (CMMError);
+
    long getRemainingImageCount();
+   bool waitForNextImage(long timeoutMs) throw (CMMError);
+   bool waitForImageCount(long count, long timeoutMs) throw (CMMError);
    long getBufferTotalCapacity();
    long getBufferFreeCapacity();
    bool isBufferOverflowed() const;
@@ -426,6 +485,16 @@ public:
    unsigned getCircularBufferMemoryFootprint();
    void initializeCircularBuffer() throw (CMMError);
    void clearCircularBuffer() throw (CMMError);
+   void enableCircularBufferPacking(bool enable);
+   bool isCircularBufferPackingEnabled();
+
+   void enableFrameStatistics(bool enable);
+   bool isFrameStatisticsEnabled();
+   void setFrameStatisticsHistogramBins(unsigned bins) throw (CMMError);
+   unsigned getFrameStatisticsHistogramBins();
+
+   double getHardwareTimestampDriftPpm(const char* cameraLabel) throw (CMMError);
+   double getHardwareTimestampJitterUs(const char* cameraLabel) throw (CMMError);
 
    bool isExposureSequenceable(const char* cameraLabel) throw (CMMError);
    void startExposureSequence(const char* cameraLabel) throw (CMMError);
@@ -620,6 +689,8 @@ public:
          const char* parentHubLabel) throw (CMMError);
 
    std::vector<std::string> getInstalledDevices(const char* hubLabel) throw (CMMError);
+   std::vector<std::string> getInstalledDevices(const char* hubLabel,
+         bool refresh) throw (CMMError);
    std::string getInstalledDeviceDescription(const char* hubLabel,
          const char* peripheralLabel) throw (CMMError);
    std::vector<std::string> getLoadedPeripheralDevices(const char* hubLabel) throw (CMMError);
@@ -651,6 +722,16 @@ private:
    std::string channelGroup_;
    long pollingIntervalMs_;
    long timeoutMs_;
+   long initializationTimeoutMs_;
+   // One entry per device, from the last initializeAllDevices()
+   std::vector<std::string> initializationTimeline_;
+   // Devices still inside Initialize(), including any that timed out; shared
+   // with the initialization threads
+   std::shared_ptr<mm::PendingInitializations> pendingInitializations_;
+   // Given to devices for their image acquisition threads, which may ask for
+   // them from any thread
+   std::atomic<long> acquisitionThreadPriority_; // 0 for normal scheduling
+   std::atomic<unsigned long long> acquisitionThreadCPUMask_; // 0 for all CPUs
    bool autoShutter_;
    std::vector<double> *nullAffine_;
    MM::Core* callback_;                 // core services for devices
@@ -659,15 +740,23 @@ private:
    MMEventCallback* externalCallback_;  // notification hook to the higher layer (e.g. GUI)
    PixelSizeConfigGroup* pixelSizeGroup_;
    CircularBuffer* cbuf_;
+   bool frameStatisticsEnabled_;
+   unsigned frameStatisticsBins_;
+   bool circularBufferPacking_;
 
    std::shared_ptr<CPluginManager> pluginManager_;
    std::shared_ptr<mm::DeviceManager> deviceManager_;
+   std::shared_ptr<mm::PropertyHandleTable> propertyHandles_;
+   std::shared_ptr<mm::CapabilityCache> capabilityCache_; // Null if disabled
+   std::shared_ptr<ThreadPool> threadPool_; // Shared with cbuf_
    std::map<int, std::string> errorText_;
 
    // Must be unlocked when calling MMEventCallback or calling device methods
    // or acquiring a module lock
    mutable MMThreadLock stateCacheLock_;
    mutable Configuration stateCache_; // Synchronized by stateCacheLock_
+   // Encoded form of stateCache_; synchronized by stateCacheLock_
+   mutable std::shared_ptr<const mm::SystemStateTags> systemStateTags_;
 
    MMThreadLock* pPostedErrorsLock_;
    mutable std::deque<std::pair< int, std::string> > postedErrors_;
@@ -684,8 +773,38 @@ private:
    static void CheckConfigGroupName(const char* groupName) throw (CMMError);
    static void CheckConfigPresetName(const char* presetName) throw (CMMError);
    bool IsCoreDeviceLabel(const char* label) const throw (CMMError);
+   std::shared_ptr<DeviceInstance> GetPropertyHandleDevice(
+         const mm::PropertyHandleTarget& target) throw (CMMError);
+   // Typed property access, updating the state cache; return false if the
+   // property requires the string form
+   bool GetPropertyValue(std::shared_ptr<DeviceInstance> pDevice,
+         const char* label, const char* propName, double& value) throw (CMMError);
+   bool GetPropertyValue(std::shared_ptr<DeviceInstance> pDevice,
+         const char* label, const char* propName, long& value) throw (CMMError);
+   bool SetPropertyValue(std::shared_ptr<DeviceInstance> pDevice,
+         const char* label, const char* propName, double value) throw (CMMError);
+   bool SetPropertyValue(std::shared_ptr<DeviceInstance> pDevice,
+         const char* label, const char* propName, long value) throw (CMMError);
+   // Using the capability cache, which must be enabled
+   std::vector<mm::CachedDevice> GetCachedAvailableDevices(
+         const char* moduleName) throw (CMMError);
+   std::vector<std::pair<std::string, std::string> > GetCachedInstalledDevices(
+         std::shared_ptr<HubInstance> pHub, bool refresh) throw (CMMError);
+   std::string GetHubFingerprint(std::shared_ptr<HubInstance> pHub) throw (CMMError);
+   // Drops the cached peripherals of the hub, e.g. after one failed
+   void InvalidateCachedPeripherals(const std::string& hubLabel);
+   // Null cameraChannelIndex if the image is not from a multi-channel camera
+   std::string GetImageTagsJSON(const Metadata& md,
+         const unsigned* cameraChannelIndex,
+         bool includeSystemStateCache) throw (CMMError);
+   std::shared_ptr<const mm::SystemStateTags> GetSystemStateTags() const;
+   void CheckImageDestination(const void* buffer, unsigned long bufferSize,
+         unsigned long imageSize) const throw (CMMError);
+   unsigned long CopyImageInto(const mm::ImgBuffer& image, void* buffer,
+         unsigned long bufferSize, Metadata& md) const throw (CMMError);
 
    void applyConfiguration(const Configuration& config) throw (CMMError);
+   void appendDeviceState(Configuration& config, const std::string& label);
    int applyProperties(std::vector<PropertySetting>& props, std::string& lastError);
    void waitForDevice(std::shared_ptr<DeviceInstance> pDev) throw (CMMError);
    Configuration getConfigGroupState(const char* group, bool fromCache) throw (CMMError);
@@ -698,7 +817,7 @@ private:
    void loadSystemConfigurationImpl(const char* fileName) throw (CMMError);
    void initializeAllDevicesSerial() throw (CMMError);
    void initializeAllDevicesParallel() throw (CMMError);
-   int initializeVectorOfDevices(std::vector<std::pair<std::shared_ptr<DeviceInstance>, std::string> > pDevices);
+   void waitForPendingInitializations() throw (CMMError);
 };
 
 #if defined(__GNUC__) && !defined(__clang__)
@@ -27,7 +27,10 @@
 #else
    #include <sys/types.h>
    #include <dirent.h>
+   #include <fcntl.h>
+   #include <unistd.h>
 #endif // _WIN32
+#include <sys/stat.h>
 
 #include "../MMDevice/ModuleInterface.h"
 #include "CoreUtils.h"
@@ -82,7 +85,8 @@ CPluginManager::~CPluginManager()
  * @param filename the name of the file to look up.
  */
 std::string
-CPluginManager::FindInSearchPath(std::string filename)
+CPluginManager::FindInSearchPath(const std::string& moduleName,
+      std::string filename)
 {
    for (const auto& p : searchPaths_) {
       std::string path = p;
@@ -92,7 +96,12 @@ CPluginManager::FindInSearchPath(std::string filename)
       path += "/" + filename;
       #endif
 
-      // test whether it exists
+      const std::vector<std::string>& modules = GetCachedModules(p);
+      if (std::find(modules.begin(), modules.end(), moduleName) != modules.end())
+         return path;
+
+      // test whether it exists (the listing omits some names, e.g. on
+      // Windows those containing a dot)
       std::ifstream in(path.c_str(), std::ifstream::in);
       in.close();
 
@@ -133,13 +142,9 @@ CPluginManager::GetDeviceAdapter(const std::string& moduleName)
       return it->second;
    }
 
-   std::string filename(LIB_NAME_PREFIX);
-   filename += moduleName;
-   filename += LIB_NAME_SUFFIX;
-   filename = FindInSearchPath(filename);
-
    std::shared_ptr<LoadedDeviceAdapter> module =
-      std::make_shared<LoadedDeviceAdapter>(moduleName, filename);
+      std::make_shared<LoadedDeviceAdapter>(moduleName,
+            GetModuleFilename(moduleName));
    moduleMap_[moduleName] = module;
    return module;
 }
@@ -154,6 +159,75 @@ CPluginManager::GetDeviceAdapter(const char* moduleName)
    return GetDeviceAdapter(std::string(moduleName));
 }
 
+// Ask the operating system to start reading the file into memory
+static void
+AdviseWillLoad(const std::string& filename)
+{
+#if defined(__linux__)
+   int fd = open(filename.c_str(), O_RDONLY | O_CLOEXEC);
+   if (fd < 0)
+      return;
+   posix_fadvise(fd, 0, 0, POSIX_FADV_WILLNEED);
+   close(fd);
+#else
+   (void)filename;
+#endif
+}
+
+/**
+ * Load several modules ahead of GetDeviceAdapter().
+ *
+ * The dynamic loader holds a process-wide lock while it maps and relocates a
+ * library (with glibc as well as on Windows), so loading on several threads
+ * is no faster than loading one module after another. What can overlap is
+ * reading the files from disk: on Linux the reads for all modules are started
+ * before the first module is loaded.
+ *
+ * Modules that are already loaded are skipped. Errors are not reported here:
+ * a module that fails to load is loaded again, and fails with the same error,
+ * when it is requested with GetDeviceAdapter().
+ *
+ * @param moduleNames Simple module names without path, prefix, or suffix.
+ */
+void
+CPluginManager::LoadDeviceAdapters(const std::vector<std::string>& moduleNames)
+{
+   std::vector<std::string> names;
+   std::vector<std::string> filenames;
+   for (const std::string& name : moduleNames)
+   {
+      if (name.empty() || moduleMap_.count(name) ||
+            std::find(names.begin(), names.end(), name) != names.end())
+         continue;
+      names.push_back(name);
+      filenames.push_back(GetModuleFilename(name));
+   }
+
+   for (const std::string& filename : filenames)
+      AdviseWillLoad(filename);
+
+   for (size_t i = 0; i < names.size(); ++i)
+   {
+      try
+      {
+         moduleMap_[names[i]] =
+            std::make_shared<LoadedDeviceAdapter>(names[i], filenames[i]);
+      }
+      catch (const CMMError&)
+      {
+      }
+   }
+}
+
+std::string
+CPluginManager::GetModuleFilename(const std::string& moduleName)
+{
+   std::string filename(LIB_NAME_PREFIX);
+   filename += moduleName;
+   filename += LIB_NAME_SUFFIX;
+   return FindInSearchPath(moduleName, filename);
+}
+
 /** 
  * Unload a module.
  */
@@ -280,6 +354,44 @@ CPluginManager::GetModules(std::vector<std::string> &modules, const char* search
 }
 
 
+/**
+ * List the modules at a given path, scanning the directory only if it has
+ * been modified since it was last scanned.
+ */
+const std::vector<std::string>&
+CPluginManager::GetCachedModules(const std::string& path)
+{
+   static const std::vector<std::string> none;
+
+#ifdef _WIN32
+   struct _stat64 st;
+   if (_stat64(path.c_str(), &st) != 0)
+#else
+   struct stat st;
+   if (stat(path.c_str(), &st) != 0)
+#endif
+   {
+      listings_.erase(path);
+      return none;
+   }
+
+   // The modification time has a resolution of (at worst) one second, so a
+   // scan made within the second of a modification may have missed a further
+   // modification in that second. Such a scan is not reused.
+   std::map<std::string, DirectoryListing>::iterator it = listings_.find(path);
+   if (it != listings_.end() && it->second.mtime == st.st_mtime &&
+         it->second.scanTime > st.st_mtime + 1)
+      return it->second.modules;
+
+   DirectoryListing& listing = listings_[path];
+   listing.mtime = st.st_mtime;
+   listing.scanTime = std::time(0);
+   listing.modules.clear();
+   GetModules(listing.modules, path.c_str());
+   return listing.modules;
+}
+
+
 /**
  * List all modules (device libraries) in all search paths.
  */
@@ -288,7 +400,10 @@ CPluginManager::GetAvailableDeviceAdapters()
 {
    std::vector<std::string> modules;
    for (const auto& path : searchPaths_)
-      GetModules(modules, path.c_str());
+   {
+      const std::vector<std::string>& found = GetCachedModules(path);
+      modules.insert(modules.end(), found.begin(), found.end());
+   }
 
    // Check for duplicates
    // XXX Is this the right place to be doing this checking? Shouldn't it be an
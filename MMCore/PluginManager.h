@@ -24,6 +24,7 @@
 
 #include "../MMDevice/DeviceThreads.h"
 
+#include <ctime>
 #include <map>
 #include <memory>
 #include <string>
@@ -55,12 +56,34 @@ public:
    std::shared_ptr<LoadedDeviceAdapter>
    GetDeviceAdapter(const char* moduleName);
 
+   /**
+    * Load device adapter modules ahead of GetDeviceAdapter()
+    */
+   void LoadDeviceAdapters(const std::vector<std::string>& moduleNames);
+
+   bool IsModuleLoaded(const std::string& moduleName) const
+   { return moduleMap_.count(moduleName) > 0; }
+   // The file that GetDeviceAdapter() would load
+   std::string GetModuleFilename(const std::string& moduleName);
+
 private:
+   // Modules found in a search path directory, reused for as long as the
+   // directory's modification time does not change
+   struct DirectoryListing
+   {
+      std::time_t mtime;
+      std::time_t scanTime;
+      std::vector<std::string> modules;
+   };
+
    static std::vector<std::string> GetDefaultSearchPaths();
    static void GetModules(std::vector<std::string> &modules, const char *path);
-   std::string FindInSearchPath(std::string filename);
+   const std::vector<std::string>& GetCachedModules(const std::string& path);
+   std::string FindInSearchPath(const std::string& moduleName,
+         std::string filename);
 
    std::vector<std::string> searchPaths_;
+   std::map<std::string, DirectoryListing> listings_;
 
    std::map< std::string, std::shared_ptr<LoadedDeviceAdapter> > moduleMap_;
 };
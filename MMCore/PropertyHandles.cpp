@@ -0,0 +1,60 @@
+///////////////////////////////////////////////////////////////////////////////
+// FILE:          PropertyHandles.cpp
+// PROJECT:       Micro-Manager
+// SUBSYSTEM:     MMCore
+//-----------------------------------------------------------------------------
+// DESCRIPTION:   Device properties resolved once and referred to by handle.
+//
+// LICENSE:       This file is distributed under the "Lesser GPL" (LGPL) license.
+//                License text is included with the source distribution.
+//
+//                This file is distributed in the hope that it will be useful,
+//                but WITHOUT ANY WARRANTY; without even the implied warranty
+//                of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+//
+//                IN NO EVENT SHALL THE COPYRIGHT OWNER OR
+//                CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+//                INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES.
+
+#include "PropertyHandles.h"
+
+#include "CoreUtils.h"
+#include "Error.h"
+
+namespace mm {
+
+long
+PropertyHandleTable::Add(const std::string& label, const std::string& name,
+      std::shared_ptr<DeviceInstance> device)
+{
+   std::shared_ptr<PropertyHandleTarget> target =
+      std::make_shared<PropertyHandleTarget>();
+   target->label = label;
+   target->name = name;
+   target->device = device;
+
+   MMThreadGuard g(lock_);
+   std::pair<std::string, std::string> key(label, name);
+   std::map<std::pair<std::string, std::string>, long>::const_iterator found =
+      index_.find(key);
+   if (found != index_.end())
+   {
+      targets_[found->second] = target;
+      return found->second;
+   }
+   long handle = static_cast<long>(targets_.size());
+   targets_.push_back(target);
+   index_[key] = handle;
+   return handle;
+}
+
+std::shared_ptr<const PropertyHandleTarget>
+PropertyHandleTable::Get(long handle) const
+{
+   MMThreadGuard g(lock_);
+   if (handle < 0 || handle >= static_cast<long>(targets_.size()))
+      throw CMMError("Invalid property handle " + ToString(handle));
+   return targets_[handle];
+}
+
+} // namespace mm
@@ -0,0 +1,70 @@
+///////////////////////////////////////////////////////////////////////////////
+// FILE:          PropertyHandles.h
+// PROJECT:       Micro-Manager
+// SUBSYSTEM:     MMCore
+//-----------------------------------------------------------------------------
+// DESCRIPTION:   Device properties resolved once and referred to by handle.
+//
+// LICENSE:       This file is distributed under the "Lesser GPL" (LGPL) license.
+//                License text is included with the source distribution.
+//
+//                This file is distributed in the hope that it will be useful,
+//                but WITHOUT ANY WARRANTY; without even the implied warranty
+//                of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+//
+//                IN NO EVENT SHALL THE COPYRIGHT OWNER OR
+//                CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+//                INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES.
+
+#pragma once
+
+#include "../MMDevice/DeviceThreads.h"
+
+#include <map>
+#include <memory>
+#include <string>
+#include <utility>
+#include <vector>
+
+class DeviceInstance;
+
+namespace mm {
+
+/**
+ * The property a handle refers to.
+ *
+ * Targets are immutable; re-resolving a handle replaces its target.
+ */
+struct PropertyHandleTarget
+{
+   std::string label;
+   std::string name;
+   // The device the property was resolved on; null for Core properties. If
+   // the device has been unloaded, the label is resolved again.
+   std::weak_ptr<DeviceInstance> device;
+};
+
+/**
+ * Handles of resolved properties.
+ *
+ * A handle is the index of its target, so handle lookup does not involve
+ * any string comparison. Resolving the same property again returns the same
+ * handle, so the table only grows with the number of distinct properties.
+ */
+class PropertyHandleTable
+{
+public:
+   // Returns the handle for the property, updating its device
+   long Add(const std::string& label, const std::string& name,
+         std::shared_ptr<DeviceInstance> device);
+
+   // Throws CMMError if the handle is invalid
+   std::shared_ptr<const PropertyHandleTarget> Get(long handle) const;
+
+private:
+   mutable MMThreadLock lock_;
+   std::vector<std::shared_ptr<const PropertyHandleTarget> > targets_;
+   std::map<std::pair<std::string, std::string>, long> index_;
+};
+
+} // namespace mm
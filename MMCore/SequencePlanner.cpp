@@ -0,0 +1,451 @@
+///////////////////////////////////////////////////////////////////////////////
+// FILE:          SequencePlanner.cpp
+// PROJECT:       Micro-Manager
+// SUBSYSTEM:     MMCore
+//-----------------------------------------------------------------------------
+// DESCRIPTION:   Splits a multi-dimensional acquisition into runs that can be
+//                played as hardware sequences, and runs them.
+//
+// LICENSE:       This file is distributed under the "Lesser GPL" (LGPL) license.
+//                License text is included with the source distribution.
+//
+//                This file is distributed in the hope that it will be useful,
+//                but WITHOUT ANY WARRANTY; without even the implied warranty
+//                of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+//
+//                IN NO EVENT SHALL THE COPYRIGHT OWNER OR
+//                CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+//                INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES.
+
+#include "SequencePlanner.h"
+
+#include "CoreUtils.h"
+#include "Error.h"
+#include "MMCore.h"
+
+#include "../MMDevice/ImageMetadata.h"
+
+#include <chrono>
+#include <set>
+#include <thread>
+#include <tuple>
+
+namespace mm {
+
+bool SequenceAxis::operator<(const SequenceAxis& other) const
+{
+   return std::tie(kind, device, property) <
+      std::tie(other.kind, other.device, other.property);
+}
+
+bool SequenceValue::operator==(const SequenceValue& other) const
+{
+   return x == other.x && y == other.y && text == other.text;
+}
+
+SequenceEvent& SequenceEvent::SetStagePosition(const std::string& stage,
+      double um)
+{
+   SequenceAxis axis = { SequenceAxis::Stage, stage, std::string() };
+   SequenceValue value;
+   value.x = um;
+   settings_[axis] = value;
+   return *this;
+}
+
+SequenceEvent& SequenceEvent::SetXYPosition(const std::string& xyStage,
+      double xUm, double yUm)
+{
+   SequenceAxis axis = { SequenceAxis::XYStage, xyStage, std::string() };
+   SequenceValue value;
+   value.x = xUm;
+   value.y = yUm;
+   settings_[axis] = value;
+   return *this;
+}
+
+SequenceEvent& SequenceEvent::SetExposure(double ms)
+{
+   SequenceAxis axis = { SequenceAxis::Exposure, std::string(), std::string() };
+   SequenceValue value;
+   value.x = ms;
+   settings_[axis] = value;
+   return *this;
+}
+
+SequenceEvent& SequenceEvent::SetProperty(const std::string& device,
+      const std::string& property, const std::string& value)
+{
+   SequenceAxis axis = { SequenceAxis::Property, device, property };
+   SequenceValue v;
+   v.text = value;
+   settings_[axis] = v;
+   return *this;
+}
+
+SequencePlanner::SequencePlanner(CMMCore& core,
+      const std::string& cameraLabel) :
+   core_(core),
+   camera_(cameraLabel.empty() ? core.getCameraDevice() : cameraLabel),
+   frameTimeoutMs_(5000.0)
+{
+}
+
+std::vector<SequenceRun> SequencePlanner::Split(
+      const std::vector<SequenceEvent::SettingMap>& settings,
+      const CapabilityMap& capabilities)
+{
+   std::vector<SequenceRun> runs;
+   std::size_t first = 0;
+   while (first < settings.size())
+   {
+      const SequenceEvent::SettingMap& start = settings[first];
+      std::set<SequenceAxis> changing;
+
+      // Grow the run while every axis that changes within it can be
+      // sequenced with the run's length
+      std::size_t end = first + 1;
+      for (; end < settings.size(); ++end)
+      {
+         const long length = static_cast<long>(end - first + 1);
+         std::set<SequenceAxis> newChanging = changing;
+         bool fits = true;
+         for (const auto& setting : settings[end])
+         {
+            auto it = start.find(setting.first);
+            if (it == start.end())
+               throw CMMError("Sequence event settings are incomplete");
+            if (it->second != setting.second)
+               newChanging.insert(setting.first);
+            if (newChanging.count(setting.first) == 0)
+               continue;
+            auto cap = capabilities.find(setting.first);
+            long maxLength = (cap == capabilities.end()) ? 0 : cap->second;
+            if (maxLength < length)
+            {
+               fits = false;
+               break;
+            }
+         }
+         if (!fits)
+            break;
+         changing.swap(newChanging);
+      }
+
+      SequenceRun run;
+      run.firstEvent = first;
+      run.eventCount = end - first;
+      for (const auto& setting : start)
+      {
+         if (changing.count(setting.first) == 0)
+         {
+            run.fixed[setting.first] = setting.second;
+            continue;
+         }
+         std::vector<SequenceValue>& values = run.sequenced[setting.first];
+         for (std::size_t i = first; i < end; ++i)
+            values.push_back(settings[i].at(setting.first));
+      }
+      runs.push_back(run);
+      first = end;
+   }
+   return runs;
+}
+
+std::vector<SequenceRun> SequencePlanner::Plan(
+      const std::vector<SequenceEvent>& events)
+{
+   std::vector<SequenceEvent::SettingMap> settings = Resolve(events);
+
+   // Only query the devices whose settings change at all
+   CapabilityMap capabilities;
+   for (std::size_t i = 1; i < settings.size(); ++i)
+   {
+      for (const auto& setting : settings[i])
+      {
+         if (capabilities.count(setting.first) == 0 &&
+               settings[0].at(setting.first) != setting.second)
+            capabilities[setting.first] = GetMaxSequenceLength(setting.first);
+      }
+   }
+   return Split(settings, capabilities);
+}
+
+void SequencePlanner::Run(const std::vector<SequenceEvent>& events,
+      const FrameHandler& handler)
+{
+   std::vector<SequenceRun> runs = Plan(events);
+   const SequenceRun* previous = 0;
+   for (const SequenceRun& run : runs)
+   {
+      // A setting that was already fixed at the same value does not need to
+      // be applied again
+      std::set<std::string> devices;
+      for (const auto& setting : run.fixed)
+      {
+         if (previous)
+         {
+            auto it = previous->fixed.find(setting.first);
+            if (it != previous->fixed.end() && it->second == setting.second)
+               continue;
+         }
+         Apply(setting.first, setting.second);
+         devices.insert(setting.first.kind == SequenceAxis::Exposure ?
+               camera_ : setting.first.device);
+      }
+      for (const std::string& device : devices)
+         core_.waitForDevice(device.c_str());
+
+      RunOne(run, handler);
+      previous = &run;
+   }
+}
+
+std::vector<SequenceEvent::SettingMap> SequencePlanner::Resolve(
+      const std::vector<SequenceEvent>& events)
+{
+   std::vector<SequenceEvent::SettingMap> settings;
+   if (events.empty())
+      return settings;
+
+   // Axes not set by the first event start out at their current value
+   SequenceEvent::SettingMap current = events[0].GetSettings();
+   for (const SequenceEvent& event : events)
+   {
+      for (const auto& setting : event.GetSettings())
+      {
+         if (current.count(setting.first) == 0)
+            current[setting.first] = GetCurrentValue(setting.first);
+      }
+   }
+
+   for (const SequenceEvent& event : events)
+   {
+      for (const auto& setting : event.GetSettings())
+         current[setting.first] = setting.second;
+      settings.push_back(current);
+   }
+   return settings;
+}
+
+SequenceValue SequencePlanner::GetCurrentValue(const SequenceAxis& axis)
+{
+   SequenceValue value;
+   const char* device = axis.device.c_str();
+   switch (axis.kind)
+   {
+      case SequenceAxis::Stage:
+         value.x = core_.getPosition(device);
+         break;
+      case SequenceAxis::XYStage:
+         core_.getXYPosition(device, value.x, value.y);
+         break;
+      case SequenceAxis::Exposure:
+         value.x = core_.getExposure(camera_.c_str());
+         break;
+      case SequenceAxis::Property:
+         value.text = core_.getProperty(device, axis.property.c_str());
+         break;
+   }
+   return value;
+}
+
+long SequencePlanner::GetMaxSequenceLength(const SequenceAxis& axis)
+{
+   const char* device = axis.device.c_str();
+   switch (axis.kind)
+   {
+      case SequenceAxis::Stage:
+         return core_.isStageSequenceable(device) ?
+            core_.getStageSequenceMaxLength(device) : 0;
+      case SequenceAxis::XYStage:
+         return core_.isXYStageSequenceable(device) ?
+            core_.getXYStageSequenceMaxLength(device) : 0;
+      case SequenceAxis::Exposure:
+         return core_.isExposureSequenceable(camera_.c_str()) ?
+            core_.getExposureSequenceMaxLength(camera_.c_str()) : 0;
+      case SequenceAxis::Property:
+         return core_.isPropertySequenceable(device, axis.property.c_str()) ?
+            core_.getPropertySequenceMaxLength(device, axis.property.c_str()) : 0;
+   }
+   return 0;
+}
+
+void SequencePlanner::Apply(const SequenceAxis& axis,
+      const SequenceValue& value)
+{
+   const char* device = axis.device.c_str();
+   switch (axis.kind)
+   {
+      case SequenceAxis::Stage:
+         core_.setPosition(device, value.x);
+         break;
+      case SequenceAxis::XYStage:
+         core_.setXYPosition(device, value.x, value.y);
+         break;
+      case SequenceAxis::Exposure:
+         core_.setExposure(camera_.c_str(), value.x);
+         break;
+      case SequenceAxis::Property:
+         core_.setProperty(device, axis.property.c_str(), value.text.c_str());
+         break;
+   }
+}
+
+void SequencePlanner::Load(const SequenceAxis& axis,
+      const std::vector<SequenceValue>& values)
+{
+   const char* device = axis.device.c_str();
+   std::vector<double> xs, ys;
+   std::vector<std::string> texts;
+   for (const SequenceValue& value : values)
+   {
+      xs.push_back(value.x);
+      ys.push_back(value.y);
+      texts.push_back(value.text);
+   }
+   switch (axis.kind)
+   {
+      case SequenceAxis::Stage:
+         core_.loadStageSequence(device, xs);
+         break;
+      case SequenceAxis::XYStage:
+         core_.loadXYStageSequence(device, xs, ys);
+         break;
+      case SequenceAxis::Exposure:
+         core_.loadExposureSequence(camera_.c_str(), xs);
+         break;
+      case SequenceAxis::Property:
+         core_.loadPropertySequence(device, axis.property.c_str(), texts);
+         break;
+   }
+}
+
+void SequencePlanner::Start(const SequenceAxis& axis)
+{
+   const char* device = axis.device.c_str();
+   switch (axis.kind)
+   {
+      case SequenceAxis::Stage:
+         core_.startStageSequence(device);
+         break;
+      case SequenceAxis::XYStage:
+         core_.startXYStageSequence(device);
+         break;
+      case SequenceAxis::Exposure:
+         core_.startExposureSequence(camera_.c_str());
+         break;
+      case SequenceAxis::Property:
+         core_.startPropertySequence(device, axis.property.c_str());
+         break;
+   }
+}
+
+void SequencePlanner::Stop(const SequenceAxis& axis)
+{
+   const char* device = axis.device.c_str();
+   switch (axis.kind)
+   {
+      case SequenceAxis::Stage:
+         core_.stopStageSequence(device);
+         break;
+      case SequenceAxis::XYStage:
+         core_.stopXYStageSequence(device);
+         break;
+      case SequenceAxis::Exposure:
+         core_.stopExposureSequence(camera_.c_str());
+         break;
+      case SequenceAxis::Property:
+         core_.stopPropertySequence(device, axis.property.c_str());
+         break;
+   }
+}
+
+/*
+ * Sequences are loaded before any of them is started, and all are started
+ * before the camera, so that the first trigger finds every device armed.
+ * They are stopped in the reverse order.
+ */
+void SequencePlanner::RunOne(const SequenceRun& run,
+      const FrameHandler& handler)
+{
+   for (const auto& sequence : run.sequenced)
+      Load(sequence.first, sequence.second);
+
+   std::vector<SequenceAxis> started;
+   bool cameraStarted = false;
+   try
+   {
+      for (const auto& sequence : run.sequenced)
+      {
+         Start(sequence.first);
+         started.push_back(sequence.first);
+      }
+
+      core_.startSequenceAcquisition(camera_.c_str(),
+            static_cast<long>(run.eventCount), 0.0, true);
+      cameraStarted = true;
+
+      const auto timeout = std::chrono::duration<double, std::milli>(frameTimeoutMs_);
+      for (std::size_t i = 0; i < run.eventCount; ++i)
+      {
+         const auto deadline = std::chrono::steady_clock::now() + timeout;
+         for (;;)
+         {
+            // Check for a stopped camera before the buffer, so that frames
+            // inserted just before it stopped are not missed
+            bool running = core_.isSequenceRunning(camera_.c_str());
+            if (core_.getRemainingImageCount() > 0)
+               break;
+            if (!running)
+               throw CMMError("Camera " + ToQuotedString(camera_) +
+                     " stopped after " + ToString(i) + " of " +
+                     ToString(run.eventCount) + " frames");
+            if (std::chrono::steady_clock::now() > deadline)
+               throw CMMError("Timed out waiting for frame " +
+                     ToString(run.firstEvent + i) + " from camera " +
+                     ToQuotedString(camera_));
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+         }
+
+         Metadata md;
+         const void* pixels = core_.popNextImageMD(md);
+         if (handler)
+            handler(run.firstEvent + i, pixels, md);
+      }
+
+      cameraStarted = false;
+      core_.stopSequenceAcquisition(camera_.c_str());
+      while (!started.empty())
+      {
+         SequenceAxis axis = started.back();
+         started.pop_back();
+         Stop(axis);
+      }
+   }
+   catch (...)
+   {
+      // Clean up as far as possible, reporting the original error
+      try
+      {
+         if (cameraStarted)
+            core_.stopSequenceAcquisition(camera_.c_str());
+      }
+      catch (const CMMError&)
+      {
+      }
+      for (auto it = started.rbegin(); it != started.rend(); ++it)
+      {
+         try
+         {
+            Stop(*it);
+         }
+         catch (const CMMError&)
+         {
+         }
+      }
+      throw;
+   }
+}
+
+} // namespace mm
@@ -0,0 +1,184 @@
+///////////////////////////////////////////////////////////////////////////////
+// FILE:          SequencePlanner.h
+// PROJECT:       Micro-Manager
+// SUBSYSTEM:     MMCore
+//-----------------------------------------------------------------------------
+// DESCRIPTION:   Splits a multi-dimensional acquisition into runs that can be
+//                played as hardware sequences, and runs them.
+//
+// LICENSE:       This file is distributed under the "Lesser GPL" (LGPL) license.
+//                License text is included with the source distribution.
+//
+//                This file is distributed in the hope that it will be useful,
+//                but WITHOUT ANY WARRANTY; without even the implied warranty
+//                of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+//
+//                IN NO EVENT SHALL THE COPYRIGHT OWNER OR
+//                CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+//                INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES.
+
+#pragma once
+
+#include <cstddef>
+#include <functional>
+#include <map>
+#include <string>
+#include <vector>
+
+class CMMCore;
+class Metadata;
+
+namespace mm {
+
+/**
+ * A setting that can change from one frame to the next: the position of a
+ * stage or XY stage, the exposure of the camera, or a device property.
+ */
+struct SequenceAxis
+{
+   enum Kind { Stage, XYStage, Exposure, Property };
+
+   Kind kind;
+   std::string device; // Empty for Exposure (the planner's camera)
+   std::string property; // Property only
+
+   bool operator<(const SequenceAxis& other) const;
+};
+
+/**
+ * The value of a SequenceAxis: x for Stage and Exposure, x and y for
+ * XYStage, text for Property.
+ */
+struct SequenceValue
+{
+   double x;
+   double y;
+   std::string text;
+
+   SequenceValue() : x(0.0), y(0.0) {}
+   bool operator==(const SequenceValue& other) const;
+   bool operator!=(const SequenceValue& other) const
+   { return !(*this == other); }
+};
+
+/**
+ * The settings for one frame.
+ *
+ * Settings that an event does not mention keep the value they had in the
+ * previous event (or, for the first event, the current hardware value).
+ */
+class SequenceEvent
+{
+public:
+   typedef std::map<SequenceAxis, SequenceValue> SettingMap;
+
+   SequenceEvent& SetStagePosition(const std::string& stage, double um);
+   SequenceEvent& SetXYPosition(const std::string& xyStage,
+         double xUm, double yUm);
+   SequenceEvent& SetExposure(double ms);
+   SequenceEvent& SetProperty(const std::string& device,
+         const std::string& property, const std::string& value);
+
+   const SettingMap& GetSettings() const { return settings_; }
+
+private:
+   SettingMap settings_;
+};
+
+/**
+ * A range of consecutive events that is acquired with a single camera
+ * sequence acquisition.
+ */
+struct SequenceRun
+{
+   std::size_t firstEvent;
+   std::size_t eventCount;
+   // Settings that are the same for all events of the run; applied before
+   // the run starts
+   std::map<SequenceAxis, SequenceValue> fixed;
+   // Settings that change within the run; loaded as hardware sequences with
+   // one value per event
+   std::map<SequenceAxis, std::vector<SequenceValue> > sequenced;
+};
+
+/**
+ * Plans and runs hardware-sequenced acquisitions.
+ *
+ * Given an ordered list of events, the planner splits them into the fewest
+ * runs such that within each run every setting that changes is hardware
+ * sequenceable and fits in the device's maximum sequence length. An event
+ * list longer than a device's maximum sequence length is thus played as
+ * consecutive runs, with the sequence reloaded in between.
+ *
+ * The devices must be set up to be triggered by the camera; the planner does
+ * not configure triggering.
+ */
+class SequencePlanner
+{
+public:
+   /**
+    * Called for each frame, in event order, with the index of the event the
+    * frame belongs to. The pixels are only valid during the call.
+    */
+   typedef std::function<void(std::size_t eventIndex, const void* pixels,
+         const Metadata& md)> FrameHandler;
+
+   // Maximum sequence length of each axis; 0 means not sequenceable
+   typedef std::map<SequenceAxis, long> CapabilityMap;
+
+   /**
+    * Uses the core's current camera unless cameraLabel is given.
+    */
+   explicit SequencePlanner(CMMCore& core,
+         const std::string& cameraLabel = std::string());
+
+   std::string GetCamera() const { return camera_; }
+
+   // How long to wait for each frame before giving up; default 5 s
+   void SetFrameTimeoutMs(double timeoutMs) { frameTimeoutMs_ = timeoutMs; }
+   double GetFrameTimeoutMs() const { return frameTimeoutMs_; }
+
+   /**
+    * Splits the events into runs, using the sequencing capabilities and
+    * current settings of the devices.
+    */
+   std::vector<SequenceRun> Plan(const std::vector<SequenceEvent>& events);
+
+   /**
+    * Plans and acquires the events.
+    *
+    * For each run, applies its fixed settings, loads and starts the
+    * sequences, acquires the run's frames and stops the sequences again.
+    * Sequences and the camera are stopped if an error occurs.
+    */
+   void Run(const std::vector<SequenceEvent>& events,
+         const FrameHandler& handler);
+
+   /**
+    * Splits fully specified settings (one map per event, each containing
+    * every axis) into runs. Exposed for testing.
+    */
+   static std::vector<SequenceRun> Split(
+         const std::vector<SequenceEvent::SettingMap>& settings,
+         const CapabilityMap& capabilities);
+
+private:
+   std::vector<SequenceEvent::SettingMap> Resolve(
+         const std::vector<SequenceEvent>& events);
+   SequenceValue GetCurrentValue(const SequenceAxis& axis);
+   long GetMaxSequenceLength(const SequenceAxis& axis);
+
+   void Apply(const SequenceAxis& axis, const SequenceValue& value);
+   void Load(const SequenceAxis& axis,
+         const std::vector<SequenceValue>& values);
+   void Start(const SequenceAxis& axis);
+   void Stop(const SequenceAxis& axis);
+
+   void RunOne(const SequenceRun& run, const FrameHandler& handler);
+
+   CMMCore& core_;
+   std::string camera_;
+   double frameTimeoutMs_;
+};
+
+} // namespace mm
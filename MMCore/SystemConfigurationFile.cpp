@@ -0,0 +1,156 @@
+///////////////////////////////////////////////////////////////////////////////
+// FILE:          SystemConfigurationFile.cpp
+// PROJECT:       Micro-Manager
+// SUBSYSTEM:     MMCore
+//-----------------------------------------------------------------------------
+// DESCRIPTION:   Parsing of system configuration (.cfg) files into commands.
+//
+// LICENSE:       This file is distributed under the "Lesser GPL" (LGPL) license.
+//                License text is included with the source distribution.
+//
+//                This file is distributed in the hope that it will be useful,
+//                but WITHOUT ANY WARRANTY; without even the implied warranty
+//                of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+//
+//                IN NO EVENT SHALL THE COPYRIGHT OWNER OR
+//                CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+//                INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES.
+
+#include "SystemConfigurationFile.h"
+
+#include "../MMDevice/DeviceUtils.h"
+#include "../MMDevice/MMDeviceConstants.h"
+
+namespace mm {
+
+namespace {
+
+typedef SystemConfigurationCommand Command;
+
+// Determines the kind of command from the name and number of fields
+// (including the name), or returns false if the command is unknown
+bool
+Classify(const std::string& name, size_t nFields, Command::Kind& kind,
+      bool& padValue)
+{
+   padValue = false;
+   kind = Command::Invalid;
+   if (name == MM::g_CFGCommand_Device)
+   {
+      if (nFields == 4)
+         kind = Command::Device;
+   }
+   else if (name == MM::g_CFGCommand_Property)
+   {
+      if (nFields == 4 || nFields == 3)
+      {
+         kind = Command::Property;
+         padValue = (nFields == 3);
+      }
+   }
+   else if (name == MM::g_CFGCommand_Delay)
+   {
+      if (nFields == 3)
+         kind = Command::Delay;
+   }
+   else if (name == MM::g_CFGCommand_FocusDirection)
+   {
+      if (nFields == 3)
+         kind = Command::FocusDirection;
+   }
+   else if (name == MM::g_CFGCommand_Label)
+   {
+      if (nFields == 4)
+         kind = Command::Label;
+   }
+   else if (name == MM::g_CFGCommand_Configuration)
+   {
+      if (nFields == 5)
+         kind = Command::ObsoleteConfig;
+   }
+   else if (name == MM::g_CFGCommand_ConfigGroup)
+   {
+      if (nFields == 6 || nFields == 5)
+      {
+         kind = Command::ConfigPreset;
+         padValue = (nFields == 5);
+      }
+      else if (nFields == 2)
+         kind = Command::ConfigGroup;
+   }
+   else if (name == MM::g_CFGCommand_ConfigPixelSize)
+   {
+      if (nFields == 5)
+         kind = Command::ConfigPixelSize;
+   }
+   else if (name == MM::g_CFGCommand_PixelSize_um)
+   {
+      if (nFields == 3)
+         kind = Command::PixelSizeUm;
+   }
+   else if (name == MM::g_CFGCommand_PixelSizeAffine)
+   {
+      if (nFields == 8)
+         kind = Command::PixelSizeAffine;
+   }
+   else if (name == MM::g_CFGCommand_ParentID)
+   {
+      if (nFields == 3)
+         kind = Command::Parent;
+   }
+   else if (name == MM::g_CFGCommand_Equipment ||
+         name == MM::g_CFGCommand_ImageSynchro)
+   {
+      // Removed; files using these cannot be loaded correctly
+   }
+   else
+   {
+      return false;
+   }
+   return true;
+}
+
+} // anonymous namespace
+
+std::vector<SystemConfigurationCommand>
+ParseSystemConfiguration(std::istream& is)
+{
+   std::vector<Command> commands;
+   std::string line;
+   std::vector<std::string> tokens;
+   int lineNumber = 0;
+   while (std::getline(is, line))
+   {
+      ++lineNumber;
+
+      // Anything from a CR on is ignored (normally just the CR of a CRLF)
+      const std::string::size_type cr = line.find('\r');
+      if (cr != std::string::npos)
+         line.erase(cr);
+      if (line.empty() || line[0] == '#')
+         continue;
+
+      tokens.clear();
+      CDeviceUtils::Tokenize(line, tokens, MM::g_FieldDelimiters);
+
+      Command command;
+      command.lineNumber = lineNumber;
+      command.kind = Command::Invalid;
+      bool padValue = false;
+      if (!tokens.empty() &&
+            !Classify(tokens[0], tokens.size(), command.kind, padValue))
+         continue;
+
+      command.line = line;
+      if (command.kind != Command::Invalid)
+      {
+         command.args.assign(tokens.begin() + 1, tokens.end());
+         if (padValue)
+            command.args.push_back(std::string());
+      }
+      commands.push_back(command);
+   }
+   return commands;
+}
+
+} // namespace mm
@@ -0,0 +1,67 @@
+///////////////////////////////////////////////////////////////////////////////
+// FILE:          SystemConfigurationFile.h
+// PROJECT:       Micro-Manager
+// SUBSYSTEM:     MMCore
+//-----------------------------------------------------------------------------
+// DESCRIPTION:   Parsing of system configuration (.cfg) files into commands.
+//
+// LICENSE:       This file is distributed under the "Lesser GPL" (LGPL) license.
+//                License text is included with the source distribution.
+//
+//                This file is distributed in the hope that it will be useful,
+//                but WITHOUT ANY WARRANTY; without even the implied warranty
+//                of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+//
+//                IN NO EVENT SHALL THE COPYRIGHT OWNER OR
+//                CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+//                INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES.
+
+#pragma once
+
+#include <istream>
+#include <string>
+#include <vector>
+
+namespace mm {
+
+/**
+ * A line of a system configuration file, checked for its number of fields.
+ */
+struct SystemConfigurationCommand
+{
+   enum Kind
+   {
+      Device,            // label, module, device name
+      Property,          // label, property, value
+      Delay,             // label, delay (ms)
+      FocusDirection,    // label, direction
+      Label,             // label, state, state label
+      ObsoleteConfig,    // (ignored)
+      ConfigGroup,       // group
+      ConfigPreset,      // group, preset, label, property, value
+      ConfigPixelSize,   // resolution ID, label, property, value
+      PixelSizeUm,       // resolution ID, pixel size
+      PixelSizeAffine,   // resolution ID, 6 coefficients
+      Parent,            // label, parent label
+      Invalid,           // wrong number of fields, or a removed command
+   };
+
+   Kind kind;
+   int lineNumber; // 1-based
+   std::string line; // Without the line ending
+   // The fields following the command name; an omitted trailing value is
+   // given as an empty string
+   std::vector<std::string> args;
+};
+
+/**
+ * Reads a whole system configuration file.
+ *
+ * Comments, blank lines, and lines with unknown commands are dropped. Lines
+ * that cannot be executed are returned with kind Invalid, so that the caller
+ * can reject the file before executing any of it.
+ */
+std::vector<SystemConfigurationCommand>
+ParseSystemConfiguration(std::istream& is);
+
+} // namespace mm
@@ -25,8 +25,9 @@
 
 #include <cassert>
 
-TaskSet::TaskSet(std::shared_ptr<ThreadPool> pool)
+TaskSet::TaskSet(std::shared_ptr<ThreadPool> pool, ThreadPool::Priority priority)
     : pool_(pool),
+    priority_(priority),
     semaphore_(std::make_shared<Semaphore>())
 {
     assert(pool);
@@ -45,7 +46,8 @@ size_t TaskSet::GetUsedTaskCount() const
 
 void TaskSet::Execute()
 {
-   pool_->Execute(std::vector<Task*>(tasks_.begin(), tasks_.begin() + usedTaskCount_));
+   pool_->Execute(std::vector<Task*>(tasks_.begin(), tasks_.begin() + usedTaskCount_),
+       priority_);
 }
 
 void TaskSet::Wait()
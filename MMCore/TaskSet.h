@@ -33,7 +33,8 @@
 class TaskSet
 {
 public:
-    explicit TaskSet(std::shared_ptr<ThreadPool> pool);
+    explicit TaskSet(std::shared_ptr<ThreadPool> pool,
+        ThreadPool::Priority priority = ThreadPool::Priority::Critical);
     virtual ~TaskSet();
 
     TaskSet(const TaskSet&) = delete;
@@ -64,6 +65,7 @@ protected:
 
 protected:
     const std::shared_ptr<ThreadPool> pool_;
+    const ThreadPool::Priority priority_;
     const std::shared_ptr<Semaphore> semaphore_;
     std::vector<Task*> tasks_{};
     size_t usedTaskCount_{ 0 };
@@ -27,6 +27,31 @@
 #include <cassert>
 #include <cstring>
 
+namespace
+{
+
+// Copies in blocks small enough to stay in L1/L2 cache and accumulates the
+// statistics of each block right after copying it, so that the pixels are
+// read from memory only once.
+void CopyWithStatistics(void* dst, const void* src, size_t pixels,
+    unsigned byteDepth, mm::FrameStatistics& stats)
+{
+    const size_t blockPixels = 32768 / byteDepth;
+    char* d = static_cast<char*>(dst);
+    const char* s = static_cast<const char*>(src);
+    while (pixels > 0)
+    {
+        const size_t n = std::min(pixels, blockPixels);
+        std::memcpy(d, s, n * byteDepth);
+        stats.Accumulate(reinterpret_cast<const unsigned char*>(d), n);
+        d += n * byteDepth;
+        s += n * byteDepth;
+        pixels -= n;
+    }
+}
+
+} // namespace
+
 TaskSet_CopyMemory::ATask::ATask(std::shared_ptr<Semaphore> semDone, size_t taskIndex, size_t totalTaskCount)
     : Task(semDone, taskIndex, totalTaskCount)
 {
@@ -38,6 +63,15 @@ void TaskSet_CopyMemory::ATask::SetUp(void* dst, const void* src, size_t bytes,
     src_ = src;
     bytes_ = bytes;
     usedTaskCount_ = usedTaskCount;
+    collectStats_ = false;
+}
+
+void TaskSet_CopyMemory::ATask::SetUpStatistics(unsigned byteDepth, unsigned histogramBins, unsigned bitDepth)
+{
+    collectStats_ = true;
+    byteDepth_ = byteDepth;
+    histogramBins_ = histogramBins;
+    bitDepth_ = bitDepth;
 }
 
 void TaskSet_CopyMemory::ATask::Execute()
@@ -45,6 +79,22 @@ void TaskSet_CopyMemory::ATask::Execute()
     if (taskIndex_ >= usedTaskCount_)
         return;
 
+    if (collectStats_)
+    {
+        // Split on pixel boundaries
+        const size_t pixels = bytes_ / byteDepth_;
+        size_t chunkPixels = pixels / usedTaskCount_;
+        const size_t chunkOffset = taskIndex_ * chunkPixels * byteDepth_;
+        if (taskIndex_ == usedTaskCount_ - 1)
+            chunkPixels += pixels % usedTaskCount_;
+
+        stats_.Reset(histogramBins_, bitDepth_, byteDepth_, chunkPixels);
+        CopyWithStatistics(static_cast<char*>(dst_) + chunkOffset,
+            static_cast<const char*>(src_) + chunkOffset, chunkPixels, byteDepth_, stats_);
+        stats_.Finalize();
+        return;
+    }
+
     size_t chunkBytes = bytes_ / usedTaskCount_;
     const size_t chunkOffset = taskIndex_ * chunkBytes;
     if (taskIndex_ == usedTaskCount_ - 1)
@@ -104,3 +154,35 @@ void TaskSet_CopyMemory::MemCopy(void* dst, const void* src, size_t bytes)
     Execute();
     Wait();
 }
+
+void TaskSet_CopyMemory::MemCopy(void* dst, const void* src, size_t bytes, unsigned byteDepth,
+    unsigned histogramBins, unsigned bitDepth, mm::FrameStatistics& stats)
+{
+    assert(dst);
+    assert(src);
+    assert(byteDepth == 1 || byteDepth == 2);
+
+    const size_t pixels = bytes / byteDepth;
+    usedTaskCount_ = std::min<size_t>(1 + bytes / 1000000, tasks_.size());
+    if (usedTaskCount_ <= 1)
+    {
+        usedTaskCount_ = 1;
+        stats.Reset(histogramBins, bitDepth, byteDepth, pixels);
+        CopyWithStatistics(dst, src, pixels, byteDepth, stats);
+        stats.Finalize();
+        return;
+    }
+
+    for (Task* task : tasks_)
+    {
+        ATask* aTask = static_cast<ATask*>(task);
+        aTask->SetUp(dst, src, bytes, usedTaskCount_);
+        aTask->SetUpStatistics(byteDepth, histogramBins, bitDepth);
+    }
+    TaskSet::Execute();
+    semaphore_->Wait(usedTaskCount_);
+
+    stats.Reset(histogramBins, bitDepth, byteDepth, 0);
+    for (size_t n = 0; n < usedTaskCount_; ++n)
+        stats.Merge(static_cast<ATask*>(tasks_[n])->GetStatistics());
+}
@@ -23,6 +23,7 @@
 
 #pragma once
 
+#include "FrameStatistics.h"
 #include "TaskSet.h"
 
 class TaskSet_CopyMemory : public TaskSet
@@ -34,13 +35,22 @@ private:
         explicit ATask(std::shared_ptr<Semaphore> semDone, size_t taskIndex, size_t totalTaskCount);
 
         void SetUp(void* dst, const void* src, size_t bytes, size_t usedTaskCount);
+        void SetUpStatistics(unsigned byteDepth, unsigned histogramBins, unsigned bitDepth);
 
         virtual void Execute() override;
 
+        const mm::FrameStatistics& GetStatistics() const { return stats_; }
+
     private:
         void* dst_{ nullptr };
         const void* src_{ nullptr };
         size_t bytes_{ 0 };
+
+        bool collectStats_{ false };
+        unsigned byteDepth_{ 1 };
+        unsigned histogramBins_{ 0 };
+        unsigned bitDepth_{ 0 };
+        mm::FrameStatistics stats_{};
     };
 
 public:
@@ -53,4 +63,9 @@ public:
 
     // Helper blocking method calling SetUp, Execute and Wait
     void MemCopy(void* dst, const void* src, size_t bytes);
+
+    // Blocking copy of a single-component 8- or 16-bit frame that also
+    // computes the frame statistics in the same pass over the data
+    void MemCopy(void* dst, const void* src, size_t bytes, unsigned byteDepth,
+        unsigned histogramBins, unsigned bitDepth, mm::FrameStatistics& stats);
 };
@@ -4,7 +4,8 @@
 // SUBSYSTEM:     MMCore
 //-----------------------------------------------------------------------------
 // DESCRIPTION:   A class executing queued tasks on separate threads
-//                and scaling number of threads based on hardware.
+//                and scaling number of threads based on hardware, with
+//                work stealing between threads and two priority classes.
 //
 // AUTHOR:        Tomas Hanak, tomas.hanak@teledyne.com, 03/03/2021
 //                Andrej Bencur, andrej.bencur@teledyne.com, 03/03/2021
@@ -22,21 +23,44 @@
 //                CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
 //                INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES.
 
+#if defined(__linux__) && !defined(_GNU_SOURCE)
+// Provide pthread_setaffinity_np()
+#   define _GNU_SOURCE
+#endif
+
 #include "ThreadPool.h"
 
 #include "Task.h"
 
 #include <algorithm>
 #include <cassert>
+#include <exception>
 #include <mutex>
 #include <thread>
 
-ThreadPool::ThreadPool()
+#ifdef _WIN32
+#   include <Windows.h>
+#elif defined(__linux__)
+#   include <pthread.h>
+#   include <sched.h>
+#endif
+
+namespace
+{
+    // The pool that the current thread belongs to, if any
+    thread_local const ThreadPool* currentPool = nullptr;
+    thread_local size_t currentWorker = 0;
+}
+
+ThreadPool::ThreadPool(size_t threadCount)
 {
-    const size_t hwThreadCount = std::max<size_t>(1, std::thread::hardware_concurrency());
-    for (size_t n = 0; n < hwThreadCount; ++n)
+    if (threadCount == 0)
+        threadCount = (std::max<size_t>)(1, std::thread::hardware_concurrency());
+    for (size_t n = 0; n < threadCount; ++n)
+        workers_.push_back(std::make_unique<Worker>());
+    for (size_t n = 0; n < threadCount; ++n)
     {
-        auto thread = std::make_unique<std::thread>(&ThreadPool::ThreadFunc, this);
+        auto thread = std::make_unique<std::thread>(&ThreadPool::ThreadFunc, this, n);
         threads_.push_back(std::move(thread));
     }
 }
@@ -44,10 +68,10 @@ ThreadPool::ThreadPool()
 ThreadPool::~ThreadPool()
 {
     {
-        std::lock_guard<std::mutex> lock(mx_);
+        std::lock_guard<std::mutex> lock(sleepMx_);
         abortFlag_ = true;
     }
-    cv_.notify_all();
+    sleepCv_.notify_all();
 
     for (const auto& thread : threads_)
         thread->join();
@@ -58,49 +82,235 @@ size_t ThreadPool::GetSize() const
     return threads_.size();
 }
 
-void ThreadPool::Execute(Task* task)
+void ThreadPool::Execute(Task* task, Priority priority)
 {
     assert(task);
+    if (abortFlag_)
+        return;
+    if (IsWorkerThread())
     {
-        std::lock_guard<std::mutex> lock(mx_);
-        if (abortFlag_)
-            return;
-        queue_.push_back(task);
+        task->Execute();
+        task->Done();
+        return;
     }
-    cv_.notify_one();
+    std::vector<Job> jobs{ [task]() { task->Execute(); task->Done(); } };
+    Submit(jobs, priority);
 }
 
-void ThreadPool::Execute(const std::vector<Task*>& tasks)
+void ThreadPool::Execute(const std::vector<Task*>& tasks, Priority priority)
 {
     assert(!tasks.empty());
-
+    if (abortFlag_)
+        return;
+    if (IsWorkerThread())
     {
-        std::lock_guard<std::mutex> lock(mx_);
-        if (abortFlag_)
-            return;
         for (Task* task : tasks)
         {
-            assert(task);
-            queue_.push_back(task);
+            task->Execute();
+            task->Done();
         }
+        return;
     }
-    cv_.notify_all();
+
+    std::vector<Job> jobs;
+    jobs.reserve(tasks.size());
+    for (Task* task : tasks)
+    {
+        assert(task);
+        jobs.push_back([task]() { task->Execute(); task->Done(); });
+    }
+    Submit(jobs, priority);
 }
 
-void ThreadPool::ThreadFunc()
+void ThreadPool::ParallelFor(size_t count, const std::function<void(size_t)>& func,
+    Priority priority)
 {
-    for (;;)
+    if (count == 0)
+        return;
+
+    // Shared with the helper jobs, which may still be queued (with nothing
+    // left to do) after this function returns
+    struct State
     {
-        Task* task = nullptr;
+        std::function<void(size_t)> func{};
+        size_t count{ 0 };
+        std::atomic<size_t> next{ 0 };
+        std::atomic<size_t> done{ 0 };
+        std::mutex mx{};
+        std::condition_variable cv{};
+        std::exception_ptr error{};
+    };
+    auto state = std::make_shared<State>();
+    state->func = func;
+    state->count = count;
+
+    auto run = [](State& s)
+    {
+        for (;;)
         {
-            std::unique_lock<std::mutex> lock(mx_);
-            cv_.wait(lock, [&]() { return abortFlag_ || !queue_.empty(); });
-            if (abortFlag_)
-                break;
-            task = queue_.front();
-            queue_.pop_front();
+            const size_t index = s.next++;
+            if (index >= s.count)
+                return;
+            try
+            {
+                s.func(index);
+            }
+            catch (...)
+            {
+                std::lock_guard<std::mutex> lock(s.mx);
+                if (!s.error)
+                    s.error = std::current_exception();
+            }
+            if (++s.done == s.count)
+            {
+                std::lock_guard<std::mutex> lock(s.mx);
+                s.cv.notify_all();
+            }
         }
-        task->Execute();
-        task->Done();
+    };
+
+    const size_t helperCount = abortFlag_ ? 0 : (std::min)(count - 1, GetSize());
+    if (helperCount > 0)
+    {
+        std::vector<Job> jobs(helperCount, [state, run]() { run(*state); });
+        Submit(jobs, priority);
+    }
+
+    run(*state);
+
+    std::unique_lock<std::mutex> lock(state->mx);
+    state->cv.wait(lock, [&]() { return state->done == state->count; });
+    if (state->error)
+        std::rethrow_exception(state->error);
+}
+
+bool ThreadPool::SetAffinity(const std::vector<unsigned>& cpus)
+{
+#if defined(__linux__)
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    if (cpus.empty())
+    {
+        // The kernel leaves out CPUs that the process may not use
+        for (unsigned cpu = 0; cpu < CPU_SETSIZE; ++cpu)
+            CPU_SET(cpu, &set);
+    }
+    for (unsigned cpu : cpus)
+    {
+        if (cpu >= CPU_SETSIZE)
+            return false;
+        CPU_SET(cpu, &set);
+    }
+    bool ok = true;
+    for (const auto& thread : threads_)
+    {
+        if (pthread_setaffinity_np(thread->native_handle(), sizeof(set), &set) != 0)
+            ok = false;
+    }
+    return ok;
+#elif defined(_WIN32)
+    DWORD_PTR mask = 0;
+    if (cpus.empty())
+    {
+        DWORD_PTR systemMask = 0;
+        if (!GetProcessAffinityMask(GetCurrentProcess(), &mask, &systemMask))
+            return false;
+    }
+    for (unsigned cpu : cpus)
+    {
+        if (cpu >= sizeof(DWORD_PTR) * 8)
+            return false;
+        mask |= static_cast<DWORD_PTR>(1) << cpu;
+    }
+    bool ok = true;
+    for (const auto& thread : threads_)
+    {
+        if (!SetThreadAffinityMask(thread->native_handle(), mask))
+            ok = false;
+    }
+    return ok;
+#else
+    // Not available (e.g. macOS only supports affinity hints)
+    (void)cpus;
+    return false;
+#endif
+}
+
+void ThreadPool::Submit(std::vector<Job>& jobs, Priority priority)
+{
+    // Counted before the jobs are queued, so that the count cannot drop
+    // below zero. A worker woken in between finds nothing and waits again.
+    {
+        std::lock_guard<std::mutex> lock(sleepMx_);
+        pending_ += jobs.size();
+    }
+
+    const bool fromWorker = IsWorkerThread();
+    for (Job& job : jobs)
+    {
+        const size_t index = fromWorker ? currentWorker : nextWorker_++ % workers_.size();
+        Worker& worker = *workers_[index];
+        std::lock_guard<std::mutex> lock(worker.mx);
+        if (priority == Priority::Critical)
+            worker.critical.push_back(std::move(job));
+        else
+            worker.background.push_back(std::move(job));
+    }
+
+    if (jobs.size() == 1)
+        sleepCv_.notify_one();
+    else
+        sleepCv_.notify_all();
+}
+
+bool ThreadPool::TryRunJob(size_t self)
+{
+    // A worker takes its own newest job, which is likely still in cache, or
+    // else the oldest job of another worker
+    const size_t workerCount = workers_.size();
+    Job job;
+    for (int pass = 0; pass < 2 && !job; ++pass)
+    {
+        for (size_t n = 0; n < workerCount && !job; ++n)
+        {
+            Worker& worker = *workers_[(self + n) % workerCount];
+            std::lock_guard<std::mutex> lock(worker.mx);
+            std::deque<Job>& queue = (pass == 0) ? worker.critical : worker.background;
+            if (queue.empty())
+                continue;
+            if (n == 0)
+            {
+                job = std::move(queue.back());
+                queue.pop_back();
+            }
+            else
+            {
+                job = std::move(queue.front());
+                queue.pop_front();
+            }
+        }
+    }
+    if (!job)
+        return false;
+    --pending_;
+    job();
+    return true;
+}
+
+bool ThreadPool::IsWorkerThread() const
+{
+    return currentPool == this;
+}
+
+void ThreadPool::ThreadFunc(size_t index)
+{
+    currentPool = this;
+    currentWorker = index;
+    while (!abortFlag_)
+    {
+        if (TryRunJob(index))
+            continue;
+        std::unique_lock<std::mutex> lock(sleepMx_);
+        sleepCv_.wait(lock, [&]() { return abortFlag_ || pending_ > 0; });
     }
 }
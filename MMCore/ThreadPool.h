@@ -4,7 +4,8 @@
 // SUBSYSTEM:     MMCore
 //-----------------------------------------------------------------------------
 // DESCRIPTION:   A class executing queued tasks on separate threads
-//                and scaling number of threads based on hardware.
+//                and scaling number of threads based on hardware, with
+//                work stealing between threads and two priority classes.
 //
 // AUTHOR:        Tomas Hanak, tomas.hanak@teledyne.com, 03/03/2021
 //                Andrej Bencur, andrej.bencur@teledyne.com, 03/03/2021
@@ -24,8 +25,11 @@
 
 #pragma once
 
+#include <atomic>
 #include <condition_variable>
+#include <cstddef>
 #include <deque>
+#include <functional>
 #include <memory>
 #include <mutex>
 #include <thread>
@@ -33,24 +37,62 @@
 
 class Task;
 
+// Each worker thread has its own queues. Work submitted from a worker goes to
+// that worker's queues; other work is spread over the workers. An idle worker
+// takes work from the other workers' queues. Critical work is always taken
+// before background work.
 class ThreadPool final
 {
 public:
-    explicit ThreadPool();
+    enum class Priority
+    {
+        Critical,   // On the acquisition path, e.g. copying images
+        Background, // Run only when no critical work is queued
+    };
+
+    // A threadCount of 0 means one thread per hardware thread
+    explicit ThreadPool(size_t threadCount = 0);
     ~ThreadPool();
 
     size_t GetSize() const;
 
-    void Execute(Task* task);
-    void Execute(const std::vector<Task*>& tasks);
+    // Tasks signal completion through Task::Done(). When called from one of
+    // this pool's threads, the tasks are run immediately on that thread, so
+    // that waiting for them cannot deadlock the pool.
+    void Execute(Task* task, Priority priority = Priority::Critical);
+    void Execute(const std::vector<Task*>& tasks, Priority priority = Priority::Critical);
+
+    // Calls func(0) to func(count - 1) on the pool threads and the calling
+    // thread, and returns when all calls have completed. If any call throws,
+    // the first exception is rethrown after all calls have completed.
+    void ParallelFor(size_t count, const std::function<void(size_t)>& func,
+        Priority priority = Priority::Critical);
+
+    // Restricts the pool threads to the given CPUs (all CPUs available to
+    // the process if empty). Returns false if not supported or if it failed.
+    bool SetAffinity(const std::vector<unsigned>& cpus);
 
 private:
-    void ThreadFunc();
+    using Job = std::function<void()>;
+
+    struct Worker
+    {
+        std::mutex mx{};
+        std::deque<Job> critical{};
+        std::deque<Job> background{};
+    };
+
+    void Submit(std::vector<Job>& jobs, Priority priority);
+    bool TryRunJob(size_t self);
+    bool IsWorkerThread() const;
+    void ThreadFunc(size_t index);
 
 private:
+    std::vector<std::unique_ptr<Worker>> workers_{};
     std::vector<std::unique_ptr<std::thread>> threads_{};
-    bool abortFlag_{ false };
-    std::mutex mx_{};
-    std::condition_variable cv_{};
-    std::deque<Task*> queue_{};
+    std::atomic<size_t> nextWorker_{ 0 };
+    std::atomic<size_t> pending_{ 0 };
+    std::atomic<bool> abortFlag_{ false };
+    std::mutex sleepMx_{};
+    std::condition_variable sleepCv_{};
 };
@@ -0,0 +1,197 @@
+#include <catch2/catch_all.hpp>
+
+#include "CircularBuffer.h"
+#include "CoreUtils.h"
+#include "MMCore.h"
+
+#include "../MMDevice/DeviceThreads.h"
+#include "../MMDevice/ImageMetadata.h"
+#include "../MMDevice/MMDeviceConstants.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <thread>
+#include <vector>
+
+TEST_CASE("CPU lists are parsed and formatted", "[AcquisitionThreads]")
+{
+   std::vector<long> cpus;
+   CHECK(ParseCPUList("", cpus));
+   CHECK(cpus.empty());
+   CHECK(ParseCPUList(" 6 2-4  0 ", cpus));
+   CHECK(cpus == std::vector<long>{ 6, 2, 3, 4, 0 });
+   CHECK(FormatCPUList(cpus) == "0 2-4 6");
+   CHECK(FormatCPUList({ 1, 1, 2 }) == "1-2");
+
+   CHECK_FALSE(ParseCPUList("1,2", cpus));
+   CHECK_FALSE(ParseCPUList("-1", cpus));
+   CHECK_FALSE(ParseCPUList("3-", cpus));
+   CHECK_FALSE(ParseCPUList("3-1", cpus));
+   CHECK_FALSE(ParseCPUList("0-100000", cpus));
+   CHECK_FALSE(ParseCPUList("x", cpus));
+}
+
+TEST_CASE("Acquisition thread placement is set through Core properties", "[AcquisitionThreads]")
+{
+   CMMCore c;
+   CHECK(c.getAcquisitionThreadPriority() == 0);
+   CHECK(c.getAcquisitionThreadCPUs().empty());
+   CHECK(c.getProperty("Core", MM::g_Keyword_CoreAcquisitionThreadPriority) == "0");
+   CHECK(c.getProperty("Core", MM::g_Keyword_CoreAcquisitionThreadCPUs).empty());
+
+   c.setProperty("Core", MM::g_Keyword_CoreAcquisitionThreadPriority, "40");
+   CHECK(c.getAcquisitionThreadPriority() == 40);
+   c.setProperty("Core", MM::g_Keyword_CoreAcquisitionThreadCPUs, "3 1-2");
+   CHECK(c.getAcquisitionThreadCPUs() == std::vector<long>{ 1, 2, 3 });
+   CHECK(c.getProperty("Core", MM::g_Keyword_CoreAcquisitionThreadCPUs) == "1-3");
+
+   // Rejected values leave the settings in effect
+   CHECK_THROWS_AS(c.setProperty("Core",
+            MM::g_Keyword_CoreAcquisitionThreadPriority, "100"), CMMError);
+   CHECK(c.getProperty("Core", MM::g_Keyword_CoreAcquisitionThreadPriority) == "40");
+   CHECK_THROWS_AS(c.setProperty("Core",
+            MM::g_Keyword_CoreAcquisitionThreadCPUs, "1,2"), CMMError);
+   CHECK_THROWS_AS(c.setProperty("Core",
+            MM::g_Keyword_CoreAcquisitionThreadCPUs, "64"), CMMError);
+   CHECK(c.getProperty("Core", MM::g_Keyword_CoreAcquisitionThreadCPUs) == "1-3");
+   CHECK(c.getAcquisitionThreadCPUs() == std::vector<long>{ 1, 2, 3 });
+
+   c.setAcquisitionThreadPriority(0);
+   c.setAcquisitionThreadCPUs({});
+   CHECK(c.getProperty("Core", MM::g_Keyword_CoreAcquisitionThreadPriority) == "0");
+   CHECK(c.getProperty("Core", MM::g_Keyword_CoreAcquisitionThreadCPUs).empty());
+   CHECK_THROWS_AS(c.setAcquisitionThreadPriority(-1), CMMError);
+}
+
+namespace {
+
+// Inserts frames into a circular buffer at a fixed rate, like a camera's
+// sequence thread, and records the intervals between inserts
+class InsertThread : public MMDeviceThreadBase
+{
+public:
+   InsertThread(CircularBuffer& buffer, unsigned width, unsigned height,
+         std::chrono::microseconds period, size_t frameCount) :
+      buffer_(buffer), width_(width), height_(height), period_(period),
+      frameCount_(frameCount), pixels_(width * height * 2, 1)
+   {}
+
+   std::atomic<bool> done{ false };
+   std::vector<double> intervalsUs;
+
+   int svc() override
+   {
+      Metadata md;
+      md.PutImageTag(MM::g_Keyword_Metadata_CameraLabel, "Camera");
+      auto next = std::chrono::steady_clock::now();
+      auto last = next;
+      for (size_t i = 0; i <= frameCount_; ++i)
+      {
+         next += period_;
+         std::this_thread::sleep_until(next);
+         buffer_.InsertImage(pixels_.data(), width_, height_, 2, &md);
+         const auto now = std::chrono::steady_clock::now();
+         if (i > 0)
+            intervalsUs.push_back(
+                  std::chrono::duration<double, std::micro>(now - last).count());
+         last = now;
+      }
+      done = true;
+      return 0;
+   }
+
+private:
+   CircularBuffer& buffer_;
+   unsigned width_;
+   unsigned height_;
+   std::chrono::microseconds period_;
+   size_t frameCount_;
+   std::vector<unsigned char> pixels_;
+};
+
+void MeasureJitter(const char* name, const MMThreadAttributes& attributes)
+{
+   const unsigned width = 512;
+   const unsigned height = 512;
+   const std::chrono::microseconds period(1000);
+   const size_t frameCount = 3000;
+
+   CircularBuffer buffer(64);
+   REQUIRE(buffer.Initialize(1, width, height, 2));
+
+   // Keep every CPU busy with memory traffic
+   std::atomic<bool> stopLoad{ false };
+   std::vector<std::thread> load;
+   const unsigned loadCount = std::max(1u, std::thread::hardware_concurrency());
+   for (unsigned n = 0; n < loadCount; ++n)
+   {
+      load.emplace_back([&stopLoad]
+      {
+         std::vector<char> a(4 << 20, 1), b(4 << 20);
+         while (!stopLoad)
+            std::memcpy(b.data(), a.data(), a.size());
+      });
+   }
+
+   InsertThread inserter(buffer, width, height, period, frameCount);
+   inserter.setAttributes(attributes);
+   inserter.activate();
+   while (!inserter.done)
+   {
+      while (buffer.GetNextImage())
+         ;
+      std::this_thread::sleep_for(std::chrono::milliseconds(1));
+   }
+   inserter.wait();
+   stopLoad = true;
+   for (std::thread& t : load)
+      t.join();
+
+   std::vector<double> intervals = inserter.intervalsUs;
+   REQUIRE(intervals.size() == frameCount);
+   double sum = 0.0;
+   for (double d : intervals)
+      sum += d;
+   const double mean = sum / intervals.size();
+   double sumSq = 0.0;
+   for (double d : intervals)
+      sumSq += (d - mean) * (d - mean);
+   std::sort(intervals.begin(), intervals.end());
+   std::printf("%s%s: interval mean %.1f us, SD %.1f us, "
+         "99th percentile %.1f us, max %.1f us (%u load threads)\n",
+         name, inserter.attributesApplied() ? "" : " (not applied)", mean,
+         std::sqrt(sumSq / intervals.size()),
+         intervals[intervals.size() * 99 / 100], intervals.back(), loadCount);
+}
+
+} // anonymous namespace
+
+// Benchmark, run only when selected, e.g. with the tag [AcquisitionJitter].
+// Inserts 512x512 16-bit frames every 1 ms while other threads load all CPUs,
+// with normal and with real-time scheduling. The CPUs for the inserting
+// thread can be given in the environment variable MM_JITTER_CPUS (e.g.
+// "2-3"), as in the Core property AcquisitionThreadCPUs.
+TEST_CASE("Insert interval jitter under load", "[.][AcquisitionJitter]")
+{
+   MMThreadAttributes attributes;
+   const char* cpuList = std::getenv("MM_JITTER_CPUS");
+   std::vector<long> cpus;
+   if (cpuList && ParseCPUList(cpuList, cpus))
+   {
+      for (long cpu : cpus)
+      {
+         if (cpu < 64)
+            attributes.cpuMask |= 1ULL << cpu;
+      }
+   }
+   MeasureJitter("Normal", attributes);
+   attributes.policy = MMThreadAttributes::PolicyRealTime;
+   attributes.priority = 50;
+   MeasureJitter("Real-time 50", attributes);
+}
@@ -0,0 +1,251 @@
+#include <catch2/catch_all.hpp>
+
+#include "CapabilityCache.h"
+#include "MMCore.h"
+#include "PluginManager.h"
+#include "SequenceTesterFixture.h"
+
+#include <cstdio>
+#include <fstream>
+#include <string>
+#include <utility>
+#include <vector>
+
+using namespace mm;
+
+namespace {
+
+typedef std::vector<std::pair<std::string, std::string> > Peripherals;
+
+// A file to stand in for a module; its identity is all that matters
+ModuleFileIdentity ModuleFile(const std::string& filename, const char* contents)
+{
+   std::ofstream(filename.c_str()) << contents;
+   ModuleFileIdentity file;
+   REQUIRE(file.Read(filename));
+   return file;
+}
+
+CachedDevice Device(const std::string& name, const std::string& description,
+      long type)
+{
+   CachedDevice device;
+   device.name = name;
+   device.description = description;
+   device.type = type;
+   return device;
+}
+
+} // anonymous namespace
+
+TEST_CASE("Capability cache entries survive reloading", "[CapabilityCache]")
+{
+   const std::string cacheFile = "CapabilityCache-Tests.cache";
+   std::remove(cacheFile.c_str());
+   const ModuleFileIdentity file = ModuleFile("CapabilityCache-Tests.mod", "x");
+
+   const std::vector<CachedDevice> devices{
+      Device("Cam", "A camera\twith\\odd\ncharacters", 2),
+      Device("", "", 0),
+   };
+   const Peripherals peripherals{ { "Stage", "A stage" }, { "Shutter", "" } };
+   {
+      CapabilityCache cache(cacheFile);
+      std::vector<CachedDevice> found;
+      CHECK_FALSE(cache.GetDevices("Mod", file, found));
+      cache.SetDevices("Mod", file, 3, 73, devices);
+      cache.SetPeripherals("Mod", file, 3, 73, "Hub\nPort=COM1", peripherals);
+      cache.SetDevices("Other", file, 1, 73, {});
+   }
+
+   CapabilityCache cache(cacheFile);
+   std::vector<CachedDevice> found;
+   REQUIRE(cache.GetDevices("Mod", file, found));
+   CHECK(found == devices);
+   REQUIRE(cache.GetDevices("Other", file, found));
+   CHECK(found.empty());
+
+   Peripherals foundPeripherals;
+   REQUIRE(cache.GetPeripherals("Mod", file, "Hub\nPort=COM1", foundPeripherals));
+   CHECK(foundPeripherals == peripherals);
+   CHECK_FALSE(cache.GetPeripherals("Mod", file, "Hub\nPort=COM2", foundPeripherals));
+
+   std::remove(cacheFile.c_str());
+   std::remove(file.path.c_str());
+}
+
+TEST_CASE("Capability cache entries are dropped when the module changes", "[CapabilityCache]")
+{
+   const std::string cacheFile = "CapabilityCache-Tests.cache";
+   std::remove(cacheFile.c_str());
+   const std::string moduleFile = "CapabilityCache-Tests.mod";
+   const ModuleFileIdentity file = ModuleFile(moduleFile, "x");
+   const std::vector<CachedDevice> devices{ Device("Cam", "A camera", 2) };
+
+   CapabilityCache cache(cacheFile);
+   std::vector<CachedDevice> found;
+
+   SECTION("Rebuilt file")
+   {
+      cache.SetDevices("Mod", file, 3, 73, devices);
+      const ModuleFileIdentity rebuilt = ModuleFile(moduleFile, "xyz");
+      CHECK_FALSE(cache.GetDevices("Mod", rebuilt, found));
+      CHECK(cache.GetDevices("Mod", file, found));
+   }
+
+   SECTION("Version mismatch on load")
+   {
+      cache.SetDevices("Mod", file, 3, 73, devices);
+      cache.Validate("Mod", 3, 73);
+      CHECK(cache.GetDevices("Mod", file, found));
+      cache.Validate("Mod", 4, 73);
+      CHECK_FALSE(cache.GetDevices("Mod", file, found));
+   }
+
+   SECTION("New version replaces peripherals")
+   {
+      cache.SetPeripherals("Mod", file, 3, 73, "Hub", { { "Stage", "" } });
+      cache.SetDevices("Mod", file, 3, 74, devices);
+      Peripherals peripherals;
+      CHECK_FALSE(cache.GetPeripherals("Mod", file, "Hub", peripherals));
+   }
+
+   SECTION("Invalidate and clear")
+   {
+      cache.SetDevices("Mod", file, 3, 73, devices);
+      cache.SetDevices("Other", file, 3, 73, devices);
+      cache.Invalidate("Mod");
+      CHECK_FALSE(cache.GetDevices("Mod", file, found));
+      CHECK(cache.GetDevices("Other", file, found));
+      cache.Clear();
+      CHECK_FALSE(CapabilityCache(cacheFile).GetDevices("Other", file, found));
+   }
+
+   SECTION("Invalidate one hub")
+   {
+      cache.SetDevices("Mod", file, 3, 73, devices);
+      cache.SetPeripherals("Mod", file, 3, 73, "Hub\nPort=COM1", { { "Stage", "" } });
+      cache.SetPeripherals("Mod", file, 3, 73, "Hub\nPort=COM2", { { "Stage", "" } });
+      cache.InvalidatePeripherals("Mod", "Hub\nPort=COM1");
+      cache.InvalidatePeripherals("NoSuchMod", "Hub\nPort=COM2");
+      CapabilityCache reloaded(cacheFile);
+      Peripherals peripherals;
+      CHECK_FALSE(reloaded.GetPeripherals("Mod", file, "Hub\nPort=COM1", peripherals));
+      CHECK(reloaded.GetPeripherals("Mod", file, "Hub\nPort=COM2", peripherals));
+      CHECK(reloaded.GetDevices("Mod", file, found));
+   }
+
+   std::remove(cacheFile.c_str());
+   std::remove(moduleFile.c_str());
+}
+
+TEST_CASE("Malformed capability cache files are ignored", "[CapabilityCache]")
+{
+   const std::string cacheFile = "CapabilityCache-Tests.cache";
+   const ModuleFileIdentity file = ModuleFile("CapabilityCache-Tests.mod", "x");
+   {
+      CapabilityCache cache(cacheFile);
+      cache.SetDevices("Mod", file, 3, 73, { Device("Cam", "A camera", 2) });
+   }
+   std::ofstream(cacheFile.c_str(), std::ios::app) << "Garbage\n";
+
+   std::vector<CachedDevice> found;
+   CHECK_FALSE(CapabilityCache(cacheFile).GetDevices("Mod", file, found));
+
+   std::ofstream(cacheFile.c_str()) << "Not a cache file\n";
+   CHECK_FALSE(CapabilityCache(cacheFile).GetDevices("Mod", file, found));
+
+   std::remove(cacheFile.c_str());
+   std::remove(file.path.c_str());
+}
+
+TEST_CASE("Core capability cache file can be set and cleared", "[CapabilityCache]")
+{
+   const std::string cacheFile = "CapabilityCache-Tests.cache";
+   CMMCore c;
+   CHECK(c.getDeviceCapabilityCacheFile().empty());
+   c.clearDeviceCapabilityCache();
+   c.setDeviceCapabilityCacheFile(cacheFile.c_str());
+   CHECK(c.getDeviceCapabilityCacheFile() == cacheFile);
+   CHECK_THROWS_AS(c.getAvailableDevices("NoSuchModule"), CMMError);
+   c.setDeviceCapabilityCacheFile("");
+   CHECK(c.getDeviceCapabilityCacheFile().empty());
+   CHECK_THROWS_AS(c.setDeviceCapabilityCacheFile(nullptr), CMMError);
+   std::remove(cacheFile.c_str());
+}
+
+TEST_CASE_METHOD(SequenceTesterFixture, "Core answers device queries from the capability cache", "[CapabilityCache]")
+{
+   const std::string cacheFile = "CapabilityCache-Tests.cache";
+   std::remove(cacheFile.c_str());
+
+   // Plant an entry that only the cache could have come up with
+   {
+      CPluginManager pm;
+      std::vector<std::string> paths(1, adapterPath);
+      pm.SetSearchPaths(paths.begin(), paths.end());
+      ModuleFileIdentity file;
+      REQUIRE(file.Read(pm.GetModuleFilename("SequenceTester")));
+      CapabilityCache cache(cacheFile);
+      cache.SetDevices("SequenceTester", file, -1, -1,
+            { Device("Planted", "From the cache", 2) });
+   }
+
+   CMMCore c;
+   c.setDeviceAdapterSearchPaths({ adapterPath });
+   c.setDeviceCapabilityCacheFile(cacheFile.c_str());
+   CHECK(c.getAvailableDevices("SequenceTester") ==
+         std::vector<std::string>{ "Planted" });
+   CHECK(c.getAvailableDeviceDescriptions("SequenceTester") ==
+         std::vector<std::string>{ "From the cache" });
+   CHECK(c.getAvailableDeviceTypes("SequenceTester") == std::vector<long>{ 2 });
+
+   // Loading the module reveals the versions do not match
+   c.loadDevice("THub", "SequenceTester", "THub");
+   std::vector<std::string> devices = c.getAvailableDevices("SequenceTester");
+   CHECK(devices == std::vector<std::string>{ "THub" });
+
+   c.initializeDevice("THub");
+   std::vector<std::string> installed = c.getInstalledDevices("THub");
+   CHECK(installed.size() == 14);
+   const std::string description =
+      c.getInstalledDeviceDescription("THub", "TCamera-0");
+   CHECK_FALSE(description.empty());
+   CHECK_THROWS_AS(c.getInstalledDeviceDescription("THub", "NoSuchDevice"),
+         CMMError);
+
+   // A new session gets both lists without loading anything
+   CMMCore c2;
+   c2.setDeviceAdapterSearchPaths({ adapterPath });
+   c2.setDeviceCapabilityCacheFile(cacheFile.c_str());
+   CHECK(c2.getAvailableDevices("SequenceTester") == devices);
+   c2.loadDevice("THub", "SequenceTester", "THub");
+   c2.initializeDevice("THub");
+   CHECK(c2.getInstalledDevices("THub") == installed);
+   CHECK(c2.getInstalledDeviceDescription("THub", "TCamera-0") == description);
+
+   // Drop a peripheral from the file, as if the hardware had changed since
+   std::string contents;
+   {
+      std::ifstream in(cacheFile.c_str());
+      std::string line;
+      while (std::getline(in, line))
+      {
+         if (line.compare(0, 21, "Peripheral\tTCamera-0\t") != 0)
+            contents += line + "\n";
+      }
+   }
+   std::ofstream(cacheFile.c_str(), std::ios::trunc) << contents;
+
+   CMMCore c3;
+   c3.setDeviceAdapterSearchPaths({ adapterPath });
+   c3.setDeviceCapabilityCacheFile(cacheFile.c_str());
+   c3.loadDevice("THub", "SequenceTester", "THub");
+   c3.initializeDevice("THub");
+   CHECK(c3.getInstalledDevices("THub").size() == installed.size() - 1);
+   // Refreshing asks the hub and updates the cache
+   CHECK(c3.getInstalledDevices("THub", true) == installed);
+   CHECK(c3.getInstalledDevices("THub") == installed);
+
+   std::remove(cacheFile.c_str());
+}
@@ -0,0 +1,208 @@
+#include <catch2/catch_all.hpp>
+
+#include "CircularBuffer.h"
+
+#include "../MMDevice/ImageMetadata.h"
+#include "../MMDevice/MMDeviceConstants.h"
+
+#include <cstring>
+#include <set>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace {
+
+std::vector<unsigned short> TestFrame(unsigned width, unsigned height,
+      unsigned seed, unsigned maxValue)
+{
+   std::vector<unsigned short> pixels(width * height);
+   for (std::size_t i = 0; i < pixels.size(); ++i)
+      pixels[i] = static_cast<unsigned short>((i * 2654435761u + seed * 40503u) % (maxValue + 1));
+   return pixels;
+}
+
+bool Insert(CircularBuffer& cb, const std::vector<unsigned short>& pixels,
+      unsigned width, unsigned height)
+{
+   Metadata md;
+   md.PutImageTag(MM::g_Keyword_Metadata_CameraLabel, "Camera");
+   return cb.InsertImage(reinterpret_cast<const unsigned char*>(pixels.data()),
+         width, height, 2, &md);
+}
+
+bool SamePixels(const mm::ImgBuffer* img, const std::vector<unsigned short>& pixels)
+{
+   return img != nullptr &&
+      std::memcmp(img->GetPixels(), pixels.data(), pixels.size() * 2) == 0;
+}
+
+} // namespace
+
+TEST_CASE("Packed circular buffer holds more frames", "[CircularBufferPacking]")
+{
+   const unsigned width = 512;
+   const unsigned height = 512;
+
+   CircularBuffer unpacked(10);
+   REQUIRE(unpacked.Initialize(1, width, height, 2, 12));
+   CHECK_FALSE(unpacked.IsPacked());
+
+   CircularBuffer packed12(10);
+   packed12.SetPacking(true);
+   REQUIRE(packed12.Initialize(1, width, height, 2, 12));
+   CHECK(packed12.IsPacked());
+   CHECK(packed12.GetSize() == unpacked.GetSize() * 4 / 3);
+
+   CircularBuffer packed10(10);
+   packed10.SetPacking(true);
+   REQUIRE(packed10.Initialize(1, width, height, 2, 10));
+   CHECK(packed10.GetSize() == unpacked.GetSize() * 8 / 5);
+
+   // Not eligible: 8-bit, or more than 12 bits
+   CircularBuffer other(10);
+   other.SetPacking(true);
+   REQUIRE(other.Initialize(1, width, height, 1, 8));
+   CHECK_FALSE(other.IsPacked());
+   REQUIRE(other.Initialize(1, width, height, 2, 14));
+   CHECK_FALSE(other.IsPacked());
+}
+
+TEST_CASE("Packed circular buffer returns unpacked frames", "[CircularBufferPacking]")
+{
+   const unsigned width = 37;
+   const unsigned height = 11;
+
+   CircularBuffer cb(1);
+   cb.SetPacking(true);
+   REQUIRE(cb.Initialize(1, width, height, 2, 10));
+   REQUIRE(cb.IsPacked());
+
+   std::vector<std::vector<unsigned short>> frames;
+   for (unsigned n = 0; n < 6; ++n)
+   {
+      frames.push_back(TestFrame(width, height, n, 1023));
+      REQUIRE(Insert(cb, frames.back(), width, height));
+   }
+
+   CHECK(SamePixels(cb.GetTopImageBuffer(0), frames[5]));
+   CHECK(SamePixels(cb.GetNthFromTopImageBuffer(2, 0), frames[3]));
+
+   for (unsigned n = 0; n < 6; ++n)
+   {
+      const mm::ImgBuffer* img = cb.GetNextImageBuffer(0);
+      REQUIRE(img != nullptr);
+      CHECK(img->Width() == width);
+      CHECK(img->Depth() == 2);
+      CHECK(SamePixels(img, frames[n]));
+      Metadata md = img->GetMetadata();
+      CHECK(md.GetSingleTag(MM::g_Keyword_Metadata_ImageNumber).GetValue() ==
+            std::to_string(n));
+      CHECK(md.HasTag(MM::g_Keyword_Elapsed_Time_ms));
+   }
+   CHECK(cb.GetNextImageBuffer(0) == nullptr);
+}
+
+TEST_CASE("Packed circular buffer rejects values beyond the bit depth",
+      "[CircularBufferPacking]")
+{
+   const unsigned width = 16;
+   const unsigned height = 2;
+
+   CircularBuffer cb(1);
+   cb.SetPacking(true);
+   REQUIRE(cb.Initialize(1, width, height, 2, 12));
+
+   std::vector<unsigned short> pixels(width * height, 4095);
+   pixels[0] = 100;
+   REQUIRE(Insert(cb, pixels, width, height));
+   pixels[width * height - 1] = 4096;
+   CHECK_THROWS_AS(Insert(cb, pixels, width, height), CMMError);
+   CHECK(cb.GetRemainingImageCount() == 1);
+
+   const unsigned short* out = reinterpret_cast<const unsigned short*>(cb.GetTopImage());
+   REQUIRE(out != nullptr);
+   CHECK(out[0] == 100);
+   CHECK(out[width * height - 1] == 4095);
+}
+
+TEST_CASE("Unpacked frames are not overwritten by other threads' reads",
+      "[CircularBufferPacking]")
+{
+   const unsigned width = 8;
+   const unsigned height = 8;
+
+   CircularBuffer cb(1);
+   cb.SetPacking(true);
+   REQUIRE(cb.Initialize(1, width, height, 2, 12));
+   std::vector<std::vector<unsigned short>> frames;
+   for (unsigned n = 0; n < 8; ++n)
+   {
+      frames.push_back(TestFrame(width, height, n, 4095));
+      REQUIRE(Insert(cb, frames.back(), width, height));
+   }
+
+   const mm::ImgBuffer* mine = cb.GetNextImageBuffer(0);
+   REQUIRE(SamePixels(mine, frames[0]));
+   std::thread other([&] {
+      for (unsigned n = 1; n < 8; ++n)
+         CHECK(SamePixels(cb.GetNextImageBuffer(0), frames[n]));
+   });
+   other.join();
+   CHECK(SamePixels(mine, frames[0]));
+
+   // The same thread's next read reuses the buffer
+   REQUIRE(Insert(cb, frames[0], width, height));
+   CHECK(cb.GetTopImageBuffer(0) == mine);
+}
+
+TEST_CASE("Unpacked frames are kept for a bounded number of threads",
+      "[CircularBufferPacking]")
+{
+   const unsigned width = 8;
+   const unsigned height = 8;
+
+   CircularBuffer cb(1);
+   cb.SetPacking(true);
+   REQUIRE(cb.Initialize(1, width, height, 2, 12));
+   const std::vector<unsigned short> frame = TestFrame(width, height, 1, 4095);
+   REQUIRE(Insert(cb, frame, width, height));
+
+   std::set<const mm::ImgBuffer*> images;
+   for (unsigned n = 0; n < 32; ++n)
+   {
+      std::thread reader([&] {
+         const mm::ImgBuffer* img = cb.GetTopImageBuffer(0);
+         CHECK(SamePixels(img, frame));
+         images.insert(img);
+      });
+      reader.join();
+   }
+   CHECK(images.size() <= 4);
+}
+
+TEST_CASE("Circular buffer packing takes effect at initialization",
+      "[CircularBufferPacking]")
+{
+   const unsigned width = 8;
+   const unsigned height = 8;
+
+   CircularBuffer cb(1);
+   REQUIRE(cb.Initialize(1, width, height, 2, 12));
+   cb.SetPacking(true);
+   CHECK(cb.IsPackingEnabled());
+   CHECK_FALSE(cb.IsPacked());
+
+   REQUIRE(cb.Initialize(1, width, height, 2, 12));
+   CHECK(cb.IsPacked());
+
+   const std::vector<unsigned short> frame = TestFrame(width, height, 1, 4095);
+   REQUIRE(Insert(cb, frame, width, height));
+   CHECK(SamePixels(cb.GetTopImageBuffer(0), frame));
+
+   cb.SetPacking(false);
+   REQUIRE(cb.Initialize(1, width, height, 2, 12));
+   CHECK_FALSE(cb.IsPacked());
+   REQUIRE(Insert(cb, frame, width, height));
+   CHECK(SamePixels(cb.GetTopImageBuffer(0), frame));
+}
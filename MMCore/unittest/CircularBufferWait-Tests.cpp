@@ -0,0 +1,95 @@
+#include <catch2/catch_all.hpp>
+
+#include "CircularBuffer.h"
+#include "MMCore.h"
+#include "SequenceTesterFixture.h"
+
+#include "../MMDevice/ImageMetadata.h"
+#include "../MMDevice/MMDeviceConstants.h"
+
+#include <chrono>
+#include <thread>
+#include <vector>
+
+namespace {
+
+bool Insert(CircularBuffer& cb, const std::vector<unsigned char>& pixels,
+      unsigned width, unsigned height)
+{
+   Metadata md;
+   md.PutImageTag(MM::g_Keyword_Metadata_CameraLabel, "Camera");
+   return cb.InsertImage(pixels.data(), width, height, 1, &md);
+}
+
+} // namespace
+
+TEST_CASE("Waiting for images wakes on insert", "[CircularBufferWait]")
+{
+   CircularBuffer cb(1);
+   REQUIRE(cb.Initialize(1, 16, 16, 1));
+   const std::vector<unsigned char> pixels(16 * 16, 7);
+   const auto start = std::chrono::steady_clock::now();
+
+   std::thread camera([&] {
+      std::this_thread::sleep_for(std::chrono::milliseconds(20));
+      Insert(cb, pixels, 16, 16);
+      std::this_thread::sleep_for(std::chrono::milliseconds(20));
+      Insert(cb, pixels, 16, 16);
+   });
+   CHECK(cb.WaitForImages(2, start + std::chrono::seconds(10)));
+   camera.join();
+   CHECK(std::chrono::steady_clock::now() - start < std::chrono::seconds(5));
+   CHECK(cb.GetRemainingImageCount() == 2);
+
+   // Available images satisfy the wait without blocking
+   CHECK(cb.WaitForImages(1, start));
+}
+
+TEST_CASE("Waiting for images times out or is interrupted", "[CircularBufferWait]")
+{
+   CircularBuffer cb(1);
+   REQUIRE(cb.Initialize(1, 16, 16, 1));
+
+   CHECK_FALSE(cb.WaitForImages(1,
+            std::chrono::steady_clock::now() + std::chrono::milliseconds(10)));
+
+   const auto start = std::chrono::steady_clock::now();
+   std::thread interrupter([&] {
+      std::this_thread::sleep_for(std::chrono::milliseconds(20));
+      cb.Interrupt();
+   });
+   CHECK_FALSE(cb.WaitForImages(1, start + std::chrono::seconds(10)));
+   interrupter.join();
+   CHECK(std::chrono::steady_clock::now() - start < std::chrono::seconds(5));
+}
+
+TEST_CASE("Core does not wait for images without an acquisition", "[CircularBufferWait]")
+{
+   CMMCore c;
+   const auto start = std::chrono::steady_clock::now();
+   CHECK_FALSE(c.waitForNextImage(10000));
+   CHECK(std::chrono::steady_clock::now() - start < std::chrono::seconds(5));
+   CHECK(c.waitForImageCount(0, 0));
+   CHECK_THROWS_AS(c.waitForNextImage(-1), CMMError);
+}
+
+TEST_CASE_METHOD(SequenceTesterFixture, "Core waits for images of a sequence acquisition", "[CircularBufferWait]")
+{
+   CMMCore c;
+   c.setDeviceAdapterSearchPaths({ adapterPath });
+   c.loadDevice("THub", "SequenceTester", "THub");
+   c.loadDevice("TCamera", "SequenceTester", "TCamera");
+   c.setParentLabel("TCamera", "THub");
+   c.initializeAllDevices();
+   c.setCameraDevice("TCamera");
+
+   c.startSequenceAcquisition(3, 0.0, true);
+   CHECK(c.waitForImageCount(3, 10000));
+   CHECK(c.getRemainingImageCount() >= 3);
+
+   // No more images arrive once the acquisition has stopped
+   c.stopSequenceAcquisition();
+   const auto start = std::chrono::steady_clock::now();
+   CHECK_FALSE(c.waitForImageCount(4, 10000));
+   CHECK(std::chrono::steady_clock::now() - start < std::chrono::seconds(5));
+}
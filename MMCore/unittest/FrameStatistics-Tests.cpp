@@ -0,0 +1,156 @@
+#include <catch2/catch_all.hpp>
+
+#include "CircularBuffer.h"
+#include "FrameStatistics.h"
+
+#include "../MMDevice/ImageMetadata.h"
+#include "../MMDevice/MMDeviceConstants.h"
+
+#include <cstdint>
+#include <vector>
+
+namespace mm {
+
+namespace {
+
+template <typename T>
+FrameStatistics Compute(const std::vector<T>& pixels, unsigned bins,
+      unsigned bitDepth)
+{
+   FrameStatistics stats;
+   stats.Reset(bins, bitDepth, sizeof(T), pixels.size());
+   stats.Accumulate(reinterpret_cast<const unsigned char*>(pixels.data()),
+         pixels.size());
+   stats.Finalize();
+   return stats;
+}
+
+} // anonymous namespace
+
+TEST_CASE("8-bit frame statistics", "[FrameStatistics]")
+{
+   std::vector<std::uint8_t> pixels = { 0, 10, 20, 255, 255, 100 };
+   FrameStatistics stats = Compute(pixels, 4, 8);
+   CHECK(stats.GetPixelCount() == 6);
+   CHECK(stats.GetMin() == 0);
+   CHECK(stats.GetMax() == 255);
+   CHECK(stats.GetMean() == 640.0 / 6);
+   CHECK(stats.GetSaturatedCount() == 2);
+   REQUIRE(stats.GetHistogramBins() == 4);
+   CHECK(stats.GetHistogram()[0] == 3);
+   CHECK(stats.GetHistogram()[1] == 1);
+   CHECK(stats.GetHistogram()[2] == 0);
+   CHECK(stats.GetHistogram()[3] == 2);
+}
+
+TEST_CASE("16-bit frame statistics, small and large frames agree",
+      "[FrameStatistics]")
+{
+   // Small frames use per-pixel accumulation; large ones use a count table
+   for (std::size_t size : { std::size_t(1000), std::size_t(1 << 17) })
+   {
+      std::vector<std::uint16_t> pixels(size);
+      std::uint64_t sum = 0;
+      std::uint64_t saturated = 0;
+      std::vector<std::uint64_t> expectedHist(16);
+      for (std::size_t i = 0; i < size; ++i)
+      {
+         pixels[i] = static_cast<std::uint16_t>((i * 7919 + 13) % 5000);
+         sum += pixels[i];
+         saturated += pixels[i] >= 4095;
+         ++expectedHist[(pixels[i] > 4095 ? 4095 : pixels[i]) >> 8];
+      }
+
+      FrameStatistics stats = Compute(pixels, 16, 12);
+      CHECK(stats.GetBitDepth() == 12);
+      CHECK(stats.GetPixelCount() == size);
+      CHECK(stats.GetMean() == double(sum) / double(size));
+      CHECK(stats.GetSaturatedCount() == saturated);
+      CHECK(stats.GetHistogram() == expectedHist);
+   }
+}
+
+TEST_CASE("Frame statistics bins are limited by bit depth",
+      "[FrameStatistics]")
+{
+   std::vector<std::uint16_t> pixels = { 0, 1, 2, 3, 3 };
+   FrameStatistics stats = Compute(pixels, 1024, 2);
+   REQUIRE(stats.GetHistogramBins() == 4);
+   CHECK(stats.GetHistogram()[3] == 2);
+   CHECK(stats.GetSaturatedCount() == 2);
+
+   // Bit depth 0 means the full range of the type
+   stats = Compute(pixels, 256, 0);
+   CHECK(stats.GetBitDepth() == 16);
+   CHECK(stats.GetSaturatedCount() == 0);
+}
+
+TEST_CASE("Merged partial frame statistics equal whole-frame statistics",
+      "[FrameStatistics]")
+{
+   std::vector<std::uint8_t> pixels(1000);
+   for (std::size_t i = 0; i < pixels.size(); ++i)
+      pixels[i] = static_cast<std::uint8_t>(i * 31);
+
+   FrameStatistics whole = Compute(pixels, 256, 8);
+
+   FrameStatistics merged;
+   merged.Reset(256, 8, 1, 0);
+   for (std::size_t start = 0; start < pixels.size(); start += 300)
+   {
+      const std::size_t n = (std::min)(std::size_t(300), pixels.size() - start);
+      FrameStatistics part;
+      part.Reset(256, 8, 1, n);
+      part.Accumulate(pixels.data() + start, n);
+      part.Finalize();
+      merged.Merge(part);
+   }
+
+   CHECK(merged.GetPixelCount() == whole.GetPixelCount());
+   CHECK(merged.GetMin() == whole.GetMin());
+   CHECK(merged.GetMax() == whole.GetMax());
+   CHECK(merged.GetMean() == whole.GetMean());
+   CHECK(merged.GetHistogram() == whole.GetHistogram());
+}
+
+} // namespace mm
+
+TEST_CASE("Circular buffer attaches frame statistics to metadata",
+      "[FrameStatistics]")
+{
+   const unsigned width = 64;
+   const unsigned height = 32;
+   std::vector<std::uint16_t> pixels(width * height, 100);
+   pixels[0] = 1023;
+   pixels[1] = 7;
+
+   Metadata cameraMd;
+   cameraMd.PutImageTag(MM::g_Keyword_Metadata_CameraLabel, "Camera");
+
+   CircularBuffer cb(10);
+   REQUIRE(cb.Initialize(1, width, height, 2, 10));
+   cb.SetFrameStatistics(true, 8);
+   REQUIRE(cb.InsertImage(reinterpret_cast<const unsigned char*>(pixels.data()),
+         width, height, 2, &cameraMd));
+
+   const mm::ImgBuffer* img = cb.GetTopImageBuffer(0);
+   REQUIRE(img != nullptr);
+   CHECK(std::vector<std::uint16_t>(
+            reinterpret_cast<const std::uint16_t*>(img->GetPixels()),
+            reinterpret_cast<const std::uint16_t*>(img->GetPixels()) + pixels.size())
+         == pixels);
+
+   Metadata md = img->GetMetadata();
+   CHECK(md.GetSingleTag(MM::g_Keyword_Metadata_StatsMin).GetValue() == "7");
+   CHECK(md.GetSingleTag(MM::g_Keyword_Metadata_StatsMax).GetValue() == "1023");
+   CHECK(md.GetSingleTag(MM::g_Keyword_Metadata_StatsSaturated).GetValue() == "1");
+   CHECK(md.GetSingleTag(MM::g_Keyword_Metadata_StatsBitDepth).GetValue() == "10");
+   CHECK(md.GetSingleTag(MM::g_Keyword_Metadata_StatsHistogram).GetValue() ==
+         "2047,0,0,0,0,0,0,1");
+
+   cb.SetFrameStatistics(false, 8);
+   REQUIRE(cb.InsertImage(reinterpret_cast<const unsigned char*>(pixels.data()),
+         width, height, 2, &cameraMd));
+   md = cb.GetTopImageBuffer(0)->GetMetadata();
+   CHECK_FALSE(md.HasTag(MM::g_Keyword_Metadata_StatsMin));
+}
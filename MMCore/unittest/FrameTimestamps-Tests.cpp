@@ -0,0 +1,118 @@
+#include <catch2/catch_all.hpp>
+
+#include "CircularBuffer.h"
+#include "FrameTimestamps.h"
+
+#include "../MMDevice/ImageMetadata.h"
+#include "../MMDevice/MMDeviceConstants.h"
+
+#include <cmath>
+#include <cstdint>
+#include <cstdlib>
+#include <string>
+#include <vector>
+
+namespace mm {
+
+TEST_CASE("Clock fit recovers drift of a noiseless device clock",
+      "[FrameTimestamps]")
+{
+   ClockDriftEstimator fit;
+   CHECK_FALSE(fit.HasFit());
+
+   // Host clock runs 50 ppm fast relative to the device; sequence of 10 hours
+   const std::int64_t deviceStart = 123456789012345LL;
+   const std::int64_t hostStart = 987654321000LL;
+   const std::int64_t interval = 36000000000LL; // 36 s
+   for (std::int64_t i = 0; i < 1000; ++i)
+   {
+      const std::int64_t device = deviceStart + i * interval;
+      const std::int64_t host = hostStart + i * interval + i * interval / 20000;
+      fit.AddSample(device, host);
+   }
+
+   REQUIRE(fit.HasFit());
+   CHECK(fit.GetSampleCount() == 1000);
+   CHECK(std::abs(fit.GetDriftPpm() - 50.0) < 1e-3);
+   CHECK(fit.GetJitterNs() < 1.0);
+
+   const std::int64_t device = deviceStart + 500 * interval;
+   const std::int64_t expected = hostStart + 500 * interval + 500 * interval / 20000;
+   CHECK(std::llabs(fit.ToHostNs(device) - expected) <= 1);
+}
+
+TEST_CASE("Clock fit reports jitter of arrival times", "[FrameTimestamps]")
+{
+   ClockDriftEstimator fit;
+   for (std::int64_t i = 0; i < 1000; ++i)
+   {
+      const std::int64_t device = i * 10000000LL;
+      const std::int64_t noise = (i % 2 == 0) ? 2000 : -2000;
+      fit.AddSample(device, 5000000000LL + device + noise);
+   }
+   CHECK(std::abs(fit.GetDriftPpm()) < 1.0);
+   CHECK(std::abs(fit.GetJitterNs() - 2000.0) < 10.0);
+}
+
+TEST_CASE("Clock fit before enough samples", "[FrameTimestamps]")
+{
+   ClockDriftEstimator fit;
+   fit.AddSample(1000, 5000);
+   CHECK_FALSE(fit.HasFit());
+   CHECK(fit.GetDriftPpm() == 0.0);
+   CHECK(fit.ToHostNs(1500) == 5500);
+   fit.Reset();
+   CHECK(fit.GetSampleCount() == 0);
+}
+
+} // namespace mm
+
+TEST_CASE("Circular buffer renders timestamp tags on read",
+      "[FrameTimestamps]")
+{
+   const unsigned width = 8;
+   const unsigned height = 4;
+   std::vector<unsigned char> pixels(width * height);
+
+   CircularBuffer cb(1);
+   REQUIRE(cb.Initialize(1, width, height, 1));
+
+   for (int i = 0; i < 5; ++i)
+   {
+      Metadata cameraMd;
+      cameraMd.PutImageTag(MM::g_Keyword_Metadata_CameraLabel, "Camera");
+      cameraMd.PutImageTag(MM::g_Keyword_Metadata_HardwareTimestamp_ns,
+            std::to_string(1000000000LL + i * 1000000LL));
+      REQUIRE(cb.InsertImage(pixels.data(), width, height, 1, &cameraMd));
+   }
+
+   const mm::ImgBuffer* img = cb.GetTopImageBuffer(0);
+   REQUIRE(img != nullptr);
+   CHECK(img->GetTimestamp().valid);
+   CHECK(img->GetTimestamp().hasHardwareHost);
+
+   Metadata md = img->GetMetadata();
+   CHECK(md.HasTag(MM::g_Keyword_Elapsed_Time_ms));
+   CHECK(md.HasTag(MM::g_Keyword_Metadata_TimeInCore));
+   CHECK(md.HasTag(MM::g_Keyword_Metadata_HardwareTimestampHost_ns));
+   CHECK(md.GetSingleTag(MM::g_Keyword_Metadata_TimeInCoreMonotonic_ns).GetValue() ==
+         std::to_string(img->GetTimestamp().monotonicNs));
+   CHECK(md.GetSingleTag(MM::g_Keyword_Metadata_TimeInCoreUTC_ns).GetValue() ==
+         std::to_string(img->GetTimestamp().utcNs));
+
+   mm::ClockDriftEstimator fit;
+   REQUIRE(cb.GetHardwareClockFit("Camera", fit));
+   CHECK(fit.GetSampleCount() == 5);
+   CHECK_FALSE(cb.GetHardwareClockFit("OtherCamera", fit));
+
+   // Camera-supplied elapsed time is kept
+   Metadata cameraMd;
+   cameraMd.PutImageTag(MM::g_Keyword_Metadata_CameraLabel, "Camera");
+   cameraMd.PutImageTag(MM::g_Keyword_Elapsed_Time_ms, "12.5");
+   REQUIRE(cb.InsertImage(pixels.data(), width, height, 1, &cameraMd));
+   md = cb.GetTopImageBuffer(0)->GetMetadata();
+   CHECK(md.GetSingleTag(MM::g_Keyword_Elapsed_Time_ms).GetValue() == "12.5");
+
+   cb.Clear();
+   CHECK_FALSE(cb.GetHardwareClockFit("Camera", fit));
+}
@@ -0,0 +1,165 @@
+#include <catch2/catch_all.hpp>
+
+#include "CircularBuffer.h"
+#include "MMCore.h"
+#include "SequenceTesterFixture.h"
+
+#include "../MMDevice/ImageMetadata.h"
+#include "../MMDevice/MMDeviceConstants.h"
+
+#include <atomic>
+#include <chrono>
+#include <cstring>
+#include <string>
+#include <thread>
+#include <vector>
+
+TEST_CASE("Copying an image needs an image and a buffer", "[ImageCopy]")
+{
+   CMMCore c;
+   std::vector<unsigned char> buffer(16);
+   Metadata md;
+   CHECK_THROWS_AS(c.getImageInto(buffer.data(), buffer.size()), CMMError);
+   CHECK_THROWS_AS(c.popNextImageInto(buffer.data(), buffer.size(), md),
+         CMMError);
+   CHECK_THROWS_AS(c.getLastImageInto(buffer.data(), buffer.size(), md),
+         CMMError);
+   CHECK_THROWS_AS(c.popNextImageInto(nullptr, 0, md), CMMError);
+
+   // Draining an empty buffer is not an error
+   std::vector<Metadata> mds(2);
+   CHECK(c.popNextImages(4, buffer.data(), buffer.size(), mds) == 0);
+   CHECK(mds.empty());
+   CHECK_THROWS_AS(c.popNextImages(4, nullptr, 0), CMMError);
+}
+
+TEST_CASE("Images are removed whole while others are inserted", "[ImageCopy]")
+{
+   // 16 frames of 64 KiB; each is filled with its frame number
+   const unsigned width = 256;
+   const unsigned height = 256;
+   CircularBuffer cb(1);
+   REQUIRE(cb.Initialize(1, width, height, 1));
+   REQUIRE(cb.GetSize() == 16);
+   const long frameCount = 2000;
+
+   std::atomic<bool> stop{ false };
+   std::thread camera([&] {
+      std::vector<unsigned char> pixels(width * height);
+      Metadata md;
+      md.PutImageTag(MM::g_Keyword_Metadata_CameraLabel, "Camera");
+      for (long n = 0; n < frameCount && !stop; )
+      {
+         std::memset(pixels.data(), static_cast<int>(n % 251), pixels.size());
+         if (cb.InsertImage(pixels.data(), width, height, 1, &md))
+            ++n;
+         else
+            std::this_thread::yield(); // Full, including slots being copied
+      }
+   });
+
+   std::vector<unsigned char> dest(8 * width * height);
+   std::vector<Metadata> mds;
+   long popped = 0;
+   bool whole = true;
+   const auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(60);
+   while (popped < frameCount && std::chrono::steady_clock::now() < deadline)
+   {
+      mds.clear();
+      unsigned long count = cb.PopNextImages(0, 8, dest.data(), dest.size(), &mds);
+      REQUIRE(mds.size() == count);
+      for (unsigned long i = 0; i < count; ++i, ++popped)
+      {
+         const unsigned char* frame = dest.data() + i * width * height;
+         const long number = std::stol(
+               mds[i].GetSingleTag(MM::g_Keyword_Metadata_ImageNumber).GetValue());
+         whole = whole && number == popped && frame[0] == popped % 251 &&
+            std::memcmp(frame, frame + 1, width * height - 1) == 0;
+      }
+      if (count == 0)
+         std::this_thread::yield();
+   }
+   stop = true;
+   camera.join();
+   CHECK(popped == frameCount);
+   CHECK(whole);
+}
+
+TEST_CASE_METHOD(SequenceTesterFixture, "Images are copied into caller buffers", "[ImageCopy]")
+{
+   CMMCore c;
+   c.setDeviceAdapterSearchPaths({ adapterPath });
+   c.loadDevice("THub", "SequenceTester", "THub");
+   c.loadDevice("TCamera", "SequenceTester", "TCamera");
+   c.setParentLabel("TCamera", "THub");
+   c.initializeAllDevices();
+   c.setCameraDevice("TCamera");
+
+   const unsigned long imageSize = c.getImageBufferSize();
+   REQUIRE(imageSize > 0);
+   std::vector<unsigned char> buffer(imageSize + 8);
+   std::vector<unsigned char> small(imageSize - 1);
+
+   c.snapImage();
+   CHECK(c.getImageInto(buffer.data(), buffer.size()) == imageSize);
+   CHECK(std::memcmp(buffer.data(), c.getImage(), imageSize) == 0);
+   CHECK_THROWS_AS(c.getImageInto(small.data(), small.size()), CMMError);
+
+   c.startSequenceAcquisition(2, 0.0, true);
+   for (int i = 0; i < 500 && c.getRemainingImageCount() < 2; ++i)
+      std::this_thread::sleep_for(std::chrono::milliseconds(10));
+   c.stopSequenceAcquisition();
+   REQUIRE(c.getRemainingImageCount() == 2);
+
+   Metadata md;
+   // The image stays in the circular buffer if the copy cannot be made
+   CHECK_THROWS_AS(c.popNextImageInto(small.data(), small.size(), md),
+         CMMError);
+   CHECK(c.getRemainingImageCount() == 2);
+
+   CHECK(c.getLastImageInto(buffer.data(), buffer.size(), md) == imageSize);
+   CHECK(std::memcmp(buffer.data(), c.getLastImage(), imageSize) == 0);
+   CHECK(c.getRemainingImageCount() == 2);
+
+   md.Clear();
+   CHECK(c.popNextImageInto(buffer.data(), buffer.size(), md) == imageSize);
+   CHECK_FALSE(md.GetKeys().empty());
+   CHECK(c.getRemainingImageCount() == 1);
+}
+
+TEST_CASE_METHOD(SequenceTesterFixture, "Images are removed in batches", "[ImageCopy]")
+{
+   CMMCore c;
+   c.setDeviceAdapterSearchPaths({ adapterPath });
+   c.loadDevice("THub", "SequenceTester", "THub");
+   c.loadDevice("TCamera", "SequenceTester", "TCamera");
+   c.setParentLabel("TCamera", "THub");
+   c.initializeAllDevices();
+   c.setCameraDevice("TCamera");
+
+   const unsigned long imageSize = c.getImageBufferSize();
+   REQUIRE(imageSize > 0);
+
+   c.startSequenceAcquisition(5, 0.0, true);
+   for (int i = 0; i < 500 && c.getRemainingImageCount() < 5; ++i)
+      std::this_thread::sleep_for(std::chrono::milliseconds(10));
+   c.stopSequenceAcquisition();
+   REQUIRE(c.getRemainingImageCount() == 5);
+
+   std::vector<unsigned char> small(imageSize - 1);
+   CHECK_THROWS_AS(c.popNextImages(1, small.data(), small.size()), CMMError);
+   CHECK(c.getRemainingImageCount() == 5);
+
+   // At most maxCount images, and no more than fit in the buffer
+   std::vector<unsigned char> buffer(4 * imageSize);
+   std::vector<Metadata> mds;
+   CHECK(c.popNextImages(3, buffer.data(), buffer.size(), mds) == 3);
+   REQUIRE(mds.size() == 3);
+   CHECK(mds[0].GetSingleTag(MM::g_Keyword_Metadata_ImageNumber).GetValue() == "0");
+   CHECK(mds[2].GetSingleTag(MM::g_Keyword_Metadata_ImageNumber).GetValue() == "2");
+   CHECK(c.popNextImages(3, buffer.data(), imageSize + 1) == 1);
+   CHECK(c.popNextImages(3, buffer.data(), buffer.size(), mds) == 1);
+   REQUIRE(mds.size() == 1);
+   CHECK(mds[0].GetSingleTag(MM::g_Keyword_Metadata_ImageNumber).GetValue() == "4");
+   CHECK(c.getRemainingImageCount() == 0);
+}
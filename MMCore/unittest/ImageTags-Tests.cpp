@@ -0,0 +1,149 @@
+#include <catch2/catch_all.hpp>
+
+#include "Configuration.h"
+#include "ImageTags.h"
+#include "MMCore.h"
+#include "SequenceTesterFixture.h"
+
+#include "../MMDevice/ImageMetadata.h"
+#include "../MMDevice/MMDeviceConstants.h"
+
+#include <cstdlib>
+#include <string>
+
+namespace {
+
+bool Contains(const std::string& json, const std::string& member)
+{
+   return json.find(member) != std::string::npos;
+}
+
+} // anonymous namespace
+
+TEST_CASE("JSON strings are escaped", "[ImageTags]")
+{
+   std::string out;
+   mm::AppendJSONString(out, "a\"b\\c\nd\te\x01");
+   CHECK(out == "\"a\\\"b\\\\c\\nd\\te\\u0001\"");
+}
+
+TEST_CASE("JSON numbers read back as floating point", "[ImageTags]")
+{
+   CHECK(mm::FormatJSONNumber(1.0) == "1.0");
+   CHECK(mm::FormatJSONNumber(0.0) == "0.0");
+   CHECK(mm::FormatJSONNumber(-2.5) == "-2.5");
+   CHECK(mm::FormatJSONNumber(0.1) == "0.1");
+   CHECK(std::strtod(mm::FormatJSONNumber(1.0 / 3.0).c_str(), 0) == 1.0 / 3.0);
+   CHECK(mm::FormatJSONNumber(1e300) == "1e+300");
+   CHECK(mm::FormatJSONNumber(std::strtod("nan", 0)) == "null");
+}
+
+TEST_CASE("Configuration revision changes on modification", "[ImageTags]")
+{
+   Configuration config;
+   CHECK(config.getRevision() == 0);
+   config.addSetting(PropertySetting("Dev", "Prop", "1"));
+   const unsigned long long revision = config.getRevision();
+   CHECK(revision != 0);
+
+   Configuration copy = config;
+   CHECK(copy.getRevision() == revision);
+   copy.addSetting(PropertySetting("Dev", "Prop", "2"));
+   CHECK(copy.getRevision() != revision);
+   CHECK(config.getRevision() == revision);
+
+   config.deleteSetting("Dev", "Prop");
+   CHECK(config.getRevision() != revision);
+   CHECK(config.getRevision() != copy.getRevision());
+}
+
+TEST_CASE("Image tags take precedence over state and metadata", "[ImageTags]")
+{
+   Configuration state;
+   state.addSetting(PropertySetting("Cam", "Binning", "2"));
+   state.addSetting(PropertySetting("Core", "Camera", "Cam"));
+   std::shared_ptr<const mm::SystemStateTags> stateTags =
+      mm::MakeSystemStateTags(state);
+   CHECK(stateTags->revision == state.getRevision());
+   CHECK(stateTags->json == "\"Cam-Binning\":\"2\",\"Core-Camera\":\"Cam\"");
+
+   Metadata md;
+   md.PutImageTag("Cam-Binning", 1);
+   md.PutImageTag("Width", 1);
+   md.PutImageTag("ElapsedTime-ms", "12.5");
+
+   mm::ImageTags tags(md, stateTags);
+   tags.SetInteger("Width", 512);
+   tags.SetFloat("PixelSizeUm", 1.0);
+   tags.SetString("Position", "Default");
+
+   std::string value;
+   CHECK(tags.Has("Width"));
+   CHECK_FALSE(tags.GetString("Width", value));
+   REQUIRE(tags.GetString("Cam-Binning", value));
+   CHECK(value == "2");
+   REQUIRE(tags.GetString("ElapsedTime-ms", value));
+   CHECK(value == "12.5");
+   CHECK_FALSE(tags.Has("Camera"));
+
+   CHECK(tags.ToJSON() ==
+         "{\"Width\":512,\"PixelSizeUm\":1.0,\"Position\":\"Default\","
+         "\"Cam-Binning\":\"2\",\"Core-Camera\":\"Cam\","
+         "\"ElapsedTime-ms\":\"12.5\"}");
+
+   mm::ImageTags withoutState(md, std::shared_ptr<const mm::SystemStateTags>());
+   CHECK(withoutState.ToJSON() ==
+         "{\"Cam-Binning\":\"1\",\"ElapsedTime-ms\":\"12.5\",\"Width\":\"1\"}");
+}
+
+TEST_CASE("Core assembles tagged image tags", "[ImageTags]")
+{
+   CMMCore c;
+   c.setAutoShutter(true);
+   Metadata md;
+   md.PutImageTag("Camera", "Cam");
+
+   std::string json = c.getTaggedImageTags(md, true);
+   CHECK(json.front() == '{');
+   CHECK(json.back() == '}');
+   CHECK(Contains(json, "\"Width\":0"));
+   CHECK(Contains(json, "\"Channel\":\"Default\""));
+   CHECK(Contains(json, "\"ChannelIndex\":0"));
+   CHECK(Contains(json, "\"Camera\":\"Cam\""));
+   CHECK(Contains(json, "\"Core-AutoShutter\":\"1\""));
+   CHECK_FALSE(Contains(json, "Binning"));
+
+   // The state part is regenerated when the state cache changes
+   c.setAutoShutter(false);
+   json = c.getTaggedImageTags(md, true);
+   CHECK(Contains(json, "\"Core-AutoShutter\":\"0\""));
+
+   json = c.getTaggedImageTags(md, false);
+   CHECK_FALSE(Contains(json, "Core-AutoShutter"));
+
+   // The camera channel is not overridden if the image has one
+   json = c.getTaggedImageTags(md, 1, false);
+   CHECK(Contains(json, "\"CameraChannelIndex\":1"));
+   CHECK(Contains(json, "\"ChannelIndex\":1"));
+   md.PutImageTag("CameraChannelIndex", 0);
+   json = c.getTaggedImageTags(md, 1, false);
+   CHECK(Contains(json, "\"CameraChannelIndex\":\"0\""));
+   CHECK(Contains(json, "\"ChannelIndex\":0"));
+}
+
+TEST_CASE_METHOD(SequenceTesterFixture, "Tagged image tags describe the current camera", "[ImageTags]")
+{
+   CMMCore c;
+   c.setDeviceAdapterSearchPaths({ adapterPath });
+   c.loadDevice("THub", "SequenceTester", "THub");
+   c.loadDevice("TCamera", "SequenceTester", "TCamera");
+   c.setParentLabel("TCamera", "THub");
+   c.initializeAllDevices();
+   c.setCameraDevice("TCamera");
+
+   std::string json = c.getTaggedImageTags(Metadata(), true);
+   CHECK(Contains(json, "\"Width\":" + std::to_string(c.getImageWidth())));
+   CHECK(Contains(json, "\"PixelType\":\"GRAY"));
+   CHECK(Contains(json, "\"Core-Camera\":\"TCamera\""));
+   CHECK(Contains(json, "\"ROI\":\"0-0-"));
+}
@@ -0,0 +1,269 @@
+#include <catch2/catch_all.hpp>
+
+#include "Error.h"
+#include "InitializationScheduler.h"
+#include "MMCore.h"
+#include "SequenceTesterFixture.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+using namespace mm;
+
+namespace {
+
+logging::Logger NullLogger()
+{
+   return logging::Logger([](logging::EntryData, const char*) {});
+}
+
+// Records the order in which devices start and the peak concurrency
+class Recorder
+{
+   std::mutex mutex_;
+   std::vector<std::string> started_;
+   int running_ = 0;
+   int peak_ = 0;
+
+public:
+   std::function<void()> Device(const std::string& label, int ms)
+   {
+      return [this, label, ms] {
+         {
+            std::lock_guard<std::mutex> lock(mutex_);
+            started_.push_back(label);
+            peak_ = (std::max)(peak_, ++running_);
+         }
+         std::this_thread::sleep_for(std::chrono::milliseconds(ms));
+         std::lock_guard<std::mutex> lock(mutex_);
+         --running_;
+      };
+   }
+
+   size_t Position(const std::string& label)
+   {
+      std::lock_guard<std::mutex> lock(mutex_);
+      return std::find(started_.begin(), started_.end(), label) -
+         started_.begin();
+   }
+
+   int Peak()
+   {
+      std::lock_guard<std::mutex> lock(mutex_);
+      return peak_;
+   }
+};
+
+const InitializationRecord& Find(const std::vector<InitializationRecord>& records,
+      const std::string& label)
+{
+   for (const InitializationRecord& record : records)
+      if (record.label == label)
+         return record;
+   FAIL("No record for " + label);
+   return records.front();
+}
+
+} // anonymous namespace
+
+TEST_CASE("Devices start after their dependencies", "[InitializationScheduler]")
+{
+   Recorder rec;
+   int a, b;
+   InitializationScheduler sched(NullLogger());
+   // Added before its dependencies on purpose
+   sched.Add("PeripheralA", &a, { "HubA" }, rec.Device("PeripheralA", 10));
+   sched.Add("HubA", &a, { "PortA" }, rec.Device("HubA", 10));
+   sched.Add("PortA", &b, {}, rec.Device("PortA", 10));
+   sched.Add("Unrelated", &b, { "NotLoaded" }, rec.Device("Unrelated", 10));
+
+   std::vector<InitializationRecord> records =
+      sched.Run(4, std::chrono::milliseconds(0));
+   REQUIRE(records.size() == 4);
+   CHECK(records[0].label == "PeripheralA");
+   for (const InitializationRecord& record : records)
+   {
+      CHECK(record.result == InitializationRecord::Succeeded);
+      CHECK(record.duration >= std::chrono::milliseconds(10));
+   }
+   CHECK(rec.Position("PortA") < rec.Position("HubA"));
+   CHECK(rec.Position("HubA") < rec.Position("PeripheralA"));
+   CHECK(Find(records, "HubA").start >= Find(records, "PortA").start +
+         Find(records, "PortA").duration);
+}
+
+TEST_CASE("Independent groups initialize concurrently", "[InitializationScheduler]")
+{
+   Recorder rec;
+   int groups[6];
+   InitializationScheduler sched(NullLogger());
+   for (int i = 0; i < 6; ++i)
+   {
+      const std::string label = "Dev" + std::to_string(i);
+      sched.Add(label, &groups[i], {}, rec.Device(label, 100));
+   }
+
+   const auto start = std::chrono::steady_clock::now();
+   std::vector<InitializationRecord> records =
+      sched.Run(3, std::chrono::milliseconds(0));
+   const auto elapsed = std::chrono::steady_clock::now() - start;
+   CHECK(rec.Peak() == 3);
+   CHECK(elapsed >= std::chrono::milliseconds(200));
+   CHECK(elapsed < std::chrono::milliseconds(550));
+}
+
+TEST_CASE("Devices of one group initialize one at a time", "[InitializationScheduler]")
+{
+   Recorder rec;
+   int module;
+   InitializationScheduler sched(NullLogger());
+   for (int i = 0; i < 4; ++i)
+   {
+      const std::string label = "Dev" + std::to_string(i);
+      sched.Add(label, &module, {}, rec.Device(label, 5));
+   }
+   sched.Run(4, std::chrono::milliseconds(0));
+   CHECK(rec.Peak() == 1);
+}
+
+TEST_CASE("Longest chains start first", "[InitializationScheduler]")
+{
+   Recorder rec;
+   int a, b, c;
+   InitializationScheduler sched(NullLogger());
+   sched.Add("Leaf", &a, {}, rec.Device("Leaf", 5));
+   sched.Add("Peripheral", &c, { "Hub" }, rec.Device("Peripheral", 5));
+   sched.Add("Hub", &b, {}, rec.Device("Hub", 5));
+   sched.Run(1, std::chrono::milliseconds(0));
+   CHECK(rec.Position("Hub") == 0);
+}
+
+TEST_CASE("Failed devices skip their dependents only", "[InitializationScheduler]")
+{
+   Recorder rec;
+   int a, b, c;
+   InitializationScheduler sched(NullLogger());
+   sched.Add("Hub", &a, {}, [] { throw CMMError("No answer", MMERR_GENERIC); });
+   sched.Add("Peripheral", &b, { "Hub" }, rec.Device("Peripheral", 1));
+   sched.Add("Second", &b, { "Peripheral" }, rec.Device("Second", 1));
+   sched.Add("Other", &c, {}, rec.Device("Other", 1));
+
+   std::vector<InitializationRecord> records =
+      sched.Run(4, std::chrono::milliseconds(0));
+   CHECK(records[0].result == InitializationRecord::Failed);
+   CHECK(records[0].message == "No answer");
+   CHECK_THROWS_AS(std::rethrow_exception(records[0].error), CMMError);
+   CHECK(records[1].result == InitializationRecord::Skipped);
+   CHECK(records[2].result == InitializationRecord::Skipped);
+   CHECK(records[3].result == InitializationRecord::Succeeded);
+   CHECK(rec.Position("Peripheral") == 1); // Never started
+}
+
+TEST_CASE("Devices that hang time out", "[InitializationScheduler]")
+{
+   Recorder rec;
+   int a, b;
+   InitializationScheduler sched(NullLogger());
+   // Shared so that it outlives the test if the thread does
+   auto finished = std::make_shared<std::atomic<bool>>(false);
+   sched.Add("Hung", &a, {}, [finished] {
+      std::this_thread::sleep_for(std::chrono::milliseconds(500));
+      *finished = true;
+   });
+   sched.Add("SameModule", &a, {}, rec.Device("SameModule", 1));
+   sched.Add("Peripheral", &b, { "Hung" }, rec.Device("Peripheral", 1));
+   sched.Add("Other", &b, {}, rec.Device("Other", 1));
+
+   const auto start = std::chrono::steady_clock::now();
+   std::vector<InitializationRecord> records =
+      sched.Run(4, std::chrono::milliseconds(50));
+   CHECK(std::chrono::steady_clock::now() - start < std::chrono::milliseconds(400));
+   CHECK_FALSE(*finished);
+
+   CHECK(records[0].result == InitializationRecord::TimedOut);
+   CHECK(records[0].duration == std::chrono::milliseconds(50));
+   CHECK(records[1].result == InitializationRecord::Skipped);
+   CHECK(records[2].result == InitializationRecord::Skipped);
+   CHECK(records[3].result == InitializationRecord::Succeeded);
+}
+
+TEST_CASE("Pending initializations can be waited for", "[InitializationScheduler]")
+{
+   auto pending = std::make_shared<PendingInitializations>();
+   CHECK(pending->WaitForAll(std::chrono::milliseconds(0)));
+
+   pending->Add("Hung");
+   pending->Add("Other");
+   pending->Remove("Other");
+   CHECK(pending->GetLabels() == std::vector<std::string>{ "Hung" });
+   CHECK_FALSE(pending->WaitForAll(std::chrono::milliseconds(10)));
+
+   std::thread t([pending] {
+      std::this_thread::sleep_for(std::chrono::milliseconds(50));
+      pending->Remove("Hung");
+   });
+   CHECK(pending->WaitForAll(std::chrono::milliseconds(5000)));
+   CHECK(pending->GetLabels().empty());
+   t.join();
+}
+
+TEST_CASE("Dependency cycles are skipped", "[InitializationScheduler]")
+{
+   int a, b, c;
+   InitializationScheduler sched(NullLogger());
+   sched.Add("A", &a, { "B" }, [] {});
+   sched.Add("B", &b, { "A" }, [] {});
+   sched.Add("C", &c, { "A" }, [] {});
+   sched.Add("D", &c, { "D" }, [] {}); // Depending on itself is ignored
+
+   std::vector<InitializationRecord> records =
+      sched.Run(4, std::chrono::milliseconds(0));
+   CHECK(records[0].result == InitializationRecord::Skipped);
+   CHECK(records[0].message == "Dependency cycle");
+   CHECK(records[1].result == InitializationRecord::Skipped);
+   CHECK(records[2].result == InitializationRecord::Skipped);
+   CHECK(records[3].result == InitializationRecord::Succeeded);
+}
+
+TEST_CASE("Core initialization timeout is validated", "[InitializationScheduler]")
+{
+   CMMCore c;
+   CHECK(c.getDeviceInitializationTimeoutMs() == 0);
+   c.setProperty("Core", "InitializationTimeoutMs", "30000");
+   CHECK(c.getDeviceInitializationTimeoutMs() == 30000);
+   CHECK_THROWS_AS(c.setDeviceInitializationTimeoutMs(-1), CMMError);
+   c.setDeviceInitializationTimeoutMs(0);
+   CHECK(c.getProperty("Core", "InitializationTimeoutMs") == "0");
+
+   c.initializeAllDevices();
+   CHECK(c.getDeviceInitializationTimeline().empty());
+}
+
+TEST_CASE_METHOD(SequenceTesterFixture, "Core reports the initialization timeline", "[InitializationScheduler]")
+{
+   CMMCore c;
+   c.setDeviceAdapterSearchPaths({ adapterPath });
+   c.loadDevice("TCamera", "SequenceTester", "TCamera");
+   c.loadDevice("THub", "SequenceTester", "THub");
+   c.setParentLabel("TCamera", "THub");
+   c.setDeviceInitializationTimeoutMs(10000);
+   c.initializeAllDevices();
+   CHECK(c.getCameraDevice() == "TCamera");
+
+   std::vector<std::string> timeline = c.getDeviceInitializationTimeline();
+   REQUIRE(timeline.size() == 2);
+   std::vector<std::string> labels;
+   for (const std::string& entry : timeline)
+   {
+      labels.push_back(entry.substr(0, entry.find('\t')));
+      CHECK(entry.substr(entry.rfind('\t') + 1) == "Succeeded");
+   }
+   CHECK(std::find(labels.begin(), labels.end(), "THub") <
+         std::find(labels.begin(), labels.end(), "TCamera"));
+}
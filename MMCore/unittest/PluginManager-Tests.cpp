@@ -0,0 +1,136 @@
+#include <catch2/catch_all.hpp>
+
+#include "Error.h"
+#include "LoadableModules/LoadedDeviceAdapter.h"
+#include "MMCore.h"
+#include "PluginManager.h"
+#include "SequenceTesterFixture.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <fstream>
+#include <string>
+#include <vector>
+
+#ifndef _WIN32
+#include <sys/stat.h>
+#include <unistd.h>
+#include <utime.h>
+
+namespace {
+
+bool Contains(const std::vector<std::string>& v, const std::string& s)
+{
+   return std::find(v.begin(), v.end(), s) != v.end();
+}
+
+std::string ModuleFile(const std::string& dir, const std::string& name)
+{
+#ifdef __linux__
+   return dir + "/libmmgr_dal_" + name + ".so.0";
+#else
+   return dir + "/libmmgr_dal_" + name;
+#endif
+}
+
+void SetModificationTime(const std::string& path, time_t t)
+{
+   struct utimbuf times;
+   times.actime = t;
+   times.modtime = t;
+   REQUIRE(utime(path.c_str(), &times) == 0);
+}
+
+} // anonymous namespace
+
+TEST_CASE("Module discovery is cached until the directory changes", "[PluginManager]")
+{
+   char dirTemplate[] = "/tmp/mmcore-plugins-XXXXXX";
+   REQUIRE(mkdtemp(dirTemplate));
+   const std::string dir = dirTemplate;
+   std::ofstream(ModuleFile(dir, "First").c_str()).put('x');
+   std::ofstream((dir + "/unrelated.txt").c_str()).put('x');
+
+   CPluginManager pm;
+   std::vector<std::string> paths(1, dir);
+   pm.SetSearchPaths(paths.begin(), paths.end());
+
+   // Recently modified directories are rescanned on every call
+   CHECK(pm.GetAvailableDeviceAdapters() == std::vector<std::string>{ "First" });
+   std::ofstream(ModuleFile(dir, "Second").c_str()).put('x');
+   CHECK(pm.GetAvailableDeviceAdapters().size() == 2);
+
+   // A scan made well after the last modification is reused, even when a
+   // file appears without the modification time changing...
+   const time_t past = time(0) - 60;
+   SetModificationTime(dir, past);
+   CHECK(pm.GetAvailableDeviceAdapters().size() == 2);
+   std::ofstream(ModuleFile(dir, "Third").c_str()).put('x');
+   SetModificationTime(dir, past);
+   CHECK(pm.GetAvailableDeviceAdapters().size() == 2);
+
+   // ...until the modification time changes
+   SetModificationTime(dir, past + 1);
+   std::vector<std::string> modules = pm.GetAvailableDeviceAdapters();
+   CHECK(modules.size() == 3);
+   CHECK(Contains(modules, "Third"));
+
+   std::remove(ModuleFile(dir, "First").c_str());
+   modules = pm.GetAvailableDeviceAdapters();
+   CHECK(modules.size() == 2);
+   CHECK_FALSE(Contains(modules, "First"));
+
+   // Modules that are not valid libraries fail when loaded, not when
+   // prefetched
+   pm.LoadDeviceAdapters({ "Second", "NoSuchModule" });
+   CHECK_THROWS_AS(pm.GetDeviceAdapter("Second"), CMMError);
+   CHECK_THROWS_AS(pm.GetDeviceAdapter("NoSuchModule"), CMMError);
+
+   std::remove(ModuleFile(dir, "Second").c_str());
+   std::remove(ModuleFile(dir, "Third").c_str());
+   std::remove((dir + "/unrelated.txt").c_str());
+   rmdir(dir.c_str());
+
+   // A search path that no longer exists lists nothing
+   CHECK(pm.GetAvailableDeviceAdapters().empty());
+}
+
+#endif // _WIN32
+
+TEST_CASE_METHOD(SequenceTesterFixture, "Adapter modules are loaded ahead of device creation", "[PluginManager]")
+{
+   CPluginManager pm;
+   std::vector<std::string> paths(1, adapterPath);
+   pm.SetSearchPaths(paths.begin(), paths.end());
+   pm.LoadDeviceAdapters({ "SequenceTester", "NoSuchModule", "SequenceTester" });
+   std::shared_ptr<LoadedDeviceAdapter> module =
+      pm.GetDeviceAdapter("SequenceTester");
+   CHECK(module->GetName() == "SequenceTester");
+   pm.LoadDeviceAdapters({ "SequenceTester" });
+   CHECK(pm.GetDeviceAdapter("SequenceTester") == module);
+
+   const std::string configFile = "PluginManager-Tests.cfg";
+   {
+      std::ofstream cfg(configFile.c_str());
+      cfg << "# Test configuration\r\n"
+         << "Device,THub,SequenceTester,THub\r\n"
+         << "Device,TCamera,SequenceTester,TCamera\r\n"
+         << "Parent,TCamera,THub\r\n"
+         << "Property,Core,Initialize,1\r\n";
+   }
+   CMMCore c;
+   c.setDeviceAdapterSearchPaths({ adapterPath });
+   c.loadSystemConfiguration(configFile.c_str());
+   CHECK(c.getLoadedDevices().size() == 3); // Including the Core
+   CHECK(c.getCameraDevice() == "TCamera");
+
+   {
+      std::ofstream cfg(configFile.c_str());
+      cfg << "Device,TCamera,SequenceTester,TCamera\n"
+         << "Device,Bad,NoSuchModule,Bad\n";
+   }
+   CMMCore c2;
+   c2.setDeviceAdapterSearchPaths({ adapterPath });
+   CHECK_THROWS_AS(c2.loadSystemConfiguration(configFile.c_str()), CMMError);
+   std::remove(configFile.c_str());
+}
@@ -0,0 +1,75 @@
+#include <catch2/catch_all.hpp>
+
+#include "MMCore.h"
+#include "SequenceTesterFixture.h"
+
+#include "../MMDevice/MMDeviceConstants.h"
+
+#include <string>
+
+TEST_CASE("Core properties can be accessed by handle", "[PropertyHandles]")
+{
+   CMMCore c;
+   long h = c.getPropertyHandle(MM::g_Keyword_CoreDevice,
+         MM::g_Keyword_CoreAutoShutter);
+   CHECK(c.getPropertyHandle(MM::g_Keyword_CoreDevice,
+         MM::g_Keyword_CoreAutoShutter) == h);
+
+   c.setPropertyByHandle(h, 0L);
+   CHECK_FALSE(c.getAutoShutter());
+   CHECK(c.getPropertyByHandle(h) == "0");
+   c.setPropertyByHandle(h, "1");
+   CHECK(c.getAutoShutter());
+   CHECK(c.getPropertyByHandle(h) == "1");
+   CHECK(c.getPropertyFromCache(MM::g_Keyword_CoreDevice,
+         MM::g_Keyword_CoreAutoShutter) == "1");
+
+   long other = c.getPropertyHandle(MM::g_Keyword_CoreDevice,
+         MM::g_Keyword_CoreCamera);
+   CHECK(other != h);
+   CHECK(c.getPropertyByHandle(other) == "");
+}
+
+TEST_CASE("Invalid property handles are rejected", "[PropertyHandles]")
+{
+   CMMCore c;
+   CHECK_THROWS_AS(c.getPropertyHandle(MM::g_Keyword_CoreDevice, "NoSuchProperty"), CMMError);
+   CHECK_THROWS_AS(c.getPropertyHandle("NoSuchDevice", "Exposure"), CMMError);
+   CHECK_THROWS_AS(c.getPropertyHandle(nullptr, "Exposure"), CMMError);
+   CHECK_THROWS_AS(c.getPropertyHandle(MM::g_Keyword_CoreDevice, nullptr), CMMError);
+
+   CHECK_THROWS_AS(c.getPropertyByHandle(0), CMMError);
+   CHECK_THROWS_AS(c.getPropertyByHandle(-1), CMMError);
+   long h = c.getPropertyHandle(MM::g_Keyword_CoreDevice,
+         MM::g_Keyword_CoreAutoShutter);
+   CHECK_THROWS_AS(c.getPropertyByHandle(h + 1), CMMError);
+   CHECK_THROWS_AS(c.setPropertyByHandle(h + 1, "1"), CMMError);
+   CHECK_THROWS_AS(c.setPropertyByHandle(h, static_cast<const char*>(nullptr)), CMMError);
+}
+
+TEST_CASE_METHOD(SequenceTesterFixture, "Property handles follow device reloading", "[PropertyHandles]")
+{
+   CMMCore c;
+   c.setDeviceAdapterSearchPaths({ adapterPath });
+   c.loadDevice("THub", "SequenceTester", "THub");
+   c.loadDevice("TCamera", "SequenceTester", "TCamera");
+   c.setParentLabel("TCamera", "THub");
+   c.initializeAllDevices();
+
+   long h = c.getPropertyHandle("TCamera", MM::g_Keyword_Exposure);
+   c.setPropertyByHandle(h, 12.5);
+   CHECK(c.getProperty("TCamera", MM::g_Keyword_Exposure) == "12.5000");
+   CHECK(c.getPropertyByHandle(h) == "12.5000");
+   CHECK(c.getPropertyFromCache("TCamera", MM::g_Keyword_Exposure) == "12.5000");
+   CHECK_THROWS_AS(c.getPropertyHandle("TCamera", "NoSuchProperty"), CMMError);
+
+   c.unloadDevice("TCamera");
+   CHECK_THROWS_AS(c.getPropertyByHandle(h), CMMError);
+
+   c.loadDevice("TCamera", "SequenceTester", "TCamera");
+   c.setParentLabel("TCamera", "THub");
+   c.initializeDevice("TCamera");
+   c.setPropertyByHandle(h, 7.0);
+   CHECK(c.getProperty("TCamera", MM::g_Keyword_Exposure) == "7.0000");
+   CHECK(c.getPropertyHandle("TCamera", MM::g_Keyword_Exposure) == h);
+}
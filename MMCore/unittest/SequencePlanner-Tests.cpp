@@ -0,0 +1,256 @@
+#include <catch2/catch_all.hpp>
+
+#include "MMCore.h"
+#include "SequencePlanner.h"
+#include "SequenceTesterFixture.h"
+
+#include "../MMDevice/ImageMetadata.h"
+#include "../MMDevice/MMDeviceConstants.h"
+
+#include <chrono>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace {
+
+mm::SequenceAxis StageAxis(const std::string& stage)
+{
+   mm::SequenceAxis axis = { mm::SequenceAxis::Stage, stage, std::string() };
+   return axis;
+}
+
+mm::SequenceAxis ExposureAxis()
+{
+   mm::SequenceAxis axis = { mm::SequenceAxis::Exposure, std::string(), std::string() };
+   return axis;
+}
+
+// One map per event with Z and exposure set
+std::vector<mm::SequenceEvent::SettingMap> Settings(
+      const std::vector<double>& z, const std::vector<double>& exposure)
+{
+   std::vector<mm::SequenceEvent::SettingMap> settings;
+   for (std::size_t i = 0; i < z.size(); ++i)
+   {
+      mm::SequenceEvent event;
+      event.SetStagePosition("Z", z[i]).SetExposure(exposure[i]);
+      settings.push_back(event.GetSettings());
+   }
+   return settings;
+}
+
+std::vector<std::size_t> RunLengths(const std::vector<mm::SequenceRun>& runs)
+{
+   std::vector<std::size_t> lengths;
+   for (const mm::SequenceRun& run : runs)
+      lengths.push_back(run.eventCount);
+   return lengths;
+}
+
+} // namespace
+
+TEST_CASE("Sequence planner keeps unchanged settings fixed", "[SequencePlanner]")
+{
+   mm::SequencePlanner::CapabilityMap caps;
+   auto runs = mm::SequencePlanner::Split(
+         Settings({ 1.0, 1.0, 1.0 }, { 10.0, 10.0, 10.0 }), caps);
+   REQUIRE(runs.size() == 1);
+   CHECK(runs[0].firstEvent == 0);
+   CHECK(runs[0].eventCount == 3);
+   CHECK(runs[0].sequenced.empty());
+   CHECK(runs[0].fixed.at(StageAxis("Z")).x == 1.0);
+   CHECK(runs[0].fixed.at(ExposureAxis()).x == 10.0);
+
+   CHECK(mm::SequencePlanner::Split({}, caps).empty());
+}
+
+TEST_CASE("Sequence planner splits at non-sequenceable changes", "[SequencePlanner]")
+{
+   mm::SequencePlanner::CapabilityMap caps;
+   caps[StageAxis("Z")] = 100;
+   auto runs = mm::SequencePlanner::Split(
+         Settings({ 0, 1, 2, 3, 4 }, { 10, 10, 20, 20, 10 }), caps);
+   CHECK(RunLengths(runs) == std::vector<std::size_t>{ 2, 2, 1 });
+   REQUIRE(runs.size() == 3);
+   CHECK(runs[1].firstEvent == 2);
+   CHECK(runs[1].fixed.at(ExposureAxis()).x == 20.0);
+   const auto& z = runs[1].sequenced.at(StageAxis("Z"));
+   REQUIRE(z.size() == 2);
+   CHECK(z[0].x == 2.0);
+   CHECK(z[1].x == 3.0);
+   // A single event needs no sequence
+   CHECK(runs[2].sequenced.empty());
+   CHECK(runs[2].fixed.at(StageAxis("Z")).x == 4.0);
+}
+
+TEST_CASE("Sequence planner chunks sequences longer than the maximum", "[SequencePlanner]")
+{
+   mm::SequencePlanner::CapabilityMap caps;
+   caps[StageAxis("Z")] = 4;
+   std::vector<double> z, exposure(10, 10.0);
+   for (int i = 0; i < 10; ++i)
+      z.push_back(i);
+   auto runs = mm::SequencePlanner::Split(Settings(z, exposure), caps);
+   CHECK(RunLengths(runs) == std::vector<std::size_t>{ 4, 4, 2 });
+   for (const mm::SequenceRun& run : runs)
+   {
+      const auto& values = run.sequenced.at(StageAxis("Z"));
+      REQUIRE(values.size() == run.eventCount);
+      for (std::size_t i = 0; i < values.size(); ++i)
+         CHECK(values[i].x == static_cast<double>(run.firstEvent + i));
+   }
+}
+
+TEST_CASE("Sequence planner limits runs by the shortest sequenced device", "[SequencePlanner]")
+{
+   mm::SequencePlanner::CapabilityMap caps;
+   caps[StageAxis("Z")] = 100;
+   caps[ExposureAxis()] = 3;
+   auto runs = mm::SequencePlanner::Split(
+         Settings({ 0, 1, 2, 3, 4, 5, 6 }, { 10, 10, 10, 10, 20, 20, 20 }), caps);
+   // Exposure only starts changing within the second run
+   CHECK(RunLengths(runs) == std::vector<std::size_t>{ 4, 3 });
+   REQUIRE(runs.size() == 2);
+   CHECK(runs[0].fixed.count(ExposureAxis()) == 1);
+   CHECK(runs[1].fixed.count(ExposureAxis()) == 1);
+
+   caps[ExposureAxis()] = 2;
+   runs = mm::SequencePlanner::Split(
+         Settings({ 0, 1, 2, 3 }, { 10, 20, 10, 20 }), caps);
+   CHECK(RunLengths(runs) == std::vector<std::size_t>{ 2, 2 });
+}
+
+namespace {
+
+void LoadTesterDevices(CMMCore& core, const std::string& adapterPath,
+      long zMaxLength, long switcherMaxLength)
+{
+   core.setDeviceAdapterSearchPaths({ adapterPath });
+   core.loadDevice("THub", "SequenceTester", "THub");
+   core.loadDevice("TCamera", "SequenceTester", "TCamera");
+   core.loadDevice("TZStage", "SequenceTester", "TZStage");
+   core.loadDevice("TSwitcher", "SequenceTester", "TSwitcher");
+   core.setParentLabel("TCamera", "THub");
+   core.setParentLabel("TZStage", "THub");
+   core.setParentLabel("TSwitcher", "THub");
+   core.setProperty("TCamera", "ImageWidth", 32L);
+   core.setProperty("TCamera", "ImageHeight", 32L);
+   core.initializeAllDevices();
+
+   core.setCameraDevice("TCamera");
+   core.setFocusDevice("TZStage");
+   core.setProperty("TCamera", "Exposure", 1.0);
+   core.setProperty("TZStage", "TriggerSourceDevice", "TCamera");
+   core.setProperty("TZStage", "TriggerSourcePort", "ExposureStartEdge");
+   core.setProperty("TZStage", "TriggerSequenceMaxLength", zMaxLength);
+   core.setProperty("TSwitcher", "TriggerSourceDevice", "TCamera");
+   core.setProperty("TSwitcher", "TriggerSourcePort", "ExposureStartEdge");
+   core.setProperty("TSwitcher", "TriggerSequenceMaxLength", switcherMaxLength);
+   core.setCircularBufferMemoryFootprint(4);
+}
+
+} // namespace
+
+TEST_CASE_METHOD(SequenceTesterFixture, "Sequence planner streams a Z stack through SequenceTester", "[SequencePlanner]")
+{
+   CMMCore core;
+   LoadTesterDevices(core, adapterPath, 4, 0);
+
+   std::vector<mm::SequenceEvent> events(10);
+   for (std::size_t i = 0; i < events.size(); ++i)
+      events[i].SetStagePosition("TZStage", 1.0 + i);
+
+   mm::SequencePlanner planner(core);
+   CHECK(planner.GetCamera() == "TCamera");
+   CHECK(RunLengths(planner.Plan(events)) == std::vector<std::size_t>{ 4, 4, 2 });
+
+   std::vector<std::size_t> frames;
+   planner.Run(events, [&](std::size_t event, const void* pixels, const Metadata& md) {
+      CHECK(pixels != nullptr);
+      CHECK(md.GetSingleTag(MM::g_Keyword_Metadata_CameraLabel).GetValue() == "TCamera");
+      frames.push_back(event);
+   });
+
+   REQUIRE(frames.size() == 10);
+   for (std::size_t i = 0; i < frames.size(); ++i)
+      CHECK(frames[i] == i);
+   // Each frame advanced the Z sequence, ending at the last event
+   CHECK(core.getPosition("TZStage") == 10.0);
+   CHECK_FALSE(core.isSequenceRunning("TCamera"));
+}
+
+TEST_CASE_METHOD(SequenceTesterFixture, "Sequence planner sets non-sequenceable devices between runs", "[SequencePlanner]")
+{
+   CMMCore core;
+   LoadTesterDevices(core, adapterPath, 100, 0);
+
+   core.setState("TSwitcher", 1);
+   std::vector<mm::SequenceEvent> events(6);
+   for (std::size_t i = 0; i < events.size(); ++i)
+      events[i].SetStagePosition("TZStage", 10.0 * i);
+   events[3].SetProperty("TSwitcher", MM::g_Keyword_State, "2");
+
+   mm::SequencePlanner planner(core);
+   auto runs = planner.Plan(events);
+   CHECK(RunLengths(runs) == std::vector<std::size_t>{ 3, 3 });
+   REQUIRE(runs.size() == 2);
+   mm::SequenceAxis switcher = { mm::SequenceAxis::Property, "TSwitcher", MM::g_Keyword_State };
+   // The switcher starts out at its current state
+   CHECK(runs[0].fixed.at(switcher).text == "1");
+   CHECK(runs[1].fixed.at(switcher).text == "2");
+
+   std::size_t frameCount = 0;
+   planner.Run(events, [&](std::size_t, const void*, const Metadata&) {
+      ++frameCount;
+   });
+   CHECK(frameCount == 6);
+   CHECK(core.getState("TSwitcher") == 2);
+   CHECK(core.getPosition("TZStage") == 50.0);
+}
+
+TEST_CASE_METHOD(SequenceTesterFixture, "Sequence planner sequences properties through SequenceTester", "[SequencePlanner]")
+{
+   CMMCore core;
+   LoadTesterDevices(core, adapterPath, 0, 8);
+
+   std::vector<mm::SequenceEvent> events(5);
+   for (std::size_t i = 0; i < events.size(); ++i)
+      events[i].SetProperty("TSwitcher", MM::g_Keyword_State, std::to_string(i + 3));
+
+   mm::SequencePlanner planner(core);
+   CHECK(RunLengths(planner.Plan(events)) == std::vector<std::size_t>{ 5 });
+   planner.Run(events, nullptr);
+   CHECK(core.getState("TSwitcher") == 7);
+   CHECK(core.getRemainingImageCount() == 0);
+}
+
+TEST_CASE_METHOD(SequenceTesterFixture, "Core loads numeric property sequences into SequenceTester", "[SequencePlanner]")
+{
+   CMMCore core;
+   LoadTesterDevices(core, adapterPath, 0, 8);
+
+   core.loadPropertySequence("TSwitcher", MM::g_Keyword_State,
+         std::vector<long>{ 3, 4, 5 });
+   CHECK_THROWS(core.loadPropertySequence("TSwitcher", MM::g_Keyword_State,
+         std::vector<long>(9, 1L)));
+   core.loadPropertySequence("TSwitcher", MM::g_Keyword_State,
+         std::vector<double>{ 1.0, 2.0, 6.0 });
+   core.startPropertySequence("TSwitcher", MM::g_Keyword_State);
+   core.startSequenceAcquisition(3, 0.0, true);
+   for (int i = 0; i < 500 && core.getRemainingImageCount() < 3; ++i)
+      std::this_thread::sleep_for(std::chrono::milliseconds(10));
+   core.stopSequenceAcquisition();
+   core.stopPropertySequence("TSwitcher", MM::g_Keyword_State);
+   CHECK(core.getRemainingImageCount() == 3);
+   CHECK(core.getState("TSwitcher") == 6);
+}
+
+TEST_CASE("Core properties cannot be loaded with numeric sequences", "[SequencePlanner]")
+{
+   CMMCore core;
+   CHECK_THROWS_AS(core.loadPropertySequence("Core", "TimeoutMs",
+         std::vector<double>{ 1.0, 2.0 }), CMMError);
+   CHECK_THROWS_AS(core.loadPropertySequence("Core", "TimeoutMs",
+         std::vector<long>{ 1, 2 }), CMMError);
+}
@@ -0,0 +1,25 @@
+#pragma once
+
+#include <catch2/catch_all.hpp>
+
+#include <cstdlib>
+#include <string>
+
+// Base for tests that use the SequenceTester device adapter, loaded from the
+// directory given by the environment variable MM_TEST_ADAPTER_PATH (set by
+// meson.build when it builds the adapter). The tests are skipped if it is not
+// set.
+class SequenceTesterFixture
+{
+public:
+   SequenceTesterFixture()
+   {
+      const char* path = std::getenv("MM_TEST_ADAPTER_PATH");
+      if (!path || !*path)
+         SKIP("MM_TEST_ADAPTER_PATH not set");
+      adapterPath = path;
+   }
+
+protected:
+   std::string adapterPath;
+};
@@ -0,0 +1,160 @@
+#include <catch2/catch_all.hpp>
+
+#include "Error.h"
+#include "MMCore.h"
+#include "SequenceTesterFixture.h"
+#include "SystemConfigurationFile.h"
+
+#include <cstdio>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+using namespace mm;
+
+namespace {
+
+std::vector<SystemConfigurationCommand> Parse(const std::string& text)
+{
+   std::istringstream is(text);
+   return ParseSystemConfiguration(is);
+}
+
+} // anonymous namespace
+
+TEST_CASE("Configuration lines are parsed into commands", "[SystemConfigurationFile]")
+{
+   std::vector<SystemConfigurationCommand> commands = Parse(
+         "# Comment\r\n"
+         "\r\n"
+         "Device,Cam,DemoCamera,DCam\r\n"
+         "Property,Cam,Mode,\r\n"
+         "Property,Core,Initialize,1\n"
+         "NoSuchCommand,x\n"
+         "ConfigGroup,Channel\n"
+         "ConfigGroup,Channel,DAPI,Wheel,Label\n"
+         "PixelSizeAffine,Res,1,0,0,0,1,0\n"
+         "Config,a,b,c,d\n"
+         "Parent,Cam,Hub");
+   REQUIRE(commands.size() == 8);
+
+   CHECK(commands[0].kind == SystemConfigurationCommand::Device);
+   CHECK(commands[0].lineNumber == 3);
+   CHECK(commands[0].line == "Device,Cam,DemoCamera,DCam");
+   CHECK(commands[0].args == std::vector<std::string>{ "Cam", "DemoCamera", "DCam" });
+
+   // An omitted value is empty
+   CHECK(commands[1].kind == SystemConfigurationCommand::Property);
+   CHECK(commands[1].args == std::vector<std::string>{ "Cam", "Mode", "" });
+   CHECK(commands[2].args == std::vector<std::string>{ "Core", "Initialize", "1" });
+
+   CHECK(commands[3].kind == SystemConfigurationCommand::ConfigGroup);
+   CHECK(commands[3].lineNumber == 7);
+   CHECK(commands[4].kind == SystemConfigurationCommand::ConfigPreset);
+   CHECK(commands[4].args.size() == 5);
+   CHECK(commands[4].args[4].empty());
+   CHECK(commands[5].kind == SystemConfigurationCommand::PixelSizeAffine);
+   CHECK(commands[5].args.size() == 7);
+   CHECK(commands[6].kind == SystemConfigurationCommand::ObsoleteConfig);
+   CHECK(commands[7].kind == SystemConfigurationCommand::Parent);
+   CHECK(commands[7].lineNumber == 11);
+}
+
+TEST_CASE("Malformed configuration lines are marked invalid", "[SystemConfigurationFile]")
+{
+   std::vector<SystemConfigurationCommand> commands = Parse(
+         "Device,Cam,DemoCamera\n"
+         "Property,Cam\n"
+         ",,,\n"
+         "Equipment,a,b\n"
+         "ImageSynchro,Cam\n"
+         "ConfigGroup,Channel,DAPI\n"
+         "Label,Wheel,1\n");
+   REQUIRE(commands.size() == 7);
+   for (const SystemConfigurationCommand& command : commands)
+   {
+      CHECK(command.kind == SystemConfigurationCommand::Invalid);
+      CHECK(command.args.empty());
+   }
+   CHECK(commands[2].line == ",,,");
+}
+
+TEST_CASE("Long configuration lines are read whole", "[SystemConfigurationFile]")
+{
+   const std::string value(10000, 'x');
+   std::vector<SystemConfigurationCommand> commands =
+      Parse("Property,Dev,Prop," + value + "\nParent,A,B\n");
+   REQUIRE(commands.size() == 2);
+   CHECK(commands[0].args[2] == value);
+   CHECK(commands[1].kind == SystemConfigurationCommand::Parent);
+}
+
+TEST_CASE("Malformed configuration is rejected before loading devices", "[SystemConfigurationFile]")
+{
+   const std::string configFile = "SystemConfigurationFile-Tests.cfg";
+   {
+      std::ofstream cfg(configFile.c_str());
+      cfg << "Device,A,NoSuchModule,A\n"
+         << "Property,Core,Initialize,1\n"
+         << "Label,A,1\n";
+   }
+   CMMCore c;
+   try
+   {
+      c.loadSystemConfiguration(configFile.c_str());
+      FAIL("No exception");
+   }
+   catch (const CMMError& e)
+   {
+      // Reported for the malformed line, not the Device line
+      CHECK(e.getCode() == MMERR_InvalidConfigurationFile);
+      CHECK(e.getMsg().find("Line 3: Label,A,1") == 0);
+   }
+   std::remove(configFile.c_str());
+}
+
+TEST_CASE_METHOD(SequenceTesterFixture, "Configuration properties are applied and cached", "[SystemConfigurationFile]")
+{
+   const std::string configFile = "SystemConfigurationFile-Tests.cfg";
+   {
+      std::ofstream cfg(configFile.c_str());
+      cfg << "Device,THub,SequenceTester,THub\n"
+         << "Device,TCamera,SequenceTester,TCamera\n"
+         << "Property,TCamera,ImageWidth,64\n"
+         << "Property,TCamera,ImageHeight,48\n"
+         << "Parent,TCamera,THub\n"
+         << "Property,Core,Initialize,1\n"
+         << "Property,TCamera,Exposure,12.5\n"
+         << "Property,TCamera,Binning,2\n"
+         << "ConfigGroup,System,Startup,TCamera,Exposure,20\n";
+   }
+   CMMCore c;
+   c.setDeviceAdapterSearchPaths({ adapterPath });
+   c.loadSystemConfiguration(configFile.c_str());
+   CHECK(c.getImageWidth() == 64);
+   CHECK(c.getPropertyFromCache("TCamera", "ImageHeight") == "48");
+   CHECK(c.getPropertyFromCache("TCamera", "Binning") == "2");
+   CHECK(c.getPropertyFromCache("TCamera", "Exposure") == "20.0000");
+   CHECK(c.getExposure() == 20.0);
+
+   {
+      std::ofstream cfg(configFile.c_str());
+      cfg << "Device,TCamera,SequenceTester,TCamera\n"
+         << "Property,TCamera,ImageWidth,64\n"
+         << "Property,TCamera,NoSuchProperty,1\n";
+   }
+   CMMCore c2;
+   c2.setDeviceAdapterSearchPaths({ adapterPath });
+   try
+   {
+      c2.loadSystemConfiguration(configFile.c_str());
+      FAIL("No exception");
+   }
+   catch (const CMMError& e)
+   {
+      CHECK(e.getMsg().find("Line 3: ") == 0);
+   }
+   CHECK(c2.getLoadedDevices().size() == 1); // Only the Core
+   std::remove(configFile.c_str());
+}
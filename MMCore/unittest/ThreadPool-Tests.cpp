@@ -0,0 +1,146 @@
+#include <catch2/catch_all.hpp>
+
+#include "MMCore.h"
+#include "Semaphore.h"
+#include "Task.h"
+#include "TaskSet_CopyMemory.h"
+#include "ThreadPool.h"
+
+#include <atomic>
+#include <cstring>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+namespace {
+
+class FuncTask : public Task
+{
+public:
+   FuncTask(std::shared_ptr<Semaphore> semaphore, std::function<void()> func) :
+      Task(semaphore, 0, 1),
+      func_(func)
+   {}
+
+   void Execute() override { func_(); }
+
+private:
+   std::function<void()> func_;
+};
+
+} // anonymous namespace
+
+TEST_CASE("Parallel loop makes every call once", "[ThreadPool]")
+{
+   ThreadPool pool(3);
+   CHECK(pool.GetSize() == 3);
+
+   std::vector<std::atomic<int>> calls(1000);
+   pool.ParallelFor(calls.size(), [&](size_t i) { ++calls[i]; });
+   for (const auto& c : calls)
+      CHECK(c == 1);
+
+   pool.ParallelFor(0, [](size_t) { FAIL("Called"); });
+}
+
+TEST_CASE("Nested parallel loops do not deadlock", "[ThreadPool]")
+{
+   ThreadPool pool(2);
+   std::atomic<int> total{ 0 };
+   pool.ParallelFor(8, [&](size_t)
+   {
+      pool.ParallelFor(8, [&](size_t) { ++total; });
+   });
+   CHECK(total == 64);
+
+   // Tasks submitted from a pool thread run on that thread
+   auto semaphore = std::make_shared<Semaphore>();
+   pool.ParallelFor(4, [&](size_t)
+   {
+      FuncTask task(semaphore, [&]() { ++total; });
+      pool.Execute(&task);
+      semaphore->Wait();
+   });
+   CHECK(total == 68);
+}
+
+TEST_CASE("Parallel loop rethrows the first exception", "[ThreadPool]")
+{
+   ThreadPool pool(2);
+   std::atomic<int> calls{ 0 };
+   CHECK_THROWS_AS(pool.ParallelFor(100, [&](size_t i)
+   {
+      ++calls;
+      if (i % 10 == 3)
+         throw std::runtime_error("Failed");
+   }), std::runtime_error);
+   CHECK(calls == 100);
+}
+
+TEST_CASE("Critical tasks run before background tasks", "[ThreadPool]")
+{
+   ThreadPool pool(1);
+   auto semaphore = std::make_shared<Semaphore>();
+
+   // Keep the only thread busy while the other tasks are queued
+   std::promise<void> started;
+   std::promise<void> release;
+   std::shared_future<void> released = release.get_future().share();
+   FuncTask blocker(semaphore, [&]()
+   {
+      started.set_value();
+      released.wait();
+   });
+   pool.Execute(&blocker);
+   started.get_future().wait();
+
+   std::mutex mx;
+   std::string order;
+   std::vector<std::unique_ptr<FuncTask>> tasks;
+   for (char kind : std::string("BBBCCC"))
+   {
+      tasks.push_back(std::make_unique<FuncTask>(semaphore, [&, kind]()
+      {
+         std::lock_guard<std::mutex> lock(mx);
+         order += kind;
+      }));
+      pool.Execute(tasks.back().get(), kind == 'C' ?
+            ThreadPool::Priority::Critical : ThreadPool::Priority::Background);
+   }
+
+   release.set_value();
+   semaphore->Wait(7);
+   CHECK(order == "CCCBBB");
+}
+
+TEST_CASE("Memory copy runs on a shared pool", "[ThreadPool]")
+{
+   auto pool = std::make_shared<ThreadPool>(2);
+   TaskSet_CopyMemory copier(pool);
+   std::vector<unsigned char> src(1 << 20);
+   for (size_t i = 0; i < src.size(); ++i)
+      src[i] = static_cast<unsigned char>(i * 7);
+   std::vector<unsigned char> dst(src.size());
+   copier.MemCopy(dst.data(), src.data(), src.size());
+   CHECK(std::memcmp(dst.data(), src.data(), src.size()) == 0);
+
+   std::atomic<int> calls{ 0 };
+   pool->ParallelFor(16, [&](size_t) { ++calls; },
+         ThreadPool::Priority::Background);
+   CHECK(calls == 16);
+}
+
+TEST_CASE("Core thread pool affinity", "[ThreadPool]")
+{
+   CMMCore c;
+   CHECK(c.getThreadPoolSize() >= 1);
+   CHECK_THROWS_AS(c.setThreadPoolAffinity({ -1 }), CMMError);
+#ifdef __linux__
+   c.setThreadPoolAffinity({ 0 });
+   c.setThreadPoolAffinity({});
+#endif
+}
@@ -0,0 +1,62 @@
+#include <catch2/catch_all.hpp>
+
+#include "MMCore.h"
+#include "SequenceTesterFixture.h"
+
+#include "../MMDevice/MMDeviceConstants.h"
+
+
+TEST_CASE("Core properties are read as numbers", "[TypedProperty]")
+{
+   CMMCore c;
+   c.setAutoShutter(true);
+   CHECK(c.getPropertyAsLong(MM::g_Keyword_CoreDevice,
+         MM::g_Keyword_CoreAutoShutter) == 1);
+   CHECK(c.getPropertyAsDouble(MM::g_Keyword_CoreDevice,
+         MM::g_Keyword_CoreAutoShutter) == 1.0);
+   // Empty and non-numeric values are not numbers
+   CHECK_THROWS_AS(c.getPropertyAsDouble(MM::g_Keyword_CoreDevice,
+         MM::g_Keyword_CoreCamera), CMMError);
+
+   c.setProperty(MM::g_Keyword_CoreDevice, MM::g_Keyword_CoreAutoShutter, 0L);
+   CHECK_FALSE(c.getAutoShutter());
+}
+
+TEST_CASE_METHOD(SequenceTesterFixture, "Device properties are read and set as numbers", "[TypedProperty]")
+{
+   CMMCore c;
+   c.setDeviceAdapterSearchPaths({ adapterPath });
+   c.loadDevice("THub", "SequenceTester", "THub");
+   c.loadDevice("TCamera", "SequenceTester", "TCamera");
+   c.loadDevice("TShutter", "SequenceTester", "TShutter");
+   c.setParentLabel("TCamera", "THub");
+   c.setParentLabel("TShutter", "THub");
+   c.initializeAllDevices();
+
+   // Float property
+   c.setProperty("TCamera", MM::g_Keyword_Exposure, 12.345678);
+   CHECK(c.getPropertyAsDouble("TCamera", MM::g_Keyword_Exposure) == 12.3457);
+   CHECK(c.getPropertyAsLong("TCamera", MM::g_Keyword_Exposure) == 12);
+   CHECK(c.getProperty("TCamera", MM::g_Keyword_Exposure) == "12.3457");
+   CHECK(c.getPropertyFromCache("TCamera", MM::g_Keyword_Exposure) == "12.3457");
+   c.setProperty("TCamera", MM::g_Keyword_Exposure, 5L);
+   CHECK(c.getPropertyAsDouble("TCamera", MM::g_Keyword_Exposure) == 5.0);
+
+   // Integer property
+   c.setProperty("TCamera", "ImageWidth", 64L);
+   CHECK(c.getPropertyAsLong("TCamera", "ImageWidth") == 64);
+   CHECK(c.getPropertyAsDouble("TCamera", "ImageWidth") == 64.0);
+   CHECK(c.getPropertyFromCache("TCamera", "ImageWidth") == "64");
+
+   // Property with allowed values
+   c.setProperty("TShutter", MM::g_Keyword_State, 1L);
+   CHECK(c.getPropertyAsLong("TShutter", MM::g_Keyword_State) == 1);
+   CHECK_THROWS_AS(c.setProperty("TShutter", MM::g_Keyword_State, 2L), CMMError);
+
+   // String property
+   CHECK_THROWS_AS(c.getPropertyAsDouble("TCamera", "ImageMode"), CMMError);
+
+   long h = c.getPropertyHandle("TCamera", MM::g_Keyword_Exposure);
+   c.setPropertyByHandle(h, 2.5);
+   CHECK(c.getPropertyAsDouble("TCamera", MM::g_Keyword_Exposure) == 2.5);
+}
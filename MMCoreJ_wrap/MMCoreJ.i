@@ -510,6 +510,28 @@
    }
 }
 
+// Map input arguments: java.nio.ByteBuffer -> C++ (void* buffer, unsigned long bufferSize)
+// for copying images into caller-supplied memory (getImageInto(),
+// getLastImageInto(), popNextImageInto(), popNextImages()). The buffer must be direct, so
+// that it can be reused across frames without a Java array being allocated
+// and garbage collected for each image.
+%typemap(jni) (void* buffer, unsigned long bufferSize)        "jobject"
+%typemap(jtype) (void* buffer, unsigned long bufferSize)      "java.nio.ByteBuffer"
+%typemap(jstype) (void* buffer, unsigned long bufferSize)     "java.nio.ByteBuffer"
+%typemap(javain) (void* buffer, unsigned long bufferSize)     "$javainput"
+%typemap(in) (void* buffer, unsigned long bufferSize)
+{
+   $1 = $input ? JCALL1(GetDirectBufferAddress, jenv, $input) : 0;
+   if ($1 == 0)
+   {
+      jclass excep = jenv->FindClass("java/lang/IllegalArgumentException");
+      if (excep)
+         jenv->ThrowNew(excep, "Image buffer must be a direct ByteBuffer");
+      return $null;
+   }
+   $2 = (unsigned long) JCALL1(GetDirectBufferCapacity, jenv, $input);
+}
+
 // Java typemap
 // change default SWIG mapping of void* return values
 // to return CObject containing array of pixel values
@@ -652,122 +674,35 @@
    }
 
 
-   private JSONObject metadataToMap(Metadata md) {
-      JSONObject tags = new JSONObject();
-      for (String key:md.GetKeys()) {
-         try {
-            tags.put(key, md.GetSingleTag(key).GetValue());
-         } catch (Exception e) {} 
-      }
-      return tags;
-   }
-
-   private String getROITag() throws java.lang.Exception {
-      String roi = "";
-      int [] x = new int[1];
-      int [] y = new int[1];
-      int [] xSize = new int[1];
-      int [] ySize = new int[1];
-      getROI(x, y, xSize, ySize);
-      roi += x[0] + "-" + y[0] + "-" + xSize[0] + "-" + ySize[0];
-      return roi;
-   }
-
-   private String getPixelType() {
-      int depth = (int) getBytesPerPixel();
-      int numComponents = (int) getNumberOfComponents();
-      switch (depth) {
-         case 1:
-            return "GRAY8";
-         case 2:
-            return "GRAY16";
-         case 4: {
-            if (numComponents == 1)
-               return "GRAY32";
-            else
-               return "RGB32";
-            }
-         case 8:
-            return "RGB64";
-     }
-     return "";
-   }
-
-   private String getMultiCameraChannel(JSONObject tags, int cameraChannelIndex) {
-	  try {
-	  String camera = tags.getString("Core-Camera");
-	  String physCamKey = camera + "-Physical Camera " + (1 + cameraChannelIndex);
-	  if (tags.has(physCamKey)) {
-		 try {
-			return tags.getString(physCamKey);
-		 } catch (Exception e2) {
-			return null;
-		 }
-	  } else {
-		 return null;
-	  }
-	 } catch (Exception e) {
-	   return null;
-	 }
-
-   }
-
    private TaggedImage createTaggedImage(Object pixels, Metadata md, int cameraChannelIndex) throws java.lang.Exception {
-      TaggedImage image = createTaggedImage(pixels, md);
-      JSONObject tags = image.tags;
-      
-      if (!tags.has("CameraChannelIndex")) {
-         tags.put("CameraChannelIndex", cameraChannelIndex);
-         tags.put("ChannelIndex", cameraChannelIndex);
-      }
-      if (!tags.has("Camera")) {
-         String physicalCamera = getMultiCameraChannel(tags, cameraChannelIndex);
-         if (physicalCamera != null) {
-            tags.put("Camera", physicalCamera);
-            tags.put("Channel",physicalCamera);
-         }
-      }
-      return image;
+      JSONObject tags = new JSONObject(getTaggedImageTags(md, cameraChannelIndex, includeSystemStateCache_));
+      return new TaggedImage(pixels, tags);
    }
 
    private TaggedImage createTaggedImage(Object pixels, Metadata md) throws java.lang.Exception {
-      JSONObject tags = metadataToMap(md);
-      PropertySetting setting;
-      if (includeSystemStateCache_) {
-         Configuration config = getSystemStateCache();
-         for (int i = 0; i < config.size(); ++i) {
-            setting = config.getSetting(i);
-            String key = setting.getDeviceLabel() + "-" + setting.getPropertyName();
-            String value = setting.getPropertyValue();
-             tags.put(key, value);
-         }
-      }
-      tags.put("BitDepth", getImageBitDepth());
-      tags.put("PixelSizeUm", getPixelSizeUm(true));
-      tags.put("PixelSizeAffine", getPixelSizeAffineAsString());
-      tags.put("ROI", getROITag());
-      tags.put("Width", getImageWidth());
-      tags.put("Height", getImageHeight());
-      tags.put("PixelType", getPixelType());
-      tags.put("Frame", 0);
-      tags.put("FrameIndex", 0);
-      tags.put("Position", "Default");
-      tags.put("PositionIndex", 0);
-      tags.put("Slice", 0);
-      tags.put("SliceIndex", 0);
-      String channel = getCurrentConfigFromCache(getPropertyFromCache("Core","ChannelGroup"));
-      if ((channel == null) || (channel.length() == 0)) {
-         channel = "Default";
-      }
-      tags.put("Channel", channel);
-      tags.put("ChannelIndex", 0);
+      JSONObject tags = new JSONObject(getTaggedImageTags(md, includeSystemStateCache_));
+      return new TaggedImage(pixels, tags);
+   }
 
+   /**
+    * Allocates a direct buffer that holds one image of the current camera.
+    *
+    * The buffer can be passed to getImageInto(), getLastImageInto() and
+    * popNextImageInto() for every frame, avoiding the allocation of a new
+    * pixel array per image. Its byte order is the native byte order, which
+    * is that of the pixels.
+    */
+   public java.nio.ByteBuffer allocateImageBuffer() {
+      return allocateImageBuffer(1);
+   }
 
-      try {
-         tags.put("Binning", getProperty(getCameraDevice(), "Binning"));
-      } catch (Exception ex) {}
-      
-      return new TaggedImage(pixels, tags);	
+   /**
+    * Allocates a direct buffer that holds imageCount images of the current
+    * camera, for use with popNextImages().
+    */
+   public java.nio.ByteBuffer allocateImageBuffer(int imageCount) {
+      return java.nio.ByteBuffer.allocateDirect(imageCount * (int) getImageBufferSize()).
+         order(java.nio.ByteOrder.nativeOrder());
    }
 
    public TaggedImage getTaggedImage(int cameraChannelIndex) throws java.lang.Exception {
@@ -1240,3 +1175,6 @@ namespace std {
 %include "../MMDevice/ImageMetadata.h"
 %include "../MMCore/MMEventCallback.h"
 
+// Metadata of the images removed by popNextImages()
+%template(MetadataVector) std::vector<Metadata>;
+
@@ -25,543 +25,715 @@
 
 #include "Debayer.h"
 
+#include <algorithm>
 #include <cassert>
+#include <condition_variable>
+#include <cstdlib>
+#include <cstring>
+#include <functional>
+#include <mutex>
+#include <system_error>
+#include <thread>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define DEBAYER_USE_SSE2
+#include <emmintrin.h>
+#endif
+
+namespace {
+
+const int ALG_REPLICATION = 0;
+const int ALG_SMOOTH_HUE = 2;
+const int ALG_ADAPTIVE_SMOOTH_HUE = 3;
+
+// Images smaller than this are always processed on the calling thread
+const std::size_t minParallelPixels = 1 << 18;
+const int minBandRows = 32;
+
+// Description of the color filter array for a given row order. The two
+// non-green channels are called P and Q: P is sampled at even columns of
+// rows with parity pRow, Q at odd columns of the other rows. This matches
+// the "b" and "r" planes of the original ImageJ-derived implementation.
+struct BayerLayout
+{
+   int pRow;   // 0 for R-G-R-G and B-G-B-G, 1 for G-R-G-R and G-B-G-B
+   int pByte;  // byte offset of P within the BGRA output pixel
+   int qByte;  // byte offset of Q
+   int shift;  // right shift from the input bit depth to 8 bits
+};
 
-///////////////////////////////////////////////////////////////////////////////
-// Debayer class implementation
-///////////////////////////////////////////////////////////////////////////////
+template <typename T>
+struct BayerImage
+{
+   const T* pixels;
+   int width;
+   int height;
 
+   const T* Row(int y) const
+   { return pixels + static_cast<std::size_t>(y) * width; }
 
-Debayer::Debayer()
+   // Reads outside of the image return 0 (same as the original
+   // implementation's GetPixel())
+   unsigned At(int x, int y) const
+   {
+      if (x < 0 || x >= width || y < 0 || y >= height)
+         return 0;
+      return Row(y)[x];
+   }
+};
+
+inline void StorePixel(unsigned char* dst, const BayerLayout& lay,
+      unsigned p, unsigned g, unsigned q)
 {
-   orders.push_back("R-G-R-G");
-   orders.push_back("B-G-B-G");
-   orders.push_back("G-R-G-R");
-   orders.push_back("G-B-G-B");
+   dst[lay.pByte] = static_cast<unsigned char>(p >> lay.shift);
+   dst[1] = static_cast<unsigned char>(g >> lay.shift);
+   dst[lay.qByte] = static_cast<unsigned char>(q >> lay.shift);
+   dst[3] = 0;
+}
 
-   algorithms.push_back("Replication");
-   algorithms.push_back("Bilinear");
-   algorithms.push_back("Smooth-Hue");
-   algorithms.push_back("Adaptive-Smooth-Hue");
+// Coordinate of the sample that a replicated channel with the given parity
+// takes its value from, or -1 when there is none (first row or column).
+inline int Anchor(int v, int parity)
+{
+   if (parity == 0)
+      return v & ~1;
+   return v == 0 ? -1 : ((v - 1) | 1);
+}
 
-   // default settings
-   orderIndex = 0; // RGRG ordering
-   algoIndex = 0;  // replication - faster
+#ifdef DEBAYER_USE_SSE2
+// The SIMD kernels process 4 output pixels at a time, one per 32-bit lane,
+// starting at an even column. Lanes 0 and 2 therefore hold even columns.
+
+inline __m128i Load4(const unsigned char* p)
+{
+   int v;
+   std::memcpy(&v, p, sizeof(v));
+   const __m128i zero = _mm_setzero_si128();
+   return _mm_unpacklo_epi16(_mm_unpacklo_epi8(_mm_cvtsi32_si128(v), zero), zero);
 }
 
-Debayer::~Debayer()
+inline __m128i Load4(const unsigned short* p)
 {
+   return _mm_unpacklo_epi16(
+         _mm_loadl_epi64(reinterpret_cast<const __m128i*>(p)),
+         _mm_setzero_si128());
 }
 
-int Debayer::Process(ImgBuffer& out, const ImgBuffer& input, int bitDepth)
+inline __m128i EvenLanes()
 {
-   assert(sizeof(int) == 4);
+   return _mm_set_epi32(0, -1, 0, -1);
+}
 
-   int byteDepth = input.Depth();
-   if (bitDepth > byteDepth * 8)
+inline __m128i Select(__m128i evenMask, __m128i even, __m128i odd)
+{
+   return _mm_or_si128(_mm_and_si128(evenMask, even), _mm_andnot_si128(evenMask, odd));
+}
+
+// v where n != 0, otherwise 0
+inline __m128i KeepIfNonZero(__m128i v, __m128i n)
+{
+   return _mm_andnot_si128(_mm_cmpeq_epi32(n, _mm_setzero_si128()), v);
+}
+
+inline void Store4(unsigned char* dst, const BayerLayout& lay,
+      __m128i p, __m128i g, __m128i q)
+{
+   const __m128i shift = _mm_cvtsi32_si128(lay.shift);
+   const __m128i byteMask = _mm_set1_epi32(0xff);
+   p = _mm_and_si128(_mm_srl_epi32(p, shift), byteMask);
+   g = _mm_and_si128(_mm_srl_epi32(g, shift), byteMask);
+   q = _mm_and_si128(_mm_srl_epi32(q, shift), byteMask);
+   const __m128i bgra = _mm_or_si128(
+         _mm_or_si128(_mm_sll_epi32(p, _mm_cvtsi32_si128(8 * lay.pByte)),
+            _mm_slli_epi32(g, 8)),
+         _mm_sll_epi32(q, _mm_cvtsi32_si128(8 * lay.qByte)));
+   _mm_storeu_si128(reinterpret_cast<__m128i*>(dst), bgra);
+}
+#endif // DEBAYER_USE_SSE2
+
+///////////////////////////////////////////////////////////////////////////////
+// Replication
+
+// Exact value of any pixel, including the first row and column
+template <typename T>
+void ReplicatePixel(const BayerImage<T>& img, const BayerLayout& lay,
+      int x, int y, unsigned char* dst)
+{
+   const int py = Anchor(y, lay.pRow);
+   const unsigned p = py < 0 ? 0 : img.At(x & ~1, py);
+   const int qx = Anchor(x, 1);
+   const int qy = Anchor(y, 1 - lay.pRow);
+   const unsigned q = (qx < 0 || qy < 0) ? 0 : img.At(qx, qy);
+   const int gx = Anchor(x, (y + 1 + lay.pRow) & 1);
+   const unsigned g = gx < 0 ? 0 : img.At(gx, y);
+   StorePixel(dst, lay, p, g, q);
+}
+
+template <typename T>
+void ReplicateRow(const BayerImage<T>& img, const BayerLayout& lay,
+      int y, unsigned char* dst)
+{
+   const int w = img.width;
+   int x = 0;
+   if (y > 0) // All anchors exist from the second row on
    {
-      assert(false);
-      return DEVICE_INVALID_INPUT_PARAM;
+      for (; x < 2 && x < w; ++x)
+         ReplicatePixel(img, lay, x, y, dst + 4 * x);
+
+      const T* pRow = img.Row(Anchor(y, lay.pRow));
+      const T* qRow = img.Row(Anchor(y, 1 - lay.pRow));
+      const T* gRow = img.Row(y);
+      const bool gOdd = ((y + 1 + lay.pRow) & 1) != 0;
+
+#ifdef DEBAYER_USE_SSE2
+      const __m128i even = EvenLanes();
+      for (; x + 3 < w; x += 4)
+      {
+         const __m128i p = Select(even, Load4(pRow + x), Load4(pRow + x - 1));
+         const __m128i q = Select(even, Load4(qRow + x - 1), Load4(qRow + x));
+         const __m128i g = gOdd ?
+            Select(even, Load4(gRow + x - 1), Load4(gRow + x)) :
+            Select(even, Load4(gRow + x), Load4(gRow + x - 1));
+         Store4(dst + 4 * x, lay, p, g, q);
+      }
+#endif
+      for (; x + 1 < w; x += 2)
+      {
+         const unsigned p = pRow[x];
+         const unsigned g0 = gOdd ? gRow[x - 1] : gRow[x];
+         const unsigned g1 = gOdd ? gRow[x + 1] : gRow[x];
+         StorePixel(dst + 4 * x, lay, p, g0, qRow[x - 1]);
+         StorePixel(dst + 4 * (x + 1), lay, p, g1, qRow[x + 1]);
+      }
    }
+   for (; x < w; ++x)
+      ReplicatePixel(img, lay, x, y, dst + 4 * x);
+}
 
-   out.Resize(input.Width(), input.Height(), 4);
-   if (input.Depth() == 1)
+///////////////////////////////////////////////////////////////////////////////
+// Smooth hue
+//
+// The original implementation computes the green plane first (including a
+// few special cases along the top and left edges) and then scales the center
+// sample by the fraction of nonzero same-color neighbors for the other two
+// channels. The functions below reproduce that output exactly, without the
+// intermediate planes.
+
+template <typename T>
+unsigned SmoothGreen(const BayerImage<T>& img, const BayerLayout& lay, int x, int y)
+{
+   if (x == 0 && y == 0)
+      return (img.At(0, 1) + img.At(1, 0)) / 2;
+   if (((x + y + lay.pRow) & 1) != 0) // Green site
+      return img.At(x, y);
+
+   const unsigned left = img.At(x - 1, y);
+   const unsigned right = img.At(x + 1, y);
+   const unsigned up = img.At(x, y - 1);
+   const unsigned down = img.At(x, y + 1);
+   const bool pRowType = (y & 1) == lay.pRow;
+   if (lay.pRow == 0)
    {
-      const unsigned char* inBuf = input.GetPixels();
-      return ProcessT(out, inBuf, input.Width(), input.Height(), bitDepth);
+      if (pRowType && x == 0)
+         return (right + img.At(2, y - 1) + down) / 3;
+      if (pRowType && y == 0)
+         return (left + right + down) / 3;
+      if (!pRowType && x == 1)
+         return (left + right + down) / 3;
    }
-   else if (input.Depth() == 2)
+   else
    {
-      const unsigned short* inBuf = reinterpret_cast<const unsigned short*>(input.GetPixels());
-      return ProcessT(out, inBuf, input.Width(), input.Height(), bitDepth);
+      if (!pRowType && y == 0)
+         return (left + right + down) / 3;
+      if (pRowType && x == 0)
+         return 0;
    }
-   else
-      return DEVICE_UNSUPPORTED_DATA_FORMAT;
-
+   return (left + right + up + down) / 4;
 }
 
-int Debayer::Process(ImgBuffer& out, const unsigned char* in, int width, int height, int bitDepth)
-{ return ProcessT(out, in, width, height, bitDepth); }
-
-int Debayer::Process(ImgBuffer& out, const unsigned short* in, int width, int height, int bitDepth)
-{ return ProcessT(out, in, width, height, bitDepth); }
+// Non-green channel whose samples have parity (cx, cy)
+template <typename T>
+unsigned SmoothChroma(const BayerImage<T>& img, int cx, int cy, int x, int y)
+{
+   const int ax = Anchor(x, cx);
+   const int ay = Anchor(y, cy);
+   if (ax < 0 || ay < 0)
+      return 0;
+   const unsigned v = img.At(x, y);
+   if (ax == x && ay == y)
+      return v;
+   if (ay == y)
+      return (v * ((img.At(x - 1, y) != 0) + (img.At(x + 1, y) != 0))) >> 1;
+   if (ax == x)
+      return (v * ((img.At(x, y - 1) != 0) + (img.At(x, y + 1) != 0))) >> 1;
+   return (v * ((img.At(x - 1, y - 1) != 0) + (img.At(x + 1, y - 1) != 0) +
+         (img.At(x - 1, y + 1) != 0) + (img.At(x + 1, y + 1) != 0))) >> 2;
+}
 
 template <typename T>
-int Debayer::ProcessT(ImgBuffer& out, const T* in, int width, int height, int bitDepth)
+void SmoothPixel(const BayerImage<T>& img, const BayerLayout& lay,
+      int x, int y, unsigned char* dst)
 {
-   assert(sizeof(int) == 4);
-   out.Resize(width, height, 4);
-   int* outBuf = reinterpret_cast<int*>(out.GetPixelsRW());
-   return Convert(in, outBuf, width, height, bitDepth, orderIndex, algoIndex);
+   StorePixel(dst, lay,
+         SmoothChroma(img, 0, lay.pRow, x, y),
+         SmoothGreen(img, lay, x, y),
+         SmoothChroma(img, 1, 1 - lay.pRow, x, y));
 }
 
-template<typename T>
-int Debayer::Convert(const T* input, int* output, int width, int height, int bitDepth, int rowOrder, int algorithm)
-{				
-	if (algorithm == 0)
-      ReplicateDecode(input, output, width, height, bitDepth, rowOrder);
-	else if (algorithm == 1)
-      return DEVICE_NOT_SUPPORTED;
-	else if (algorithm == 2)
-      SmoothDecode(input, output, width, height, bitDepth, rowOrder);
-	else if (algorithm == 3)
-      return DEVICE_NOT_SUPPORTED;
+// Interior site (all 8 neighbors inside the image, x >= 2)
+template <typename T>
+inline void SmoothInterior(const T* up, const T* mid, const T* down, int x,
+      bool pRowType, unsigned& p, unsigned& g, unsigned& q)
+{
+   const unsigned v = mid[x];
+   const bool even = (x & 1) == 0;
+   if (pRowType ? even : !even)
+   {
+      // P or Q site: green from the 4 neighbors, other channel from diagonals
+      const unsigned avg = (mid[x - 1] + mid[x + 1] + up[x] + down[x]) / 4;
+      const unsigned diag = (v * ((up[x - 1] != 0) + (up[x + 1] != 0) +
+            (down[x - 1] != 0) + (down[x + 1] != 0))) >> 2;
+      g = avg;
+      p = pRowType ? v : diag;
+      q = pRowType ? diag : v;
+   }
    else
-      return DEVICE_NOT_SUPPORTED;
-
+   {
+      const unsigned horiz = (v * ((mid[x - 1] != 0) + (mid[x + 1] != 0))) >> 1;
+      const unsigned vert = (v * ((up[x] != 0) + (down[x] != 0))) >> 1;
+      g = v;
+      p = pRowType ? horiz : vert;
+      q = pRowType ? vert : horiz;
+   }
+}
 
-   return DEVICE_OK;
+template <typename T>
+void SmoothRow(const BayerImage<T>& img, const BayerLayout& lay,
+      int y, unsigned char* dst)
+{
+   const int w = img.width;
+   int x = 0;
+   if (y > 0 && y < img.height - 1)
+   {
+      for (; x < 2 && x < w; ++x)
+         SmoothPixel(img, lay, x, y, dst + 4 * x);
+
+      const T* up = img.Row(y - 1);
+      const T* mid = img.Row(y);
+      const T* down = img.Row(y + 1);
+      const bool pRowType = (y & 1) == lay.pRow;
+
+#ifdef DEBAYER_USE_SSE2
+      const __m128i even = EvenLanes();
+      for (; x + 4 < w; x += 4)
+      {
+         const __m128i c = Load4(mid + x);
+         const __m128i l = Load4(mid + x - 1);
+         const __m128i r = Load4(mid + x + 1);
+         const __m128i u = Load4(up + x);
+         const __m128i d = Load4(down + x);
+         const __m128i avg = _mm_srli_epi32(
+               _mm_add_epi32(_mm_add_epi32(l, r), _mm_add_epi32(u, d)), 2);
+         const __m128i horiz = _mm_srli_epi32(
+               _mm_add_epi32(KeepIfNonZero(c, l), KeepIfNonZero(c, r)), 1);
+         const __m128i vert = _mm_srli_epi32(
+               _mm_add_epi32(KeepIfNonZero(c, u), KeepIfNonZero(c, d)), 1);
+         const __m128i diag = _mm_srli_epi32(_mm_add_epi32(
+                  _mm_add_epi32(KeepIfNonZero(c, Load4(up + x - 1)),
+                     KeepIfNonZero(c, Load4(up + x + 1))),
+                  _mm_add_epi32(KeepIfNonZero(c, Load4(down + x - 1)),
+                     KeepIfNonZero(c, Load4(down + x + 1)))), 2);
+         if (pRowType)
+            Store4(dst + 4 * x, lay, Select(even, c, horiz),
+                  Select(even, avg, c), Select(even, diag, vert));
+         else
+            Store4(dst + 4 * x, lay, Select(even, vert, diag),
+                  Select(even, c, avg), Select(even, horiz, c));
+      }
+#endif
+      for (; x + 2 < w; x += 2)
+      {
+         unsigned p, g, q;
+         SmoothInterior(up, mid, down, x, pRowType, p, g, q);
+         StorePixel(dst + 4 * x, lay, p, g, q);
+         SmoothInterior(up, mid, down, x + 1, pRowType, p, g, q);
+         StorePixel(dst + 4 * (x + 1), lay, p, g, q);
+      }
+   }
+   for (; x < w; ++x)
+      SmoothPixel(img, lay, x, y, dst + 4 * x);
 }
 
-unsigned short Debayer::GetPixel(const unsigned short* v, int x, int y, int width, int height)
+///////////////////////////////////////////////////////////////////////////////
+// Adaptive smooth hue (edge-aware)
+//
+// Green is interpolated along the direction of the smaller gradient, using
+// the Laplacian of the center channel as a correction term
+// (Hamilton-Adams). The non-green channels are then interpolated as color
+// differences to the green plane, which avoids the zipper artifacts of the
+// ratio-based smooth hue method. Borders are handled by mirroring with a
+// period of 2 so that the filter pattern is preserved.
+
+inline int Reflect(int v, int n)
 {
-   if (x >= width || x < 0 || y >= height || y < 0)
-      return 0;
-   else
-      return v[y*width + x];
+   if (v < 0)
+      v = -v;
+   if (v >= n)
+      v = 2 * (n - 1) - v;
+   return v < 0 ? 0 : (v >= n ? n - 1 : v);
 }
 
-void Debayer::SetPixel(std::vector<unsigned short>& v, unsigned short val, int x, int y, int width, int height)
+inline int ClampValue(int v, int maxVal)
 {
-   if (x < width && x >= 0 && y < height && y >= 0)
-      v[y*width + x] = val;
+   return v < 0 ? 0 : (v > maxVal ? maxVal : v);
 }
 
-unsigned short Debayer::GetPixel(const unsigned char* v, int x, int y, int width, int height)
+template <typename T>
+inline int Sample(const T* row, int x, int width)
 {
-   if (x >= width || x < 0 || y >= height || y < 0)
-      return 0;
-   else
-      return v[y*width + x];
+   return static_cast<unsigned>(x) < static_cast<unsigned>(width) ?
+      row[x] : row[Reflect(x, width)];
 }
 
-// Replication algorithm
 template <typename T>
-void Debayer::ReplicateDecode(const T* input, int* output, int width, int height, int bitDepth, int rowOrder)
+void AdaptiveGreenRow(const BayerImage<T>& img, const BayerLayout& lay,
+      int maxVal, int y, int* green)
 {
-   unsigned numPixels(width*height);
-   if (r.size() != numPixels)
+   const int w = img.width;
+   const int h = img.height;
+   const T* row = img.Row(y);
+   const T* up1 = img.Row(Reflect(y - 1, h));
+   const T* up2 = img.Row(Reflect(y - 2, h));
+   const T* down1 = img.Row(Reflect(y + 1, h));
+   const T* down2 = img.Row(Reflect(y + 2, h));
+   for (int x = 0; x < w; ++x)
    {
-      r.resize(numPixels);
-      g.resize(numPixels);
-      b.resize(numPixels);
+      const int c = row[x];
+      if (((x + y + lay.pRow) & 1) != 0)
+      {
+         green[x] = c;
+         continue;
+      }
+      const int l1 = Sample(row, x - 1, w);
+      const int r1 = Sample(row, x + 1, w);
+      const int l2 = Sample(row, x - 2, w);
+      const int r2 = Sample(row, x + 2, w);
+      const int u1 = up1[x];
+      const int d1 = down1[x];
+      const int u2 = up2[x];
+      const int d2 = down2[x];
+      const int gradH = std::abs(l1 - r1) + std::abs(2 * c - l2 - r2);
+      const int gradV = std::abs(u1 - d1) + std::abs(2 * c - u2 - d2);
+      const int estH = 2 * (l1 + r1) + 2 * c - l2 - r2; // 4x estimate
+      const int estV = 2 * (u1 + d1) + 2 * c - u2 - d2;
+      int g;
+      if (gradH < gradV)
+         g = estH >> 2;
+      else if (gradV < gradH)
+         g = estV >> 2;
+      else
+         g = (estH + estV) >> 3;
+      green[x] = ClampValue(g, maxVal);
    }
+}
 
-   int bitShift = bitDepth - 8;
-	
-	if (rowOrder == 0 || rowOrder == 1) {
-		for (int y=0; y<height; y+=2) {
-			for (int x=0; x<width; x+=2) {
-				unsigned short one = GetPixel(input, x, y, width, height);
-				SetPixel(b, one, x, y, width, height);
-				SetPixel(b, one, x+1, y, width, height);
-				SetPixel(b, one, x, y+1, width, height); 
-				SetPixel(b, one, x+1, y+1, width, height);
-			}
-		}
-		
-		for (int y=1; y<height; y+=2) {
-			for (int x=1; x<width; x+=2) {
-            unsigned short one = GetPixel(input, x, y, width, height);
-				SetPixel(r, one, x, y, width, height);
-				SetPixel(r, one, x+1, y, width, height);
-				SetPixel(r, one, x, y+1, width, height); 
-				SetPixel(r, one, x+1, y+1, width, height);
-			}
-		}
-		
-		for (int y=0; y<height; y+=2) {
-			for (int x=1; x<width; x+=2) {
-				unsigned short one = GetPixel(input, x, y, width, height);
-            SetPixel(g, one, x, y, width, height);
-            SetPixel(g, one, x+1, y, width, height);
-			}
-		}	
-			
-		for (int y=1; y<height; y+=2) {
-			for (int x=0; x<width; x+=2) {
-            unsigned short one = GetPixel(input, x, y, width, height);
-            SetPixel(g, one, x, y, width, height);
-            SetPixel(g, one, x+1, y, width, height);
-			}
-		}	
-		
-		if (rowOrder == 0) {
-         for (int i=0; i<height*width; i++)
-         {
-            output[i] = 0;
-            unsigned char* bytePix = (unsigned char*)(output+i);
-            *bytePix = (unsigned char)(r[i] >> bitShift);
-            *(bytePix+1) = (unsigned char)(g[i] >> bitShift);
-            *(bytePix+2) = (unsigned char)(b[i] >> bitShift);
-
-			   //rgb.addSlice("red",b);	
-			   //rgb.addSlice("green",g);
-			   //rgb.addSlice("blue",r);
-         }
-		}
-		else if (rowOrder == 1) {
-         for (int i=0; i<height*width; i++)
-         {
-            output[i] = 0;
-            unsigned char* bytePix = (unsigned char*)(output+i);
-            *bytePix = (unsigned char)(b[i] >> bitShift);
-            *(bytePix+1) = (unsigned char)(g[i] >> bitShift);
-            *(bytePix+2) = (unsigned char)(r[i] >> bitShift);
-
-			   //rgb.addSlice("red",r);	
-			   //rgb.addSlice("green",g);
-			   //rgb.addSlice("blue",b);			
-		   }
-      }
-	}
-
-	else if (rowOrder == 2 || rowOrder == 3) {
-		for (int y=1; y<height; y+=2) {
-			for (int x=0; x<width; x+=2) {
-				unsigned short one = GetPixel(input, x, y, width, height);
-				SetPixel(b, one, x, y, width, height);
-				SetPixel(b, one, x+1, y, width, height);
-				SetPixel(b, one, x, y+1, width, height); 
-				SetPixel(b, one, x+1, y+1, width, height);
-			}
-		}
-		
-		for (int y=0; y<height; y+=2) {
-			for (int x=1; x<width; x+=2) {
-            unsigned short one = GetPixel(input, x, y, width, height);
-				SetPixel(r, one, x, y, width, height);
-				SetPixel(r, one, x+1, y, width, height);
-				SetPixel(r, one, x, y+1, width, height); 
-				SetPixel(r, one, x+1, y+1, width, height);
-			}
-		}
-		
-		for (int y=0; y<height; y+=2) {
-			for (int x=0; x<width; x+=2) {
-				unsigned short one = GetPixel(input, x, y, width, height);
-            SetPixel(g, one, x, y, width, height);
-            SetPixel(g, one, x+1, y, width, height);
-			}
-		}	
-			
-		for (int y=1; y<height; y+=2) {
-			for (int x=1; x<width; x+=2) {
-            unsigned short one = GetPixel(input, x, y, width, height);
-            SetPixel(g, one, x, y, width, height);
-            SetPixel(g, one, x+1, y, width, height);
-			}
-		}	
-		
-		if (rowOrder == 2) {
-         for (int i=0; i<height*width; i++)
+template <typename T>
+void AdaptiveBand(const BayerImage<T>& img, const BayerLayout& lay, int maxVal,
+      unsigned char* out, int yBegin, int yEnd)
+{
+   const int w = img.width;
+   const int h = img.height;
+   std::vector<int> ring(3 * static_cast<std::size_t>(w));
+   int* gUp = &ring[0];
+   int* gMid = gUp + w;
+   int* gDown = gMid + w;
+   AdaptiveGreenRow(img, lay, maxVal, Reflect(yBegin - 1, h), gUp);
+   AdaptiveGreenRow(img, lay, maxVal, yBegin, gMid);
+
+   for (int y = yBegin; y < yEnd; ++y)
+   {
+      AdaptiveGreenRow(img, lay, maxVal, Reflect(y + 1, h), gDown);
+
+      const T* row = img.Row(y);
+      const T* up = img.Row(Reflect(y - 1, h));
+      const T* down = img.Row(Reflect(y + 1, h));
+      const bool pRowType = (y & 1) == lay.pRow;
+      unsigned char* dst = out + static_cast<std::size_t>(y) * w * 4;
+      for (int x = 0; x < w; ++x)
+      {
+         const int xl = x > 0 ? x - 1 : Reflect(x - 1, w);
+         const int xr = x + 1 < w ? x + 1 : Reflect(x + 1, w);
+         const int g = gMid[x];
+         const int c = row[x];
+         int p, q;
+         if (((x + y + lay.pRow) & 1) != 0)
          {
-            output[i] = 0;
-            unsigned char* bytePix = (unsigned char*)(output+i);
-            *bytePix = (unsigned char)(r[i] >> bitShift);
-            *(bytePix+1) = (unsigned char)(g[i] >> bitShift);
-            *(bytePix+2) = (unsigned char)(b[i] >> bitShift);
-
-            //rgb.addSlice("red",b);	
-			   //rgb.addSlice("green",g);
-			   //rgb.addSlice("blue",r);
+            // Green site: one channel left/right, the other above/below
+            const int horiz = g + ((row[xl] - gMid[xl]) + (row[xr] - gMid[xr])) / 2;
+            const int vert = g + ((up[x] - gUp[x]) + (down[x] - gDown[x])) / 2;
+            p = pRowType ? horiz : vert;
+            q = pRowType ? vert : horiz;
          }
-		}
-		else if (rowOrder == 3) {
-         for (int i=0; i<height*width; i++)
+         else
          {
-            output[i] = 0;
-            unsigned char* bytePix = (unsigned char*)(output+i);
-            *bytePix = (unsigned char)(b[i] >> bitShift);
-            *(bytePix+1) = (unsigned char)(g[i] >> bitShift);
-            *(bytePix+2) = (unsigned char)(r[i] >> bitShift);
-
-            //rgb.addSlice("red",r);	
-			   //rgb.addSlice("green",g);
-			   //rgb.addSlice("blue",b);
+            const int diag = g + ((up[xl] - gUp[xl]) + (up[xr] - gUp[xr]) +
+                  (down[xl] - gDown[xl]) + (down[xr] - gDown[xr])) / 4;
+            p = pRowType ? c : diag;
+            q = pRowType ? diag : c;
          }
-		}
-	}
-}
+         StorePixel(dst + 4 * x, lay, ClampValue(p, maxVal), g, ClampValue(q, maxVal));
+      }
 
-// Smooth Hue algorithm
-template <typename T>
-void Debayer::SmoothDecode(const T* input, int* output, int width, int height, int bitDepth, int rowOrder)
-{
-   double G1 = 0;
-   double G2 = 0;
-   double G3 = 0;
-   double G4 = 0;
-   double G5 = 0;
-   double G6 = 0;
-   //double G7 = 0;
-   //double G8 = 0;
-   double G9 = 0;
-   double B1 = 0;
-   double B2 = 0;
-   double B3 = 0;
-   double B4 = 0;
-   double R1 = 0;
-   double R2 = 0;
-   double R3 = 0;
-   double R4 = 0;
-
-   unsigned numPixels(width*height);
-   if (r.size() != numPixels)
-   {
-      r.resize(numPixels);
-      g.resize(numPixels);
-      b.resize(numPixels);
+      std::swap(gUp, gMid);
+      std::swap(gMid, gDown);
    }
+}
 
-   int bitShift = bitDepth - 8;
-
-   if (rowOrder == 0 || rowOrder == 1) {
-      //Solve for green pixels first
-      for (int y=0; y<height; y+=2) {
-         for (int x=1; x<width; x+=2) {
-            G1 = GetPixel(input, x, y, width, height);
-            G2 = GetPixel(input, x+2, y, width, height);
-            G3 = GetPixel(input, x+1, y+1, width, height);
-            G4 = GetPixel(input, x+1, y-1, width, height);
-
-            SetPixel(g, (unsigned short)G1, x, y, width, height);
-            if (y==0)
-               SetPixel(g, (unsigned short)((G1+G2+G3)/3.0), x+1, y, width, height);
-            else
-               SetPixel(g, (unsigned short)((G1+G2+G3+G4)/4.0), x+1, y, width, height);
-
-            if (x==1)
-               SetPixel(g, (unsigned short)((G1 + G4 + GetPixel(input, x-1, y+1, width, height))/3.0), x-1, y, width, height);
-         }
-      }	
+} // anonymous namespace
 
-      for (int x=0; x<width; x+=2) {	
-         for (int y=1; y<height; y+=2) {
+///////////////////////////////////////////////////////////////////////////////
 
-            G1 = GetPixel(input, x, y, width, height);
-            G2 = GetPixel(input, x+2, y, width, height);
-            G3 = GetPixel(input, x+1, y+1, width, height);
-            G4 = GetPixel(input, x+1, y-1, width, height);
+// Threads that process the bands of one image at a time, together with the
+// thread calling Run()
+class Debayer::Workers
+{
+public:
+   Workers() : job(0), bands(0), nextBand(0), busy(0), generation(0),
+      stop(false), startFailed(false)
+   {}
 
-            SetPixel(g, (unsigned short)G1, x, y, width, height);
-            if (x==0)
-               SetPixel(g, (unsigned short)((G1+G2+G3)/3.0), x+1, y, width, height);
-            else
-               SetPixel(g, (unsigned short)((G1+G2+G3+G4)/4.0), x+1, y, width, height);
-         }
-      }	
-
-      SetPixel(g, (unsigned short)((GetPixel(input, 0, 1, width, height) + GetPixel(input, 1, 0, width, height))/2.0), 0, 0, width, height);
-
-      for (int y=0; y<height; y+=2) {
-         for (int x=0; x<width; x+=2) {
-            B1 = GetPixel(input, x, y, width, height);
-            B2 = GetPixel(input, x+2, y, width, height);
-            B3 = GetPixel(input, x, y+2, width, height);
-            B4 = GetPixel(input, x+2, y+2, width, height);
-            G1 = GetPixel(input, x, y, width, height);
-            G2 = GetPixel(input, x+2, y, width, height);
-            G3 = GetPixel(input, x, y+2, width, height);
-            G4 = GetPixel(input, x+2, y+2, width, height);;
-            G5 = GetPixel(input, x+1, y, width, height);
-            G6 = GetPixel(input, x, y+1, width, height);
-            G9 = GetPixel(input, x+1, y+1, width, height);
-            if (G1==0) G1=1;
-            if (G2==0) G2=1;
-            if (G3==0) G3=1;
-            if (G4==0) G4=1;
-
-            SetPixel(b, (unsigned short)B1, x, y, width, height);
-            //b.putPixel(x+1,y,(int)((G5/2 * ((B1/G1) + (B2/G2)) )) );
-            SetPixel(b, (unsigned short)((G5/2 * ((B1/G1) + (B2/G2)) )), x+1, y, width, height);
-            //b.putPixel(x,y+1,(int)(( G6/2 * ((B1/G1) + (B3/G3)) )) );
-            SetPixel(b, (unsigned short)((G6/2 * ((B1/G1) + (B3/G3)) )), x, y+1, width, height);
-            //b.putPixel(x+1,y+1, (int)((G9/4 *  ((B1/G1) + (B3/G3) + (B2/G2) + (B4/G4)) )) );
-            SetPixel(b, (unsigned short)((G9/4 * ((B1/G1) + (B3/G3) + (B2/G2) + (B4/G4)) )), x+1, y+1, width, height);
-         }
+   ~Workers()
+   {
+      {
+         std::lock_guard<std::mutex> lock(mutex);
+         stop = true;
       }
+      startCv.notify_all();
+      for (std::vector<std::thread>::iterator it = threads.begin(); it != threads.end(); ++it)
+         it->join();
+   }
 
-      for (int y=1; y<height; y+=2) {
-         for (int x=1; x<width; x+=2) {
-            R1 = GetPixel(input, x, y, width, height);
-            R2 = GetPixel(input, x+2, y, width, height);
-            R3 = GetPixel(input, x, y+2, width, height);
-            R4 = GetPixel(input, x+2, y+2, width, height);
-            G1 = GetPixel(input, x, y, width, height);
-            G2 = GetPixel(input, x+2, y, width, height);
-            G3 = GetPixel(input, x, y+2, width, height);
-            G4 = GetPixel(input, x+2, y+2, width, height);
-            G5 = GetPixel(input, x+1, y, width, height);
-            G6 = GetPixel(input, x, y+1, width, height);
-            G9 = GetPixel(input, x+1, y+1, width, height);
-            if(G1==0) G1=1;
-            if(G2==0) G2=1;
-            if(G3==0) G3=1;
-            if(G4==0) G4=1;
-
-            //r.putPixel(x,y,(int)(R1));
-            SetPixel(r, (unsigned short)R1, x, y, width, height);
-            //r.putPixel(x+1,y,(int)((G5/2 * ((R1/G1) + (R2/G2) )) ));
-            SetPixel(r, (unsigned short)((G5/2 * ((R1/G1) + (R2/G2) )) ), x+1, y, width, height);
-            //r.putPixel(x,y+1,(int)(( G6/2 * ((R1/G1) + (R3/G3) )) ));
-            SetPixel(r, (unsigned short)(( G6/2 * ((R1/G1) + (R3/G3) )) ), x, y+1, width, height);
-            //r.putPixel(x+1,y+1, (int)((G9/4 *  ((R1/G1) + (R3/G3) + (R2/G2) + (R4/G4)) ) ));
-            SetPixel(r, (unsigned short)((G9/4 *  ((R1/G1) + (R3/G3) + (R2/G2) + (R4/G4)) ) ), x+1, y+1, width, height);
-         }
+   // Calls fn(band) for each band in [0, bandCount), and returns when all
+   // calls have returned
+   void Run(int bandCount, const std::function<void(int)>& fn)
+   {
+      std::lock_guard<std::mutex> runLock(runMutex);
+      StartThreads(bandCount - 1);
+
+      std::unique_lock<std::mutex> lock(mutex);
+      job = &fn;
+      bands = bandCount;
+      nextBand = 0;
+      ++generation;
+      lock.unlock();
+      startCv.notify_all();
+
+      lock.lock();
+      while (nextBand < bands)
+      {
+         const int band = nextBand++;
+         lock.unlock();
+         fn(band);
+         lock.lock();
       }
+      doneCv.wait(lock, [this] { return busy == 0; });
+      job = 0;
+   }
 
-
-      if (rowOrder == 0) {
-         for (int i=0; i<height*width; i++)
+private:
+   void StartThreads(int count)
+   {
+      while (!startFailed && static_cast<int>(threads.size()) < count)
+      {
+         try
          {
-            output[i] = 0;
-            unsigned char* bytePix = (unsigned char*)(output+i);
-            *bytePix = (unsigned char)(r[i] >> bitShift);
-            *(bytePix+1) = (unsigned char)(g[i] >> bitShift);
-            *(bytePix+2) = (unsigned char)(b[i] >> bitShift);
-
-            //rgb.addSlice("red",b);	
-            //rgb.addSlice("green",g);
-            //rgb.addSlice("blue",r);
+            threads.emplace_back(&Workers::Work, this, generation);
+         }
+         catch (const std::system_error&)
+         {
+            // Make do with the threads we have; the calling thread
+            // processes the bands that no worker takes
+            startFailed = true;
          }
       }
-      else if (rowOrder == 1) {
-         for (int i=0; i<height*width; i++)
+   }
+
+   // Waits for images after the one numbered seen
+   void Work(unsigned long long seen)
+   {
+      std::unique_lock<std::mutex> lock(mutex);
+      for (;;)
+      {
+         startCv.wait(lock, [&] { return stop || generation != seen; });
+         if (stop)
+            return;
+         seen = generation;
+         ++busy;
+         while (nextBand < bands)
          {
-            output[i] = 0;
-            unsigned char* bytePix = (unsigned char*)(output+i);
-            *bytePix = (unsigned char)(b[i] >> bitShift);
-            *(bytePix+1) = (unsigned char)(g[i] >> bitShift);
-            *(bytePix+2) = (unsigned char)(r[i] >> bitShift);
-
-            //rgb.addSlice("red",r);	
-            //rgb.addSlice("green",g);
-            //rgb.addSlice("blue",b);			
+            const int band = nextBand++;
+            lock.unlock();
+            (*job)(band);
+            lock.lock();
          }
+         if (--busy == 0)
+            doneCv.notify_one();
       }
    }
 
-   else if (rowOrder == 2 || rowOrder == 3) {
+   std::vector<std::thread> threads;
+   std::mutex runMutex; // One image at a time
+   std::mutex mutex;
+   std::condition_variable startCv;
+   std::condition_variable doneCv;
+   const std::function<void(int)>* job;
+   int bands;
+   int nextBand;
+   int busy;
+   unsigned long long generation;
+   bool stop;
+   bool startFailed;
+};
+
+namespace {
+
+// Calls fn(yBegin, yEnd) for horizontal bands covering the image, using up
+// to maxThreads threads (including the calling thread) from workers.
+template <typename Workers, typename Fn>
+void RunBands(Workers& workers, int width, int height, int maxThreads, Fn fn)
+{
+   int bands = 1;
+   if (maxThreads > 1 &&
+         static_cast<std::size_t>(width) * height >= minParallelPixels)
+      bands = (std::min)(maxThreads, (std::max)(1, height / minBandRows));
+   if (bands == 1)
+   {
+      fn(0, height);
+      return;
+   }
 
-      for (int y=0; y<height; y+=2) {
-         for (int x=0; x<width; x+=2) {
-            G1 = GetPixel(input, x, y, width, height);
-            G2 = GetPixel(input, x+2, y, width, height);
-            G3 = GetPixel(input, x+1, y+1, width, height);
-            G4 = GetPixel(input, x+1, y-1, width, height);
+   const int rowsPerBand = (height + bands - 1) / bands;
+   workers.Run(bands, [&](int band) {
+      const int yBegin = band * rowsPerBand;
+      if (yBegin < height)
+         fn(yBegin, (std::min)(height, yBegin + rowsPerBand));
+   });
+}
 
-            SetPixel(g, (unsigned short)G1, x, y, width, height);
-            if (y==0)
-               SetPixel(g, (unsigned short)((G1+G2+G3)/3.0), x+1, y, width, height);
-            else
-               SetPixel(g, (unsigned short)((G1+G2+G3+G4)/4.0), x+1, y, width, height);
+} // anonymous namespace
 
-            if (x==1)
-               SetPixel(g, (unsigned short)((G1+G4+GetPixel(input, x-1, y+1, width, height))/3.0), x-1, y, width, height);
-         }
-      }	
-
-      for (int y=1; y<height; y+=2) {
-         for (int x=1; x<width; x+=2) {
-            G1 = GetPixel(input, x, y, width, height);
-            G2 = GetPixel(input, x+2, y, width, height);
-            G3 = GetPixel(input, x+1, y+1, width, height);
-            G4 = GetPixel(input, x+1, y-1, width, height);
-
-            SetPixel(g, (unsigned short)G1, x, y, width, height);
-            if (x==0)
-               SetPixel(g, (unsigned short)((G1+G2+G3)/3.0), x+1, y, width, height);
-            else
-               SetPixel(g, (unsigned short)((G1+G2+G3+G4)/4.0), x+1, y, width, height);
-         }
-      }
+///////////////////////////////////////////////////////////////////////////////
+// Debayer class implementation
+///////////////////////////////////////////////////////////////////////////////
 
-      SetPixel(g, (unsigned short)((GetPixel(input, 0, 1, width, height) + GetPixel(input, 1, 0, width, height))/2.0), 0, 0, width, height);
-
-      for (int y=1; y<height; y+=2) {
-         for (int x=0; x<width; x+=2) {
-            B1 = GetPixel(input, x, y, width, height);
-            B2 = GetPixel(input, x+2, y, width, height);
-            B3 = GetPixel(input, x, y+2, width, height);
-            B4 = GetPixel(input, x+2, y+2, width, height);
-            G1 = GetPixel(input, x, y, width, height);
-            G2 = GetPixel(input, x+2, y, width, height);
-            G3 = GetPixel(input, x, y+2, width, height);
-            G4 = GetPixel(input, x+2, y+2, width, height);;
-            G5 = GetPixel(input, x+1, y, width, height);
-            G6 = GetPixel(input, x, y+1, width, height);
-            G9 = GetPixel(input, x+1, y+1, width, height);
-            if (G1==0) G1=1;
-            if (G2==0) G2=1;
-            if (G3==0) G3=1;
-            if (G4==0) G4=1;
-
-            SetPixel(b, (unsigned short)B1, x, y, width, height);
-            SetPixel(b, (unsigned short)((G5/2 * ((B1/G1) + (B2/G2)) )), x+1, y, width, height);
-            SetPixel(b, (unsigned short)((G6/2 * ((B1/G1) + (B3/G3)) )), x, y+1, width, height);
-            SetPixel(b, (unsigned short)((G9/4 * ((B1/G1) + (B3/G3) + (B2/G2) + (B4/G4)) )), x+1, y+1, width, height);
-         }
-      }
 
-      for (int y=0; y<height; y+=2) {
-         for (int x=1; x<width; x+=2) {
-            R1 = GetPixel(input, x, y, width, height);
-            R2 = GetPixel(input, x+2, y, width, height);
-            R3 = GetPixel(input, x, y+2, width, height);
-            R4 = GetPixel(input, x+2, y+2, width, height);
-            G1 = GetPixel(input, x, y, width, height);
-            G2 = GetPixel(input, x+2, y, width, height);
-            G3 = GetPixel(input, x, y+2, width, height);
-            G4 = GetPixel(input, x+2, y+2, width, height);
-            G5 = GetPixel(input, x+1, y, width, height);
-            G6 = GetPixel(input, x, y+1, width, height);
-            G9 = GetPixel(input, x+1, y+1, width, height);
-            if(G1==0) G1=1;
-            if(G2==0) G2=1;
-            if(G3==0) G3=1;
-            if(G4==0) G4=1;
-
-            //r.putPixel(x,y,(int)(R1));
-            SetPixel(r, (unsigned short)R1, x, y, width, height);
-            //r.putPixel(x+1,y,(int)((G5/2 * ((R1/G1) + (R2/G2) )) ));
-            SetPixel(r, (unsigned short)((G5/2 * ((R1/G1) + (R2/G2) )) ), x+1, y, width, height);
-            //r.putPixel(x,y+1,(int)(( G6/2 * ((R1/G1) + (R3/G3) )) ));
-            SetPixel(r, (unsigned short)(( G6/2 * ((R1/G1) + (R3/G3) )) ), x, y+1, width, height);
-            //r.putPixel(x+1,y+1, (int)((G9/4 *  ((R1/G1) + (R3/G3) + (R2/G2) + (R4/G4)) ) ));
-            SetPixel(r, (unsigned short)((G9/4 *  ((R1/G1) + (R3/G3) + (R2/G2) + (R4/G4)) ) ), x+1, y+1, width, height);
-         }
-      }
+Debayer::Debayer() :
+   workers(new Workers())
+{
+   orders.push_back("R-G-R-G");
+   orders.push_back("B-G-B-G");
+   orders.push_back("G-R-G-R");
+   orders.push_back("G-B-G-B");
 
+   algorithms.push_back("Replication");
+   algorithms.push_back("Bilinear");
+   algorithms.push_back("Smooth-Hue");
+   algorithms.push_back("Adaptive-Smooth-Hue");
 
+   // default settings
+   orderIndex = 0; // RGRG ordering
+   algoIndex = 0;  // replication - faster
 
-      if (rowOrder == 2) {
-         for (int i=0; i<height*width; i++)
-         {
-            output[i] = 0;
-            unsigned char* bytePix = (unsigned char*)(output+i);
-            *bytePix = (unsigned char)(r[i] >> bitShift);
-            *(bytePix+1) = (unsigned char)(g[i] >> bitShift);
-            *(bytePix+2) = (unsigned char)(b[i] >> bitShift);
-
-            //rgb.addSlice("red",b);	
-            //rgb.addSlice("green",g);
-            //rgb.addSlice("blue",r);
-         }
-      }
-      else if (rowOrder == 3) {
-         for (int i=0; i<height*width; i++)
-         {
-            output[i] = 0;
-            unsigned char* bytePix = (unsigned char*)(output+i);
-            *bytePix = (unsigned char)(b[i] >> bitShift);
-            *(bytePix+1) = (unsigned char)(g[i] >> bitShift);
-            *(bytePix+2) = (unsigned char)(r[i] >> bitShift);
-
-            //rgb.addSlice("red",r);	
-            //rgb.addSlice("green",g);
-            //rgb.addSlice("blue",b);			
-         }
-      }
+   threadCount = static_cast<int>(std::thread::hardware_concurrency());
+   if (threadCount < 1)
+      threadCount = 1;
+}
+
+Debayer::~Debayer()
+{
+}
+
+int Debayer::Process(ImgBuffer& out, const ImgBuffer& input, int bitDepth)
+{
+   assert(sizeof(int) == 4);
+
+   int byteDepth = input.Depth();
+   if (bitDepth > byteDepth * 8)
+   {
+      assert(false);
+      return DEVICE_INVALID_INPUT_PARAM;
+   }
+
+   out.Resize(input.Width(), input.Height(), 4);
+   if (input.Depth() == 1)
+   {
+      const unsigned char* inBuf = input.GetPixels();
+      return ProcessT(out, inBuf, input.Width(), input.Height(), bitDepth);
+   }
+   else if (input.Depth() == 2)
+   {
+      const unsigned short* inBuf = reinterpret_cast<const unsigned short*>(input.GetPixels());
+      return ProcessT(out, inBuf, input.Width(), input.Height(), bitDepth);
+   }
+   else
+      return DEVICE_UNSUPPORTED_DATA_FORMAT;
+
+}
+
+int Debayer::Process(ImgBuffer& out, const unsigned char* in, int width, int height, int bitDepth)
+{ return ProcessT(out, in, width, height, bitDepth); }
+
+int Debayer::Process(ImgBuffer& out, const unsigned short* in, int width, int height, int bitDepth)
+{ return ProcessT(out, in, width, height, bitDepth); }
+
+template <typename T>
+int Debayer::ProcessT(ImgBuffer& out, const T* in, int width, int height, int bitDepth)
+{
+   if (orderIndex < 0 || orderIndex > 3)
+      return DEVICE_NOT_SUPPORTED;
+   if (algoIndex != ALG_REPLICATION && algoIndex != ALG_SMOOTH_HUE &&
+         algoIndex != ALG_ADAPTIVE_SMOOTH_HUE)
+      return DEVICE_NOT_SUPPORTED;
+
+   out.Resize(width, height, 4);
+   if (width <= 0 || height <= 0)
+      return DEVICE_OK;
+
+   BayerImage<T> img;
+   img.pixels = in;
+   img.width = width;
+   img.height = height;
+
+   BayerLayout lay;
+   lay.pRow = orderIndex < 2 ? 0 : 1;
+   // R-G-R-G and G-R-G-R place P in the third byte, the others in the first
+   lay.pByte = (orderIndex % 2 == 0) ? 2 : 0;
+   lay.qByte = 2 - lay.pByte;
+   lay.shift = bitDepth > 8 ? bitDepth - 8 : 0;
+
+   unsigned char* outBuf = out.GetPixelsRW();
+   const std::size_t rowBytes = static_cast<std::size_t>(width) * 4;
+
+   if (algoIndex == ALG_REPLICATION)
+   {
+      RunBands(*workers, width, height, threadCount, [&](int yBegin, int yEnd) {
+         for (int y = yBegin; y < yEnd; ++y)
+            ReplicateRow(img, lay, y, outBuf + y * rowBytes);
+      });
+   }
+   else if (algoIndex == ALG_SMOOTH_HUE)
+   {
+      RunBands(*workers, width, height, threadCount, [&](int yBegin, int yEnd) {
+         for (int y = yBegin; y < yEnd; ++y)
+            SmoothRow(img, lay, y, outBuf + y * rowBytes);
+      });
    }
+   else
+   {
+      const int maxVal = (1 << (lay.shift + 8)) - 1;
+      RunBands(*workers, width, height, threadCount, [&](int yBegin, int yEnd) {
+         AdaptiveBand(img, lay, maxVal, outBuf, yBegin, yEnd);
+      });
+   }
+   return DEVICE_OK;
 }
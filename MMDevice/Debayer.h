@@ -26,12 +26,18 @@
 
 #include "ImgBuffer.h"
 
+#include <memory>
 #include <string>
 #include <vector>
 
 /**
  * Utility class to build color image from the Bayer grayscale image
  * Based on the Debayer_Image plugin for ImageJ, by Jennifer West, University of Manitoba
+ *
+ * The output is written directly as 32-bit BGRA pixels in a single pass over
+ * the input. Large images are split into horizontal bands that are processed
+ * concurrently; the band count is limited by SetThreadCount(). The worker
+ * threads are started on first use and kept until the object is destroyed.
  */
 class Debayer
 {
@@ -49,26 +55,28 @@ public:
    void SetOrderIndex(int idx) {orderIndex = idx;}
    void SetAlgorithmIndex(int idx) {algoIndex = idx;}
 
+   /**
+    * Maximum number of threads used for a single image (default: number of
+    * hardware threads). A value of 1 processes all images on the calling
+    * thread.
+    */
+   void SetThreadCount(int count) {threadCount = count < 1 ? 1 : count;}
+   int GetThreadCount() const {return threadCount;}
+
 private:
    template <typename T>
    int ProcessT(ImgBuffer& out, const T* in, int width, int height, int bitDepth);
-   template<typename T>
-   void ReplicateDecode(const T* input, int* out, int width, int height, int bitDepth, int rowOrder);
-   template <typename T>
-   void SmoothDecode(const T* input, int* output, int width, int height, int bitDepth, int rowOrder);
-   template<typename T>
-   int Convert(const T* input, int* output, int width, int height, int bitDepth, int rowOrder, int algorithm);
-   unsigned short GetPixel(const unsigned short* v, int x, int y, int width, int height);
-   void SetPixel(std::vector<unsigned short>& v, unsigned short val, int x, int y, int width, int height);
-   unsigned short GetPixel(const unsigned char* v, int x, int y, int width, int height);
 
-   std::vector<unsigned short> r; // red scratch buffer
-   std::vector<unsigned short> g; // green scratch buffer
-   std::vector<unsigned short> b; // blue scratch buffer
+   class Workers;
+
+   Debayer(const Debayer&);
+   Debayer& operator=(const Debayer&);
 
    std::vector<std::string> orders;
    std::vector<std::string> algorithms;
 
    int orderIndex;
    int algoIndex;
+   int threadCount;
+   std::unique_ptr<Workers> workers;
 };
@@ -38,6 +38,7 @@
 #include <iomanip>
 #include <map>
 #include <sstream>
+#include <type_traits>
 
 // common error messages
 const char* const g_Msg_ERR = "Unknown error in the device";
@@ -196,11 +197,12 @@ public:
    virtual int GetProperty(const char* name, char* value) const
    {
       std::string strVal;
-      // additional information for reporting invalid properties.
-      SetMorePropertyErrorInfo(name);
       int nRet = properties_.Get(name, strVal);
       if (nRet == DEVICE_OK)
          CDeviceUtils::CopyLimitedString(value, strVal.c_str());
+      else
+         // additional information for reporting invalid properties.
+         SetMorePropertyErrorInfo(name);
       return nRet;
    }
 
@@ -476,6 +478,47 @@ public:
       return pProp->SendSequence();
    }
 
+   /**
+    * This function is used by the Core to communicate a numeric sequence to
+    * the device in one call. The property's action handler receives it on
+    * AfterLoadSequence and can read it with GetFloatSequence() (or, as
+    * strings, with GetSequence()).
+    * @param name - name of the sequenceable property
+    * @param values - the sequence
+    * @param count - number of values
+    */
+   virtual int LoadFloatPropertySequence(const char* name,
+         const double* values, unsigned long count)
+   {
+      MM::Property* pProp;
+      int ret = GetSequenceableProperty(&pProp, name);
+      if (ret != DEVICE_OK)
+         return ret;
+
+      ret = pProp->SetSequence(values, count);
+      if (ret != DEVICE_OK)
+         return ret;
+      return pProp->SendSequence();
+   }
+
+   /**
+    * Integer counterpart of LoadFloatPropertySequence(); the action handler
+    * can read the sequence with GetIntegerSequence().
+    */
+   virtual int LoadIntegerPropertySequence(const char* name,
+         const long* values, unsigned long count)
+   {
+      MM::Property* pProp;
+      int ret = GetSequenceableProperty(&pProp, name);
+      if (ret != DEVICE_OK)
+         return ret;
+
+      ret = pProp->SetSequence(values, count);
+      if (ret != DEVICE_OK)
+         return ret;
+      return pProp->SendSequence();
+   }
+
    /**
    * Obtains the property name given the index.
    * Can be used for enumerating properties.
@@ -522,6 +565,67 @@ public:
       return ret;
    }
 
+   /**
+   * Obtains the value of a Float property, without formatting it as a string.
+   * @param name - property identifier (name)
+   * @param value - the value of the property
+   */
+   virtual int GetFloatPropertyValue(const char* name, double& value) const
+   {
+      int ret = properties_.GetFloat(name, value);
+      if (ret != DEVICE_OK)
+         SetMorePropertyErrorInfo(name);
+      return ret;
+   }
+
+   /**
+   * Obtains the value of an Integer property, without formatting it as a
+   * string.
+   * @param name - property identifier (name)
+   * @param value - the value of the property
+   */
+   virtual int GetIntegerPropertyValue(const char* name, long& value) const
+   {
+      int ret = properties_.GetInteger(name, value);
+      if (ret != DEVICE_OK)
+         SetMorePropertyErrorInfo(name);
+      return ret;
+   }
+
+   /**
+   * Sets the value of a Float property, without parsing it from a string.
+   * Returns DEVICE_INVALID_PROPERTY_TYPE if the device overrides
+   * SetProperty(), so that the caller goes through it instead.
+   * @param name - property identifier (name)
+   * @param value - the new value of the property
+   */
+   virtual int SetFloatPropertyValue(const char* name, double value)
+   {
+      if (OverridesSetProperty())
+         return DEVICE_INVALID_PROPERTY_TYPE;
+      int ret = properties_.SetFloat(name, value);
+      if (ret != DEVICE_OK)
+         SetMorePropertyErrorInfo(name);
+      return ret;
+   }
+
+   /**
+   * Sets the value of an Integer property, without parsing it from a string.
+   * Returns DEVICE_INVALID_PROPERTY_TYPE if the device overrides
+   * SetProperty(), so that the caller goes through it instead.
+   * @param name - property identifier (name)
+   * @param value - the new value of the property
+   */
+   virtual int SetIntegerPropertyValue(const char* name, long value)
+   {
+      if (OverridesSetProperty())
+         return DEVICE_INVALID_PROPERTY_TYPE;
+      int ret = properties_.SetInteger(name, value);
+      if (ret != DEVICE_OK)
+         SetMorePropertyErrorInfo(name);
+      return ret;
+   }
+
    /**
    * Checks if device supports a given property.
    */
@@ -1150,6 +1254,47 @@ protected:
       return MM::MMTime(0.0);
    }
 
+   /**
+   * Calls func(context, 0) to func(context, count - 1) in parallel on the
+   * Core's thread pool and waits for them to complete. Without a Core, the
+   * calls are made in turn on the calling thread.
+   */
+   int RunInParallel(void (*func)(void* context, unsigned index), void* context,
+         unsigned count, bool critical = false)
+   {
+      if (callback_)
+         return callback_->RunInParallel(this, func, context, count, critical);
+
+      if (!func)
+         return DEVICE_INVALID_INPUT_PARAM;
+      for (unsigned i = 0; i < count; ++i)
+         func(context, i);
+      return DEVICE_OK;
+   }
+
+   /**
+   * Returns the scheduling settings that the user chose for image acquisition
+   * threads, to pass to MMDeviceThreadBase::setAttributes() before starting
+   * such a thread. Without a Core, the settings are the defaults.
+   */
+   MMThreadAttributes GetAcquisitionThreadAttributes()
+   {
+      MMThreadAttributes attributes;
+      int priority = 0;
+      unsigned long long cpuMask = 0;
+      if (callback_ && callback_->GetAcquisitionThreadPlacement(this,
+               priority, cpuMask) == DEVICE_OK)
+      {
+         if (priority > 0)
+         {
+            attributes.policy = MMThreadAttributes::PolicyRealTime;
+            attributes.priority = priority;
+         }
+         attributes.cpuMask = cpuMask;
+      }
+      return attributes;
+   }
+
    /**
    * Check if we have callback mechanism set up.
    */
@@ -1224,6 +1369,14 @@ private:
       return properties_.Find(propName) != 0;
    }
 
+   // Whether U (or a class between it and this one) declares SetProperty(),
+   // which typed sets would otherwise bypass
+   static bool OverridesSetProperty()
+   {
+      return !std::is_same<decltype(&U::SetProperty),
+            int (CDeviceBase::*)(const char*, const char*)>::value;
+   }
+
    /**
     * Finds a property by name and determines whether it is a sequenceable property
     * @param pProp - pointer to pointer used to return the property if found
@@ -1633,6 +1786,7 @@ protected:
          imageCounter_=0;
          stop_ = false;
          suspend_=false;
+         setAttributes(camera_->GetAcquisitionThreadAttributes());
          activate();
          actualDuration_ = MM::MMTime{};
          startTime_= camera_->GetCurrentMMTime();
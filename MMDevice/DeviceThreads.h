@@ -24,27 +24,169 @@
    #define WIN32_LEAN_AND_MEAN
    #include <windows.h>
 #else
+   #include <errno.h>
    #include <pthread.h>
+   #include <sched.h>
 #endif
 
+#include <cstddef>
+
+/**
+ * Scheduling settings for a thread started by MMDeviceThreadBase. The
+ * defaults leave everything to the operating system.
+ */
+struct MMThreadAttributes
+{
+   enum Policy
+   {
+      PolicyNormal,   // Time-sharing, like other threads
+      PolicyRealTime, // Runs ahead of normal threads
+   };
+
+   MMThreadAttributes() :
+      policy(PolicyNormal),
+      priority(0),
+      cpuMask(0),
+      stackSize(0)
+   {}
+
+   Policy policy;
+   // For PolicyRealTime, 1 (lowest) to 99 (highest). This is the SCHED_FIFO
+   // priority on Linux and macOS, where it usually requires privileges; on
+   // Windows it selects a thread priority from ABOVE_NORMAL to TIME_CRITICAL.
+   int priority;
+   // Bit n set allows the thread to run on CPU n; 0 allows all CPUs. Not
+   // supported on macOS.
+   unsigned long long cpuMask;
+   // Stack size in bytes, or 0 for the default
+   size_t stackSize;
+};
+
 /**
  * Base class for threads in MM devices
  */
 class MMDeviceThreadBase
 {
 public:
-   MMDeviceThreadBase() : thread_(0) {}
+   MMDeviceThreadBase() : thread_(0), attributesApplied_(true) {}
    virtual ~MMDeviceThreadBase() {}
 
    virtual int svc() = 0;
 
+   /**
+    * Sets the scheduling settings for threads started by later calls to
+    * activate().
+    */
+   void setAttributes(const MMThreadAttributes& attributes)
+   {
+      attributes_ = attributes;
+   }
+
+   const MMThreadAttributes& getAttributes() const { return attributes_; }
+
+   /**
+    * Returns whether all of the attributes could be applied when the thread
+    * was last started. A thread is started even if they could not be.
+    */
+   bool attributesApplied() const { return attributesApplied_; }
+
    virtual int activate()
    {
+      attributesApplied_ = true;
+      const bool realTime =
+         attributes_.policy == MMThreadAttributes::PolicyRealTime;
 #ifdef _WIN32
       DWORD id;
-      thread_ = CreateThread(NULL, 0, ThreadProc, this, 0, &id);
+      DWORD flags = CREATE_SUSPENDED;
+      if (attributes_.stackSize > 0)
+         flags |= STACK_SIZE_PARAM_IS_A_RESERVATION;
+      thread_ = CreateThread(NULL, attributes_.stackSize, ThreadProc, this,
+         flags, &id);
+      if (!thread_)
+      {
+         attributesApplied_ = false;
+         return 0;
+      }
+      if (realTime)
+      {
+         int level = THREAD_PRIORITY_TIME_CRITICAL;
+         if (attributes_.priority < 34)
+            level = THREAD_PRIORITY_ABOVE_NORMAL;
+         else if (attributes_.priority < 67)
+            level = THREAD_PRIORITY_HIGHEST;
+         if (!SetThreadPriority(thread_, level))
+            attributesApplied_ = false;
+      }
+      if (attributes_.cpuMask != 0)
+      {
+         const DWORD_PTR mask = static_cast<DWORD_PTR>(attributes_.cpuMask);
+         if (mask != attributes_.cpuMask || !SetThreadAffinityMask(thread_, mask))
+            attributesApplied_ = false;
+      }
+      ResumeThread(thread_);
 #else
-      pthread_create(&thread_, NULL, ThreadProc, this);
+      pthread_attr_t attr;
+      pthread_attr_init(&attr);
+      if (attributes_.stackSize > 0 &&
+            pthread_attr_setstacksize(&attr, attributes_.stackSize) != 0)
+         attributesApplied_ = false;
+      if (realTime)
+      {
+         // Set at creation, so the thread never runs at normal priority
+         sched_param param;
+         param.sched_priority = attributes_.priority;
+         const int minPriority = sched_get_priority_min(SCHED_FIFO);
+         const int maxPriority = sched_get_priority_max(SCHED_FIFO);
+         if (param.sched_priority < minPriority)
+            param.sched_priority = minPriority;
+         if (param.sched_priority > maxPriority)
+            param.sched_priority = maxPriority;
+         pthread_attr_setinheritsched(&attr, PTHREAD_EXPLICIT_SCHED);
+         pthread_attr_setschedpolicy(&attr, SCHED_FIFO);
+         pthread_attr_setschedparam(&attr, &param);
+      }
+      bool affinitySet = false;
+      if (attributes_.cpuMask != 0)
+      {
+#ifdef __linux__
+         // Also set at creation, so the thread never runs on other CPUs
+         cpu_set_t set;
+         CPU_ZERO(&set);
+         for (unsigned cpu = 0; cpu < 64; ++cpu)
+         {
+            if (attributes_.cpuMask & (1ULL << cpu))
+               CPU_SET(cpu, &set);
+         }
+         affinitySet = pthread_attr_setaffinity_np(&attr, sizeof(set), &set) == 0;
+#endif
+         if (!affinitySet)
+            attributesApplied_ = false;
+      }
+      int err = pthread_create(&thread_, &attr, ThreadProc, this);
+#ifdef __linux__
+      if (err == EINVAL && affinitySet)
+      {
+         // None of the CPUs can be used; run where the process may
+         attributesApplied_ = false;
+         cpu_set_t set;
+         if (sched_getaffinity(0, sizeof(set), &set) == 0 &&
+               pthread_attr_setaffinity_np(&attr, sizeof(set), &set) == 0)
+            err = pthread_create(&thread_, &attr, ThreadProc, this);
+      }
+#endif
+      if (err == EPERM && realTime)
+      {
+         // Not permitted; run with normal scheduling instead
+         attributesApplied_ = false;
+         pthread_attr_setinheritsched(&attr, PTHREAD_INHERIT_SCHED);
+         err = pthread_create(&thread_, &attr, ThreadProc, this);
+      }
+      pthread_attr_destroy(&attr);
+      if (err != 0)
+      {
+         attributesApplied_ = false;
+         return 0;
+      }
 #endif
       return 0; // TODO: return thread id
    }
@@ -69,6 +211,8 @@ private:
    pthread_t
 #endif
    thread_;
+   MMThreadAttributes attributes_;
+   bool attributesApplied_;
 
    static
 #ifdef _WIN32
@@ -28,7 +28,7 @@
 // Header version
 // If any of the class definitions changes, the interface version
 // must be incremented
-#define DEVICE_INTERFACE_VERSION 71
+#define DEVICE_INTERFACE_VERSION 76
 ///////////////////////////////////////////////////////////////////////////////
 
 // N.B.
@@ -216,6 +216,19 @@ namespace MM {
       virtual unsigned GetNumberOfProperties() const = 0;
       virtual int GetProperty(const char* name, char* value) const = 0;
       virtual int SetProperty(const char* name, const char* value) = 0;
+      /**
+       * Get or set a Float (double) or Integer (long) property without
+       * converting its value to or from a string.
+       *
+       * Return DEVICE_INVALID_PROPERTY_TYPE if the property is not of the
+       * matching type, or (for setting) if it has a list of allowed values
+       * or the device handles sets in its own SetProperty(); the caller
+       * should then use GetProperty() or SetProperty().
+       */
+      virtual int GetFloatPropertyValue(const char* name, double& value) const = 0;
+      virtual int GetIntegerPropertyValue(const char* name, long& value) const = 0;
+      virtual int SetFloatPropertyValue(const char* name, double value) = 0;
+      virtual int SetIntegerPropertyValue(const char* name, long value) = 0;
       virtual bool HasProperty(const char* name) const = 0;
       virtual bool GetPropertyName(unsigned idx, char* name) const = 0;
       virtual int GetPropertyReadOnly(const char* name, bool& readOnly) const = 0;
@@ -259,6 +272,16 @@ namespace MM {
        * Signal that we are done sending sequence values so that the adapter can send the whole sequence to the device
        */
       virtual int SendPropertySequence(const char* propertyName) = 0;
+      /**
+       * Replace the sequence with the given numeric values and send it to the
+       * device, in one call. Equivalent to ClearPropertySequence(),
+       * AddToPropertySequence() for each value and SendPropertySequence(),
+       * but without converting each value to and from a string.
+       */
+      virtual int LoadFloatPropertySequence(const char* propertyName,
+            const double* values, unsigned long count) = 0;
+      virtual int LoadIntegerPropertySequence(const char* propertyName,
+            const long* values, unsigned long count) = 0;
 
       virtual bool GetErrorText(int errorCode, char* errMessage) const = 0;
       virtual bool Busy() = 0;
@@ -1381,6 +1404,28 @@ namespace MM {
       // Prefer std::chrono::steady_clock::now() in new code.
       virtual MM::MMTime GetCurrentMMTime() = 0;
 
+      /**
+       * Calls func(context, 0) to func(context, count - 1) on the Core's
+       * thread pool, and returns when all calls have completed. The calling
+       * thread also makes some of the calls. Intended for CPU-bound work such
+       * as image processing, in place of creating threads; calls should not
+       * wait for hardware. Critical work (e.g. on the acquisition path) is
+       * run before other work. func must not throw.
+       */
+      virtual int RunInParallel(const Device* caller,
+            void (*func)(void* context, unsigned index), void* context,
+            unsigned count, bool critical) = 0;
+
+      /**
+       * Gets the scheduling settings that the user chose for threads that
+       * acquire images (the Core properties AcquisitionThreadPriority and
+       * AcquisitionThreadCPUs). priority is 0 for normal scheduling, or a
+       * real-time priority from 1 to 99. Bit n of cpuMask allows CPU n; 0
+       * allows all CPUs.
+       */
+      virtual int GetAcquisitionThreadPlacement(const Device* caller,
+            int& priority, unsigned long long& cpuMask) = 0;
+
       // sequence acquisition
       virtual int AcqFinished(const Device* caller, int statusCode) = 0;
       virtual int PrepareForAcq(const Device* caller) = 0;
@@ -88,6 +88,9 @@
 #define DEVICE_SEQUENCE_TOO_LARGE      39
 #define DEVICE_OUT_OF_MEMORY           40
 #define DEVICE_NOT_YET_IMPLEMENTED     41
+// Not an error: returned by ImageProcessor::Process() when the image has been
+// consumed (e.g. accumulated) and should not be inserted into the buffer
+#define DEVICE_IMAGE_CONSUMED          42
 
 
 namespace MM {
@@ -144,6 +147,9 @@ namespace MM {
    const char* const g_Keyword_CoreSLM          = "SLM";
    const char* const g_Keyword_CoreGalvo        = "Galvo";
    const char* const g_Keyword_CoreTimeoutMs    = "TimeoutMs";
+   const char* const g_Keyword_CoreInitializationTimeoutMs = "InitializationTimeoutMs";
+   const char* const g_Keyword_CoreAcquisitionThreadPriority = "AcquisitionThreadPriority";
+   const char* const g_Keyword_CoreAcquisitionThreadCPUs = "AcquisitionThreadCPUs";
    const char* const g_Keyword_Channel          = "Channel";
    const char* const g_Keyword_Version          = "Version";
    const char* const g_Keyword_ColorMode        = "ColorMode";
@@ -173,6 +179,20 @@ namespace MM {
    const char* const g_Keyword_Metadata_ROI_X       = "ROI-X-start";
    const char* const g_Keyword_Metadata_ROI_Y       = "ROI-Y-start";
    const char* const g_Keyword_Metadata_TimeInCore  = "TimeReceivedByCore";
+   const char* const g_Keyword_Metadata_TimeInCoreUTC_ns       = "TimeReceivedByCore-UTC-ns";
+   const char* const g_Keyword_Metadata_TimeInCoreMonotonic_ns = "TimeReceivedByCore-Monotonic-ns";
+   // Device clock timestamp of the frame in nanoseconds (integer), set by
+   // cameras that provide hardware timestamps
+   const char* const g_Keyword_Metadata_HardwareTimestamp_ns   = "HardwareTimestamp-ns";
+   // Added by the Core: hardware timestamp mapped to the monotonic host clock
+   const char* const g_Keyword_Metadata_HardwareTimestampHost_ns = "HardwareTimestamp-HostMonotonic-ns";
+   // Added by the Core when frame statistics are enabled
+   const char* const g_Keyword_Metadata_StatsMin        = "Statistics-Min";
+   const char* const g_Keyword_Metadata_StatsMax        = "Statistics-Max";
+   const char* const g_Keyword_Metadata_StatsMean       = "Statistics-Mean";
+   const char* const g_Keyword_Metadata_StatsSaturated  = "Statistics-SaturatedPixels";
+   const char* const g_Keyword_Metadata_StatsBitDepth   = "Statistics-BitDepth";
+   const char* const g_Keyword_Metadata_StatsHistogram  = "Statistics-Histogram";
 
    // configuration file format constants
    const char* const g_FieldDelimiters = ",";
@@ -0,0 +1,477 @@
+///////////////////////////////////////////////////////////////////////////////
+// FILE:          PackedPixels.cpp
+// PROJECT:       Micro-Manager
+// SUBSYSTEM:     MMDevice - Device adapter kit
+//-----------------------------------------------------------------------------
+// DESCRIPTION:   Conversion between 16-bit pixels and the packed 10- and
+//                12-bit layouts delivered by GenICam and MIPI CSI-2 cameras.
+//
+// LICENSE:       This file is distributed under the BSD license.
+//                License text is included with the source distribution.
+//
+//                This file is distributed in the hope that it will be useful,
+//                but WITHOUT ANY WARRANTY; without even the implied warranty
+//                of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+//
+//                IN NO EVENT SHALL THE COPYRIGHT OWNER OR
+//                CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+//                INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES.
+
+#include "PackedPixels.h"
+
+#include <cstdint>
+#include <cstring>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define PACKEDPIXELS_USE_SSE2
+#include <emmintrin.h>
+#endif
+
+namespace {
+
+// Each layout converts a group of 4 pixels: the packed bytes, loaded as a
+// little-endian 64-bit word, to/from four 16-bit lanes of a 64-bit word.
+// The operations are written against Op so that the same expressions work
+// on a uint64_t and on both 64-bit halves of an SSE2 register.
+
+struct ScalarOp
+{
+   typedef std::uint64_t V;
+   template <int N> static V Shl(V v) { return v << N; }
+   template <int N> static V Shr(V v) { return v >> N; }
+   static V And(V v, std::uint64_t mask) { return v & mask; }
+   static V Or(V a, V b) { return a | b; }
+};
+
+#ifdef PACKEDPIXELS_USE_SSE2
+struct Sse2Op
+{
+   typedef __m128i V;
+   template <int N> static V Shl(V v) { return _mm_slli_epi64(v, N); }
+   template <int N> static V Shr(V v) { return _mm_srli_epi64(v, N); }
+   static V And(V v, std::uint64_t mask)
+   { return _mm_and_si128(v, _mm_set1_epi64x(static_cast<long long>(mask))); }
+   static V Or(V a, V b) { return _mm_or_si128(a, b); }
+};
+#endif
+
+// Pixel k in bits 10k..10k+9
+struct Mono10pLayout
+{
+   static const unsigned Bits = 10;
+   static const unsigned GroupBytes = 5;
+   static std::size_t PackedBytes(std::size_t n) { return (n * 10 + 7) / 8; }
+
+   template <typename Op>
+   static typename Op::V Unpack(typename Op::V v)
+   {
+      return Op::Or(
+            Op::Or(Op::And(v, 0x3FFull),
+               Op::And(Op::template Shl<6>(v), 0x3FF0000ull)),
+            Op::Or(Op::And(Op::template Shl<12>(v), 0x3FF00000000ull),
+               Op::And(Op::template Shl<18>(v), 0x3FF000000000000ull)));
+   }
+
+   template <typename Op>
+   static typename Op::V Pack(typename Op::V v)
+   {
+      return Op::Or(
+            Op::Or(Op::And(v, 0x3FFull),
+               Op::And(Op::template Shr<6>(v), 0xFFC00ull)),
+            Op::Or(Op::And(Op::template Shr<12>(v), 0x3FF00000ull),
+               Op::And(Op::template Shr<18>(v), 0xFFC0000000ull)));
+   }
+};
+
+// Pixel k in bits 12k..12k+11
+struct Mono12pLayout
+{
+   static const unsigned Bits = 12;
+   static const unsigned GroupBytes = 6;
+   static std::size_t PackedBytes(std::size_t n) { return (n * 12 + 7) / 8; }
+
+   template <typename Op>
+   static typename Op::V Unpack(typename Op::V v)
+   {
+      return Op::Or(
+            Op::Or(Op::And(v, 0xFFFull),
+               Op::And(Op::template Shl<4>(v), 0xFFF0000ull)),
+            Op::Or(Op::And(Op::template Shl<8>(v), 0xFFF00000000ull),
+               Op::And(Op::template Shl<12>(v), 0xFFF000000000000ull)));
+   }
+
+   template <typename Op>
+   static typename Op::V Pack(typename Op::V v)
+   {
+      return Op::Or(
+            Op::Or(Op::And(v, 0xFFFull),
+               Op::And(Op::template Shr<4>(v), 0xFFF000ull)),
+            Op::Or(Op::And(Op::template Shr<8>(v), 0xFFF000000ull),
+               Op::And(Op::template Shr<12>(v), 0xFFF000000000ull)));
+   }
+};
+
+// Per pixel pair: B0 = p0[9:2], B1 = p0[1:0] | p1[1:0] << 4, B2 = p1[9:2]
+struct Mono10PackedLayout
+{
+   static const unsigned Bits = 10;
+   static const unsigned GroupBytes = 6;
+   static std::size_t PackedBytes(std::size_t n) { return (n + 1) / 2 * 3; }
+
+   template <typename Op>
+   static typename Op::V Unpack(typename Op::V v)
+   {
+      return Op::Or(
+            Op::Or(
+               Op::Or(Op::And(Op::template Shl<2>(v), 0x3FC03FCull),
+                  Op::And(Op::template Shr<8>(v), 0x3ull)),
+               Op::Or(Op::And(Op::template Shl<4>(v), 0x30000ull),
+                  Op::And(Op::template Shl<10>(v), 0x3FC03FC00000000ull))),
+            Op::Or(Op::And(v, 0x300000000ull),
+               Op::And(Op::template Shl<12>(v), 0x3000000000000ull)));
+   }
+
+   template <typename Op>
+   static typename Op::V Pack(typename Op::V v)
+   {
+      return Op::Or(
+            Op::Or(
+               Op::Or(Op::And(Op::template Shr<2>(v), 0xFF00FFull),
+                  Op::And(Op::template Shl<8>(v), 0x300ull)),
+               Op::Or(Op::And(Op::template Shr<4>(v), 0x3000ull),
+                  Op::And(Op::template Shr<10>(v), 0xFF00FF000000ull))),
+            Op::Or(Op::And(v, 0x300000000ull),
+               Op::And(Op::template Shr<12>(v), 0x3000000000ull)));
+   }
+};
+
+// Per pixel pair: B0 = p0[11:4], B1 = p0[3:0] | p1[3:0] << 4, B2 = p1[11:4]
+struct Mono12PackedLayout
+{
+   static const unsigned Bits = 12;
+   static const unsigned GroupBytes = 6;
+   static std::size_t PackedBytes(std::size_t n) { return (n + 1) / 2 * 3; }
+
+   template <typename Op>
+   static typename Op::V Unpack(typename Op::V v)
+   {
+      return Op::Or(
+            Op::Or(Op::And(Op::template Shl<4>(v), 0xFFF0FF0ull),
+               Op::And(Op::template Shr<8>(v), 0xFull)),
+            Op::Or(Op::And(Op::template Shl<12>(v), 0xFFF0FF000000000ull),
+               Op::And(v, 0xF00000000ull)));
+   }
+
+   template <typename Op>
+   static typename Op::V Pack(typename Op::V v)
+   {
+      return Op::Or(
+            Op::Or(Op::And(Op::template Shr<4>(v), 0xFFF0FFull),
+               Op::And(Op::template Shl<8>(v), 0xF00ull)),
+            Op::Or(Op::And(Op::template Shr<12>(v), 0xFFF0FF000000ull),
+               Op::And(v, 0xF00000000ull)));
+   }
+};
+
+// B0..B3 = p0..p3[9:2], B4 = p0[1:0] | p1[1:0] << 2 | p2[1:0] << 4 | p3[1:0] << 6
+struct MipiRaw10Layout
+{
+   static const unsigned Bits = 10;
+   static const unsigned GroupBytes = 5;
+   static std::size_t PackedBytes(std::size_t n) { return (n + 3) / 4 * 5; }
+
+   template <typename Op>
+   static typename Op::V Unpack(typename Op::V v)
+   {
+      return Op::Or(
+            Op::Or(
+               Op::Or(Op::And(Op::template Shl<2>(v), 0x3FCull),
+                  Op::And(Op::template Shr<32>(v), 0x3ull)),
+               Op::Or(Op::And(Op::template Shl<10>(v), 0x3FC0000ull),
+                  Op::And(Op::template Shr<18>(v), 0x30000ull))),
+            Op::Or(
+               Op::Or(Op::And(Op::template Shl<18>(v), 0x3FC00000000ull),
+                  Op::And(Op::template Shr<4>(v), 0x300000000ull)),
+               Op::Or(Op::And(Op::template Shl<26>(v), 0x3FC000000000000ull),
+                  Op::And(Op::template Shl<10>(v), 0x3000000000000ull))));
+   }
+
+   template <typename Op>
+   static typename Op::V Pack(typename Op::V v)
+   {
+      return Op::Or(
+            Op::Or(
+               Op::Or(Op::And(Op::template Shr<2>(v), 0xFFull),
+                  Op::And(Op::template Shr<10>(v), 0xFF00ull)),
+               Op::Or(Op::And(Op::template Shr<18>(v), 0xFF0000ull),
+                  Op::And(Op::template Shr<26>(v), 0xFF000000ull))),
+            Op::Or(
+               Op::Or(Op::And(Op::template Shl<32>(v), 0x300000000ull),
+                  Op::And(Op::template Shl<18>(v), 0xC00000000ull)),
+               Op::Or(Op::And(Op::template Shl<4>(v), 0x3000000000ull),
+                  Op::And(Op::template Shr<10>(v), 0xC000000000ull))));
+   }
+};
+
+// Per pixel pair: B0 = p0[11:4], B1 = p1[11:4], B2 = p0[3:0] | p1[3:0] << 4
+struct MipiRaw12Layout
+{
+   static const unsigned Bits = 12;
+   static const unsigned GroupBytes = 6;
+   static std::size_t PackedBytes(std::size_t n) { return (n + 1) / 2 * 3; }
+
+   template <typename Op>
+   static typename Op::V Unpack(typename Op::V v)
+   {
+      return Op::Or(
+            Op::Or(
+               Op::Or(Op::And(Op::template Shl<4>(v), 0xFF0ull),
+                  Op::And(Op::template Shr<16>(v), 0xFull)),
+               Op::Or(Op::And(Op::template Shl<12>(v), 0xFF00000ull),
+                  Op::And(Op::template Shr<4>(v), 0xF0000ull))),
+            Op::Or(
+               Op::Or(Op::And(Op::template Shl<12>(v), 0xFF000000000ull),
+                  Op::And(Op::template Shr<8>(v), 0xF00000000ull)),
+               Op::Or(Op::And(Op::template Shl<20>(v), 0xFF0000000000000ull),
+                  Op::And(Op::template Shl<4>(v), 0xF000000000000ull))));
+   }
+
+   template <typename Op>
+   static typename Op::V Pack(typename Op::V v)
+   {
+      return Op::Or(
+            Op::Or(
+               Op::Or(Op::And(Op::template Shr<4>(v), 0xFFull),
+                  Op::And(Op::template Shr<12>(v), 0xFF00FF00ull)),
+               Op::Or(Op::And(Op::template Shl<16>(v), 0xF0000ull),
+                  Op::And(Op::template Shl<4>(v), 0xF00000ull))),
+            Op::Or(
+               Op::Or(Op::And(Op::template Shr<20>(v), 0xFF00000000ull),
+                  Op::And(Op::template Shl<8>(v), 0xF0000000000ull)),
+               Op::And(Op::template Shr<4>(v), 0xF00000000000ull)));
+   }
+};
+
+// Unpacks pixelCount pixels; readableBytes (at least the packed size) bounds
+// the 8-byte loads used for whole groups
+template <typename Layout>
+void UnpackT(std::uint16_t* dst, const unsigned char* src,
+      std::size_t pixelCount, std::size_t readableBytes)
+{
+   const unsigned G = Layout::GroupBytes;
+   std::size_t offset = 0;
+   std::size_t remaining = pixelCount;
+
+#ifdef PACKEDPIXELS_USE_SSE2
+   while (remaining >= 8 && offset + G + 8 <= readableBytes)
+   {
+      __m128i v = _mm_unpacklo_epi64(
+            _mm_loadl_epi64(reinterpret_cast<const __m128i*>(src + offset)),
+            _mm_loadl_epi64(reinterpret_cast<const __m128i*>(src + offset + G)));
+      _mm_storeu_si128(reinterpret_cast<__m128i*>(dst),
+            Layout::template Unpack<Sse2Op>(v));
+      offset += 2 * G;
+      dst += 8;
+      remaining -= 8;
+   }
+#endif
+
+   while (remaining >= 4 && offset + 8 <= readableBytes)
+   {
+      std::uint64_t v;
+      std::memcpy(&v, src + offset, 8);
+      v = Layout::template Unpack<ScalarOp>(v);
+      std::memcpy(dst, &v, 8);
+      offset += G;
+      dst += 4;
+      remaining -= 4;
+   }
+
+   // Groups too close to the end of the data for a full load
+   while (remaining > 0)
+   {
+      const std::size_t n = remaining < 4 ? remaining : 4;
+      std::uint64_t v = 0;
+      std::memcpy(&v, src + offset, Layout::PackedBytes(n));
+      v = Layout::template Unpack<ScalarOp>(v);
+      std::memcpy(dst, &v, n * sizeof(std::uint16_t));
+      offset += G;
+      dst += n;
+      remaining -= n;
+   }
+}
+
+template <typename Layout>
+std::size_t PackT(unsigned char* dst, const std::uint16_t* src, std::size_t pixelCount)
+{
+   const unsigned G = Layout::GroupBytes;
+   const std::uint16_t maxValue = static_cast<std::uint16_t>((1u << Layout::Bits) - 1);
+   const std::size_t dstBytes = Layout::PackedBytes(pixelCount);
+   std::size_t offset = 0;
+   std::size_t remaining = pixelCount;
+   std::size_t saturated = 0;
+
+#ifdef PACKEDPIXELS_USE_SSE2
+   // Unsigned 16-bit minimum: x - max(x - m, 0)
+   const __m128i maxVec = _mm_set1_epi16(static_cast<short>(maxValue));
+   const __m128i zero = _mm_setzero_si128();
+   while (remaining >= 8 && offset + G + 8 <= dstBytes)
+   {
+      __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src));
+      const __m128i excess = _mm_subs_epu16(v, maxVec);
+      // Out-of-range values are expected to be rare, so they are counted
+      // one by one
+      if (_mm_movemask_epi8(_mm_cmpeq_epi16(excess, zero)) != 0xFFFF)
+      {
+         for (unsigned k = 0; k < 8; ++k)
+            saturated += src[k] > maxValue;
+      }
+      v = _mm_sub_epi16(v, excess);
+      v = Layout::template Pack<Sse2Op>(v);
+      // The bytes stored past the end of each group are overwritten by the
+      // next group
+      _mm_storel_epi64(reinterpret_cast<__m128i*>(dst + offset), v);
+      _mm_storel_epi64(reinterpret_cast<__m128i*>(dst + offset + G),
+            _mm_srli_si128(v, 8));
+      offset += 2 * G;
+      src += 8;
+      remaining -= 8;
+   }
+#endif
+
+   while (remaining > 0)
+   {
+      const std::size_t n = remaining < 4 ? remaining : 4;
+      std::uint16_t lanes[4] = { 0, 0, 0, 0 };
+      for (std::size_t k = 0; k < n; ++k)
+      {
+         lanes[k] = src[k] < maxValue ? src[k] : maxValue;
+         saturated += src[k] > maxValue;
+      }
+      std::uint64_t v;
+      std::memcpy(&v, lanes, 8);
+      v = Layout::template Pack<ScalarOp>(v);
+      std::memcpy(dst + offset, &v, Layout::PackedBytes(n));
+      offset += G;
+      src += n;
+      remaining -= n;
+   }
+   return saturated;
+}
+
+template <typename Layout>
+void UnpackRowsT(std::uint16_t* dst, const unsigned char* src,
+      std::size_t srcRowBytes, unsigned width, unsigned height)
+{
+   const std::size_t rowBytes = Layout::PackedBytes(width);
+   for (unsigned y = 0; y < height; ++y)
+   {
+      // Loads may extend into the following rows
+      const std::size_t readable = (height - y - 1) * srcRowBytes + rowBytes;
+      UnpackT<Layout>(dst + static_cast<std::size_t>(y) * width,
+            src + y * srcRowBytes, width, readable);
+   }
+}
+
+bool EndsWith(const char* s, std::size_t len, const char* suffix)
+{
+   const std::size_t suffixLen = std::strlen(suffix);
+   return len >= suffixLen && std::strcmp(s + len - suffixLen, suffix) == 0;
+}
+
+} // anonymous namespace
+
+
+unsigned PackedPixels::BitDepth(Format format)
+{
+   switch (format)
+   {
+      case Mono10p:
+      case Mono10Packed:
+      case MipiRaw10:
+         return 10;
+      default:
+         return 12;
+   }
+}
+
+std::size_t PackedPixels::PackedBytes(Format format, std::size_t pixelCount)
+{
+   switch (format)
+   {
+      case Mono10p: return Mono10pLayout::PackedBytes(pixelCount);
+      case Mono12p: return Mono12pLayout::PackedBytes(pixelCount);
+      case Mono10Packed: return Mono10PackedLayout::PackedBytes(pixelCount);
+      case Mono12Packed: return Mono12PackedLayout::PackedBytes(pixelCount);
+      case MipiRaw10: return MipiRaw10Layout::PackedBytes(pixelCount);
+      case MipiRaw12: return MipiRaw12Layout::PackedBytes(pixelCount);
+   }
+   return 0;
+}
+
+bool PackedPixels::FormatFromName(const char* pfncName, Format& format)
+{
+   if (!pfncName)
+      return false;
+   const std::size_t len = std::strlen(pfncName);
+   if (std::strncmp(pfncName, "Mono", 4) != 0 &&
+         std::strncmp(pfncName, "Bayer", 5) != 0)
+      return false;
+
+   if (EndsWith(pfncName, len, "10p"))
+      format = Mono10p;
+   else if (EndsWith(pfncName, len, "12p"))
+      format = Mono12p;
+   else if (EndsWith(pfncName, len, "10Packed"))
+      format = Mono10Packed;
+   else if (EndsWith(pfncName, len, "12Packed"))
+      format = Mono12Packed;
+   else
+      return false;
+   return true;
+}
+
+void PackedPixels::Unpack(Format format, unsigned short* dst,
+      const unsigned char* src, std::size_t pixelCount)
+{
+   const std::size_t bytes = PackedBytes(format, pixelCount);
+   switch (format)
+   {
+      case Mono10p: UnpackT<Mono10pLayout>(dst, src, pixelCount, bytes); break;
+      case Mono12p: UnpackT<Mono12pLayout>(dst, src, pixelCount, bytes); break;
+      case Mono10Packed: UnpackT<Mono10PackedLayout>(dst, src, pixelCount, bytes); break;
+      case Mono12Packed: UnpackT<Mono12PackedLayout>(dst, src, pixelCount, bytes); break;
+      case MipiRaw10: UnpackT<MipiRaw10Layout>(dst, src, pixelCount, bytes); break;
+      case MipiRaw12: UnpackT<MipiRaw12Layout>(dst, src, pixelCount, bytes); break;
+   }
+}
+
+void PackedPixels::UnpackRows(Format format, unsigned short* dst,
+      const unsigned char* src, std::size_t srcRowBytes,
+      unsigned width, unsigned height)
+{
+   switch (format)
+   {
+      case Mono10p: UnpackRowsT<Mono10pLayout>(dst, src, srcRowBytes, width, height); break;
+      case Mono12p: UnpackRowsT<Mono12pLayout>(dst, src, srcRowBytes, width, height); break;
+      case Mono10Packed: UnpackRowsT<Mono10PackedLayout>(dst, src, srcRowBytes, width, height); break;
+      case Mono12Packed: UnpackRowsT<Mono12PackedLayout>(dst, src, srcRowBytes, width, height); break;
+      case MipiRaw10: UnpackRowsT<MipiRaw10Layout>(dst, src, srcRowBytes, width, height); break;
+      case MipiRaw12: UnpackRowsT<MipiRaw12Layout>(dst, src, srcRowBytes, width, height); break;
+   }
+}
+
+std::size_t PackedPixels::Pack(Format format, unsigned char* dst,
+      const unsigned short* src, std::size_t pixelCount)
+{
+   switch (format)
+   {
+      case Mono10p: return PackT<Mono10pLayout>(dst, src, pixelCount);
+      case Mono12p: return PackT<Mono12pLayout>(dst, src, pixelCount);
+      case Mono10Packed: return PackT<Mono10PackedLayout>(dst, src, pixelCount);
+      case Mono12Packed: return PackT<Mono12PackedLayout>(dst, src, pixelCount);
+      case MipiRaw10: return PackT<MipiRaw10Layout>(dst, src, pixelCount);
+      case MipiRaw12: return PackT<MipiRaw12Layout>(dst, src, pixelCount);
+   }
+   return 0;
+}
@@ -0,0 +1,82 @@
+///////////////////////////////////////////////////////////////////////////////
+// FILE:          PackedPixels.h
+// PROJECT:       Micro-Manager
+// SUBSYSTEM:     MMDevice - Device adapter kit
+//-----------------------------------------------------------------------------
+// DESCRIPTION:   Conversion between 16-bit pixels and the packed 10- and
+//                12-bit layouts delivered by GenICam and MIPI CSI-2 cameras.
+//
+// LICENSE:       This file is distributed under the BSD license.
+//                License text is included with the source distribution.
+//
+//                This file is distributed in the hope that it will be useful,
+//                but WITHOUT ANY WARRANTY; without even the implied warranty
+//                of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+//
+//                IN NO EVENT SHALL THE COPYRIGHT OWNER OR
+//                CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+//                INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES.
+
+#pragma once
+
+#include <cstddef>
+
+/**
+ * Unpacking of packed 10- and 12-bit pixel data to 16 bits per pixel (with
+ * the value in the low bits, as expected by InsertImage() for a camera
+ * reporting a bit depth of 10 or 12), and packing in the opposite direction.
+ *
+ * Every 4 pixels are converted with a few shifts and masks on a 64-bit word
+ * (two words at a time with SSE2), so no per-layout scalar loop is needed in
+ * camera adapters. Data is assumed to be in little-endian byte order, which
+ * is the case for all supported platforms.
+ */
+class PackedPixels
+{
+public:
+   enum Format
+   {
+      // GenICam PFNC "p" formats: pixels are concatenated LSB first with no
+      // padding (4 pixels in 5 bytes, or 2 pixels in 3 bytes)
+      Mono10p,
+      Mono12p,
+      // GigE Vision "Packed" formats: 2 pixels in 3 bytes, with the most
+      // significant bits in the outer bytes and the low bits in the middle
+      Mono10Packed,
+      Mono12Packed,
+      // MIPI CSI-2 RAW10 (4 pixels in 5 bytes) and RAW12 (2 pixels in 3
+      // bytes): high bits of each pixel followed by a byte of low bits, as
+      // used by V4L2 (e.g. V4L2_PIX_FMT_SRGGB10P)
+      MipiRaw10,
+      MipiRaw12,
+   };
+
+   // Significant bits per pixel (10 or 12)
+   static unsigned BitDepth(Format format);
+
+   // Size of pixelCount packed pixels; a partial group of pixels at the end
+   // occupies a whole number of bytes (e.g. 2 bytes for a single Mono10p
+   // pixel)
+   static std::size_t PackedBytes(Format format, std::size_t pixelCount);
+
+   // Gets the layout for a GenICam PFNC pixel format name such as
+   // "Mono12p", "BayerRG12p" or "Mono12Packed". Returns false if the name
+   // does not refer to one of the supported layouts.
+   static bool FormatFromName(const char* pfncName, Format& format);
+
+   // Unpacks PackedBytes(format, pixelCount) bytes
+   static void Unpack(Format format, unsigned short* dst,
+         const unsigned char* src, std::size_t pixelCount);
+
+   // Unpacks an image whose packed rows start every srcRowBytes bytes
+   // (srcRowBytes >= PackedBytes(format, width)); the output is contiguous
+   static void UnpackRows(Format format, unsigned short* dst,
+         const unsigned char* src, std::size_t srcRowBytes,
+         unsigned width, unsigned height);
+
+   // Packs pixelCount pixels into PackedBytes(format, pixelCount) bytes.
+   // Values that do not fit in BitDepth(format) bits are saturated; returns
+   // the number of such values, so that callers can reject the data.
+   static std::size_t Pack(Format format, unsigned char* dst,
+         const unsigned short* src, std::size_t pixelCount);
+};
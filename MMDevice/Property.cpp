@@ -21,6 +21,7 @@
 
 #include "Property.h"
 
+#include <algorithm>
 #include <cmath>
 #include <cstdio>
 #include <cstdlib>
@@ -85,6 +86,143 @@ void MM::Property::SetSequenceable(long sequenceMaxSize)
    sequenceMaxSize_ = sequenceMaxSize;
 }
 
+int MM::Property::ClearSequence()
+{
+   sequenceEvents_.clear();
+   floatSequence_.clear();
+   integerSequence_.clear();
+   stringSequenceValid_ = true;
+   floatSequenceValid_ = false;
+   integerSequenceValid_ = false;
+   return DEVICE_OK;
+}
+
+int MM::Property::AddToSequence(const char* value)
+{
+   try
+   {
+      StringSequence();
+      sequenceEvents_.push_back(value);
+      floatSequenceValid_ = false;
+      integerSequenceValid_ = false;
+      if (sequenceEvents_.size() > (unsigned) GetSequenceMaxSize())
+         return DEVICE_SEQUENCE_TOO_LARGE;
+   } catch (...)
+   {
+      return MM_CODE_ERR;
+   }
+
+   return DEVICE_OK;
+}
+
+int MM::Property::SetSequence(const double* values, unsigned long count)
+{
+   if (count > (unsigned long) GetSequenceMaxSize())
+      return DEVICE_SEQUENCE_TOO_LARGE;
+   try
+   {
+      floatSequence_.assign(values, values + count);
+   } catch (...)
+   {
+      return MM_CODE_ERR;
+   }
+   floatSequenceValid_ = true;
+   integerSequenceValid_ = false;
+   stringSequenceValid_ = false;
+   return DEVICE_OK;
+}
+
+int MM::Property::SetSequence(const long* values, unsigned long count)
+{
+   if (count > (unsigned long) GetSequenceMaxSize())
+      return DEVICE_SEQUENCE_TOO_LARGE;
+   try
+   {
+      integerSequence_.assign(values, values + count);
+   } catch (...)
+   {
+      return MM_CODE_ERR;
+   }
+   integerSequenceValid_ = true;
+   floatSequenceValid_ = false;
+   stringSequenceValid_ = false;
+   return DEVICE_OK;
+}
+
+std::vector<std::string> MM::Property::GetSequence() const
+{
+   return StringSequence();
+}
+
+const std::vector<std::string>& MM::Property::StringSequence() const
+{
+   if (!stringSequenceValid_)
+   {
+      char buf[BUFSIZE];
+      sequenceEvents_.clear();
+      if (floatSequenceValid_)
+      {
+         for (double val : floatSequence_)
+         {
+            // Shortest text that reads back as the same value
+            std::snprintf(buf, BUFSIZE, "%.15g", val);
+            if (std::atof(buf) != val)
+               std::snprintf(buf, BUFSIZE, "%.17g", val);
+            sequenceEvents_.push_back(buf);
+         }
+      }
+      else
+      {
+         for (long val : integerSequence_)
+         {
+            std::snprintf(buf, BUFSIZE, "%ld", val);
+            sequenceEvents_.push_back(buf);
+         }
+      }
+      stringSequenceValid_ = true;
+   }
+   return sequenceEvents_;
+}
+
+const std::vector<double>& MM::Property::GetFloatSequence() const
+{
+   if (!floatSequenceValid_)
+   {
+      floatSequence_.clear();
+      if (stringSequenceValid_)
+      {
+         for (const std::string& val : sequenceEvents_)
+            floatSequence_.push_back(std::atof(val.c_str()));
+      }
+      else
+      {
+         floatSequence_.assign(integerSequence_.begin(), integerSequence_.end());
+      }
+      floatSequenceValid_ = true;
+   }
+   return floatSequence_;
+}
+
+const std::vector<long>& MM::Property::GetIntegerSequence() const
+{
+   if (!integerSequenceValid_)
+   {
+      integerSequence_.clear();
+      if (floatSequenceValid_)
+      {
+         for (double val : floatSequence_)
+            integerSequence_.push_back((long)val); // As FloatProperty::Get(long&)
+      }
+      else
+      {
+         for (const std::string& val : sequenceEvents_)
+            integerSequence_.push_back(std::atol(val.c_str()));
+      }
+      integerSequenceValid_ = true;
+   }
+   return integerSequence_;
+}
+
 
 ///////////////////////////////////////////////////////////////////////////////
 // MM::StringProperty
@@ -302,6 +440,67 @@ int MM::PropertyCollection::Get(const char* pszPropName, std::string& strValue)
    return DEVICE_OK;
 }
 
+namespace {
+
+template <typename T>
+int GetTyped(MM::Property* pProp, MM::PropertyType eType, T& value)
+{
+   if (!pProp)
+      return DEVICE_INVALID_PROPERTY; // name not found
+   if (pProp->GetType() != eType)
+      return DEVICE_INVALID_PROPERTY_TYPE;
+
+   if (!pProp->GetCached())
+   {
+      int nRet = pProp->Update();
+      if (nRet != DEVICE_OK)
+         return nRet;
+   }
+   pProp->Get(value);
+   return DEVICE_OK;
+}
+
+// As PropertyCollection::Set(), which also checks allowed values; those are
+// strings, so they can only be checked in string form
+template <typename T>
+int SetTyped(MM::Property* pProp, MM::PropertyType eType, T value)
+{
+   if (!pProp)
+      return DEVICE_INVALID_PROPERTY; // name not found
+   if (pProp->GetType() != eType || pProp->HasAllowedValues())
+      return DEVICE_INVALID_PROPERTY_TYPE;
+
+   if (pProp->GetReadOnly())
+      return DEVICE_OK;
+
+   if (!pProp->Set(value))
+      return DEVICE_INVALID_PROPERTY_VALUE;
+
+   return pProp->Apply();
+}
+
+} // anonymous namespace
+
+int MM::PropertyCollection::GetFloat(const char* pszPropName, double& dValue) const
+{
+   return GetTyped(Find(pszPropName), MM::Float, dValue);
+}
+
+int MM::PropertyCollection::GetInteger(const char* pszPropName, long& lValue) const
+{
+   return GetTyped(Find(pszPropName), MM::Integer, lValue);
+}
+
+int MM::PropertyCollection::SetFloat(const char* pszPropName, double dValue)
+{
+   return SetTyped(Find(pszPropName), MM::Float, dValue);
+}
+
+int MM::PropertyCollection::SetInteger(const char* pszPropName, long lValue)
+{
+   return SetTyped(Find(pszPropName), MM::Integer, lValue);
+}
+
 MM::Property* MM::PropertyCollection::Find(const char* pszName) const
 {
    CPropArray::const_iterator it = properties_.find(pszName);
@@ -312,13 +511,7 @@ MM::Property* MM::PropertyCollection::Find(const char* pszName) const
 
 std::vector<std::string> MM::PropertyCollection::GetNames() const
 {
-   std::vector<std::string> nameList;
-
-   CPropArray::const_iterator it;
-   for (it = properties_.begin(); it != properties_.end(); it++)
-      nameList.push_back(it->first);
-
-   return nameList;
+   return names_;
 }
  
 unsigned MM::PropertyCollection::GetSize() const
@@ -357,6 +550,7 @@ int MM::PropertyCollection::CreateProperty(const char* pszName, const char* pszV
    pProp->SetReadOnly(bReadOnly);
    pProp->SetInitStatus(isPreInitProperty);
    properties_[pszName] = pProp;
+   names_.insert(std::lower_bound(names_.begin(), names_.end(), pszName), pszName);
 
    // assign action functor
    pProp->RegisterAction(pAct);
@@ -435,13 +629,10 @@ int MM::PropertyCollection::GetCurrentPropertyData(const char* name, long& data)
 
 bool MM::PropertyCollection::GetName(unsigned uIdx, std::string& strName) const
 {
-   if (uIdx >= properties_.size())
+   if (uIdx >= names_.size())
       return false; // unknown index
 
-   CPropArray::const_iterator it = properties_.begin();
-   for (unsigned i=0; i<uIdx; i++)
-      it++;
-   strName = it->first;
+   strName = names_[uIdx];
    return true;
 }
 
@@ -458,11 +649,11 @@ int MM::PropertyCollection::RegisterAction(const char* pszName, MM::ActionFuncto
 
 int MM::PropertyCollection::UpdateAll()
 {
-   CPropArray::const_iterator it;
-   for (it=properties_.begin(); it!=properties_.end(); it++)
+   std::vector<std::string>::const_iterator it;
+   for (it=names_.begin(); it!=names_.end(); it++)
    {
       int nRet;
-      nRet = it->second->Update();
+      nRet = properties_.find(*it)->second->Update();
       if (nRet != DEVICE_OK)
          return nRet;
    }
@@ -471,11 +662,11 @@ int MM::PropertyCollection::UpdateAll()
 
 int MM::PropertyCollection::ApplyAll()
 {
-   CPropArray::const_iterator it;
-   for (it=properties_.begin(); it!=properties_.end(); it++)
+   std::vector<std::string>::const_iterator it;
+   for (it=names_.begin(); it!=names_.end(); it++)
    {
       int nRet;
-      nRet = it->second->Apply();
+      nRet = properties_.find(*it)->second->Apply();
       if (nRet != DEVICE_OK)
          return nRet;
    }
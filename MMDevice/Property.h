@@ -26,6 +26,7 @@
 #include <functional>
 #include <map>
 #include <string>
+#include <unordered_map>
 #include <vector>
 
 namespace MM {
@@ -65,6 +66,14 @@ public:
    virtual int AddToSequence(const char* value) = 0;
    virtual int SendSequence() = 0;
 
+   // Numeric sequences. A sequence can be read in any of the three forms,
+   // regardless of the form it was loaded in; reading it in the form it was
+   // loaded in involves no conversion.
+   virtual int SetSequence(const double* values, unsigned long count) = 0;
+   virtual int SetSequence(const long* values, unsigned long count) = 0;
+   virtual const std::vector<double>& GetFloatSequence() const = 0;
+   virtual const std::vector<long>& GetIntegerSequence() const = 0;
+
    virtual std::string GetName() const = 0;
 };
 
@@ -152,6 +161,9 @@ public:
       sequenceable_(false),
       sequenceMaxSize_(0),
       sequenceEvents_(),
+      stringSequenceValid_(true),
+      floatSequenceValid_(false),
+      integerSequenceValid_(false),
       lowerLimit_(0.0),
       upperLimit_(0.0),
       name_(name)
@@ -198,6 +210,7 @@ public:
    void AddAllowedValue(const char* value);
    void AddAllowedValue(const char* value, long data);
    bool IsAllowed(const char* value) const;
+   bool HasAllowedValues() const {return !values_.empty();}
    bool GetData(const char* value, long& data) const;
 
    bool HasLimits() const 
@@ -245,35 +258,10 @@ public:
       return sequenceMaxSize_;
    }
 
-   int ClearSequence() 
-   {
-      try
-      {
-         if (sequenceEvents_.size() > 0){
-            sequenceEvents_.clear();
-         }
-      } catch (...)
-      {
-         return MM_CODE_ERR;
-      }
-
-      return DEVICE_OK;
-   }
-
-   int AddToSequence(const char* value) 
-   {
-      try
-      {
-         sequenceEvents_.push_back(value);
-         if (sequenceEvents_.size() > (unsigned) GetSequenceMaxSize())           
-            return DEVICE_SEQUENCE_TOO_LARGE;
-      } catch (...)
-      {
-         return MM_CODE_ERR;
-      }
-
-      return DEVICE_OK;
-   }
+   int ClearSequence();
+   int AddToSequence(const char* value);
+   int SetSequence(const double* values, unsigned long count);
+   int SetSequence(const long* values, unsigned long count);
 
    int SendSequence() 
    {
@@ -288,10 +276,9 @@ public:
       return name_;
    }
 
-   std::vector<std::string> GetSequence() const
-   {
-      return sequenceEvents_;
-   }
+   std::vector<std::string> GetSequence() const;
+   const std::vector<double>& GetFloatSequence() const;
+   const std::vector<long>& GetIntegerSequence() const;
 
    int StartSequence() 
    {
@@ -308,6 +295,8 @@ public:
    }
 
 protected:
+   const std::vector<std::string>& StringSequence() const;
+
    bool readOnly_;
    ActionFunctor* fpAction_;
    bool cached_;
@@ -316,7 +305,14 @@ protected:
    bool limits_;
    bool sequenceable_;
    long sequenceMaxSize_;
-   std::vector<std::string> sequenceEvents_;
+   // The sequence in each form, converted on demand from the form it was
+   // loaded in
+   mutable std::vector<std::string> sequenceEvents_;
+   mutable std::vector<double> floatSequence_;
+   mutable std::vector<long> integerSequence_;
+   mutable bool stringSequenceValid_;
+   mutable bool floatSequenceValid_;
+   mutable bool integerSequenceValid_;
    double lowerLimit_;
    double upperLimit_;
    std::map<std::string, long> values_; // allowed values
@@ -447,6 +443,13 @@ public:
    int GetCurrentPropertyData(const char* name, long& data);
    int Set(const char* propName, const char* Value);
    int Get(const char* propName, std::string& val) const;
+   // Numeric access without string conversion. Fails with
+   // DEVICE_INVALID_PROPERTY_TYPE unless the property is of the matching
+   // type (Float or Integer) and, for setting, has no allowed values.
+   int GetFloat(const char* propName, double& val) const;
+   int GetInteger(const char* propName, long& val) const;
+   int SetFloat(const char* propName, double val);
+   int SetInteger(const char* propName, long val);
    Property* Find(const char* name) const;
    std::vector<std::string> GetNames() const;
    unsigned GetSize() const;
@@ -457,8 +460,11 @@ public:
    int Apply(const char* Name);
 
 private:
-   typedef std::map<std::string, Property*> CPropArray;
+   // Properties are looked up by name on every get and set, so they are
+   // hashed; names_ keeps the (sorted) order in which they are listed.
+   typedef std::unordered_map<std::string, Property*> CPropArray;
    CPropArray properties_;
+   std::vector<std::string> names_;
 };
 
 
@@ -0,0 +1,634 @@
+#include <catch2/catch_all.hpp>
+
+#include "Debayer.h"
+
+#include <cstring>
+#include <random>
+#include <vector>
+
+namespace {
+
+// The original (pre-SIMD) implementation, used as the reference for the
+// Replication and Smooth-Hue algorithms
+class LegacyDebayer
+{
+public:
+   template <typename T>
+   void Convert(const T* input, int* output, int width, int height, int bitDepth, int rowOrder, int algorithm)
+   {
+      if (algorithm == 0)
+         ReplicateDecode(input, output, width, height, bitDepth, rowOrder);
+      else if (algorithm == 2)
+         SmoothDecode(input, output, width, height, bitDepth, rowOrder);
+   }
+
+private:
+   template<typename T>
+   void ReplicateDecode(const T* input, int* out, int width, int height, int bitDepth, int rowOrder);
+   template <typename T>
+   void SmoothDecode(const T* input, int* output, int width, int height, int bitDepth, int rowOrder);
+   unsigned short GetPixel(const unsigned short* v, int x, int y, int width, int height);
+   void SetPixel(std::vector<unsigned short>& v, unsigned short val, int x, int y, int width, int height);
+   unsigned short GetPixel(const unsigned char* v, int x, int y, int width, int height);
+
+   std::vector<unsigned short> r;
+   std::vector<unsigned short> g;
+   std::vector<unsigned short> b;
+};
+
+unsigned short LegacyDebayer::GetPixel(const unsigned short* v, int x, int y, int width, int height)
+{
+   if (x >= width || x < 0 || y >= height || y < 0)
+      return 0;
+   else
+      return v[y*width + x];
+}
+
+void LegacyDebayer::SetPixel(std::vector<unsigned short>& v, unsigned short val, int x, int y, int width, int height)
+{
+   if (x < width && x >= 0 && y < height && y >= 0)
+      v[y*width + x] = val;
+}
+
+unsigned short LegacyDebayer::GetPixel(const unsigned char* v, int x, int y, int width, int height)
+{
+   if (x >= width || x < 0 || y >= height || y < 0)
+      return 0;
+   else
+      return v[y*width + x];
+}
+
+// Replication algorithm
+template <typename T>
+void LegacyDebayer::ReplicateDecode(const T* input, int* output, int width, int height, int bitDepth, int rowOrder)
+{
+   unsigned numPixels(width*height);
+   if (r.size() != numPixels)
+   {
+      r.resize(numPixels);
+      g.resize(numPixels);
+      b.resize(numPixels);
+   }
+
+   int bitShift = bitDepth - 8;
+
+   if (rowOrder == 0 || rowOrder == 1) {
+      for (int y=0; y<height; y+=2) {
+         for (int x=0; x<width; x+=2) {
+            unsigned short one = GetPixel(input, x, y, width, height);
+            SetPixel(b, one, x, y, width, height);
+            SetPixel(b, one, x+1, y, width, height);
+            SetPixel(b, one, x, y+1, width, height);
+            SetPixel(b, one, x+1, y+1, width, height);
+         }
+      }
+
+      for (int y=1; y<height; y+=2) {
+         for (int x=1; x<width; x+=2) {
+            unsigned short one = GetPixel(input, x, y, width, height);
+            SetPixel(r, one, x, y, width, height);
+            SetPixel(r, one, x+1, y, width, height);
+            SetPixel(r, one, x, y+1, width, height);
+            SetPixel(r, one, x+1, y+1, width, height);
+         }
+      }
+
+      for (int y=0; y<height; y+=2) {
+         for (int x=1; x<width; x+=2) {
+            unsigned short one = GetPixel(input, x, y, width, height);
+            SetPixel(g, one, x, y, width, height);
+            SetPixel(g, one, x+1, y, width, height);
+         }
+      }
+
+      for (int y=1; y<height; y+=2) {
+         for (int x=0; x<width; x+=2) {
+            unsigned short one = GetPixel(input, x, y, width, height);
+            SetPixel(g, one, x, y, width, height);
+            SetPixel(g, one, x+1, y, width, height);
+         }
+      }
+
+      if (rowOrder == 0) {
+         for (int i=0; i<height*width; i++)
+         {
+            output[i] = 0;
+            unsigned char* bytePix = (unsigned char*)(output+i);
+            *bytePix = (unsigned char)(r[i] >> bitShift);
+            *(bytePix+1) = (unsigned char)(g[i] >> bitShift);
+            *(bytePix+2) = (unsigned char)(b[i] >> bitShift);
+
+            //rgb.addSlice("red",b);
+            //rgb.addSlice("green",g);
+            //rgb.addSlice("blue",r);
+         }
+      }
+      else if (rowOrder == 1) {
+         for (int i=0; i<height*width; i++)
+         {
+            output[i] = 0;
+            unsigned char* bytePix = (unsigned char*)(output+i);
+            *bytePix = (unsigned char)(b[i] >> bitShift);
+            *(bytePix+1) = (unsigned char)(g[i] >> bitShift);
+            *(bytePix+2) = (unsigned char)(r[i] >> bitShift);
+
+            //rgb.addSlice("red",r);
+            //rgb.addSlice("green",g);
+            //rgb.addSlice("blue",b);
+         }
+      }
+   }
+
+   else if (rowOrder == 2 || rowOrder == 3) {
+      for (int y=1; y<height; y+=2) {
+         for (int x=0; x<width; x+=2) {
+            unsigned short one = GetPixel(input, x, y, width, height);
+            SetPixel(b, one, x, y, width, height);
+            SetPixel(b, one, x+1, y, width, height);
+            SetPixel(b, one, x, y+1, width, height);
+            SetPixel(b, one, x+1, y+1, width, height);
+         }
+      }
+
+      for (int y=0; y<height; y+=2) {
+         for (int x=1; x<width; x+=2) {
+            unsigned short one = GetPixel(input, x, y, width, height);
+            SetPixel(r, one, x, y, width, height);
+            SetPixel(r, one, x+1, y, width, height);
+            SetPixel(r, one, x, y+1, width, height);
+            SetPixel(r, one, x+1, y+1, width, height);
+         }
+      }
+
+      for (int y=0; y<height; y+=2) {
+         for (int x=0; x<width; x+=2) {
+            unsigned short one = GetPixel(input, x, y, width, height);
+            SetPixel(g, one, x, y, width, height);
+            SetPixel(g, one, x+1, y, width, height);
+         }
+      }
+
+      for (int y=1; y<height; y+=2) {
+         for (int x=1; x<width; x+=2) {
+            unsigned short one = GetPixel(input, x, y, width, height);
+            SetPixel(g, one, x, y, width, height);
+            SetPixel(g, one, x+1, y, width, height);
+         }
+      }
+
+      if (rowOrder == 2) {
+         for (int i=0; i<height*width; i++)
+         {
+            output[i] = 0;
+            unsigned char* bytePix = (unsigned char*)(output+i);
+            *bytePix = (unsigned char)(r[i] >> bitShift);
+            *(bytePix+1) = (unsigned char)(g[i] >> bitShift);
+            *(bytePix+2) = (unsigned char)(b[i] >> bitShift);
+
+            //rgb.addSlice("red",b);
+            //rgb.addSlice("green",g);
+            //rgb.addSlice("blue",r);
+         }
+      }
+      else if (rowOrder == 3) {
+         for (int i=0; i<height*width; i++)
+         {
+            output[i] = 0;
+            unsigned char* bytePix = (unsigned char*)(output+i);
+            *bytePix = (unsigned char)(b[i] >> bitShift);
+            *(bytePix+1) = (unsigned char)(g[i] >> bitShift);
+            *(bytePix+2) = (unsigned char)(r[i] >> bitShift);
+
+            //rgb.addSlice("red",r);
+            //rgb.addSlice("green",g);
+            //rgb.addSlice("blue",b);
+         }
+      }
+   }
+}
+
+// Smooth Hue algorithm
+template <typename T>
+void LegacyDebayer::SmoothDecode(const T* input, int* output, int width, int height, int bitDepth, int rowOrder)
+{
+   double G1 = 0;
+   double G2 = 0;
+   double G3 = 0;
+   double G4 = 0;
+   double G5 = 0;
+   double G6 = 0;
+   //double G7 = 0;
+   //double G8 = 0;
+   double G9 = 0;
+   double B1 = 0;
+   double B2 = 0;
+   double B3 = 0;
+   double B4 = 0;
+   double R1 = 0;
+   double R2 = 0;
+   double R3 = 0;
+   double R4 = 0;
+
+   unsigned numPixels(width*height);
+   if (r.size() != numPixels)
+   {
+      r.resize(numPixels);
+      g.resize(numPixels);
+      b.resize(numPixels);
+   }
+
+   int bitShift = bitDepth - 8;
+
+   if (rowOrder == 0 || rowOrder == 1) {
+      //Solve for green pixels first
+      for (int y=0; y<height; y+=2) {
+         for (int x=1; x<width; x+=2) {
+            G1 = GetPixel(input, x, y, width, height);
+            G2 = GetPixel(input, x+2, y, width, height);
+            G3 = GetPixel(input, x+1, y+1, width, height);
+            G4 = GetPixel(input, x+1, y-1, width, height);
+
+            SetPixel(g, (unsigned short)G1, x, y, width, height);
+            if (y==0)
+               SetPixel(g, (unsigned short)((G1+G2+G3)/3.0), x+1, y, width, height);
+            else
+               SetPixel(g, (unsigned short)((G1+G2+G3+G4)/4.0), x+1, y, width, height);
+
+            if (x==1)
+               SetPixel(g, (unsigned short)((G1 + G4 + GetPixel(input, x-1, y+1, width, height))/3.0), x-1, y, width, height);
+         }
+      }
+
+      for (int x=0; x<width; x+=2) {
+         for (int y=1; y<height; y+=2) {
+
+            G1 = GetPixel(input, x, y, width, height);
+            G2 = GetPixel(input, x+2, y, width, height);
+            G3 = GetPixel(input, x+1, y+1, width, height);
+            G4 = GetPixel(input, x+1, y-1, width, height);
+
+            SetPixel(g, (unsigned short)G1, x, y, width, height);
+            if (x==0)
+               SetPixel(g, (unsigned short)((G1+G2+G3)/3.0), x+1, y, width, height);
+            else
+               SetPixel(g, (unsigned short)((G1+G2+G3+G4)/4.0), x+1, y, width, height);
+         }
+      }
+
+      SetPixel(g, (unsigned short)((GetPixel(input, 0, 1, width, height) + GetPixel(input, 1, 0, width, height))/2.0), 0, 0, width, height);
+
+      for (int y=0; y<height; y+=2) {
+         for (int x=0; x<width; x+=2) {
+            B1 = GetPixel(input, x, y, width, height);
+            B2 = GetPixel(input, x+2, y, width, height);
+            B3 = GetPixel(input, x, y+2, width, height);
+            B4 = GetPixel(input, x+2, y+2, width, height);
+            G1 = GetPixel(input, x, y, width, height);
+            G2 = GetPixel(input, x+2, y, width, height);
+            G3 = GetPixel(input, x, y+2, width, height);
+            G4 = GetPixel(input, x+2, y+2, width, height);;
+            G5 = GetPixel(input, x+1, y, width, height);
+            G6 = GetPixel(input, x, y+1, width, height);
+            G9 = GetPixel(input, x+1, y+1, width, height);
+            if (G1==0) G1=1;
+            if (G2==0) G2=1;
+            if (G3==0) G3=1;
+            if (G4==0) G4=1;
+
+            SetPixel(b, (unsigned short)B1, x, y, width, height);
+            //b.putPixel(x+1,y,(int)((G5/2 * ((B1/G1) + (B2/G2)) )) );
+            SetPixel(b, (unsigned short)((G5/2 * ((B1/G1) + (B2/G2)) )), x+1, y, width, height);
+            //b.putPixel(x,y+1,(int)(( G6/2 * ((B1/G1) + (B3/G3)) )) );
+            SetPixel(b, (unsigned short)((G6/2 * ((B1/G1) + (B3/G3)) )), x, y+1, width, height);
+            //b.putPixel(x+1,y+1, (int)((G9/4 *  ((B1/G1) + (B3/G3) + (B2/G2) + (B4/G4)) )) );
+            SetPixel(b, (unsigned short)((G9/4 * ((B1/G1) + (B3/G3) + (B2/G2) + (B4/G4)) )), x+1, y+1, width, height);
+         }
+      }
+
+      for (int y=1; y<height; y+=2) {
+         for (int x=1; x<width; x+=2) {
+            R1 = GetPixel(input, x, y, width, height);
+            R2 = GetPixel(input, x+2, y, width, height);
+            R3 = GetPixel(input, x, y+2, width, height);
+            R4 = GetPixel(input, x+2, y+2, width, height);
+            G1 = GetPixel(input, x, y, width, height);
+            G2 = GetPixel(input, x+2, y, width, height);
+            G3 = GetPixel(input, x, y+2, width, height);
+            G4 = GetPixel(input, x+2, y+2, width, height);
+            G5 = GetPixel(input, x+1, y, width, height);
+            G6 = GetPixel(input, x, y+1, width, height);
+            G9 = GetPixel(input, x+1, y+1, width, height);
+            if(G1==0) G1=1;
+            if(G2==0) G2=1;
+            if(G3==0) G3=1;
+            if(G4==0) G4=1;
+
+            //r.putPixel(x,y,(int)(R1));
+            SetPixel(r, (unsigned short)R1, x, y, width, height);
+            //r.putPixel(x+1,y,(int)((G5/2 * ((R1/G1) + (R2/G2) )) ));
+            SetPixel(r, (unsigned short)((G5/2 * ((R1/G1) + (R2/G2) )) ), x+1, y, width, height);
+            //r.putPixel(x,y+1,(int)(( G6/2 * ((R1/G1) + (R3/G3) )) ));
+            SetPixel(r, (unsigned short)(( G6/2 * ((R1/G1) + (R3/G3) )) ), x, y+1, width, height);
+            //r.putPixel(x+1,y+1, (int)((G9/4 *  ((R1/G1) + (R3/G3) + (R2/G2) + (R4/G4)) ) ));
+            SetPixel(r, (unsigned short)((G9/4 *  ((R1/G1) + (R3/G3) + (R2/G2) + (R4/G4)) ) ), x+1, y+1, width, height);
+         }
+      }
+
+
+      if (rowOrder == 0) {
+         for (int i=0; i<height*width; i++)
+         {
+            output[i] = 0;
+            unsigned char* bytePix = (unsigned char*)(output+i);
+            *bytePix = (unsigned char)(r[i] >> bitShift);
+            *(bytePix+1) = (unsigned char)(g[i] >> bitShift);
+            *(bytePix+2) = (unsigned char)(b[i] >> bitShift);
+
+            //rgb.addSlice("red",b);
+            //rgb.addSlice("green",g);
+            //rgb.addSlice("blue",r);
+         }
+      }
+      else if (rowOrder == 1) {
+         for (int i=0; i<height*width; i++)
+         {
+            output[i] = 0;
+            unsigned char* bytePix = (unsigned char*)(output+i);
+            *bytePix = (unsigned char)(b[i] >> bitShift);
+            *(bytePix+1) = (unsigned char)(g[i] >> bitShift);
+            *(bytePix+2) = (unsigned char)(r[i] >> bitShift);
+
+            //rgb.addSlice("red",r);
+            //rgb.addSlice("green",g);
+            //rgb.addSlice("blue",b);
+         }
+      }
+   }
+
+   else if (rowOrder == 2 || rowOrder == 3) {
+
+      for (int y=0; y<height; y+=2) {
+         for (int x=0; x<width; x+=2) {
+            G1 = GetPixel(input, x, y, width, height);
+            G2 = GetPixel(input, x+2, y, width, height);
+            G3 = GetPixel(input, x+1, y+1, width, height);
+            G4 = GetPixel(input, x+1, y-1, width, height);
+
+            SetPixel(g, (unsigned short)G1, x, y, width, height);
+            if (y==0)
+               SetPixel(g, (unsigned short)((G1+G2+G3)/3.0), x+1, y, width, height);
+            else
+               SetPixel(g, (unsigned short)((G1+G2+G3+G4)/4.0), x+1, y, width, height);
+
+            if (x==1)
+               SetPixel(g, (unsigned short)((G1+G4+GetPixel(input, x-1, y+1, width, height))/3.0), x-1, y, width, height);
+         }
+      }
+
+      for (int y=1; y<height; y+=2) {
+         for (int x=1; x<width; x+=2) {
+            G1 = GetPixel(input, x, y, width, height);
+            G2 = GetPixel(input, x+2, y, width, height);
+            G3 = GetPixel(input, x+1, y+1, width, height);
+            G4 = GetPixel(input, x+1, y-1, width, height);
+
+            SetPixel(g, (unsigned short)G1, x, y, width, height);
+            if (x==0)
+               SetPixel(g, (unsigned short)((G1+G2+G3)/3.0), x+1, y, width, height);
+            else
+               SetPixel(g, (unsigned short)((G1+G2+G3+G4)/4.0), x+1, y, width, height);
+         }
+      }
+
+      SetPixel(g, (unsigned short)((GetPixel(input, 0, 1, width, height) + GetPixel(input, 1, 0, width, height))/2.0), 0, 0, width, height);
+
+      for (int y=1; y<height; y+=2) {
+         for (int x=0; x<width; x+=2) {
+            B1 = GetPixel(input, x, y, width, height);
+            B2 = GetPixel(input, x+2, y, width, height);
+            B3 = GetPixel(input, x, y+2, width, height);
+            B4 = GetPixel(input, x+2, y+2, width, height);
+            G1 = GetPixel(input, x, y, width, height);
+            G2 = GetPixel(input, x+2, y, width, height);
+            G3 = GetPixel(input, x, y+2, width, height);
+            G4 = GetPixel(input, x+2, y+2, width, height);;
+            G5 = GetPixel(input, x+1, y, width, height);
+            G6 = GetPixel(input, x, y+1, width, height);
+            G9 = GetPixel(input, x+1, y+1, width, height);
+            if (G1==0) G1=1;
+            if (G2==0) G2=1;
+            if (G3==0) G3=1;
+            if (G4==0) G4=1;
+
+            SetPixel(b, (unsigned short)B1, x, y, width, height);
+            SetPixel(b, (unsigned short)((G5/2 * ((B1/G1) + (B2/G2)) )), x+1, y, width, height);
+            SetPixel(b, (unsigned short)((G6/2 * ((B1/G1) + (B3/G3)) )), x, y+1, width, height);
+            SetPixel(b, (unsigned short)((G9/4 * ((B1/G1) + (B3/G3) + (B2/G2) + (B4/G4)) )), x+1, y+1, width, height);
+         }
+      }
+
+      for (int y=0; y<height; y+=2) {
+         for (int x=1; x<width; x+=2) {
+            R1 = GetPixel(input, x, y, width, height);
+            R2 = GetPixel(input, x+2, y, width, height);
+            R3 = GetPixel(input, x, y+2, width, height);
+            R4 = GetPixel(input, x+2, y+2, width, height);
+            G1 = GetPixel(input, x, y, width, height);
+            G2 = GetPixel(input, x+2, y, width, height);
+            G3 = GetPixel(input, x, y+2, width, height);
+            G4 = GetPixel(input, x+2, y+2, width, height);
+            G5 = GetPixel(input, x+1, y, width, height);
+            G6 = GetPixel(input, x, y+1, width, height);
+            G9 = GetPixel(input, x+1, y+1, width, height);
+            if(G1==0) G1=1;
+            if(G2==0) G2=1;
+            if(G3==0) G3=1;
+            if(G4==0) G4=1;
+
+            //r.putPixel(x,y,(int)(R1));
+            SetPixel(r, (unsigned short)R1, x, y, width, height);
+            //r.putPixel(x+1,y,(int)((G5/2 * ((R1/G1) + (R2/G2) )) ));
+            SetPixel(r, (unsigned short)((G5/2 * ((R1/G1) + (R2/G2) )) ), x+1, y, width, height);
+            //r.putPixel(x,y+1,(int)(( G6/2 * ((R1/G1) + (R3/G3) )) ));
+            SetPixel(r, (unsigned short)(( G6/2 * ((R1/G1) + (R3/G3) )) ), x, y+1, width, height);
+            //r.putPixel(x+1,y+1, (int)((G9/4 *  ((R1/G1) + (R3/G3) + (R2/G2) + (R4/G4)) ) ));
+            SetPixel(r, (unsigned short)((G9/4 *  ((R1/G1) + (R3/G3) + (R2/G2) + (R4/G4)) ) ), x+1, y+1, width, height);
+         }
+      }
+
+
+
+      if (rowOrder == 2) {
+         for (int i=0; i<height*width; i++)
+         {
+            output[i] = 0;
+            unsigned char* bytePix = (unsigned char*)(output+i);
+            *bytePix = (unsigned char)(r[i] >> bitShift);
+            *(bytePix+1) = (unsigned char)(g[i] >> bitShift);
+            *(bytePix+2) = (unsigned char)(b[i] >> bitShift);
+
+            //rgb.addSlice("red",b);
+            //rgb.addSlice("green",g);
+            //rgb.addSlice("blue",r);
+         }
+      }
+      else if (rowOrder == 3) {
+         for (int i=0; i<height*width; i++)
+         {
+            output[i] = 0;
+            unsigned char* bytePix = (unsigned char*)(output+i);
+            *bytePix = (unsigned char)(b[i] >> bitShift);
+            *(bytePix+1) = (unsigned char)(g[i] >> bitShift);
+            *(bytePix+2) = (unsigned char)(r[i] >> bitShift);
+
+            //rgb.addSlice("red",r);
+            //rgb.addSlice("green",g);
+            //rgb.addSlice("blue",b);
+         }
+      }
+   }
+}
+
+template <typename T>
+std::vector<T> RandomBayer(int width, int height, int bitDepth, unsigned seed)
+{
+   std::mt19937 rng(seed);
+   std::uniform_int_distribution<int> value(0, (1 << bitDepth) - 1);
+   std::uniform_int_distribution<int> percent(0, 99);
+   std::vector<T> pixels(static_cast<std::size_t>(width) * height);
+   for (auto& p : pixels)
+   {
+      // Include plenty of zeros; Smooth-Hue treats them specially
+      p = static_cast<T>(percent(rng) < 10 ? 0 : value(rng));
+   }
+   return pixels;
+}
+
+template <typename T>
+void CheckMatchesLegacy(int width, int height, int bitDepth, int threads)
+{
+   const std::vector<T> input = RandomBayer<T>(width, height, bitDepth,
+         static_cast<unsigned>(width * 1000 + height));
+   for (int algo : { 0, 2 })
+   {
+      for (int order = 0; order < 4; ++order)
+      {
+         CAPTURE(width, height, bitDepth, algo, order);
+         LegacyDebayer legacy;
+         std::vector<int> expected(static_cast<std::size_t>(width) * height);
+         legacy.Convert(input.data(), expected.data(), width, height, bitDepth, order, algo);
+
+         Debayer debayer;
+         debayer.SetOrderIndex(order);
+         debayer.SetAlgorithmIndex(algo);
+         debayer.SetThreadCount(threads);
+         ImgBuffer out;
+         REQUIRE(debayer.Process(out, input.data(), width, height, bitDepth) == DEVICE_OK);
+         REQUIRE(out.Depth() == 4);
+         CHECK(std::memcmp(out.GetPixels(), expected.data(), expected.size() * 4) == 0);
+      }
+   }
+}
+
+} // anonymous namespace
+
+TEST_CASE("Debayer matches original implementation, 8-bit", "[Debayer]")
+{
+   for (int width : { 2, 3, 4, 5, 8, 9, 17, 64 })
+      for (int height : { 2, 3, 4, 7, 16 })
+         CheckMatchesLegacy<unsigned char>(width, height, 8, 1);
+}
+
+TEST_CASE("Debayer matches original implementation, 16-bit", "[Debayer]")
+{
+   for (int bitDepth : { 10, 12, 14, 16 })
+      for (int width : { 2, 5, 6, 33 })
+         for (int height : { 2, 5, 12 })
+            CheckMatchesLegacy<unsigned short>(width, height, bitDepth, 1);
+}
+
+TEST_CASE("Debayer matches original implementation with multiple threads", "[Debayer]")
+{
+   CheckMatchesLegacy<unsigned char>(642, 481, 8, 4);
+   CheckMatchesLegacy<unsigned short>(641, 480, 12, 3);
+}
+
+TEST_CASE("Debayer adaptive smooth hue", "[Debayer]")
+{
+   const int width = 96;
+   const int height = 80;
+
+   SECTION("Uniform gray stays gray")
+   {
+      std::vector<unsigned short> input(width * height, 1000);
+      for (int order = 0; order < 4; ++order)
+      {
+         Debayer debayer;
+         debayer.SetOrderIndex(order);
+         debayer.SetAlgorithmIndex(3);
+         ImgBuffer out;
+         REQUIRE(debayer.Process(out, input.data(), width, height, 12) == DEVICE_OK);
+         const unsigned char* pix = out.GetPixels();
+         for (int i = 0; i < width * height; ++i)
+         {
+            CHECK(pix[4 * i + 0] == 1000 >> 4);
+            CHECK(pix[4 * i + 1] == 1000 >> 4);
+            CHECK(pix[4 * i + 2] == 1000 >> 4);
+         }
+      }
+   }
+
+   SECTION("Flat color field is reconstructed")
+   {
+      // R-G-R-G: R = 200, G = 100, B = 50
+      std::vector<unsigned char> input(width * height);
+      for (int y = 0; y < height; ++y)
+         for (int x = 0; x < width; ++x)
+            input[y * width + x] = (x % 2 == 0 && y % 2 == 0) ? 200 :
+               (x % 2 == 1 && y % 2 == 1) ? 50 : 100;
+      Debayer debayer;
+      debayer.SetAlgorithmIndex(3);
+      ImgBuffer out;
+      REQUIRE(debayer.Process(out, input.data(), width, height, 8) == DEVICE_OK);
+      const unsigned char* pix = out.GetPixels();
+      for (int i = 0; i < width * height; ++i)
+      {
+         CHECK(pix[4 * i + 0] == 50);
+         CHECK(pix[4 * i + 1] == 100);
+         CHECK(pix[4 * i + 2] == 200);
+      }
+   }
+
+   SECTION("Threaded output equals single-threaded output")
+   {
+      const int bigWidth = 640;
+      const int bigHeight = 512;
+      const std::vector<unsigned short> input =
+         RandomBayer<unsigned short>(bigWidth, bigHeight, 12, 42);
+      Debayer single;
+      single.SetAlgorithmIndex(3);
+      single.SetThreadCount(1);
+      Debayer multi;
+      multi.SetAlgorithmIndex(3);
+      multi.SetThreadCount(4);
+      ImgBuffer out1, out2;
+      REQUIRE(single.Process(out1, input.data(), bigWidth, bigHeight, 12) == DEVICE_OK);
+      // The same worker threads process each image
+      for (int threads : { 4, 4, 2, 8, 4 })
+      {
+         CAPTURE(threads);
+         multi.SetThreadCount(threads);
+         REQUIRE(multi.Process(out2, input.data(), bigWidth, bigHeight, 12) == DEVICE_OK);
+         CHECK(std::memcmp(out1.GetPixels(), out2.GetPixels(), bigWidth * bigHeight * 4) == 0);
+      }
+   }
+}
+
+TEST_CASE("Debayer rejects unsupported algorithm", "[Debayer]")
+{
+   std::vector<unsigned char> input(16 * 16);
+   Debayer debayer;
+   debayer.SetAlgorithmIndex(1);
+   ImgBuffer out;
+   CHECK(debayer.Process(out, input.data(), 16, 16, 8) == DEVICE_NOT_SUPPORTED);
+}
@@ -0,0 +1,68 @@
+#include <catch2/catch_all.hpp>
+
+#include "DeviceBase.h"
+#include "MMDeviceConstants.h"
+
+#include <string>
+
+namespace {
+
+template <class U>
+class TestDeviceBase : public CGenericBase<U>
+{
+public:
+   TestDeviceBase()
+   {
+      this->CreateFloatProperty("Float", 1.0, false);
+      this->CreateIntegerProperty("Integer", 1, false);
+   }
+
+   int Initialize() { return DEVICE_OK; }
+   int Shutdown() { return DEVICE_OK; }
+   bool Busy() { return false; }
+   void GetName(char* name) const { CDeviceUtils::CopyLimitedString(name, "Test"); }
+};
+
+class PlainDevice : public TestDeviceBase<PlainDevice>
+{
+};
+
+class InterceptingDevice : public TestDeviceBase<InterceptingDevice>
+{
+public:
+   int SetProperty(const char* name, const char* value)
+   {
+      lastSet = name;
+      return CGenericBase<InterceptingDevice>::SetProperty(name, value);
+   }
+
+   std::string lastSet;
+};
+
+} // anonymous namespace
+
+TEST_CASE("Typed property sets update the property", "[DeviceBase]")
+{
+   PlainDevice dev;
+   CHECK(dev.SetFloatPropertyValue("Float", 2.5) == DEVICE_OK);
+   CHECK(dev.SetIntegerPropertyValue("Integer", 7) == DEVICE_OK);
+   double d = 0.0;
+   long l = 0;
+   CHECK(dev.GetFloatPropertyValue("Float", d) == DEVICE_OK);
+   CHECK(dev.GetIntegerPropertyValue("Integer", l) == DEVICE_OK);
+   CHECK(d == 2.5);
+   CHECK(l == 7);
+}
+
+TEST_CASE("Typed property sets defer to an overridden SetProperty()", "[DeviceBase]")
+{
+   InterceptingDevice dev;
+   CHECK(dev.SetFloatPropertyValue("Float", 2.5) == DEVICE_INVALID_PROPERTY_TYPE);
+   CHECK(dev.SetIntegerPropertyValue("Integer", 7) == DEVICE_INVALID_PROPERTY_TYPE);
+   CHECK(dev.lastSet.empty());
+
+   // Typed gets are unaffected
+   long l = 0;
+   CHECK(dev.GetIntegerPropertyValue("Integer", l) == DEVICE_OK);
+   CHECK(l == 1);
+}
@@ -0,0 +1,103 @@
+#include <catch2/catch_all.hpp>
+
+#include "DeviceThreads.h"
+
+#include <atomic>
+#include <thread>
+
+namespace {
+
+class RecordingThread : public MMDeviceThreadBase
+{
+public:
+   std::atomic<int> runs{ 0 };
+   std::atomic<int> policy{ -1 };
+   std::atomic<bool> onlyOnCPU0{ false };
+
+   int svc() override
+   {
+#ifndef _WIN32
+      int p = 0;
+      sched_param param;
+      if (pthread_getschedparam(pthread_self(), &p, &param) == 0)
+         policy = p;
+#endif
+#ifdef __linux__
+      cpu_set_t set;
+      if (pthread_getaffinity_np(pthread_self(), sizeof(set), &set) == 0)
+         onlyOnCPU0 = CPU_ISSET(0, &set) && CPU_COUNT(&set) == 1;
+#endif
+      ++runs;
+      return 0;
+   }
+};
+
+} // anonymous namespace
+
+TEST_CASE("Threads run with default attributes", "[DeviceThreads]")
+{
+   RecordingThread thread;
+   CHECK(thread.getAttributes().policy == MMThreadAttributes::PolicyNormal);
+   CHECK(thread.getAttributes().cpuMask == 0);
+   thread.activate();
+   thread.wait();
+   CHECK(thread.runs == 1);
+   CHECK(thread.attributesApplied());
+#ifndef _WIN32
+   CHECK(thread.policy == SCHED_OTHER);
+#endif
+}
+
+TEST_CASE("Threads run with CPU affinity and stack size", "[DeviceThreads]")
+{
+   RecordingThread thread;
+   MMThreadAttributes attributes;
+   attributes.cpuMask = 1;
+   attributes.stackSize = 1 << 20;
+   thread.setAttributes(attributes);
+   thread.activate();
+   thread.wait();
+   CHECK(thread.runs == 1);
+#ifdef __linux__
+   CHECK(thread.attributesApplied());
+   CHECK(thread.onlyOnCPU0);
+#endif
+
+   // Unavailable CPUs are ignored
+   attributes.cpuMask = 1ULL << 63;
+   attributes.stackSize = 0;
+   thread.setAttributes(attributes);
+   thread.activate();
+   thread.wait();
+   CHECK(thread.runs == 2);
+#ifdef __linux__
+   if (std::thread::hardware_concurrency() < 64)
+      CHECK_FALSE(thread.attributesApplied());
+#endif
+
+   // An unusable stack size is ignored
+   attributes.cpuMask = 0;
+   attributes.stackSize = 1;
+   thread.setAttributes(attributes);
+   thread.activate();
+   thread.wait();
+   CHECK(thread.runs == 3);
+#ifndef _WIN32
+   CHECK_FALSE(thread.attributesApplied());
+#endif
+}
+
+TEST_CASE("Threads run even if real-time priority is not permitted", "[DeviceThreads]")
+{
+   RecordingThread thread;
+   MMThreadAttributes attributes;
+   attributes.policy = MMThreadAttributes::PolicyRealTime;
+   attributes.priority = 200; // Limited to the highest priority
+   thread.setAttributes(attributes);
+   thread.activate();
+   thread.wait();
+   CHECK(thread.runs == 1);
+#ifndef _WIN32
+   CHECK(thread.policy == (thread.attributesApplied() ? SCHED_FIFO : SCHED_OTHER));
+#endif
+}
@@ -0,0 +1,301 @@
+#include <catch2/catch_all.hpp>
+
+#include "PackedPixels.h"
+
+#include <cstddef>
+#include <random>
+#include <vector>
+
+namespace {
+
+const PackedPixels::Format allFormats[] = {
+   PackedPixels::Mono10p,
+   PackedPixels::Mono12p,
+   PackedPixels::Mono10Packed,
+   PackedPixels::Mono12Packed,
+   PackedPixels::MipiRaw10,
+   PackedPixels::MipiRaw12,
+};
+
+// Straightforward per-pixel implementations of the layout definitions
+
+unsigned short ReferencePixel(PackedPixels::Format format,
+      const unsigned char* src, std::size_t i)
+{
+   switch (format)
+   {
+      case PackedPixels::Mono10p:
+      case PackedPixels::Mono12p:
+      {
+         const unsigned bits = PackedPixels::BitDepth(format);
+         unsigned value = 0;
+         for (unsigned b = 0; b < bits; ++b)
+         {
+            const std::size_t bit = i * bits + b;
+            value |= ((src[bit / 8] >> (bit % 8)) & 1u) << b;
+         }
+         return static_cast<unsigned short>(value);
+      }
+      case PackedPixels::Mono10Packed:
+      {
+         const unsigned char* g = src + i / 2 * 3;
+         if (i % 2 == 0)
+            return static_cast<unsigned short>((g[0] << 2) | (g[1] & 0x3));
+         return static_cast<unsigned short>((g[2] << 2) | ((g[1] >> 4) & 0x3));
+      }
+      case PackedPixels::Mono12Packed:
+      {
+         const unsigned char* g = src + i / 2 * 3;
+         if (i % 2 == 0)
+            return static_cast<unsigned short>((g[0] << 4) | (g[1] & 0xF));
+         return static_cast<unsigned short>((g[2] << 4) | (g[1] >> 4));
+      }
+      case PackedPixels::MipiRaw10:
+      {
+         const unsigned char* g = src + i / 4 * 5;
+         const unsigned k = i % 4;
+         return static_cast<unsigned short>((g[k] << 2) | ((g[4] >> (2 * k)) & 0x3));
+      }
+      case PackedPixels::MipiRaw12:
+      {
+         const unsigned char* g = src + i / 2 * 3;
+         if (i % 2 == 0)
+            return static_cast<unsigned short>((g[0] << 4) | (g[2] & 0xF));
+         return static_cast<unsigned short>((g[1] << 4) | (g[2] >> 4));
+      }
+   }
+   return 0;
+}
+
+std::vector<unsigned char> ReferencePack(PackedPixels::Format format,
+      const std::vector<unsigned short>& pixels)
+{
+   std::vector<unsigned char> out(PackedPixels::PackedBytes(format, pixels.size()), 0);
+   for (std::size_t i = 0; i < pixels.size(); ++i)
+   {
+      const unsigned p = pixels[i];
+      switch (format)
+      {
+         case PackedPixels::Mono10p:
+         case PackedPixels::Mono12p:
+         {
+            const unsigned bits = PackedPixels::BitDepth(format);
+            for (unsigned b = 0; b < bits; ++b)
+            {
+               const std::size_t bit = i * bits + b;
+               out[bit / 8] |= static_cast<unsigned char>(((p >> b) & 1u) << (bit % 8));
+            }
+            break;
+         }
+         case PackedPixels::Mono10Packed:
+         {
+            unsigned char* g = &out[i / 2 * 3];
+            if (i % 2 == 0)
+            {
+               g[0] = static_cast<unsigned char>(p >> 2);
+               g[1] |= static_cast<unsigned char>(p & 0x3);
+            }
+            else
+            {
+               g[2] = static_cast<unsigned char>(p >> 2);
+               g[1] |= static_cast<unsigned char>((p & 0x3) << 4);
+            }
+            break;
+         }
+         case PackedPixels::Mono12Packed:
+         {
+            unsigned char* g = &out[i / 2 * 3];
+            if (i % 2 == 0)
+            {
+               g[0] = static_cast<unsigned char>(p >> 4);
+               g[1] |= static_cast<unsigned char>(p & 0xF);
+            }
+            else
+            {
+               g[2] = static_cast<unsigned char>(p >> 4);
+               g[1] |= static_cast<unsigned char>((p & 0xF) << 4);
+            }
+            break;
+         }
+         case PackedPixels::MipiRaw10:
+         {
+            unsigned char* g = &out[i / 4 * 5];
+            const unsigned k = i % 4;
+            g[k] = static_cast<unsigned char>(p >> 2);
+            g[4] |= static_cast<unsigned char>((p & 0x3) << (2 * k));
+            break;
+         }
+         case PackedPixels::MipiRaw12:
+         {
+            unsigned char* g = &out[i / 2 * 3];
+            g[i % 2] = static_cast<unsigned char>(p >> 4);
+            g[2] |= static_cast<unsigned char>((p & 0xF) << (4 * (i % 2)));
+            break;
+         }
+      }
+   }
+   return out;
+}
+
+std::vector<std::size_t> TestCounts()
+{
+   std::vector<std::size_t> counts;
+   for (std::size_t n = 0; n <= 40; ++n)
+      counts.push_back(n);
+   counts.push_back(1023);
+   counts.push_back(4096);
+   return counts;
+}
+
+} // namespace
+
+TEST_CASE("Packed sizes", "[PackedPixels]")
+{
+   CHECK(PackedPixels::PackedBytes(PackedPixels::Mono10p, 4) == 5);
+   CHECK(PackedPixels::PackedBytes(PackedPixels::Mono10p, 1) == 2);
+   CHECK(PackedPixels::PackedBytes(PackedPixels::Mono12p, 2) == 3);
+   CHECK(PackedPixels::PackedBytes(PackedPixels::Mono12p, 3) == 5);
+   CHECK(PackedPixels::PackedBytes(PackedPixels::Mono10Packed, 3) == 6);
+   CHECK(PackedPixels::PackedBytes(PackedPixels::Mono12Packed, 640) == 960);
+   CHECK(PackedPixels::PackedBytes(PackedPixels::MipiRaw10, 5) == 10);
+   CHECK(PackedPixels::PackedBytes(PackedPixels::MipiRaw12, 1) == 3);
+   CHECK(PackedPixels::BitDepth(PackedPixels::MipiRaw10) == 10);
+   CHECK(PackedPixels::BitDepth(PackedPixels::Mono12Packed) == 12);
+}
+
+TEST_CASE("Unpack matches layout definitions", "[PackedPixels]")
+{
+   std::mt19937 rng(42);
+   std::uniform_int_distribution<int> byteDist(0, 255);
+
+   for (PackedPixels::Format format : allFormats)
+   {
+      for (std::size_t count : TestCounts())
+      {
+         // Offset by one byte to exercise unaligned access
+         const std::size_t bytes = PackedPixels::PackedBytes(format, count);
+         std::vector<unsigned char> storage(bytes + 1);
+         for (unsigned char& b : storage)
+            b = static_cast<unsigned char>(byteDist(rng));
+         const unsigned char* src = storage.data() + 1;
+
+         std::vector<unsigned short> out(count + 1, 0xBEEF);
+         PackedPixels::Unpack(format, out.data(), src, count);
+
+         INFO("format " << format << ", " << count << " pixels");
+         for (std::size_t i = 0; i < count; ++i)
+         {
+            INFO("pixel " << i);
+            REQUIRE(out[i] == ReferencePixel(format, src, i));
+         }
+         CHECK(out[count] == 0xBEEF);
+      }
+   }
+}
+
+TEST_CASE("Pack matches layout definitions", "[PackedPixels]")
+{
+   std::mt19937 rng(7);
+
+   for (PackedPixels::Format format : allFormats)
+   {
+      const unsigned maxValue = (1u << PackedPixels::BitDepth(format)) - 1;
+      std::uniform_int_distribution<unsigned> pixelDist(0, maxValue);
+      for (std::size_t count : TestCounts())
+      {
+         std::vector<unsigned short> pixels(count);
+         for (unsigned short& p : pixels)
+            p = static_cast<unsigned short>(pixelDist(rng));
+
+         const std::vector<unsigned char> expected = ReferencePack(format, pixels);
+         std::vector<unsigned char> out(expected.size() + 1, 0xA5);
+         const std::size_t saturated =
+            PackedPixels::Pack(format, out.data(), pixels.data(), count);
+
+         INFO("format " << format << ", " << count << " pixels");
+         CHECK(saturated == 0);
+         for (std::size_t i = 0; i < expected.size(); ++i)
+         {
+            INFO("byte " << i);
+            REQUIRE(out[i] == expected[i]);
+         }
+         CHECK(out[expected.size()] == 0xA5);
+
+         std::vector<unsigned short> roundTrip(count);
+         PackedPixels::Unpack(format, roundTrip.data(), out.data(), count);
+         CHECK(roundTrip == pixels);
+      }
+   }
+}
+
+TEST_CASE("Pack saturates and counts out-of-range values", "[PackedPixels]")
+{
+   for (PackedPixels::Format format : allFormats)
+   {
+      const unsigned short maxValue =
+         static_cast<unsigned short>((1u << PackedPixels::BitDepth(format)) - 1);
+      std::vector<unsigned short> pixels(21);
+      for (std::size_t i = 0; i < pixels.size(); ++i)
+         pixels[i] = static_cast<unsigned short>(i % 3 == 0 ? 65535 : maxValue + i);
+      pixels[4] = 17;
+
+      pixels[5] = maxValue;
+
+      std::vector<unsigned char> packed(PackedPixels::PackedBytes(format, pixels.size()));
+      INFO("format " << format);
+      CHECK(PackedPixels::Pack(format, packed.data(), pixels.data(),
+               pixels.size()) == pixels.size() - 2);
+      std::vector<unsigned short> out(pixels.size());
+      PackedPixels::Unpack(format, out.data(), packed.data(), pixels.size());
+
+      CHECK(out[4] == 17);
+      for (std::size_t i = 0; i < out.size(); ++i)
+      {
+         if (i != 4)
+            CHECK(out[i] == maxValue);
+      }
+   }
+}
+
+TEST_CASE("Unpack rows with padding", "[PackedPixels]")
+{
+   std::mt19937 rng(3);
+   std::uniform_int_distribution<int> byteDist(0, 255);
+
+   const unsigned width = 37;
+   const unsigned height = 5;
+   for (PackedPixels::Format format : allFormats)
+   {
+      const std::size_t rowBytes = PackedPixels::PackedBytes(format, width);
+      const std::size_t stride = rowBytes + 3;
+      std::vector<unsigned char> src(stride * height);
+      for (unsigned char& b : src)
+         b = static_cast<unsigned char>(byteDist(rng));
+
+      std::vector<unsigned short> out(width * height);
+      PackedPixels::UnpackRows(format, out.data(), src.data(), stride, width, height);
+
+      INFO("format " << format);
+      for (unsigned y = 0; y < height; ++y)
+         for (unsigned x = 0; x < width; ++x)
+            REQUIRE(out[y * width + x] == ReferencePixel(format, &src[y * stride], x));
+   }
+}
+
+TEST_CASE("Formats from PFNC names", "[PackedPixels]")
+{
+   PackedPixels::Format format = PackedPixels::MipiRaw10;
+   CHECK(PackedPixels::FormatFromName("Mono10p", format));
+   CHECK(format == PackedPixels::Mono10p);
+   CHECK(PackedPixels::FormatFromName("BayerRG12p", format));
+   CHECK(format == PackedPixels::Mono12p);
+   CHECK(PackedPixels::FormatFromName("Mono12Packed", format));
+   CHECK(format == PackedPixels::Mono12Packed);
+   CHECK(PackedPixels::FormatFromName("BayerGB10Packed", format));
+   CHECK(format == PackedPixels::Mono10Packed);
+
+   CHECK_FALSE(PackedPixels::FormatFromName("Mono12", format));
+   CHECK_FALSE(PackedPixels::FormatFromName("Mono8", format));
+   CHECK_FALSE(PackedPixels::FormatFromName("RGB12p", format));
+   CHECK_FALSE(PackedPixels::FormatFromName(0, format));
+}
@@ -0,0 +1,123 @@
+#include <catch2/catch_all.hpp>
+
+#include "MMDeviceConstants.h"
+#include "Property.h"
+
+#include <cstdio>
+#include <string>
+#include <vector>
+
+namespace MM {
+
+TEST_CASE("Properties are listed in name order", "[PropertyCollection]")
+{
+   PropertyCollection props;
+   CHECK(props.CreateProperty("Gain", "1", Integer, false) == DEVICE_OK);
+   CHECK(props.CreateProperty("Binning", "1", Integer, false) == DEVICE_OK);
+   CHECK(props.CreateProperty("Exposure", "10.0", Float, false) == DEVICE_OK);
+   CHECK(props.CreateProperty("Name", "Cam", String, true) == DEVICE_OK);
+
+   CHECK(props.GetSize() == 4);
+   CHECK(props.GetNames() ==
+         std::vector<std::string>{ "Binning", "Exposure", "Gain", "Name" });
+   std::string name;
+   CHECK(props.GetName(2, name));
+   CHECK(name == "Gain");
+   CHECK_FALSE(props.GetName(4, name));
+}
+
+TEST_CASE("Properties are found by name", "[PropertyCollection]")
+{
+   PropertyCollection props;
+   CHECK(props.CreateProperty("Exposure", "10.0", Float, false) == DEVICE_OK);
+   CHECK(props.CreateProperty("Exposure", "1.0", Float, false) == DEVICE_DUPLICATE_PROPERTY);
+
+   REQUIRE(props.Find("Exposure") != nullptr);
+   CHECK(props.Find("Exposure")->GetName() == "Exposure");
+   CHECK(props.Find("exposure") == nullptr);
+   CHECK(props.Find("") == nullptr);
+
+   CHECK(props.Set("Exposure", "25.5") == DEVICE_OK);
+   std::string value;
+   CHECK(props.Get("Exposure", value) == DEVICE_OK);
+   CHECK(value == "25.5000");
+   CHECK(props.Set("Gain", "2") == DEVICE_INVALID_PROPERTY);
+   CHECK(props.Get("Gain", value) == DEVICE_INVALID_PROPERTY);
+}
+
+TEST_CASE("Numeric properties are accessed without strings", "[PropertyCollection]")
+{
+   PropertyCollection props;
+   CHECK(props.CreateProperty("Exposure", "10.0", Float, false) == DEVICE_OK);
+   CHECK(props.CreateProperty("Binning", "1", Integer, false) == DEVICE_OK);
+   CHECK(props.CreateProperty("Mode", "Fast", String, false) == DEVICE_OK);
+
+   double d;
+   long l;
+   CHECK(props.SetFloat("Exposure", 12.25) == DEVICE_OK);
+   CHECK(props.GetFloat("Exposure", d) == DEVICE_OK);
+   CHECK(d == 12.25);
+   std::string value;
+   CHECK(props.Get("Exposure", value) == DEVICE_OK);
+   CHECK(value == "12.2500");
+
+   CHECK(props.SetInteger("Binning", 4) == DEVICE_OK);
+   CHECK(props.GetInteger("Binning", l) == DEVICE_OK);
+   CHECK(l == 4);
+
+   // Only the matching type
+   CHECK(props.GetInteger("Exposure", l) == DEVICE_INVALID_PROPERTY_TYPE);
+   CHECK(props.SetInteger("Exposure", 1) == DEVICE_INVALID_PROPERTY_TYPE);
+   CHECK(props.GetFloat("Binning", d) == DEVICE_INVALID_PROPERTY_TYPE);
+   CHECK(props.GetFloat("Mode", d) == DEVICE_INVALID_PROPERTY_TYPE);
+   CHECK(props.GetFloat("Gain", d) == DEVICE_INVALID_PROPERTY);
+   CHECK(props.SetFloat("Gain", 1.0) == DEVICE_INVALID_PROPERTY);
+}
+
+TEST_CASE("Numeric set checks limits and truncates as string set does", "[PropertyCollection]")
+{
+   PropertyCollection props;
+   CHECK(props.CreateProperty("Position", "0.0", Float, false) == DEVICE_OK);
+   REQUIRE(props.Find("Position")->SetLimits(-10.0, 10.0));
+
+   const double values[] = { 0.00004, 0.00005, -0.00005, 1.23456, -9.99999 };
+   for (double v : values)
+   {
+      std::string text;
+      CHECK(props.SetFloat("Position", v) == DEVICE_OK);
+      CHECK(props.Get("Position", text) == DEVICE_OK);
+
+      char buf[32];
+      snprintf(buf, sizeof(buf), "%.17g", v);
+      CHECK(props.Set("Position", buf) == DEVICE_OK);
+      std::string expected;
+      CHECK(props.Get("Position", expected) == DEVICE_OK);
+      CHECK(text == expected);
+   }
+
+   double d;
+   CHECK(props.SetFloat("Position", 10.5) == DEVICE_INVALID_PROPERTY_VALUE);
+   CHECK(props.GetFloat("Position", d) == DEVICE_OK);
+   CHECK(d == -10.0);
+}
+
+TEST_CASE("Numeric set defers to string set for allowed values", "[PropertyCollection]")
+{
+   PropertyCollection props;
+   CHECK(props.CreateProperty("Binning", "1", Integer, false) == DEVICE_OK);
+   CHECK(props.AddAllowedValue("Binning", "1") == DEVICE_OK);
+   CHECK(props.AddAllowedValue("Binning", "2") == DEVICE_OK);
+   CHECK(props.SetInteger("Binning", 2) == DEVICE_INVALID_PROPERTY_TYPE);
+   long l;
+   CHECK(props.GetInteger("Binning", l) == DEVICE_OK);
+   CHECK(l == 1);
+
+   // Read-only properties are silently left unchanged, as with Set()
+   CHECK(props.CreateProperty("Temperature", "20.0", Float, true) == DEVICE_OK);
+   CHECK(props.SetFloat("Temperature", 25.0) == DEVICE_OK);
+   double d;
+   CHECK(props.GetFloat("Temperature", d) == DEVICE_OK);
+   CHECK(d == 20.0);
+}
+
+} // namespace MM
@@ -0,0 +1,83 @@
+#include <catch2/catch_all.hpp>
+
+#include "MMDeviceConstants.h"
+#include "Property.h"
+
+#include <string>
+#include <vector>
+
+namespace MM {
+
+TEST_CASE("Float sequence is read back in all forms", "[PropertySequence]")
+{
+   FloatProperty fp("TestProp");
+   fp.SetSequenceable(10);
+   const double values[] = { 0.5, -1.25, 3.0, 0.1 };
+   CHECK(fp.SetSequence(values, 4) == DEVICE_OK);
+
+   CHECK(fp.GetFloatSequence() == std::vector<double>(values, values + 4));
+   CHECK(fp.GetIntegerSequence() == std::vector<long>{ 0, -1, 3, 0 });
+
+   std::vector<std::string> strings = fp.GetSequence();
+   REQUIRE(strings.size() == 4);
+   CHECK(strings[0] == "0.5");
+   CHECK(strings[1] == "-1.25");
+   CHECK(strings[2] == "3");
+   // Values that do not survive 15 digits are formatted exactly
+   CHECK(std::stod(strings[3]) == 0.1);
+}
+
+TEST_CASE("Integer sequence is read back in all forms", "[PropertySequence]")
+{
+   IntegerProperty ip("TestProp");
+   ip.SetSequenceable(10);
+   const long values[] = { 2, -7, 100000 };
+   CHECK(ip.SetSequence(values, 3) == DEVICE_OK);
+
+   CHECK(ip.GetIntegerSequence() == std::vector<long>(values, values + 3));
+   CHECK(ip.GetFloatSequence() == std::vector<double>{ 2.0, -7.0, 100000.0 });
+   CHECK(ip.GetSequence() == std::vector<std::string>{ "2", "-7", "100000" });
+}
+
+TEST_CASE("String sequence is converted to numbers", "[PropertySequence]")
+{
+   FloatProperty fp("TestProp");
+   fp.SetSequenceable(10);
+   CHECK(fp.AddToSequence("1.5") == DEVICE_OK);
+   CHECK(fp.AddToSequence("-2") == DEVICE_OK);
+
+   CHECK(fp.GetSequence() == std::vector<std::string>{ "1.5", "-2" });
+   CHECK(fp.GetFloatSequence() == std::vector<double>{ 1.5, -2.0 });
+   CHECK(fp.GetIntegerSequence() == std::vector<long>{ 1, -2 });
+}
+
+TEST_CASE("Adding to a numeric sequence appends to it", "[PropertySequence]")
+{
+   FloatProperty fp("TestProp");
+   fp.SetSequenceable(10);
+   const double values[] = { 1.0, 2.0 };
+   CHECK(fp.SetSequence(values, 2) == DEVICE_OK);
+   CHECK(fp.AddToSequence("4.5") == DEVICE_OK);
+   CHECK(fp.GetFloatSequence() == std::vector<double>{ 1.0, 2.0, 4.5 });
+
+   CHECK(fp.ClearSequence() == DEVICE_OK);
+   CHECK(fp.GetSequence().empty());
+   CHECK(fp.GetFloatSequence().empty());
+   CHECK(fp.GetIntegerSequence().empty());
+}
+
+TEST_CASE("Too long sequences are rejected", "[PropertySequence]")
+{
+   FloatProperty fp("TestProp");
+   fp.SetSequenceable(2);
+   const double values[] = { 1.0, 2.0, 3.0 };
+   CHECK(fp.SetSequence(values, 3) == DEVICE_SEQUENCE_TOO_LARGE);
+   CHECK(fp.SetSequence(values, 2) == DEVICE_OK);
+   CHECK(fp.AddToSequence("3") == DEVICE_SEQUENCE_TOO_LARGE);
+
+   IntegerProperty ip("TestProp");
+   const long longs[] = { 1 };
+   CHECK(ip.SetSequence(longs, 1) == DEVICE_SEQUENCE_TOO_LARGE);
+}
+
+} // namespace MM